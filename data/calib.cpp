@@ -0,0 +1,497 @@
+/**
+ * mieze-tool
+ * detector calibration applied while loading pad and tof data
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "calib.h"
+#include "main/settings.h"
+#include "loader/loadcasc.h"
+#include "helper/mfourier.h"
+#include "helper/workpool.h"
+#include "data/data.h"
+
+#include "tlibs/phys/mieze.h"
+#include "tlibs/string/string.h"
+#include "tlibs/helper/misc.h"
+#include "tlibs/log/log.h"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QDateTime>
+
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+#include <boost/numeric/ublas/matrix.hpp>
+
+
+namespace ublas = boost::numeric::ublas;
+namespace units = boost::units;
+
+using tl::cm;
+using tl::angstrom;
+using tl::ps;
+
+
+CalibConfig CalibConfig::FromSettings()
+{
+	CalibConfig cfg;
+	cfg.bEnabled = Settings::Get<int>("calib/enabled");
+
+	cfg.strEfficiency = Settings::Get<QString>("calib/efficiency_file").toStdString();
+	cfg.strBackground = Settings::Get<QString>("calib/background_file").toStdString();
+	cfg.dBackgroundScale = Settings::Get<double>("calib/background_scale");
+
+	cfg.phases = CalibPhases(Settings::Get<int>("calib/phases"));
+	cfg.strPhases = Settings::Get<QString>("calib/phase_file").toStdString();
+	cfg.dNumOsc = Settings::Get<double>("mieze/num_osc");
+
+	cfg.dDeadTime = Settings::Get<double>("calib/dead_time");
+	cfg.strTimeKey = Settings::Get<QString>("calib/time_key").toStdString();
+
+	return cfg;
+}
+
+
+// theoretical phases of the psd phase dialog, for the detector resolution
+static bool get_theo_phases(unsigned int iW, unsigned int iH, std::vector<double>& vecPhases)
+{
+	if(!Settings::HasKey("phase/lx"))
+	{
+		tl::log_err("No theoretical phase map configured, set it up in the psd phase dialog.");
+		return false;
+	}
+
+	units::quantity<units::si::length> lx = Settings::Get<double>("phase/lx")*cm;
+	units::quantity<units::si::length> ly = Settings::Get<double>("phase/ly")*cm;
+	units::quantity<units::si::length> Ls = Settings::Get<double>("phase/Ls")*cm;
+	units::quantity<units::si::time> tau = Settings::Get<double>("phase/tau")*ps;
+	units::quantity<units::si::length> lam = Settings::Get<double>("phase/lam")*angstrom;
+	units::quantity<units::si::length> xpos = Settings::Get<double>("phase/center_x")*cm;
+	units::quantity<units::si::length> ypos = Settings::Get<double>("phase/center_y")*cm;
+	units::quantity<units::si::plane_angle> phase_offs =
+		Settings::Get<double>("phase/central_phase")*units::si::radians;
+
+	ublas::matrix<double> matPhases;
+	tl::mieze_reduction_det(lx, ly, xpos, ypos, Ls, tau, lam, phase_offs, iW, iH, &matPhases);
+
+	vecPhases.resize(std::size_t(iW)*iH);
+	for(unsigned int iY=0; iY<iH; ++iY)
+		for(unsigned int iX=0; iX<iW; ++iX)
+			vecPhases[iY*iW + iX] = matPhases(iX, iY);
+	return true;
+}
+
+static bool load_phases(const std::string& strFile, unsigned int iW, unsigned int iH,
+	std::vector<double>& vecPhases)
+{
+	std::ifstream ifstr(strFile);
+	vecPhases.resize(std::size_t(iW)*iH);
+
+	for(double& dPhase : vecPhases)
+	{
+		if(!(ifstr >> dPhase))
+		{
+			tl::log_err("Phase map \"", strFile, "\" needs ", iW, "x", iH, " values.");
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool load_efficiency(const std::string& strFile, unsigned int iW, unsigned int iH,
+	std::vector<double>& vecWeights)
+{
+	PadFile pad(strFile.c_str());
+	const unsigned int *pDat = pad.IsOpen() ? pad.GetData() : 0;
+	if(!pDat || pad.GetWidth()!=iW || pad.GetHeight()!=iH)
+	{
+		tl::log_err("Cannot use efficiency map \"", strFile, "\".");
+		if(pDat) pad.ReleaseData(pDat);
+		return false;
+	}
+
+	const std::size_t iSize = std::size_t(iW)*iH;
+	double dTotal = 0.;
+	std::size_t iLive = 0;
+	for(std::size_t i=0; i<iSize; ++i)
+	{
+		dTotal += pDat[i];
+		iLive += (pDat[i] != 0);
+	}
+
+	// dead pixels are masked
+	const double dMean = iLive ? dTotal/double(iLive) : 0.;
+	vecWeights.resize(iSize);
+	for(std::size_t i=0; i<iSize; ++i)
+		vecWeights[i] = pDat[i] ? dMean/double(pDat[i]) : 0.;
+
+	pad.ReleaseData(pDat);
+	return true;
+}
+
+static bool load_background(const std::string& strFile, CalibTables& tab)
+{
+	const std::size_t iSliceSize = std::size_t(tab.iW)*tab.iH;
+	const std::string strExt = tl::get_fileext(strFile);
+
+	if(tl::str_is_equal(strExt, std::string("tof")))
+	{
+		TofFile tof(strFile.c_str());
+		if(!tof.IsOpen() || tof.GetWidth()!=tab.iW || tof.GetHeight()!=tab.iH)
+		{
+			tl::log_err("Cannot use background \"", strFile, "\".");
+			return false;
+		}
+
+		// pad data gets the background summed over all bins of a pixel
+		tab.bBkgPerBin = (tab.iTc == tof.GetTcCnt() && tab.iFoils == tof.GetFoilCnt());
+		tab.vecBkg.assign(tab.bBkgPerBin ? iSliceSize*tab.iTc*tab.iFoils : iSliceSize, 0.);
+
+		const std::size_t iFoilSize = iSliceSize*tof.GetTcCnt();
+		for(unsigned int iFoil=0; iFoil<tof.GetFoilCnt(); ++iFoil)
+		{
+			const unsigned int *pDat = tof.GetData(iFoil);
+			if(!pDat)
+			{
+				tl::log_err("Cannot read background \"", strFile, "\".");
+				return false;
+			}
+
+			if(tab.bBkgPerBin)
+			{
+				std::copy(pDat, pDat+iFoilSize, tab.vecBkg.begin() + iFoil*iFoilSize);
+			}
+			else
+			{
+				for(std::size_t i=0; i<iFoilSize; ++i)
+					tab.vecBkg[i % iSliceSize] += pDat[i];
+			}
+			tof.ReleaseData(pDat);
+		}
+
+		if(!tab.bBkgPerBin)
+			for(double& dBkg : tab.vecBkg)
+				dBkg /= double(tab.iTc)*tab.iFoils;
+	}
+	else
+	{
+		PadFile pad(strFile.c_str());
+		const unsigned int *pDat = pad.IsOpen() ? pad.GetData() : 0;
+		if(!pDat || pad.GetWidth()!=tab.iW || pad.GetHeight()!=tab.iH)
+		{
+			tl::log_err("Cannot use background \"", strFile, "\".");
+			if(pDat) pad.ReleaseData(pDat);
+			return false;
+		}
+
+		tab.bBkgPerBin = 0;
+		tab.vecBkg.resize(iSliceSize);
+		for(std::size_t i=0; i<iSliceSize; ++i)
+			tab.vecBkg[i] = double(pDat[i]) / (double(tab.iTc)*tab.iFoils);
+		pad.ReleaseData(pDat);
+	}
+
+	for(double& dBkg : tab.vecBkg)
+		dBkg *= tab.dBkgScale;
+	return true;
+}
+
+
+// the files are part of the key with their modification times
+static std::string file_key(const std::string& strFile)
+{
+	if(strFile == "")
+		return "-";
+
+	QFileInfo info(strFile.c_str());
+	std::ostringstream ostr;
+	ostr << strFile << "@" << info.lastModified().toMSecsSinceEpoch();
+	return ostr.str();
+}
+
+std::shared_ptr<const CalibTables> get_calib_tables(const CalibConfig& cfg,
+	unsigned int iW, unsigned int iH, unsigned int iTc, unsigned int iFoils)
+{
+	static std::mutex s_mtx;
+	static std::map<std::string, std::shared_ptr<const CalibTables>> s_mapTables;
+
+	const bool bPhases = (cfg.phases != CALIB_PHASES_NONE) && iTc > 1;
+
+	std::ostringstream ostrKey;
+	ostrKey.precision(16);
+	ostrKey << iW << "x" << iH << "x" << iTc << "x" << iFoils
+		<< ";" << file_key(cfg.strEfficiency)
+		<< ";" << file_key(cfg.strBackground) << "*" << cfg.dBackgroundScale
+		<< ";" << (bPhases ? int(cfg.phases) : 0) << "/" << cfg.dNumOsc;
+	if(bPhases && cfg.phases == CALIB_PHASES_FILE)
+		ostrKey << ";" << file_key(cfg.strPhases);
+	else if(bPhases && cfg.phases == CALIB_PHASES_THEO)
+		for(const char* pcKey : {"phase/lx", "phase/ly", "phase/Ls", "phase/tau",
+			"phase/lam", "phase/center_x", "phase/center_y", "phase/central_phase"})
+			ostrKey << ";" << Settings::Get<double>(pcKey);
+	const std::string strKey = ostrKey.str();
+
+	std::lock_guard<std::mutex> lock(s_mtx);
+	auto iter = s_mapTables.find(strKey);
+	if(iter != s_mapTables.end())
+		return iter->second;
+
+	std::shared_ptr<CalibTables> pTab = std::make_shared<CalibTables>();
+	pTab->iW = iW; pTab->iH = iH;
+	pTab->iTc = iTc; pTab->iFoils = iFoils;
+	pTab->dBkgScale = cfg.dBackgroundScale;
+	pTab->dNumOsc = cfg.dNumOsc;
+
+	bool bOk = 1;
+	if(cfg.strEfficiency != "")
+		bOk = bOk && load_efficiency(cfg.strEfficiency, iW, iH, pTab->vecWeights);
+	if(cfg.strBackground != "")
+		bOk = bOk && load_background(cfg.strBackground, *pTab);
+	if(bPhases && cfg.phases == CALIB_PHASES_THEO)
+		bOk = bOk && get_theo_phases(iW, iH, pTab->vecPhases);
+	else if(bPhases && cfg.phases == CALIB_PHASES_FILE)
+		bOk = bOk && load_phases(cfg.strPhases, iW, iH, pTab->vecPhases);
+
+	if(!bOk)
+		return 0;
+
+	// the tables of only a few configurations are kept
+	if(s_mapTables.size() >= 4)
+		s_mapTables.clear();
+	s_mapTables[strKey] = pTab;
+
+	tl::log_info("Loaded calibration tables for ", iW, "x", iH, " pixels, ",
+		iTc, " time channels and ", iFoils, " foils.");
+	return pTab;
+}
+
+
+double get_calib_dead_time(const CalibConfig& cfg, const StringMap& mapParams, unsigned int iTc)
+{
+	if(cfg.dDeadTime <= 0.)
+		return 0.;
+
+	if(!mapParams.HasKey(cfg.strTimeKey))
+	{
+		tl::log_warn("No measurement time \"", cfg.strTimeKey, "\", no dead time correction.");
+		return 0.;
+	}
+
+	const double dTime = tl::str_to_var<double>(mapParams[cfg.strTimeKey]);
+	if(dTime <= 0.)
+		return 0.;
+	return cfg.dDeadTime / (dTime/double(iTc));
+}
+
+
+void calib_apply(const CalibTables& tab, double dDeadTime,
+	unsigned int iFoil, unsigned int iTc, unsigned int iNumTc,
+	const unsigned int *pRaw, double *pVals, double *pErrs)
+{
+	const std::size_t iSliceSize = std::size_t(tab.iW)*tab.iH;
+	const double *pWeights = tab.vecWeights.size() ? tab.vecWeights.data() : 0;
+	const double dBkgScale = tab.dBkgScale;
+
+	for(unsigned int iT=0; iT<iNumTc; ++iT)
+	{
+		const std::size_t iOffs = iT*iSliceSize;
+		const unsigned int *pRawT = pRaw + iOffs;
+		double *pValsT = pVals + iOffs;
+		double *pErrsT = pErrs + iOffs;
+
+		const double *pBkg = 0;
+		if(tab.vecBkg.size())
+			pBkg = tab.bBkgPerBin ?
+				tab.vecBkg.data() + (std::size_t(iFoil)*tab.iTc + iTc + iT)*iSliceSize :
+				tab.vecBkg.data();
+
+		for(std::size_t i=0; i<iSliceSize; ++i)
+		{
+			// non-paralysable dead time: n / (1 - n*tau/t), at most a factor of 10
+			const double dN = double(pRawT[i]);
+			const double dLive = std::max(1. - dN*dDeadTime, 0.1);
+			double dVal = dN / dLive;
+			double dVar = dN / (dLive*dLive*dLive*dLive);
+
+			// the scaled background counts are poisson-distributed as well
+			const double dBkg = pBkg ? pBkg[i] : 0.;
+			dVal -= dBkg;
+			dVar += dBkg*dBkgScale;
+
+			const double dWeight = pWeights ? pWeights[i] : 1.;
+			pValsT[i] = dVal * dWeight;
+			pErrsT[i] = std::sqrt(dVar) * dWeight;
+		}
+	}
+}
+
+void calib_apply_phases(const CalibTables& tab, double *pVals, double *pErrs)
+{
+	if(!tab.NeedsFullFoil() || tab.iTc < 2)
+		return;
+
+	const unsigned int iW = tab.iW, iH = tab.iH, iTc = tab.iTc;
+	const std::size_t iSliceSize = std::size_t(iW)*iH;
+
+	// one fourier workspace per row block
+	const unsigned int iRowsPerBlock = 16;
+	WorkPool pool;
+
+	for(unsigned int iY0=0; iY0<iH; iY0+=iRowsPerBlock)
+	{
+		const unsigned int iY1 = std::min(iH, iY0+iRowsPerBlock);
+		pool.AddTask([&tab, pVals, pErrs, iW, iTc, iSliceSize, iY0, iY1]()
+		{
+			MFourier fourier(iTc);
+			std::vector<double> vecMem(iTc*4);
+			double *pdY = vecMem.data();
+			double *pdY_shift = pdY + iTc;
+			double *pdYErr = pdY + 2*iTc;
+			double *pdYErr_shift = pdY + 3*iTc;
+
+			for(unsigned int iY=iY0; iY<iY1; ++iY)
+				for(unsigned int iX=0; iX<iW; ++iX)
+				{
+					const std::size_t iPixel = std::size_t(iY)*iW + iX;
+					for(unsigned int iT=0; iT<iTc; ++iT)
+					{
+						pdY[iT] = pVals[iT*iSliceSize + iPixel];
+						pdYErr[iT] = pErrs[iT*iSliceSize + iPixel];
+					}
+
+					const double dPhase = tab.vecPhases[iPixel] / tab.dNumOsc;
+					fourier.phase_correction_0(pdY, pdY_shift, dPhase);
+					fourier.phase_correction_0(pdYErr, pdYErr_shift, dPhase);
+
+					for(unsigned int iT=0; iT<iTc; ++iT)
+					{
+						pVals[iT*iSliceSize + iPixel] = std::max(pdY_shift[iT], 0.);
+						pErrs[iT*iSliceSize + iPixel] = std::fabs(pdYErr_shift[iT]);
+					}
+				}
+		}, double(iY1-iY0));
+	}
+
+	pool.Start();
+	pool.Join();
+}
+
+
+bool calib_load_tof(const char* pcFile, const CalibConfig& cfg, Data4& dat4)
+{
+	TofFile tof(pcFile);
+	if(!tof.IsOpen())
+		return false;
+
+	const unsigned int iW = tof.GetWidth();
+	const unsigned int iH = tof.GetHeight();
+	const unsigned int iTcCnt = tof.GetTcCnt();
+	const unsigned int iFoilCnt = tof.GetFoilCnt();
+	dat4.SetSize(iW, iH, iTcCnt, iFoilCnt);
+
+	// the raw counts are corrected while being converted
+	std::shared_ptr<const CalibTables> pCalib;
+	double dDeadTime = 0.;
+	if(cfg.bEnabled)
+	{
+		pCalib = get_calib_tables(cfg, iW, iH, iTcCnt, iFoilCnt);
+		dDeadTime = get_calib_dead_time(cfg, tof.GetParamMap(), iTcCnt);
+		if(!pCalib)
+			tl::log_err("Loading \"", pcFile, "\" without calibration.");
+	}
+
+	// a block of time channels at a time, so that large detectors need not fit into memory;
+	// the phase correction needs whole foils
+	const unsigned int iTcBlock = (pCalib && pCalib->NeedsFullFoil())
+		? iTcCnt : std::min<unsigned int>(iTcCnt, CHUNK_T);
+	const std::size_t iBlockLen = std::size_t(iW)*iH*iTcBlock;
+
+	std::vector<double> vecDat(iBlockLen), vecErr(iBlockLen);
+	double *pdDat = vecDat.data();
+	double *pdErr = vecErr.data();
+	for(unsigned int iFoil=0; iFoil<iFoilCnt; ++iFoil)
+	{
+		const unsigned int* pDat = tof.GetData(iFoil);
+		if(!pDat)
+		{
+			tl::log_err("Could not load \"", pcFile, "\" correctly.");
+			break;
+		}
+
+		for(unsigned int iTc=0; iTc<iTcCnt; iTc+=iTcBlock)
+		{
+			const unsigned int iNumTc = std::min(iTcBlock, iTcCnt-iTc);
+			const std::size_t iLen = std::size_t(iW)*iH*iNumTc;
+
+			if(pCalib)
+			{
+				calib_apply(*pCalib, dDeadTime, iFoil, iTc, iNumTc,
+					pDat + std::size_t(iW)*iH*iTc, pdDat, pdErr);
+				if(iNumTc == iTcCnt)
+					calib_apply_phases(*pCalib, pdDat, pdErr);
+			}
+			else
+			{
+				tl::convert(pdDat, pDat + std::size_t(iW)*iH*iTc, iLen);
+				tl::apply_fkt(pdDat, pdErr, ::sqrt, iLen);
+			}
+			dat4.SetSlices(iFoil, iTc, iNumTc, pdDat, pdErr);
+		}
+
+		tof.ReleaseData(pDat);
+	}
+	dat4.SelectStorage();
+	dat4.SetParamMapStat(tof.GetParamMap());
+
+	return true;
+}
+
+bool calib_load_pad(const char* pcFile, const CalibConfig& cfg, Data4& dat4)
+{
+	PadFile pad(pcFile);
+	if(!pad.IsOpen())
+		return false;
+
+	const unsigned int* pDat = pad.GetData();
+	if(!pDat)
+		return false;
+
+	const unsigned int iW = pad.GetWidth();
+	const unsigned int iH = pad.GetHeight();
+	const std::size_t iLen = std::size_t(iW)*iH;
+	dat4.SetSize(iW, iH, 1, 1);
+
+	std::shared_ptr<const CalibTables> pCalib;
+	if(cfg.bEnabled)
+	{
+		pCalib = get_calib_tables(cfg, iW, iH);
+		if(!pCalib)
+			tl::log_err("Loading \"", pcFile, "\" without calibration.");
+	}
+
+	std::vector<double> vecDat(iLen), vecErr(iLen);
+	if(pCalib)
+	{
+		calib_apply(*pCalib, get_calib_dead_time(cfg, pad.GetParamMap()),
+			0, 0, 1, pDat, vecDat.data(), vecErr.data());
+	}
+	else
+	{
+		tl::convert(vecDat.data(), pDat, iLen);
+		tl::apply_fkt(vecDat.data(), vecErr.data(), ::sqrt, iLen);
+	}
+	pad.ReleaseData(pDat);
+
+	dat4.SetSlices(0, 0, 1, vecDat.data(), vecErr.data());
+	dat4.SelectStorage();
+	dat4.SetParamMapStat(pad.GetParamMap());
+
+	return true;
+}
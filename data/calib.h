@@ -0,0 +1,101 @@
+/**
+ * mieze-tool
+ * detector calibration applied while loading pad and tof data
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_CALIB__
+#define __MIEZE_CALIB__
+
+#include <vector>
+#include <string>
+#include <memory>
+#include "helper/string_map.h"
+
+class Data4;
+
+enum CalibPhases
+{
+	CALIB_PHASES_NONE = 0,
+	CALIB_PHASES_THEO = 1,		// from the settings of the psd phase dialog
+	CALIB_PHASES_FILE = 2		// measured, text file with one row per y pixel
+};
+
+struct CalibConfig
+{
+	bool bEnabled = 0;
+
+	// flat-field measurement, pad file
+	std::string strEfficiency;
+
+	// pad file, spread evenly over the time channels and foils, or tof file
+	std::string strBackground;
+	double dBackgroundScale = 1.;
+
+	CalibPhases phases = CALIB_PHASES_NONE;
+	std::string strPhases;
+	double dNumOsc = 2.;
+
+	// non-paralysable dead time in s and the parameter holding the measurement time
+	double dDeadTime = 0.;
+	std::string strTimeKey;
+
+	// the "calib/" settings
+	static CalibConfig FromSettings();
+};
+
+/*
+ * tables for one detector configuration, loaded once and cached
+ */
+struct CalibTables
+{
+	unsigned int iW = 0, iH = 0, iTc = 1, iFoils = 1;
+
+	// per pixel: 1/efficiency, normalised to a mean efficiency of 1; empty: none
+	std::vector<double> vecWeights;
+
+	// scaled background counts, per pixel or per [foil][t][y][x] bin; empty: none
+	std::vector<double> vecBkg;
+	bool bBkgPerBin = 0;
+	double dBkgScale = 1.;
+
+	// per pixel, in rad; empty: none
+	std::vector<double> vecPhases;
+	double dNumOsc = 2.;
+
+	// the phase correction needs whole time series
+	bool NeedsFullFoil() const { return vecPhases.size() != 0; }
+};
+
+// iTc = iFoils = 1 for pad data; null if a calibration file cannot be used
+extern std::shared_ptr<const CalibTables> get_calib_tables(const CalibConfig& cfg,
+	unsigned int iW, unsigned int iH, unsigned int iTc=1, unsigned int iFoils=1);
+
+/*
+ * converts the raw counts of the time channels [iTc, iTc+iNumTc) of a foil
+ * into corrected values and errors in one pass: dead time, background and
+ * efficiency. dDeadTime is the dead time per time channel length, 0: none
+ */
+extern void calib_apply(const CalibTables& tab, double dDeadTime,
+	unsigned int iFoil, unsigned int iTc, unsigned int iNumTc,
+	const unsigned int *pRaw, double *pVals, double *pErrs);
+
+// dead time per time channel length for the parameters of a file, 0: no correction
+extern double get_calib_dead_time(const CalibConfig& cfg, const StringMap& mapParams,
+	unsigned int iTc=1);
+
+// shifts the time series of every pixel of a whole [t][y][x] foil by its phase
+extern void calib_apply_phases(const CalibTables& tab, double *pVals, double *pErrs);
+
+/*
+ * loads a tof file block by block, corrected if cfg is enabled, and selects
+ * the storage of the data; false if the file cannot be opened
+ */
+extern bool calib_load_tof(const char* pcFile, const CalibConfig& cfg, Data4& dat4);
+
+// loads a pad file as data with one time channel and foil, corrected if cfg is enabled
+extern bool calib_load_pad(const char* pcFile, const CalibConfig& cfg, Data4& dat4);
+
+#endif
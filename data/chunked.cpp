@@ -0,0 +1,303 @@
+/**
+ * mieze-tool
+ * disk-backed storage of tof data larger than the memory
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "chunked.h"
+#include "tlibs/log/log.h"
+
+#include <algorithm>
+#include <atomic>
+
+
+static std::atomic<std::size_t> s_iChunkedMinSize(std::size_t(1)<<32);
+static std::atomic<std::size_t> s_iChunkCacheSize(std::size_t(1)<<29);
+
+std::size_t chunked_min_size() { return s_iChunkedMinSize; }
+void set_chunked_min_size(std::size_t iBytes) { s_iChunkedMinSize = iBytes; }
+
+std::size_t chunk_cache_size() { return s_iChunkCacheSize; }
+void set_chunk_cache_size(std::size_t iBytes) { s_iChunkCacheSize = iBytes; }
+
+static std::mutex s_mtxChunkDir;
+static std::string s_strChunkDir;
+
+std::string chunk_dir()
+{
+	std::lock_guard<std::mutex> lock(s_mtxChunkDir);
+	return s_strChunkDir;
+}
+
+void set_chunk_dir(const std::string& strDir)
+{
+	std::lock_guard<std::mutex> lock(s_mtxChunkDir);
+	s_strChunkDir = strDir;
+}
+
+
+// every chunk has a slot of the size of a full chunk in the file
+static inline qint64 get_slot_size(bool bErrs)
+{
+	return qint64(CHUNK_XY)*CHUNK_XY*CHUNK_T*sizeof(double) * (bErrs ? 2 : 1);
+}
+
+
+ChunkedData::ChunkedData(unsigned int iW, unsigned int iH, unsigned int iD, unsigned int iD2, bool bErrs)
+	: m_iW(iW), m_iH(iH), m_iD(iD), m_iD2(iD2), m_bErrs(bErrs),
+	  m_iNumX((iW+CHUNK_XY-1)/CHUNK_XY), m_iNumY((iH+CHUNK_XY-1)/CHUNK_XY),
+	  m_iNumD((iD+CHUNK_T-1)/CHUNK_T)
+{
+	m_vecInFile.assign(GetNumChunks(), 0);
+
+	const std::string strDir = chunk_dir();
+	if(strDir != "")
+		m_file.setFileTemplate((strDir + "/cattus_chunks_XXXXXX").c_str());
+
+	if(!m_file.open())
+		tl::log_err("Cannot create temporary file for chunked data.");
+}
+
+ChunkedData::~ChunkedData()
+{}
+
+bool ChunkedData::IsOk() const { return m_file.isOpen(); }
+
+std::size_t ChunkedData::GetMemory() const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_iCachedBytes;
+}
+
+std::size_t ChunkedData::GetChunkBytes(const DataChunk& chunk) const
+{
+	return (chunk.vecVals.size() + chunk.vecErrs.size())*sizeof(double);
+}
+
+
+// called with the mutex locked
+std::shared_ptr<DataChunk> ChunkedData::Fetch(std::size_t iChunk) const
+{
+	auto iter = m_mapCached.find(iChunk);
+	if(iter != m_mapCached.end())
+	{
+		m_lstLru.splice(m_lstLru.begin(), m_lstLru, iter->second);
+		return *iter->second;
+	}
+
+	std::shared_ptr<DataChunk> pChunk = std::make_shared<DataChunk>();
+	DataChunk& chunk = *pChunk;
+
+	std::size_t iIdx = iChunk;
+	const unsigned int iCX = iIdx % m_iNumX; iIdx /= m_iNumX;
+	const unsigned int iCY = iIdx % m_iNumY; iIdx /= m_iNumY;
+	const unsigned int iCD = iIdx % m_iNumD; iIdx /= m_iNumD;
+
+	chunk.iX0 = iCX*CHUNK_XY;
+	chunk.iY0 = iCY*CHUNK_XY;
+	chunk.iD0 = iCD*CHUNK_T;
+	chunk.iD2 = iIdx;
+	chunk.iW = std::min<unsigned int>(CHUNK_XY, m_iW - chunk.iX0);
+	chunk.iH = std::min<unsigned int>(CHUNK_XY, m_iH - chunk.iY0);
+	chunk.iD = std::min<unsigned int>(CHUNK_T, m_iD - chunk.iD0);
+
+	const std::size_t iLen = std::size_t(chunk.iW)*chunk.iH*chunk.iD;
+	chunk.vecVals.assign(iLen, 0.);
+	if(m_bErrs)
+		chunk.vecErrs.assign(iLen, 0.);
+
+	if(m_vecInFile[iChunk])
+	{
+		const qint64 iBytes = qint64(iLen*sizeof(double));
+		bool bOk = m_file.seek(qint64(iChunk)*get_slot_size(m_bErrs));
+		bOk = bOk && m_file.read((char*)chunk.vecVals.data(), iBytes) == iBytes;
+		if(m_bErrs)
+			bOk = bOk && m_file.read((char*)chunk.vecErrs.data(), iBytes) == iBytes;
+
+		if(!bOk)
+			tl::log_err("Cannot read chunk ", iChunk, " of chunked data.");
+	}
+
+	m_lstLru.push_front(pChunk);
+	m_mapCached[iChunk] = m_lstLru.begin();
+	m_iCachedBytes += GetChunkBytes(chunk);
+	Evict();
+
+	return pChunk;
+}
+
+// called with the mutex locked
+void ChunkedData::Store(const DataChunk& chunk) const
+{
+	const std::size_t iChunk = GetChunkIndex(chunk.iX0, chunk.iY0, chunk.iD0, chunk.iD2);
+	const qint64 iBytes = qint64(chunk.vecVals.size()*sizeof(double));
+
+	bool bOk = m_file.seek(qint64(iChunk)*get_slot_size(m_bErrs));
+	bOk = bOk && m_file.write((const char*)chunk.vecVals.data(), iBytes) == iBytes;
+	if(m_bErrs)
+		bOk = bOk && m_file.write((const char*)chunk.vecErrs.data(), iBytes) == iBytes;
+
+	if(bOk)
+		m_vecInFile[iChunk] = 1;
+	else
+		tl::log_err("Cannot write chunk ", iChunk, " of chunked data.");
+}
+
+// least recently used chunks first, skipping the ones in use;
+// called with the mutex locked
+void ChunkedData::Evict() const
+{
+	const std::size_t iMaxBytes = chunk_cache_size();
+
+	auto iter = m_lstLru.end();
+	while(m_iCachedBytes > iMaxBytes && iter != m_lstLru.begin())
+	{
+		--iter;
+		if(iter->use_count() > 1)
+			continue;
+
+		DataChunk& chunk = **iter;
+		if(chunk.bDirty)
+			Store(chunk);
+
+		m_iCachedBytes -= GetChunkBytes(chunk);
+		m_mapCached.erase(GetChunkIndex(chunk.iX0, chunk.iY0, chunk.iD0, chunk.iD2));
+		iter = m_lstLru.erase(iter);
+	}
+}
+
+
+std::shared_ptr<const DataChunk> ChunkedData::GetChunk(std::size_t iChunk) const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return Fetch(iChunk);
+}
+
+std::shared_ptr<DataChunk> ChunkedData::WriteChunk(std::size_t iChunk)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	std::shared_ptr<DataChunk> pChunk = Fetch(iChunk);
+	pChunk->bDirty = 1;
+	return pChunk;
+}
+
+
+double ChunkedData::GetVal(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2) const
+{
+	std::shared_ptr<const DataChunk> pChunk = GetChunk(GetChunkIndex(iX, iY, iD, iD2));
+	return pChunk->vecVals[((iD-pChunk->iD0)*pChunk->iH + iY-pChunk->iY0)*pChunk->iW + iX-pChunk->iX0];
+}
+
+double ChunkedData::GetErr(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2) const
+{
+	if(!m_bErrs)
+		return 0.;
+
+	std::shared_ptr<const DataChunk> pChunk = GetChunk(GetChunkIndex(iX, iY, iD, iD2));
+	return pChunk->vecErrs[((iD-pChunk->iD0)*pChunk->iH + iY-pChunk->iY0)*pChunk->iW + iX-pChunk->iX0];
+}
+
+void ChunkedData::SetVal(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2, double dVal)
+{
+	std::shared_ptr<DataChunk> pChunk = WriteChunk(GetChunkIndex(iX, iY, iD, iD2));
+	pChunk->vecVals[((iD-pChunk->iD0)*pChunk->iH + iY-pChunk->iY0)*pChunk->iW + iX-pChunk->iX0] = dVal;
+}
+
+void ChunkedData::SetErr(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2, double dErr)
+{
+	if(!m_bErrs)
+		return;
+
+	std::shared_ptr<DataChunk> pChunk = WriteChunk(GetChunkIndex(iX, iY, iD, iD2));
+	pChunk->vecErrs[((iD-pChunk->iD0)*pChunk->iH + iY-pChunk->iY0)*pChunk->iW + iX-pChunk->iX0] = dErr;
+}
+
+
+void ChunkedData::GetSlices(unsigned int iD2, unsigned int iD, unsigned int iNum,
+	double *pVals, double *pErrs) const
+{
+	const std::size_t iSliceSize = std::size_t(m_iW)*m_iH;
+	if(pErrs && !m_bErrs)
+		std::fill(pErrs, pErrs + iNum*iSliceSize, 0.);
+
+	for(unsigned int iCD=iD/CHUNK_T; iCD*CHUNK_T<iD+iNum; ++iCD)
+		for(unsigned int iCY=0; iCY<m_iNumY; ++iCY)
+			for(unsigned int iCX=0; iCX<m_iNumX; ++iCX)
+			{
+				std::shared_ptr<const DataChunk> pChunk = GetChunk(
+					GetChunkIndex(iCX*CHUNK_XY, iCY*CHUNK_XY, iCD*CHUNK_T, iD2));
+				const DataChunk& chunk = *pChunk;
+
+				const unsigned int iT0 = std::max(iD, chunk.iD0);
+				const unsigned int iT1 = std::min(iD+iNum, chunk.iD0+chunk.iD);
+				for(unsigned int iT=iT0; iT<iT1; ++iT)
+					for(unsigned int iY=0; iY<chunk.iH; ++iY)
+					{
+						const std::size_t iIn = (std::size_t(iT-chunk.iD0)*chunk.iH + iY)*chunk.iW;
+						const std::size_t iOut = (iT-iD)*iSliceSize + std::size_t(chunk.iY0+iY)*m_iW + chunk.iX0;
+
+						std::copy(chunk.vecVals.begin()+iIn, chunk.vecVals.begin()+iIn+chunk.iW, pVals+iOut);
+						if(pErrs && m_bErrs)
+							std::copy(chunk.vecErrs.begin()+iIn, chunk.vecErrs.begin()+iIn+chunk.iW, pErrs+iOut);
+					}
+			}
+}
+
+void ChunkedData::SetSlices(unsigned int iD2, unsigned int iD, unsigned int iNum,
+	const double *pVals, const double *pErrs)
+{
+	const std::size_t iSliceSize = std::size_t(m_iW)*m_iH;
+
+	for(unsigned int iCD=iD/CHUNK_T; iCD*CHUNK_T<iD+iNum; ++iCD)
+		for(unsigned int iCY=0; iCY<m_iNumY; ++iCY)
+			for(unsigned int iCX=0; iCX<m_iNumX; ++iCX)
+			{
+				std::shared_ptr<DataChunk> pChunk = WriteChunk(
+					GetChunkIndex(iCX*CHUNK_XY, iCY*CHUNK_XY, iCD*CHUNK_T, iD2));
+				DataChunk& chunk = *pChunk;
+
+				const unsigned int iT0 = std::max(iD, chunk.iD0);
+				const unsigned int iT1 = std::min(iD+iNum, chunk.iD0+chunk.iD);
+				for(unsigned int iT=iT0; iT<iT1; ++iT)
+					for(unsigned int iY=0; iY<chunk.iH; ++iY)
+					{
+						const std::size_t iOut = (std::size_t(iT-chunk.iD0)*chunk.iH + iY)*chunk.iW;
+						const std::size_t iIn = (iT-iD)*iSliceSize + std::size_t(chunk.iY0+iY)*m_iW + chunk.iX0;
+
+						std::copy(pVals+iIn, pVals+iIn+chunk.iW, chunk.vecVals.begin()+iOut);
+						if(m_bErrs)
+						{
+							if(pErrs)
+								std::copy(pErrs+iIn, pErrs+iIn+chunk.iW, chunk.vecErrs.begin()+iOut);
+							else
+								std::fill(chunk.vecErrs.begin()+iOut, chunk.vecErrs.begin()+iOut+chunk.iW, 0.);
+						}
+					}
+			}
+}
+
+
+std::shared_ptr<ChunkedData> ChunkedData::Clone() const
+{
+	std::shared_ptr<ChunkedData> pClone = std::make_shared<ChunkedData>(m_iW, m_iH, m_iD, m_iD2, m_bErrs);
+
+	for(std::size_t iChunk=0; iChunk<GetNumChunks(); ++iChunk)
+	{
+		// chunks which have never been written are zero in both
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			if(!m_vecInFile[iChunk] && !m_mapCached.count(iChunk))
+				continue;
+		}
+
+		std::shared_ptr<const DataChunk> pChunk = GetChunk(iChunk);
+		std::shared_ptr<DataChunk> pChunkClone = pClone->WriteChunk(iChunk);
+
+		pChunkClone->vecVals = pChunk->vecVals;
+		pChunkClone->vecErrs = pChunk->vecErrs;
+	}
+
+	return pClone;
+}
@@ -0,0 +1,126 @@
+/**
+ * mieze-tool
+ * disk-backed storage of tof data larger than the memory
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_CHUNKED__
+#define __MIEZE_CHUNKED__
+
+#include <QtCore/QTemporaryFile>
+#include <vector>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+
+
+// chunk size in x and y and in time channels; a chunk covers one foil
+#define CHUNK_XY 128
+#define CHUNK_T 16
+
+
+struct DataChunk
+{
+	unsigned int iX0, iY0, iD0, iD2;	// first pixel, time channel and foil
+	unsigned int iW, iH, iD;		// size, smaller at the borders
+
+	// [t][y][x] within the chunk, no errors if the data has none
+	std::vector<double> vecVals;
+	std::vector<double> vecErrs;
+
+	bool bDirty = 0;			// changed since it was read from the file
+};
+
+
+/*
+ * [foil][t][y][x] data in chunks of CHUNK_XY x CHUNK_XY pixels and CHUNK_T
+ * time channels of one foil, kept in a temporary file; the most recently
+ * used chunks stay in memory up to chunk_cache_size() bytes.
+ * chunks in use are never evicted, so the shared pointers returned by
+ * GetChunk() and WriteChunk() stay valid; all methods are thread-safe
+ */
+class ChunkedData
+{
+protected:
+	unsigned int m_iW, m_iH, m_iD, m_iD2;
+	bool m_bErrs;
+
+	// chunks per axis
+	unsigned int m_iNumX, m_iNumY, m_iNumD;
+
+	mutable std::mutex m_mtx;
+	mutable QTemporaryFile m_file;
+	mutable std::vector<bool> m_vecInFile;	// chunks not in the file are zero
+
+	typedef std::list<std::shared_ptr<DataChunk>> t_lru;
+	mutable t_lru m_lstLru;			// most recently used first
+	mutable std::unordered_map<std::size_t, t_lru::iterator> m_mapCached;
+	mutable std::size_t m_iCachedBytes = 0;
+
+	std::shared_ptr<DataChunk> Fetch(std::size_t iChunk) const;
+	void Store(const DataChunk& chunk) const;
+	void Evict() const;
+	std::size_t GetChunkBytes(const DataChunk& chunk) const;
+
+public:
+	ChunkedData(unsigned int iW, unsigned int iH, unsigned int iD, unsigned int iD2, bool bErrs);
+	~ChunkedData();
+
+	ChunkedData(const ChunkedData&) = delete;
+	ChunkedData& operator=(const ChunkedData&) = delete;
+
+	bool IsOk() const;
+	bool HasErrs() const { return m_bErrs; }
+	unsigned int GetWidth() const { return m_iW; }
+	unsigned int GetHeight() const { return m_iH; }
+	unsigned int GetDepth() const { return m_iD; }
+	unsigned int GetDepth2() const { return m_iD2; }
+	std::size_t GetSize() const { return std::size_t(m_iD2)*m_iD*m_iH*m_iW; }
+	std::size_t GetMemory() const;		// bytes of the cached chunks
+
+	std::size_t GetNumChunks() const { return std::size_t(m_iD2)*m_iNumD*m_iNumY*m_iNumX; }
+	std::size_t GetChunkIndex(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2) const
+	{
+		return ((std::size_t(iD2)*m_iNumD + iD/CHUNK_T)*m_iNumY + iY/CHUNK_XY)*m_iNumX + iX/CHUNK_XY;
+	}
+
+	std::shared_ptr<const DataChunk> GetChunk(std::size_t iChunk) const;
+	// the chunk is written back to the file when it is evicted
+	std::shared_ptr<DataChunk> WriteChunk(std::size_t iChunk);
+
+	double GetVal(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2) const;
+	double GetErr(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2) const;
+	void SetVal(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2, double dVal);
+	void SetErr(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2, double dErr);
+
+	// dense [t][y][x] data of the time channels [iD, iD+iNum) of a foil;
+	// the error buffers may be null
+	void GetSlices(unsigned int iD2, unsigned int iD, unsigned int iNum,
+		double *pVals, double *pErrs=0) const;
+	void SetSlices(unsigned int iD2, unsigned int iD, unsigned int iNum,
+		const double *pVals, const double *pErrs=0);
+
+	// copy in a new temporary file
+	std::shared_ptr<ChunkedData> Clone() const;
+};
+
+
+// 4d data whose values and errors take at least this many bytes is
+// stored in chunks on disk, 0: never
+extern std::size_t chunked_min_size();
+extern void set_chunked_min_size(std::size_t iBytes);
+
+// bytes of chunks kept in memory per data set
+extern std::size_t chunk_cache_size();
+extern void set_chunk_cache_size(std::size_t iBytes);
+
+// directory of the chunk files, empty: the system's temporary directory
+extern std::string chunk_dir();
+extern void set_chunk_dir(const std::string& strDir);
+
+#endif
@@ -12,6 +12,7 @@
 #include "tlibs/log/log.h"
 
 #include <fstream>
+#include <cmath>
 
 
 bool DataInterface::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
@@ -113,8 +114,18 @@ void load_xml_vecs(unsigned int iNumVecs,
 			if(bHasBlobIdx)
 			{
 				bool bCompressed = xml.Query<bool>((strBase + "blob_" + pstrs[iObj] + "_compressed").c_str(), 0);
+				bool bChunked = 0;
+				int iCodec = xml.Query<int>((strBase + "blob_" + pstrs[iObj] + "_codec").c_str(), 0, &bChunked);
 
-				if(bCompressed)
+				if(bCompressed && bChunked)
+				{
+					// blob format v2
+					qint64 iLenComp = xml.Query<qint64>((strBase + "blob_" + pstrs[iObj] + "_size").c_str(), 0);
+					if(!blob_read_chunked(blob, iBlobIdx, iLenComp, pvecs[iObj]->data(),
+						pvecs[iObj]->size()*sizeof(double), BlobCodec(iCodec)))
+						tl::log_err("Cannot decompress data in blob.");
+				}
+				else if(bCompressed)
 				{
 					qint64 iLenComp = xml.Query<qint64>((strBase + "blob_" + pstrs[iObj] + "_size").c_str(), 0);
 					void *pvMemComp = blob.map(iBlobIdx, iLenComp);
@@ -156,22 +167,23 @@ void save_xml_vecs(unsigned int iNumVecs,
 
 	ostr << "<in_blob> " << bSaveInBlob << " </in_blob>\n";
 
+	const BlobCodec codec = get_blob_codec(ostrBlob);
+
 	for(unsigned int iObj=0; iObj<iNumVecs; ++iObj)
 	{
 		if(bSaveInBlob)
 		{
-			bool bCompress = (pvecs[iObj]->size() > 1024);
+			bool bCompress = (pvecs[iObj]->size() > 1024) && (codec != BlobCodec::NONE);
 
 			qint64 iBlobIdx = ostrBlob.tellp();
 
 			if(!bCompress)
 			{
-				for(double d : *pvecs[iObj])
-					ostrBlob.write((char*)&d, sizeof(d));
+				ostrBlob.write((const char*)pvecs[iObj]->data(), pvecs[iObj]->size()*sizeof(double));
 			}
 			else
 			{
-				if(!tl::comp_mem_to_stream<char>((void*)pvecs[iObj]->data(), pvecs[iObj]->size()*sizeof(double), ostrBlob/*, COMP_BZ2*/))
+				if(!blob_write_chunked(ostrBlob, pvecs[iObj]->data(), pvecs[iObj]->size()*sizeof(double), codec))
 					tl::log_err("Cannot compress data in blob.");
 			}
 
@@ -188,6 +200,13 @@ void save_xml_vecs(unsigned int iNumVecs,
 			ostr << "<" << "blob_" << pstrs[iObj] << "_compressed" << "> ";
 			ostr << bCompress;
 			ostr << " </" << "blob_" << pstrs[iObj] << "_compressed" << ">\n";
+
+			if(bCompress)
+			{
+				ostr << "<" << "blob_" << pstrs[iObj] << "_codec" << "> ";
+				ostr << int(codec);
+				ostr << " </" << "blob_" << pstrs[iObj] << "_codec" << ">\n";
+			}
 		}
 		else
 		{
@@ -273,6 +292,42 @@ void XYRange::CopyXYRangeFrom(const XYRange* pRan)
 	*((XYRange*)this) = *pRan;
 }
 
+// range point at a fractional pixel position
+static double range_pos(double dPix, uint iPixels, double dMin, double dMax, bool bLog)
+{
+	const double dVal = iPixels>1 ? dPix/double(iPixels-1) : 0.;
+	if(bLog)
+		return pow(10., log10(dMin) + dVal*(log10(dMax)-log10(dMin)));
+	return dMin + dVal*(dMax-dMin);
+}
+
+void XYRange::ScaleRange(uint iNewWidth, uint iNewHeight)
+{
+	if(m_bHasRange && m_iWidth>1 && m_iHeight>1)
+	{
+		// centres of the first and last new pixels in old pixel coordinates
+		const double dScaleX = double(m_iWidth)/double(iNewWidth);
+		const double dScaleY = double(m_iHeight)/double(iNewHeight);
+
+		const double dXMin = range_pos(0.5*dScaleX - 0.5, m_iWidth, m_dXMin, m_dXMax, m_bXIsLog);
+		const double dXMax = range_pos((iNewWidth-0.5)*dScaleX - 0.5, m_iWidth, m_dXMin, m_dXMax, m_bXIsLog);
+		const double dYMin = range_pos(0.5*dScaleY - 0.5, m_iHeight, m_dYMin, m_dYMax, m_bYIsLog);
+		const double dYMax = range_pos((iNewHeight-0.5)*dScaleY - 0.5, m_iHeight, m_dYMin, m_dYMax, m_bYIsLog);
+
+		m_dXMin = dXMin; m_dXMax = dXMax;
+		m_dYMin = dYMin; m_dYMax = dYMax;
+	}
+	else
+	{
+		m_dXMin = m_dYMin = 0.;
+		m_dXMax = iNewWidth-1;
+		m_dYMax = iNewHeight-1;
+	}
+
+	m_iWidth = iNewWidth;
+	m_iHeight = iNewHeight;
+}
+
 
 bool XYRange::LoadRangeXml(tl::Xml& xml, const std::string& strBase)
 {
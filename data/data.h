@@ -14,6 +14,7 @@ typedef unsigned char uchar;
 
 #include <vector>
 #include <algorithm>
+#include <memory>
 
 #include <boost/numeric/ublas/matrix.hpp>
 namespace ublas = boost::numeric::ublas;
@@ -23,6 +24,12 @@ namespace ublas = boost::numeric::ublas;
 #include "helper/xml.h"
 #include "helper/blob.h"
 #include "helper/string_map.h"
+#include "helper/cow.h"
+#include "resample.h"
+#include "sumtable.h"
+#include "pyramid.h"
+#include "sparse.h"
+#include "chunked.h"
 
 enum DataType
 {
@@ -147,6 +154,9 @@ public:
 	virtual bool LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase);
 	virtual bool SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const;
 
+	// bytes of the values and errors held in memory
+	virtual std::size_t GetMemory() const { return 0; }
+
 	StringMap& GetParamMapDyn() { return m_mapDynData; }
 	const StringMap& GetParamMapDyn() const { return m_mapDynData; }
 	void SetParamMapDyn(const StringMap& mapParam) { m_mapDynData = mapParam; }
@@ -199,6 +209,9 @@ public:
 
 	void CopyXYRangeFrom(const XYRange* pRan);
 
+	// new pixel count, the range still spans the same area
+	void ScaleRange(uint iNewWidth, uint iNewHeight);
+
 	bool LoadRangeXml(tl::Xml& xml, const std::string& strBase);
 	bool SaveRangeXml(std::ostream& ostr) const;
 };
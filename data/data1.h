@@ -51,6 +51,11 @@ public:
 	const std::vector<double>& GetYRaw() const { return m_vecValsY; }
 	const std::vector<double>& GetXErrRaw() const { return m_vecErrsX; }
 	const std::vector<double>& GetYErrRaw() const { return m_vecErrsY; }
+	virtual std::size_t GetMemory() const override
+	{
+		return (m_vecValsX.size() + m_vecValsY.size() +
+			m_vecErrsX.size() + m_vecErrsY.size())*sizeof(double);
+	}
 
 	// only points in roi, all points if no roi active
 	void GetData(const std::vector<double> **pvecX, const std::vector<double> **pvecY,
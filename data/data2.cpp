@@ -7,6 +7,7 @@
  */
 
 #include "data2.h"
+#include "stats.h"
 
 #include "tlibs/math/math.h"
 #include <limits>
@@ -30,33 +31,23 @@ Data2::Data2(uint iW, uint iH, const double* pDat, const double *pErr)
 
 void Data2::SetZero()
 {
-		for(uint iY=0; iY<m_iHeight; ++iY)
-			for(uint iX=0; iX<m_iWidth; ++iX)
-			{
-				SetVal(iX, iY, 0.);
-				SetErr(iX, iY, 0.);
-			}
-
-	m_dMin = m_dMax = m_dTotal = 0.;
+	m_vecVals.fill(0.);
+	m_vecErrs.fill(0.);
+	InvalidateCaches();
 }
 
 void Data2::Add(const Data2& dat)
 {
-	m_dMin = std::numeric_limits<double>::max();
-	m_dMax = -m_dMin;
-	m_dTotal = 0.;
-
-	for(uint iY=0; iY<m_iHeight; ++iY)
-		for(uint iX=0; iX<m_iWidth; ++iX)
-		{
-			const double dNewVal = GetValRaw(iX, iY)+dat.GetValRaw(iX, iY);
-			const double dNewErr = GetErrRaw(iX, iY)+dat.GetErrRaw(iX, iY);
-
-			SetVal(iX, iY, dNewVal);
-			SetErr(iX, iY, dNewErr);
+	const std::size_t iLen = std::min(m_vecVals.size(), dat.m_vecVals.size());
+	double *pVals = m_vecVals.WriteData();
+	double *pErrs = m_vecErrs.WriteData();
+	for(std::size_t i=0; i<iLen; ++i)
+	{
+		pVals[i] += dat.m_vecVals[i];
+		pErrs[i] += dat.m_vecErrs[i];
+	}
 
-			m_dTotal += dNewVal;
-		}
+	InvalidateCaches();
 }
 
 void Data2::SetSize(uint iWidth, uint iHeight)
@@ -64,6 +55,7 @@ void Data2::SetSize(uint iWidth, uint iHeight)
 	if(m_iWidth==iWidth && m_iHeight==iHeight)
 		return;
 
+	InvalidateCaches();
 	m_iWidth = iWidth;
 	m_iHeight = iHeight;
 
@@ -96,73 +88,120 @@ double Data2::GetErr(uint iX, uint iY) const
 
 void Data2::SetVal(uint iX, uint iY, double dVal)
 {
-	m_vecVals[iY*m_iWidth + iX] = dVal;
-	m_dMin = std::min(m_dMin, dVal);
-	m_dMax = std::max(m_dMax, dVal);
+	InvalidateCaches();
+	m_vecVals.Write()[iY*m_iWidth + iX] = dVal;
 }
 
 void Data2::SetErr(uint iX, uint iY, double dVal)
 {
-	m_vecErrs[iY*m_iWidth + iX] = dVal;
+	InvalidateCaches();
+	m_vecErrs.Write()[iY*m_iWidth + iX] = dVal;
 }
 
 void Data2::SetVals(const double* pDat, const double *pErr)
 {
-	m_dMin = std::numeric_limits<double>::max();
-	m_dMax = -m_dMin;
-	m_dTotal = 0.;
-
-	for(uint iY=0; iY<m_iHeight; ++iY)
-		for(uint iX=0; iX<m_iWidth; ++iX)
-		{
-			double dVal = pDat ? pDat[iY*m_iWidth + iX] : 0.;
-			double dErr = pErr ? pErr[iY*m_iWidth + iX] : 0.;
+	if(pDat)
+		m_vecVals.assign(pDat, pDat+m_vecVals.size());
+	else
+		m_vecVals.fill(0.);
 
-			this->SetVal(iX, iY, dVal);
-			this->SetErr(iX, iY, dErr);
+	if(pErr)
+		m_vecErrs.assign(pErr, pErr+m_vecErrs.size());
+	else
+		m_vecErrs.fill(0.);
 
-			m_dTotal += dVal;
-		}
+	InvalidateCaches();
 }
 
 double Data2::GetTotalInROI() const
 {
-	double dTotal = 0.;
+	if(use_sum_tables())
+	{
+		std::vector<PixelRect> vecRects;
+		get_roi_rects(*this, *this, m_iWidth, m_iHeight, vecRects);
 
-	for(uint iY=0; iY<m_iHeight; ++iY)
-		for(uint iX=0; iX<m_iWidth; ++iX)
-			dTotal += GetVal(iX, iY);
+		double dTotal = 0.;
+		GetSumTable()->GetSums(vecRects, 0, 1, &dTotal);
+		return dTotal;
+	}
+
+	if(!IsAnyRoiActive())
+		return GetTotal();
+
+	std::vector<PixelRect> vecRects;
+	get_roi_rects(*this, *this, m_iWidth, m_iHeight, vecRects);
+
+	double dTotal = 0.;
+	for(const PixelRect& rect : vecRects)
+		for(uint iY=rect.iY0; iY<rect.iY1; ++iY)
+		{
+			const double *pRow = m_vecVals.data() + iY*m_iWidth;
+			for(uint iX=rect.iX0; iX<rect.iX1; ++iX)
+				dTotal += pRow[iX];
+		}
 
 	return dTotal;
 }
 
-void Data2::RecalcMinMaxTotal()
+std::shared_ptr<const SumTable> Data2::GetSumTable() const
 {
-	m_dMin = std::numeric_limits<double>::max();
-	m_dMax = -m_dMin;
-	m_dTotal = 0.;
+	std::shared_ptr<const SumTable> pTab = std::atomic_load(&m_pSumTable);
+	if(!pTab)
+	{
+		pTab = std::make_shared<const SumTable>(1, m_iWidth, m_iHeight,
+			m_vecVals.data(), m_vecErrs.data());
+		std::atomic_store(&m_pSumTable, pTab);
+	}
+	return pTab;
+}
 
-	for(uint iY=0; iY<m_iHeight; ++iY)
-		for(uint iX=0; iX<m_iWidth; ++iX)
-		{
-			double dVal = this->GetValRaw(iX, iY);
-			m_dTotal += dVal;
+std::shared_ptr<const Pyramid> Data2::GetPyramid() const
+{
+	std::shared_ptr<const Pyramid> pPyr = std::atomic_load(&m_pPyramid);
+	if(!pPyr)
+	{
+		pPyr = std::make_shared<const Pyramid>(1, m_iWidth, m_iHeight,
+			m_vecVals.data(), m_vecErrs.data());
+		std::atomic_store(&m_pPyramid, pPyr);
+	}
+	return pPyr;
+}
 
-			m_dMin = std::min(m_dMin, dVal);
-			m_dMax = std::max(m_dMax, dVal);
-		}
+void Data2::CalcStats() const
+{
+	const DataStats stats = get_stats(m_vecVals.data(), m_vecVals.size());
+	m_dMin = stats.dMin;
+	m_dMax = stats.dMax;
+	m_dTotal = stats.dTotal;
+	m_iStatsVersion = m_iVersion;
+}
+
+void Data2::RecalcMinMaxTotal()
+{
+	CalcStats();
 }
 
 Data1 Data2::SumY() const
 {
+	// whole rows of the roi rectangles are added to the column sums
+	std::vector<PixelRect> vecRects;
+	get_roi_rects(*this, *this, m_iWidth, m_iHeight, vecRects);
+
+	std::vector<double> vecSums(m_iWidth, 0.);
+	for(const PixelRect& rect : vecRects)
+		for(uint iY=rect.iY0; iY<rect.iY1; ++iY)
+		{
+			const double *pRow = m_vecVals.data() + iY*m_iWidth;
+			for(uint iX=rect.iX0; iX<rect.iX1; ++iX)
+				vecSums[iX] += pRow[iX];
+		}
+
 	Data1 dat1;
 	dat1.SetLength(GetWidth());
 
 	for(uint iX=0; iX<GetWidth(); ++iX)
 	{
-		double dVal = 0.;
-		for(uint iY=0; iY<GetHeight(); ++iY)
-			dVal += this->GetVal(iX, iY);
+		const double dVal = vecSums[iX];
 
 		dat1.SetX(iX, HasRange()?GetRangeXPos(iX):double(iX));
 		dat1.SetXErr(iX, 0.);
@@ -180,94 +219,39 @@ void Data2::FromMatrix(const ublas::matrix<double>& mat)
 {
 	this->SetSize(mat.size1(), mat.size2());
 
-	m_dMin = std::numeric_limits<double>::max();
-	m_dMax = -m_dMin;
-	m_dTotal = 0.;
-
+	double *pVals = m_vecVals.WriteData();
 	for(uint iY=0; iY<m_iHeight; ++iY)
 		for(uint iX=0; iX<m_iWidth; ++iX)
-		{
-			double dVal = mat(iX, iY);
-			this->SetVal(iX, iY, dVal);
-			this->SetErr(iX, iY, 0.);
+			pVals[iY*m_iWidth + iX] = mat(iX, iY);
+	m_vecErrs.fill(0.);
 
-			m_dTotal += dVal;
-		}
+	InvalidateCaches();
 }
 
-void Data2::ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts)
+void Data2::ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight,
+	bool bKeepTotalCounts, ResampleMode mode)
 {
-	std::vector<double> vecVals = m_vecVals;
-	std::vector<double> vecErrs = m_vecErrs;
-
-	m_vecVals.resize(iNewWidth*iNewHeight);
-	m_vecErrs.resize(iNewWidth*iNewHeight);
+	if(iNewWidth==m_iWidth && iNewHeight==m_iHeight)
+		return;
 
-	double dAreaFactor = double(m_iWidth*m_iHeight)/double(iNewWidth*iNewHeight);
+	std::vector<double> vecVals(iNewWidth*iNewHeight);
+	std::vector<double> vecErrs(iNewWidth*iNewHeight);
 
-	for(int iY=0; iY<iNewHeight; ++iY)
-		for(int iX=0; iX<iNewWidth; ++iX)
-		{
-			double dOldY0 = ((iY+0.5)*double(m_iHeight))/double(iNewHeight) - 0.5;
-			double dOldX0 = ((iX+0.5)*double(m_iWidth))/double(iNewWidth) - 0.5;
-
-			int iX0 = int(dOldX0);
-			int iY0 = int(dOldY0);
-			int iX1 = iX0+1;
-			int iY1 = iY0+1;
-
-			if(iX0<0) iX0=0;
-			if(iY0<0) iY0=0;
-			if(iX1<0) iX1=0;
-			if(iY1<0) iY1=0;
-
-			if(iX0>=m_iWidth) iX0=m_iWidth-1;
-			if(iY0>=m_iHeight) iY0=m_iHeight-1;
-			if(iX1>=m_iWidth) iX1=m_iWidth-1;
-			if(iY1>=m_iHeight) iY1=m_iHeight-1;
-
-			double dX = (dOldX0 - double(iX0));
-			double dY = (dOldY0 - double(iY0));
-
-			if(dX<0.) dX=0.; if(dX>1.) dX=1.;
-			if(dY<0.) dY=0.; if(dY>1.) dY=1.;
-
-			double dx0y0 = vecVals[iY0*m_iWidth + iX0];
-			double dx0y1 = vecVals[iY1*m_iWidth + iX0];
-			double dx1y0 = vecVals[iY0*m_iWidth + iX1];
-			double dx1y1 = vecVals[iY1*m_iWidth + iX1];
-
-			double dx0y0_err = vecErrs[iY0*m_iWidth + iX0];
-			double dx0y1_err = vecErrs[iY1*m_iWidth + iX0];
-			double dx1y0_err = vecErrs[iY0*m_iWidth + iX1];
-			double dx1y1_err = vecErrs[iY1*m_iWidth + iX1];
-
-			m_vecVals[iY*iNewWidth + iX] = tl::bilinear_interp<double>(dx0y0, dx1y0, dx0y1, dx1y1, dX, dY);
-			m_vecErrs[iY*iNewHeight + iX] = tl::bilinear_interp<double>(dx0y0_err, dx1y0_err, dx0y1_err, dx1y1_err, dX, dY);
-
-			if(bKeepTotalCounts)
-			{
-				m_vecVals[iY*iNewWidth + iX] *= dAreaFactor;
-				m_vecErrs[iY*iNewWidth + iX] *= dAreaFactor;
-			}
-		}
+	resample_slices(mode, bKeepTotalCounts, 1, m_iWidth, m_iHeight,
+		m_vecVals.data(), m_vecErrs.data(), iNewWidth, iNewHeight,
+		vecVals.data(), vecErrs.data());
 
-	// TODO: handle range correctly
-	//if(!m_bHasRange)
-	{
-		m_dXMax = iNewWidth-1;
-		m_dYMax = iNewHeight-1;
+	m_vecVals.Replace(std::move(vecVals));
+	m_vecErrs.Replace(std::move(vecErrs));
+	InvalidateCaches();
 
-		m_iWidth = iNewWidth;
-		m_iHeight = iNewHeight;
-	}
-
-	RecalcMinMaxTotal();
+	ScaleRange(iNewWidth, iNewHeight);
 }
 
 
 bool Data2::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
 {
+	InvalidateCaches();
 	LoadRangeXml(xml, strBase);
 	m_roi.LoadXML(xml, strBase);
 	m_antiroi.LoadXML(xml, strBase);
@@ -276,7 +260,7 @@ bool Data2::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
 	m_vecVals.resize(uiCnt);
 	m_vecErrs.resize(uiCnt);
 
-	std::vector<double>* vecs[] = {&m_vecVals, &m_vecErrs};
+	std::vector<double>* vecs[] = {&m_vecVals.Write(), &m_vecErrs.Write()};
 	std::string strs[] = {"vals", "errs"};
 
 	load_xml_vecs(2, vecs, strs, xml, strBase, blob);
@@ -284,16 +268,17 @@ bool Data2::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
 	m_dMin = xml.Query<double>((strBase+"min").c_str(), 0.);
 	m_dMax = xml.Query<double>((strBase+"max").c_str(), 0.);
 	m_dTotal = xml.Query<double>((strBase+"total").c_str(), 0.);
-
+	m_iStatsVersion = m_iVersion;
 
 	return DataInterface::LoadXML(xml, blob, strBase);;
 }
 
 bool Data2::SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const
 {
+	UpdateStats();
 	const bool bSaveInBlob = (m_vecVals.size() > BLOB_SIZE);
 
-	const std::vector<double>* vecs[] = {&m_vecVals, &m_vecErrs};
+	const std::vector<double>* vecs[] = {&m_vecVals.Get(), &m_vecErrs.Get()};
 	std::string strs[] = {"vals", "errs"};
 
 	save_xml_vecs(2, vecs, strs, ostr, ostrBlob, bSaveInBlob);
@@ -14,10 +14,28 @@
 class Data2 : public DataInterface, public XYRange
 {
 protected:
-	std::vector<double> m_vecVals;
-	std::vector<double> m_vecErrs;
-	double m_dMin, m_dMax;
-	double m_dTotal;	// sum of all values
+	// shared between copies until written to
+	CowVector<double> m_vecVals;
+	CowVector<double> m_vecErrs;
+
+	// statistics, recalculated on demand if the data version has changed
+	mutable double m_dMin, m_dMax;
+	mutable double m_dTotal;	// sum of all values
+	mutable std::size_t m_iStatsVersion = 0;
+	std::size_t m_iVersion = 0;
+
+	void UpdateStats() const { if(m_iStatsVersion != m_iVersion) CalcStats(); }
+	void CalcStats() const;
+
+	// derived data, built on first use and dropped on writes
+	mutable std::shared_ptr<const SumTable> m_pSumTable;
+	mutable std::shared_ptr<const Pyramid> m_pPyramid;
+	void InvalidateCaches()
+	{
+		++m_iVersion;
+		std::atomic_store(&m_pSumTable, std::shared_ptr<const SumTable>());
+		std::atomic_store(&m_pPyramid, std::shared_ptr<const Pyramid>());
+	}
 
 public:
 	Data2(uint iW=128, uint iH=128,
@@ -43,21 +61,37 @@ public:
 	void SetErr(uint iX, uint iY, double dVal);
 	void SetVals(const double *pDat, const double *pErr=0);
 
-	double GetMin() const { return m_dMin; }
-	double GetMax() const { return m_dMax; }
+	// contiguous [y][x] buffers
+	const double* GetValsRaw() const { return m_vecVals.data(); }
+	const double* GetErrsRaw() const { return m_vecErrs.data(); }
+	virtual std::size_t GetMemory() const override
+	{ return (m_vecVals.size() + m_vecErrs.size())*sizeof(double); }
 
-	void SetMinMax(double dMin, double dMax)  { m_dMin=dMin; m_dMax=dMax; }
+	double GetMin() const { UpdateStats(); return m_dMin; }
+	double GetMax() const { UpdateStats(); return m_dMax; }
 
-	double GetTotal() const { return m_dTotal; }
-	void SetTotal(double dTot) { m_dTotal = dTot; }
+	void SetMinMax(double dMin, double dMax)  { UpdateStats(); m_dMin=dMin; m_dMax=dMax; }
+
+	double GetTotal() const { UpdateStats(); return m_dTotal; }
+	// overrides the total until the next change of the data
+	void SetTotal(double dTot) { UpdateStats(); m_dTotal = dTot; }
+
+	// incremented on every change of the data
+	std::size_t GetVersion() const { return m_iVersion; }
 	double GetTotalInROI() const;
 
+	std::shared_ptr<const SumTable> GetSumTable() const;
+
+	// coarser copies for display, level 0 is the data itself
+	std::shared_ptr<const Pyramid> GetPyramid() const;
+
 	void FromMatrix(const ublas::matrix<double>& mat);
 
 	Data1 SumY() const;
 
 	void RecalcMinMaxTotal();
-	void ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts=false);
+	void ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts=false,
+		ResampleMode mode=RESAMPLE_AUTO);
 
 	virtual bool LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase) override;
 	virtual bool SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const override;
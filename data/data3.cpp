@@ -7,6 +7,8 @@
  */
 
 #include "data3.h"
+#include "reduce.h"
+#include "stats.h"
 
 #include "tlibs/math/math.h"
 #include <limits>
@@ -33,53 +35,40 @@ Data3::Data3(uint iW, uint iH, uint iT, const double* pDat, const double *pErr)
 
 void Data3::SetZero()
 {
-	for(uint iT=0; iT<m_iDepth; ++iT)
-		for(uint iY=0; iY<m_iHeight; ++iY)
-			for(uint iX=0; iX<m_iWidth; ++iX)
-			{
-				SetVal(iX, iY, iT, 0.);
-				SetErr(iX, iY, iT, 0.);
-			}
-
-	m_dMin = m_dMax = m_dTotal = 0.;
+	m_vecVals.fill(0.);
+	m_vecErrs.fill(0.);
+	InvalidateCaches();
+}
+
+void Data3::CalcStats() const
+{
+	const DataStats stats = get_stats(m_vecVals.data(), m_vecVals.size());
+	m_dMin = stats.dMin;
+	m_dMax = stats.dMax;
+	m_dTotal = stats.dTotal;
+	m_iStatsVersion = m_iVersion;
 }
 
 void Data3::RecalcMinMaxTotal()
 {
-	m_dMin = std::numeric_limits<double>::max();
-	m_dMax = -m_dMin;
-	m_dTotal = 0.;
-
-	for(uint iD=0; iD<m_iDepth; ++iD)
-		for(uint iY=0; iY<m_iHeight; ++iY)
-			for(uint iX=0; iX<m_iWidth; ++iX)
-			{
-				double dVal = this->GetValRaw(iX, iY, iD);
-				m_dTotal += dVal;
-
-				m_dMin = std::min(m_dMin, dVal);
-				m_dMax = std::max(m_dMax, dVal);
-			}
+	CalcStats();
 }
 
 void Data3::Add(const Data3& dat)
 {
-	m_dMin = std::numeric_limits<double>::max();
-	m_dMax = -m_dMin;
-	m_dTotal = 0.;
-
-	for(uint iT=0; iT<m_iDepth; ++iT)
-		for(uint iY=0; iY<m_iHeight; ++iY)
-			for(uint iX=0; iX<m_iWidth; ++iX)
-			{
-				const double dNewVal = GetValRaw(iX, iY, iT)+dat.GetValRaw(iX, iY, iT);
-				const double dNewErr = GetErrRaw(iX, iY, iT)+dat.GetErrRaw(iX, iY, iT);
-
-				SetVal(iX, iY, iT, dNewVal);
-				SetErr(iX, iY, iT, dNewErr);
-
-				m_dTotal += dNewVal;
-			}
+	const std::size_t iLen = std::min(m_vecVals.size(), dat.m_vecVals.size());
+	double *pVals = m_vecVals.WriteData();
+	for(std::size_t i=0; i<iLen; ++i)
+		pVals[i] += dat.m_vecVals[i];
+
+	if(m_bUseErrs && dat.m_bUseErrs)
+	{
+		double *pErrs = m_vecErrs.WriteData();
+		for(std::size_t i=0; i<iLen; ++i)
+			pErrs[i] += dat.m_vecErrs[i];
+	}
+
+	InvalidateCaches();
 }
 
 void Data3::SetSize(uint iWidth, uint iHeight, uint iDepth)
@@ -87,6 +76,7 @@ void Data3::SetSize(uint iWidth, uint iHeight, uint iDepth)
 	if(m_iWidth==iWidth && m_iHeight==iHeight && m_iDepth==iDepth)
 		return;
 
+	InvalidateCaches();
 	m_iWidth = iWidth;
 	m_iHeight = iHeight;
 	m_iDepth = iDepth;
@@ -125,57 +115,47 @@ double Data3::GetErr(uint iX, uint iY, uint iT) const
 
 void Data3::SetVal(uint iX, uint iY, uint iT, double dVal)
 {
-	m_vecVals[iT*m_iWidth*m_iHeight + iY*m_iWidth + iX] = dVal;
-	m_dMin = std::min(m_dMin, dVal);
-	m_dMax = std::max(m_dMax, dVal);
+	InvalidateCaches();
+	m_vecVals.Write()[iT*m_iWidth*m_iHeight + iY*m_iWidth + iX] = dVal;
 }
 void Data3::SetErr(uint iX, uint iY, uint iT, double dVal)
 {
+	InvalidateCaches();
 	if(m_bUseErrs)
-		m_vecErrs[iT*m_iWidth*m_iHeight +
+		m_vecErrs.Write()[iT*m_iWidth*m_iHeight +
 						  iY*m_iWidth + iX] = dVal;
 }
 
 void Data3::SetVals(const double* pDat, const double *pErr)
 {
-	m_dMin = std::numeric_limits<double>::max();
-	m_dMax = -m_dMin;
-	m_dTotal = 0.;
-
-	for(uint iT=0; iT<m_iDepth; ++iT)
-		for(uint iY=0; iY<m_iHeight; ++iY)
-			for(uint iX=0; iX<m_iWidth; ++iX)
-			{
-				double dVal = pDat ? pDat[iT*m_iWidth*m_iHeight + iY*m_iWidth + iX] : 0.;
-				double dErr = pErr ? pErr[iT*m_iWidth*m_iHeight + iY*m_iWidth + iX] : 0.;
-
-				this->SetVal(iX, iY, iT, dVal);
-				this->SetErr(iX, iY, iT, dErr);
-
-				m_dTotal += dVal;
-			}
+	if(pDat)
+		m_vecVals.assign(pDat, pDat+m_vecVals.size());
+	else
+		m_vecVals.fill(0.);
+
+	if(m_bUseErrs)
+	{
+		if(pErr)
+			m_vecErrs.assign(pErr, pErr+m_vecErrs.size());
+		else
+			m_vecErrs.fill(0.);
+	}
+
+	InvalidateCaches();
 }
 
 Data2 Data3::GetVal(uint iT) const
 {
-	Data2 dat(m_iWidth, m_iHeight);
+	const std::size_t iSliceSize = std::size_t(m_iWidth)*m_iHeight;
+	const bool bInside = iT < m_iDepth;
+
+	Data2 dat(m_iWidth, m_iHeight,
+		bInside ? m_vecVals.data() + iT*iSliceSize : 0,
+		bInside && m_bUseErrs ? m_vecErrs.data() + iT*iSliceSize : 0);
 	dat.CopyParamMapsFrom(this);
 	dat.CopyXYRangeFrom(this);
 	dat.CopyRoiFlagsFrom(this);
 
-	double dTotal = 0.;
-	for(uint iY=0; iY<m_iHeight; ++iY)
-		for(uint iX=0; iX<m_iWidth; ++iX)
-		{
-			double dVal = iT<m_iDepth ? this->GetValRaw(iX, iY, iT) : 0.;
-
-			dat.SetVal(iX, iY, dVal);
-			dat.SetErr(iX, iY, iT<m_iDepth ? this->GetErrRaw(iX, iY, iT) : 0.);
-
-			dTotal += dVal;
-		}
-
-	dat.SetTotal(dTotal);
 	return dat;
 }
 
@@ -201,151 +181,56 @@ Data1 Data3::GetXY(uint iX, uint iY) const
 
 Data1 Data3::GetXYSum() const
 {
-	Data1 dat;
-	dat.CopyParamMapsFrom(this);
-	dat.SetLength(this->GetDepth());
+	ReduceParams params;
+	params.iAxes = AXIS_X | AXIS_Y;
+	params.bUseRoi = 1;
 
-	uint iYStart=0, iYEnd=GetHeight();
-	uint iXStart=0, iXEnd=GetWidth();
+	ReduceResult res;
+	reduce(*this, params, res);
 
-	if(IsRoiActive(0))
-	{
-		BoundingRect br = m_roi.GetBoundingRect();
-		iXStart = GetPixelXPos(br.bottomleft[0]);
-		iYStart = GetPixelYPos(br.bottomleft[1]);
-
-		iXEnd = GetPixelXPos(br.topright[0]);
-		iYEnd = GetPixelYPos(br.topright[1]);
-
-		if(iXEnd > GetWidth()) iXEnd = GetWidth();
-		if(iYEnd > GetHeight()) iYEnd = GetHeight();
-		if(iXStart > GetWidth()) iXStart = GetWidth();
-		if(iYStart > GetHeight()) iYStart = GetHeight();
-	}
-
-	double* pMem = new double[dat.GetLength()*2];
-	double* dSum = pMem;
-	double* dErrSum = pMem + dat.GetLength();
-
-	for(uint iT=0; iT<GetDepth(); ++iT)
-		dSum[iT] = dErrSum[iT] = 0.;
+	Data1 dat = res.GetLine();
+	dat.CopyParamMapsFrom(this);
+	return dat;
+}
 
-	for(uint iY=iYStart; iY<iYEnd; ++iY)
-	{
-		for(uint iX=iXStart; iX<iXEnd; ++iX)
-		{
-			if(!IsInsideRoi(GetRangeXPos(iX), GetRangeYPos(iY)))
-				continue;
-
-			for(uint iT=0; iT<GetDepth(); ++iT)
-			{
-				dSum[iT] += GetValRaw(iX, iY, iT);
-				dErrSum[iT] += GetErrRaw(iX, iY, iT)*GetErrRaw(iX, iY, iT);
-			}
-		}
-	}
 
-	for(uint iT=0; iT<GetDepth(); ++iT)
+std::shared_ptr<const SumTable> Data3::GetSumTable() const
+{
+	std::shared_ptr<const SumTable> pTab = std::atomic_load(&m_pSumTable);
+	if(!pTab)
 	{
-		dat.SetX(iT, iT);
-		dat.SetXErr(iT, 0.);
-		dat.SetY(iT, dSum[iT]);
-		dat.SetYErr(iT, sqrt(dErrSum[iT]) /*sqrt(dSum[iT])*/);
+		pTab = std::make_shared<const SumTable>(m_iDepth, m_iWidth, m_iHeight,
+			GetValsRaw(), GetErrsRaw());
+		std::atomic_store(&m_pSumTable, pTab);
 	}
-
-	delete[] pMem;
-	return dat;
+	return pTab;
 }
 
-
-void Data3::ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts)
+void Data3::ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight,
+	bool bKeepTotalCounts, ResampleMode mode)
 {
-	std::vector<double> vecVals = m_vecVals;
-	std::vector<double> vecErrs;
-	if(m_bUseErrs) vecErrs = m_vecErrs;
+	if(iNewWidth==m_iWidth && iNewHeight==m_iHeight)
+		return;
 
-	m_vecVals.resize(m_iDepth*iNewWidth*iNewHeight);
+	std::vector<double> vecVals(m_iDepth*iNewWidth*iNewHeight);
+	std::vector<double> vecErrs(m_bUseErrs ? vecVals.size() : 0);
 
+	resample_slices(mode, bKeepTotalCounts, m_iDepth, m_iWidth, m_iHeight,
+		m_vecVals.data(), m_bUseErrs ? m_vecErrs.data() : 0, iNewWidth, iNewHeight,
+		vecVals.data(), m_bUseErrs ? vecErrs.data() : 0);
+
+	m_vecVals.Replace(std::move(vecVals));
 	if(m_bUseErrs)
-		m_vecErrs.resize(m_iDepth*iNewWidth*iNewHeight);
-
-	double dAreaFactor = double(m_iWidth*m_iHeight)/double(iNewWidth*iNewHeight);
-
-	for(int iT=0; iT<int(m_iDepth); ++iT)
-		for(int iY=0; iY<int(iNewHeight); ++iY)
-			for(int iX=0; iX<int(iNewWidth); ++iX)
-			{
-				double dOldY0 = ((iY+0.5)*double(m_iHeight))/double(iNewHeight) - 0.5;
-				double dOldX0 = ((iX+0.5)*double(m_iWidth))/double(iNewWidth) - 0.5;
-
-				int iX0 = int(dOldX0);
-				int iY0 = int(dOldY0);
-				int iX1 = iX0+1;
-				int iY1 = iY0+1;
-
-				if(iX0<0) iX0=0;
-				if(iY0<0) iY0=0;
-				if(iX1<0) iX1=0;
-				if(iY1<0) iY1=0;
-
-				if(iX0>=int(m_iWidth)) iX0=int(m_iWidth)-1;
-				if(iY0>=int(m_iHeight)) iY0=int(m_iHeight)-1;
-				if(iX1>=int(m_iWidth)) iX1=int(m_iWidth)-1;
-				if(iY1>=int(m_iHeight)) iY1=int(m_iHeight)-1;
-
-				double dX = (dOldX0 - double(iX0));
-				double dY = (dOldY0 - double(iY0));
-
-				if(dX<0.) dX=0.; if(dX>1.) dX=1.;
-				if(dY<0.) dY=0.; if(dY>1.) dY=1.;
-
-				const uint iOldIdx = iT*m_iWidth*m_iHeight;
-
-				double dx0y0 = vecVals[iOldIdx + iY0*m_iWidth + iX0];
-				double dx0y1 = vecVals[iOldIdx + iY1*m_iWidth + iX0];
-				double dx1y0 = vecVals[iOldIdx + iY0*m_iWidth + iX1];
-				double dx1y1 = vecVals[iOldIdx + iY1*m_iWidth + iX1];
-
-				double dx0y0_err = 0.;
-				double dx0y1_err = 0.;
-				double dx1y0_err = 0.;
-				double dx1y1_err = 0.;
-
-				if(vecErrs.size())
-				{
-					dx0y0_err = vecErrs[iOldIdx + iY0*m_iWidth + iX0];
-					dx0y1_err = vecErrs[iOldIdx + iY1*m_iWidth + iX0];
-					dx1y0_err = vecErrs[iOldIdx + iY0*m_iWidth + iX1];
-					dx1y1_err = vecErrs[iOldIdx + iY1*m_iWidth + iX1];
-				}
-
-				const uint iNewIdx = iT*iNewWidth*iNewHeight + iY*iNewWidth + iX;
-
-				m_vecVals[iNewIdx] = tl::bilinear_interp<double>(dx0y0, dx1y0, dx0y1, dx1y1, dX, dY);
-				if(m_bUseErrs)
-					m_vecErrs[iNewIdx] = tl::bilinear_interp<double>(dx0y0_err, dx1y0_err, dx0y1_err, dx1y1_err, dX, dY);
-
-				if(bKeepTotalCounts)
-				{
-					m_vecVals[iNewIdx] *= dAreaFactor;
-					if(m_bUseErrs)
-						m_vecErrs[iNewIdx] *= dAreaFactor;
-				}
-			}
-
-	// TODO: handle range correctly
-	m_dXMax = iNewWidth-1;
-	m_dYMax = iNewHeight-1;
-
-	m_iWidth = iNewWidth;
-	m_iHeight = iNewHeight;
-
-	RecalcMinMaxTotal();
+		m_vecErrs.Replace(std::move(vecErrs));
+	InvalidateCaches();
+
+	ScaleRange(iNewWidth, iNewHeight);
 }
 
 
 bool Data3::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
 {
+	InvalidateCaches();
 	LoadRangeXml(xml, strBase);
 	m_iDepth = xml.Query<unsigned int>((strBase+"depth").c_str(), 0);
 	m_bUseErrs = xml.Query<int>((strBase+"use_errs").c_str(), 0);
@@ -358,7 +243,7 @@ bool Data3::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
 	if(m_bUseErrs)
 		m_vecErrs.resize(uiCnt);
 
-	std::vector<double>* vecs[] = {&m_vecVals, &m_vecErrs};
+	std::vector<double>* vecs[] = {&m_vecVals.Write(), &m_vecErrs.Write()};
 	std::string strs[] = {"vals", "errs"};
 
 	load_xml_vecs(m_bUseErrs?2:1, vecs, strs, xml, strBase, blob);
@@ -366,15 +251,17 @@ bool Data3::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
 	m_dMin = xml.Query<double>((strBase+"min").c_str(), 0.);
 	m_dMax = xml.Query<double>((strBase+"max").c_str(), 0.);
 	m_dTotal = xml.Query<double>((strBase+"total").c_str(), 0.);
+	m_iStatsVersion = m_iVersion;
 
 	return DataInterface::LoadXML(xml, blob, strBase);;
 }
 
 bool Data3::SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const
 {
+	UpdateStats();
 	const bool bSaveInBlob = (m_vecVals.size() > BLOB_SIZE);
 
-	const std::vector<double>* vecs[] = {&m_vecVals, &m_vecErrs};
+	const std::vector<double>* vecs[] = {&m_vecVals.Get(), &m_vecErrs.Get()};
 	std::string strs[] = {"vals", "errs"};
 
 	save_xml_vecs(m_bUseErrs?2:1, vecs, strs, ostr, ostrBlob, bSaveInBlob);
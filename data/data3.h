@@ -15,10 +15,26 @@ class Data3 : public DataInterface, public XYRange
 {
 protected:
 	uint m_iDepth;
-	std::vector<double> m_vecVals;
-	std::vector<double> m_vecErrs;
-	double m_dMin, m_dMax;
-	double m_dTotal;	// sum of all values
+	// shared between copies until written to
+	CowVector<double> m_vecVals;
+	CowVector<double> m_vecErrs;
+
+	// statistics, recalculated on demand if the data version has changed
+	mutable double m_dMin, m_dMax;
+	mutable double m_dTotal;	// sum of all values
+	mutable std::size_t m_iStatsVersion = 0;
+	std::size_t m_iVersion = 0;
+
+	void UpdateStats() const { if(m_iStatsVersion != m_iVersion) CalcStats(); }
+	void CalcStats() const;
+
+	// derived data, built on first use and dropped on writes
+	mutable std::shared_ptr<const SumTable> m_pSumTable;
+	void InvalidateCaches()
+	{
+		++m_iVersion;
+		std::atomic_store(&m_pSumTable, std::shared_ptr<const SumTable>());
+	}
 
 	bool m_bUseErrs;
 
@@ -45,11 +61,22 @@ public:
 	void SetErr(uint iX, uint iY, uint iT, double dVal);
 	void SetVals(const double *pDat, const double *pErr=0);
 
-	double GetMin() const { return m_dMin; }
-	double GetMax() const { return m_dMax; }
+	double GetMin() const { UpdateStats(); return m_dMin; }
+	double GetMax() const { UpdateStats(); return m_dMax; }
 
-	double GetTotal() const { return m_dTotal; }
-	void SetTotal(double dTot) { m_dTotal = dTot; }
+	double GetTotal() const { UpdateStats(); return m_dTotal; }
+	// overrides the total until the next change of the data
+	void SetTotal(double dTot) { UpdateStats(); m_dTotal = dTot; }
+
+	// incremented on every change of the data
+	std::size_t GetVersion() const { return m_iVersion; }
+
+	// contiguous [t][y][x] buffers, no errors if they are not used
+	const double* GetValsRaw() const { return m_vecVals.data(); }
+	const double* GetErrsRaw() const { return m_bUseErrs ? m_vecErrs.data() : 0; }
+	virtual std::size_t GetMemory() const override
+	{ return (m_vecVals.size() + m_vecErrs.size())*sizeof(double); }
+	std::shared_ptr<const SumTable> GetSumTable() const;
 
 	Data2 GetVal(uint iT) const;
 	Data1 GetXY(uint iX, uint iY) const;
@@ -58,7 +85,8 @@ public:
 	void Add(const Data3& dat);
 
 	void RecalcMinMaxTotal();
-	void ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts=false);
+	void ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts=false,
+		ResampleMode mode=RESAMPLE_AUTO);
 
 	virtual bool LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase) override;
 	virtual bool SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const override;
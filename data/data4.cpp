@@ -7,8 +7,11 @@
  */
 
 #include "data4.h"
+#include "reduce.h"
+#include "stats.h"
 #include "tlibs/math/math.h"
 #include "tlibs/string/string.h"
+#include "tlibs/log/log.h"
 
 #include <limits>
 #include <boost/algorithm/minmax_element.hpp>
@@ -32,23 +35,133 @@ Data4::Data4(uint iW, uint iH, uint iD, uint iD2, const double* pDat, const doub
 	SetYRange(0., m_iHeight-1);
 }
 
+void Data4::CalcStats() const
+{
+	DataStats stats;
+	if(m_pSparse)
+	{
+		stats = get_stats(m_pSparse->GetVals(), m_pSparse->GetNumNonZero());
+
+		// the bins which are not stored
+		if(m_pSparse->GetNumNonZero() < m_pSparse->GetSize())
+		{
+			stats.dMin = std::min(stats.dMin, 0.);
+			stats.dMax = std::max(stats.dMax, 0.);
+		}
+	}
+	else if(m_pChunks)
+	{
+		stats = DataStats{std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), 0.};
+
+		for(std::size_t iChunk=0; iChunk<m_pChunks->GetNumChunks(); ++iChunk)
+		{
+			std::shared_ptr<const DataChunk> pChunk = m_pChunks->GetChunk(iChunk);
+			const DataStats statsChunk = get_stats(pChunk->vecVals.data(), pChunk->vecVals.size());
+
+			stats.dMin = std::min(stats.dMin, statsChunk.dMin);
+			stats.dMax = std::max(stats.dMax, statsChunk.dMax);
+			stats.dTotal += statsChunk.dTotal;
+		}
+	}
+	else
+	{
+		stats = get_stats(m_vecVals.data(), m_vecVals.size());
+	}
+
+	m_dMin = stats.dMin;
+	m_dMax = stats.dMax;
+	m_dTotal = stats.dTotal;
+	m_iStatsVersion = m_iVersion;
+}
+
+void Data4::SelectStorage()
+{
+	// chunked data is too large to be expanded for the test
+	const double dThreshold = sparse_threshold();
+	if(m_pSparse || m_pChunks || dThreshold <= 0.)
+		return;
+
+	const double *pErrs = m_bUseErrs ? m_vecErrs.data() : 0;
+	const double dOccupancy = get_occupancy(m_vecVals.data(), pErrs, m_vecVals.size());
+	if(m_vecVals.empty() || dOccupancy >= dThreshold)
+		return;
+
+	std::shared_ptr<const SparseData> pSparse = std::make_shared<const SparseData>(
+		m_iWidth, m_iHeight, m_iDepth, m_iDepth2, m_vecVals.data(), pErrs);
+	tl::log_debug("Storing 4d data sparsely, occupancy: ", dOccupancy,
+		", size: ", pSparse->GetMemory(), " bytes instead of ",
+		(m_vecVals.size() + (pErrs ? m_vecErrs.size() : 0))*sizeof(double), " bytes.");
+
+	// the values don't change, so the statistics and caches stay valid
+	m_pSparse = pSparse;
+	m_vecVals.Replace(std::vector<double>());
+	m_vecErrs.Replace(std::vector<double>());
+}
+
+void Data4::MakeDense()
+{
+	if(!m_pSparse)
+		return;
+
+	std::vector<double> vecVals(m_pSparse->GetSize());
+	std::vector<double> vecErrs(m_bUseErrs ? vecVals.size() : 0);
+	m_pSparse->GetDense(vecVals.data(), m_bUseErrs ? vecErrs.data() : 0);
+
+	m_vecVals.Replace(std::move(vecVals));
+	m_vecErrs.Replace(std::move(vecErrs));
+	m_pSparse.reset();
+}
+
+std::size_t Data4::GetMemory() const
+{
+	std::size_t iBytes = (m_vecVals.size() + m_vecErrs.size())*sizeof(double);
+	if(m_pSparse)
+		iBytes += m_pSparse->GetMemory();
+	if(m_pChunks)
+		iBytes += m_pChunks->GetMemory();
+	return iBytes;
+}
+
 void Data4::RecalcMinMaxTotal()
 {
-	m_dMin = std::numeric_limits<double>::max();
-	m_dMax = -m_dMin;
-	m_dTotal = 0.;
+	CalcStats();
+}
 
-	for(uint iD2=0; iD2<m_iDepth2; ++iD2)
-		for(uint iD=0; iD<m_iDepth; ++iD)
-			for(uint iY=0; iY<m_iHeight; ++iY)
-				for(uint iX=0; iX<m_iWidth; ++iX)
-				{
-					double dVal = this->GetValRaw(iX, iY, iD, iD2);
-					m_dTotal += dVal;
-
-					m_dMin = std::min(m_dMin, dVal);
-					m_dMax = std::max(m_dMax, dVal);
-				}
+// dense buffers or, for data too large for the memory, chunks on disk
+void Data4::AllocStorage()
+{
+	const std::size_t iSize = std::size_t(m_iWidth)*m_iHeight*m_iDepth*m_iDepth2;
+	const std::size_t iMinChunked = chunked_min_size();
+	m_pSparse.reset();
+	m_pChunks.reset();
+
+	if(iMinChunked && iSize*sizeof(double)*(m_bUseErrs ? 2 : 1) >= iMinChunked)
+	{
+		std::shared_ptr<ChunkedData> pChunks = std::make_shared<ChunkedData>(
+			m_iWidth, m_iHeight, m_iDepth, m_iDepth2, m_bUseErrs);
+
+		if(pChunks->IsOk())
+		{
+			tl::log_info("Storing 4d data of ", iSize, " bins in chunks on disk.");
+
+			m_pChunks = pChunks;
+			m_vecVals.Replace(std::vector<double>());
+			m_vecErrs.Replace(std::vector<double>());
+			return;
+		}
+	}
+
+	m_vecVals.resize(iSize);
+	if(m_bUseErrs)
+		m_vecErrs.resize(iSize);
+}
+
+// copies of the data share their chunks until one of them is written to
+ChunkedData& Data4::WriteChunks()
+{
+	if(m_pChunks.use_count() > 1)
+		m_pChunks = m_pChunks->Clone();
+	return *m_pChunks;
 }
 
 void Data4::SetSize(uint iWidth, uint iHeight, uint iDepth, uint iDepth2)
@@ -57,18 +170,23 @@ void Data4::SetSize(uint iWidth, uint iHeight, uint iDepth, uint iDepth2)
 		m_iDepth==iDepth && m_iDepth2==iDepth2)
 		return;
 
+	MakeDense();
+	InvalidateCaches();
 	m_iWidth = iWidth;
 	m_iHeight = iHeight;
 	m_iDepth = iDepth;
 	m_iDepth2 = iDepth2;
 
-	m_vecVals.resize(m_iWidth * m_iHeight * m_iDepth * m_iDepth2);
-	if(m_bUseErrs)
-		m_vecErrs.resize(m_iWidth * m_iHeight * m_iDepth * m_iDepth2);
+	AllocStorage();
 }
 
 double Data4::GetValRaw(uint iX, uint iY, uint iD, uint iD2) const
 {
+	if(m_pSparse)
+		return m_pSparse->GetVal(iX, iY, iD, iD2);
+	if(m_pChunks)
+		return m_pChunks->GetVal(iX, iY, iD, iD2);
+
 	return m_vecVals[iD2*m_iDepth*m_iWidth*m_iHeight +
 	                 	 	 iD*m_iWidth*m_iHeight +
 	                 	 	 iY*m_iWidth + iX];
@@ -76,6 +194,11 @@ double Data4::GetValRaw(uint iX, uint iY, uint iD, uint iD2) const
 
 double Data4::GetErrRaw(uint iX, uint iY, uint iD, uint iD2) const
 {
+	if(m_pSparse)
+		return m_pSparse->GetErr(iX, iY, iD, iD2);
+	if(m_pChunks)
+		return m_pChunks->GetErr(iX, iY, iD, iD2);
+
 	if(m_bUseErrs)
 		return m_vecErrs[iD2*m_iDepth*m_iWidth*m_iHeight +
 	                 	 	 iD*m_iWidth*m_iHeight +
@@ -101,43 +224,92 @@ double Data4::GetErr(uint iX, uint iY, uint iD, uint iD2) const
 
 void Data4::SetVal(uint iX, uint iY, uint iD, uint iD2, double dVal)
 {
-	m_vecVals[iD2*m_iDepth*m_iWidth*m_iHeight + iD*m_iWidth*m_iHeight + iY*m_iWidth + iX] = dVal;
-	m_dMin = std::min(m_dMin, dVal);
-	m_dMax = std::max(m_dMax, dVal);
+	InvalidateCaches();
+	if(m_pChunks)
+	{
+		WriteChunks().SetVal(iX, iY, iD, iD2, dVal);
+		return;
+	}
+
+	MakeDense();
+	m_vecVals.Write()[iD2*m_iDepth*m_iWidth*m_iHeight + iD*m_iWidth*m_iHeight + iY*m_iWidth + iX] = dVal;
 }
 
 void Data4::SetVals(const double* pDat, const double *pErr)
 {
-	m_dMin = std::numeric_limits<double>::max();
-	m_dMax = -m_dMin;
-	m_dTotal = 0.;
+	// everything is overwritten, so the sparse bins need not be expanded
+	if(m_pSparse)
+	{
+		m_pSparse.reset();
+		m_vecVals.resize(std::size_t(m_iWidth)*m_iHeight*m_iDepth*m_iDepth2);
+		if(m_bUseErrs)
+			m_vecErrs.resize(m_vecVals.size());
+	}
+
+	const std::size_t iFoilSize = std::size_t(m_iDepth)*m_iWidth*m_iHeight;
 
 	for(uint iD2=0; iD2<m_iDepth2; ++iD2)
-		SetVals(iD2, pDat+iD2*m_iDepth*m_iWidth*m_iHeight, pErr+iD2*m_iDepth*m_iWidth*m_iHeight);
+		SetVals(iD2, pDat ? pDat+iD2*iFoilSize : 0, pErr ? pErr+iD2*iFoilSize : 0);
 }
 
 void Data4::SetVals(uint iD2, const double *pDat, const double *pErr)
 {
-	for(uint iD=0; iD<m_iDepth; ++iD)
-		for(uint iY=0; iY<m_iHeight; ++iY)
-			for(uint iX=0; iX<m_iWidth; ++iX)
-			{
-				double dVal = pDat ? pDat[iD*m_iWidth*m_iHeight + iY*m_iWidth + iX] : 0.;
-				double dErr = pErr ? pErr[iD*m_iWidth*m_iHeight + iY*m_iWidth + iX] : 0.;
+	SetSlices(iD2, 0, m_iDepth, pDat, pErr);
+}
+
+void Data4::SetSlices(uint iD2, uint iD, uint iNum, const double *pDat, const double *pErr)
+{
+	if(iD2 >= m_iDepth2 || iD >= m_iDepth)
+		return;
+	iNum = std::min(iNum, m_iDepth-iD);
 
-				this->SetVal(iX, iY, iD, iD2, dVal);
-				this->SetErr(iX, iY, iD, iD2, dErr);
+	const std::size_t iLen = std::size_t(iNum)*m_iWidth*m_iHeight;
+	InvalidateCaches();
 
-				m_dTotal += dVal;
-			}
+	if(m_pChunks)
+	{
+		std::vector<double> vecZero;
+		if(!pDat)
+		{
+			vecZero.assign(iLen, 0.);
+			pDat = vecZero.data();
+		}
 
-	//RecalcMinMaxTotal();
+		WriteChunks().SetSlices(iD2, iD, iNum, pDat, pErr);
+		return;
+	}
+
+	MakeDense();
+	const std::size_t iOffs = (std::size_t(iD2)*m_iDepth + iD)*m_iWidth*m_iHeight;
+	double *pVals = m_vecVals.WriteData() + iOffs;
+
+	if(pDat)
+		std::copy(pDat, pDat+iLen, pVals);
+	else
+		std::fill(pVals, pVals+iLen, 0.);
+
+	if(m_bUseErrs)
+	{
+		double *pErrs = m_vecErrs.WriteData() + iOffs;
+		if(pErr)
+			std::copy(pErr, pErr+iLen, pErrs);
+		else
+			std::fill(pErrs, pErrs+iLen, 0.);
+	}
 }
 
 void Data4::SetErr(uint iX, uint iY, uint iD, uint iD2, double dVal)
 {
+	InvalidateCaches();
+	if(m_pChunks)
+	{
+		WriteChunks().SetErr(iX, iY, iD, iD2, dVal);
+		return;
+	}
+
+	MakeDense();
 	if(m_bUseErrs)
-		m_vecErrs[iD2*m_iDepth*m_iWidth*m_iHeight +
+		m_vecErrs.Write()[iD2*m_iDepth*m_iWidth*m_iHeight +
 						  iD*m_iWidth*m_iHeight +
 						  iY*m_iWidth + iX] = dVal;
 }
@@ -145,25 +317,34 @@ void Data4::SetErr(uint iX, uint iY, uint iD, uint iD2, double dVal)
 
 Data3 Data4::GetVal(uint iD2) const
 {
-	Data3 dat(m_iWidth, m_iHeight, m_iDepth);
-	dat.CopyXYRangeFrom(this);
-	dat.CopyRoiFlagsFrom(this);
+	const std::size_t iFoilSize = std::size_t(m_iDepth)*m_iWidth*m_iHeight;
 
-	double dTotal = 0.;
-	for(uint iD=0; iD<m_iDepth; ++iD)
-		for(uint iY=0; iY<m_iHeight; ++iY)
-			for(uint iX=0; iX<m_iWidth; ++iX)
-			{
-				double dVal = this->GetValRaw(iX, iY, iD, iD2);
-				double dErr = this->GetErrRaw(iX, iY, iD, iD2);
-
-				dat.SetVal(iX, iY, iD, dVal);
-				dat.SetErr(iX, iY, iD, dErr);
-
-				dTotal += dVal;
-			}
+	std::vector<double> vecFoil;
+	const double *pFoil = 0;
+	if(iD2 < m_iDepth2)
+	{
+		if(m_pSparse)
+		{
+			vecFoil.resize(iFoilSize);
+			m_pSparse->GetFoil(iD2, vecFoil.data());
+			pFoil = vecFoil.data();
+		}
+		else if(m_pChunks)
+		{
+			vecFoil.resize(iFoilSize);
+			m_pChunks->GetSlices(iD2, 0, m_iDepth, vecFoil.data());
+			pFoil = vecFoil.data();
+		}
+		else
+		{
+			pFoil = m_vecVals.data() + iD2*iFoilSize;
+		}
+	}
 
-	dat.SetTotal(dTotal);
+	// the errors are not passed on
+	Data3 dat(m_iWidth, m_iHeight, m_iDepth, pFoil);
+	dat.CopyXYRangeFrom(this);
+	dat.CopyRoiFlagsFrom(this);
 	dat.CopyParamMapsFrom(this);
 
 	return dat;
@@ -171,28 +352,42 @@ Data3 Data4::GetVal(uint iD2) const
 
 Data2 Data4::GetVal(uint iD, uint iD2) const
 {
-	Data2 dat(m_iWidth, m_iHeight);
-	dat.CopyXYRangeFrom(this);
-	dat.CopyRoiFlagsFrom(this);
+	const std::size_t iSliceSize = std::size_t(m_iWidth)*m_iHeight;
+	const bool bInside = iD<m_iDepth && iD2<m_iDepth2;
+	const std::size_t iOffs = (std::size_t(iD2)*m_iDepth + iD)*iSliceSize;
 
-	double dTotal = 0.;
-	for(uint iY=0; iY<m_iHeight; ++iY)
-		for(uint iX=0; iX<m_iWidth; ++iX)
-		{
-			double dVal=0., dErr=0.;
-			if(iD<m_iDepth && iD2<m_iDepth2)
-			{
-				dVal = this->GetValRaw(iX, iY, iD, iD2);
-				dErr = this->GetErrRaw(iX, iY, iD, iD2);
-			}
+	const double *pVals = 0;
+	const double *pErrs = 0;
 
-			dat.SetVal(iX, iY, dVal);
-			dat.SetErr(iX, iY, dErr);
+	std::vector<double> vecVals, vecErrs;
+	if(bInside && m_pSparse)
+	{
+		vecVals.resize(iSliceSize);
+		vecErrs.resize(m_bUseErrs ? iSliceSize : 0);
+		m_pSparse->GetSlice(iD, iD2, vecVals.data(), m_bUseErrs ? vecErrs.data() : 0);
 
-			dTotal += dVal;
-		}
+		pVals = vecVals.data();
+		pErrs = m_bUseErrs ? vecErrs.data() : 0;
+	}
+	else if(bInside && m_pChunks)
+	{
+		vecVals.resize(iSliceSize);
+		vecErrs.resize(m_bUseErrs ? iSliceSize : 0);
+		m_pChunks->GetSlices(iD2, iD, 1, vecVals.data(), m_bUseErrs ? vecErrs.data() : 0);
+
+		pVals = vecVals.data();
+		pErrs = m_bUseErrs ? vecErrs.data() : 0;
+	}
+	else if(bInside)
+	{
+		// only dense data has its values in m_vecVals/m_vecErrs
+		pVals = m_vecVals.data() + iOffs;
+		pErrs = m_bUseErrs ? m_vecErrs.data() + iOffs : 0;
+	}
 
-	dat.SetTotal(dTotal);
+	Data2 dat(m_iWidth, m_iHeight, pVals, pErrs);
+	dat.CopyXYRangeFrom(this);
+	dat.CopyRoiFlagsFrom(this);
 	dat.CopyParamMapsFrom(this);
 
 	return dat;
@@ -200,62 +395,36 @@ Data2 Data4::GetVal(uint iD, uint iD2) const
 
 Data1 Data4::GetXYSum(uint iD2) const
 {
-	Data1 dat;
-	dat.CopyParamMapsFrom(this);
-	dat.SetLength(this->GetDepth());
-
-	uint iYStart=0, iYEnd=GetHeight();
-	uint iXStart=0, iXEnd=GetWidth();
-
-	if(IsRoiActive(0))
-	{
-		BoundingRect br = m_roi.GetBoundingRect();
-		iXStart = GetPixelXPos(br.bottomleft[0]);
-		iYStart = GetPixelYPos(br.bottomleft[1]);
-
-		iXEnd = GetPixelXPos(br.topright[0]);
-		iYEnd = GetPixelYPos(br.topright[1]);
-
-		if(iXEnd > GetWidth()) iXEnd = GetWidth();
-		if(iYEnd > GetHeight()) iYEnd = GetHeight();
-		if(iXStart > GetWidth()) iXStart = GetWidth();
-		if(iYStart > GetHeight()) iYStart = GetHeight();
-	}
+	ReduceParams params;
+	params.iAxes = AXIS_X | AXIS_Y;
+	params.iFoil = iD2;
+	params.bUseRoi = 1;
 
+	ReduceResult res;
+	reduce(*this, params, res);
 
-	double* pMem = new double[dat.GetLength()*2];
-	double* dSum = pMem;
-	double* dErrSum = pMem + dat.GetLength();
+	Data1 dat = res.GetLine();
+	dat.CopyParamMapsFrom(this);
+	return dat;
+}
 
-	for(uint iT=0; iT<GetDepth(); ++iT)
-		dSum[iT] = dErrSum[iT] = 0.;
+std::vector<Data1> Data4::GetXYSums() const
+{
+	ReduceParams params;
+	params.iAxes = AXIS_X | AXIS_Y;
+	params.bUseRoi = 1;
 
-	for(uint iY=iYStart; iY<iYEnd; ++iY)
-	{
-		for(uint iX=iXStart; iX<iXEnd; ++iX)
-		{
-			if(!IsInsideRoi(GetRangeXPos(iX), GetRangeYPos(iY)))
-				continue;
-
-			for(uint iT=0; iT<GetDepth(); ++iT)
-			{
-				dSum[iT] += GetValRaw(iX, iY, iT, iD2);
-				dErrSum[iT] += GetErrRaw(iX, iY, iT, iD2)*GetErrRaw(iX, iY, iT, iD2);
-			}
-		}
-	}
+	ReduceResult res;
+	reduce(*this, params, res);
 
-	for(uint iT=0; iT<GetDepth(); ++iT)
+	std::vector<Data1> vecDat;
+	vecDat.reserve(GetDepth2());
+	for(uint iD2=0; iD2<GetDepth2(); ++iD2)
 	{
-		dat.SetX(iT, iT);
-		dat.SetXErr(iT, 0.);
-		dat.SetY(iT, dSum[iT]);
-		dat.SetYErr(iT, sqrt(dErrSum[iT]) /*sqrt(dSum[iT])*/);
+		vecDat.push_back(res.GetLine(iD2));
+		vecDat.rbegin()->CopyParamMapsFrom(this);
 	}
-
-	delete[] pMem;
-
-	return dat;
+	return vecDat;
 }
 
 Data1 Data4::GetXYD2(uint iX, uint iY, uint iD2) const
@@ -279,95 +448,81 @@ Data1 Data4::GetXYD2(uint iX, uint iY, uint iD2) const
 }
 
 
-void Data4::ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts)
+std::shared_ptr<const SumTable> Data4::GetSumTable() const
 {
-	std::vector<double> vecVals = m_vecVals;
-	std::vector<double> vecErrs;
-	if(m_bUseErrs) vecErrs = m_vecErrs;
+	// sparse and chunked data are reduced without tables
+	if(m_pChunks || m_pSparse)
+		return std::shared_ptr<const SumTable>();
 
-	m_vecVals.resize(m_iDepth2*m_iDepth*iNewWidth*iNewHeight);
+	std::shared_ptr<const SumTable> pTab = std::atomic_load(&m_pSumTable);
+	if(!pTab)
+	{
+		pTab = std::make_shared<const SumTable>(m_iDepth2*m_iDepth, m_iWidth, m_iHeight,
+			GetValsRaw(), GetErrsRaw());
+		std::atomic_store(&m_pSumTable, pTab);
+	}
+	return pTab;
+}
+
+void Data4::ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight,
+	bool bKeepTotalCounts, ResampleMode mode)
+{
+	if(iNewWidth==m_iWidth && iNewHeight==m_iHeight)
+		return;
+
+	if(m_pChunks)
+	{
+		// foil by foil, into new dense buffers or chunks
+		std::shared_ptr<const ChunkedData> pChunks = m_pChunks;
+		const uint iOldW = m_iWidth, iOldH = m_iHeight;
+		ScaleRange(iNewWidth, iNewHeight);
+		AllocStorage();
+		InvalidateCaches();
+
+		std::vector<double> vecOldVals(std::size_t(iOldW)*iOldH*m_iDepth);
+		std::vector<double> vecOldErrs(m_bUseErrs ? vecOldVals.size() : 0);
+		std::vector<double> vecVals(std::size_t(iNewWidth)*iNewHeight*m_iDepth);
+		std::vector<double> vecErrs(m_bUseErrs ? vecVals.size() : 0);
+
+		for(uint iD2=0; iD2<m_iDepth2; ++iD2)
+		{
+			pChunks->GetSlices(iD2, 0, m_iDepth, vecOldVals.data(), m_bUseErrs ? vecOldErrs.data() : 0);
+			resample_slices(mode, bKeepTotalCounts, m_iDepth, iOldW, iOldH,
+				vecOldVals.data(), m_bUseErrs ? vecOldErrs.data() : 0, iNewWidth, iNewHeight,
+				vecVals.data(), m_bUseErrs ? vecErrs.data() : 0);
+			SetSlices(iD2, 0, m_iDepth, vecVals.data(), m_bUseErrs ? vecErrs.data() : 0);
+		}
+		return;
+	}
+
+	const bool bWasSparse = IsSparse();
+	MakeDense();
+
+	// every (depth, depth2) image is one slice
+	std::vector<double> vecVals(m_iDepth2*m_iDepth*iNewWidth*iNewHeight);
+	std::vector<double> vecErrs(m_bUseErrs ? vecVals.size() : 0);
+
+	resample_slices(mode, bKeepTotalCounts, m_iDepth2*m_iDepth, m_iWidth, m_iHeight,
+		m_vecVals.data(), m_bUseErrs ? m_vecErrs.data() : 0, iNewWidth, iNewHeight,
+		vecVals.data(), m_bUseErrs ? vecErrs.data() : 0);
+
+	m_vecVals.Replace(std::move(vecVals));
 	if(m_bUseErrs)
-		m_vecErrs.resize(m_iDepth2*m_iDepth*iNewWidth*iNewHeight);
-
-	double dAreaFactor = double(m_iWidth*m_iHeight)/double(iNewWidth*iNewHeight);
-
-	for(int iF=0; iF<int(m_iDepth2); ++iF)
-		for(int iT=0; iT<int(m_iDepth); ++iT)
-			for(int iY=0; iY<int(iNewHeight); ++iY)
-				for(int iX=0; iX<int(iNewWidth); ++iX)
-				{
-					double dOldY0 = ((iY+0.5)*double(m_iHeight))/double(iNewHeight) - 0.5;
-					double dOldX0 = ((iX+0.5)*double(m_iWidth))/double(iNewWidth) - 0.5;
-
-					int iX0 = int(dOldX0);
-					int iY0 = int(dOldY0);
-					int iX1 = iX0+1;
-					int iY1 = iY0+1;
-
-					if(iX0<0) iX0=0;
-					if(iY0<0) iY0=0;
-					if(iX1<0) iX1=0;
-					if(iY1<0) iY1=0;
-
-					if(iX0>=int(m_iWidth)) iX0=m_iWidth-1;
-					if(iY0>=int(m_iHeight)) iY0=m_iHeight-1;
-					if(iX1>=int(m_iWidth)) iX1=m_iWidth-1;
-					if(iY1>=int(m_iHeight)) iY1=m_iHeight-1;
-
-					double dX = (dOldX0 - double(iX0));
-					double dY = (dOldY0 - double(iY0));
-
-					if(dX<0.) dX=0.; if(dX>1.) dX=1.;
-					if(dY<0.) dY=0.; if(dY>1.) dY=1.;
-
-
-					const uint iOldIdx = iF*m_iDepth*m_iWidth*m_iHeight + iT*m_iWidth*m_iHeight;
-
-					double dx0y0 = vecVals[iOldIdx + iY0*m_iWidth + iX0];
-					double dx0y1 = vecVals[iOldIdx + iY1*m_iWidth + iX0];
-					double dx1y0 = vecVals[iOldIdx + iY0*m_iWidth + iX1];
-					double dx1y1 = vecVals[iOldIdx + iY1*m_iWidth + iX1];
-
-					double dx0y0_err = 0.;
-					double dx0y1_err = 0.;
-					double dx1y0_err = 0.;
-					double dx1y1_err = 0.;
-
-					if(vecErrs.size())
-					{
-						dx0y0_err = vecErrs[iOldIdx + iY0*m_iWidth + iX0];
-						dx0y1_err = vecErrs[iOldIdx + iY1*m_iWidth + iX0];
-						dx1y0_err = vecErrs[iOldIdx + iY0*m_iWidth + iX1];
-						dx1y1_err = vecErrs[iOldIdx + iY1*m_iWidth + iX1];
-					}
-
-					const uint iNewIdx = iF*m_iDepth*iNewWidth*iNewHeight + iT*iNewWidth*iNewHeight + iY*iNewWidth + iX;
-
-					m_vecVals[iNewIdx] = tl::bilinear_interp<double>(dx0y0, dx1y0, dx0y1, dx1y1, dX, dY);
-					if(m_bUseErrs)
-						m_vecErrs[iNewIdx] = tl::bilinear_interp<double>(dx0y0_err, dx1y0_err, dx0y1_err, dx1y1_err, dX, dY);
-
-					if(bKeepTotalCounts)
-					{
-						m_vecVals[iNewIdx] *= dAreaFactor;
-						if(m_bUseErrs)
-							m_vecErrs[iNewIdx] *= dAreaFactor;
-					}
-				}
-
-	// TODO: handle range correctly (also in radial integration)
-	m_dXMax = iNewWidth-1;
-	m_dYMax = iNewHeight-1;
-
-	m_iWidth = iNewWidth;
-	m_iHeight = iNewHeight;
-
-	RecalcMinMaxTotal();
+		m_vecErrs.Replace(std::move(vecErrs));
+	InvalidateCaches();
+
+	ScaleRange(iNewWidth, iNewHeight);
+
+	if(bWasSparse)
+		SelectStorage();
 }
 
 
 bool Data4::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
 {
+	InvalidateCaches();
+	m_pSparse.reset();
+	m_pChunks.reset();
 	LoadRangeXml(xml, strBase);
 	m_iDepth = xml.Query<unsigned int>((strBase+"depth").c_str(), 0);
 	m_iDepth2 = xml.Query<unsigned int>((strBase+"depth2").c_str(), 0);
@@ -381,7 +536,7 @@ bool Data4::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
 	if(m_bUseErrs)
 		m_vecErrs.resize(uiCnt);
 
-	std::vector<double>* vecs[] = {&m_vecVals, &m_vecErrs};
+	std::vector<double>* vecs[] = {&m_vecVals.Write(), &m_vecErrs.Write()};
 	std::string strs[] = {"vals", "errs"};
 
 	load_xml_vecs(m_bUseErrs?2:1, vecs, strs, xml, strBase, blob);
@@ -389,20 +544,40 @@ bool Data4::LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
 	m_dMin = xml.Query<double>((strBase+"min").c_str(), 0.);
 	m_dMax = xml.Query<double>((strBase+"max").c_str(), 0.);
 	m_dTotal = xml.Query<double>((strBase+"total").c_str(), 0.);
+	m_iStatsVersion = m_iVersion;
 
 	std::string strPhases = xml.QueryString((strBase+"phases").c_str(), "");
 	tl::get_tokens<double>(strPhases, std::string(",; "), m_vecPhases);
 
+	SelectStorage();
 	return DataInterface::LoadXML(xml, blob, strBase);;
 }
 
 bool Data4::SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const
 {
-	const bool bSaveInBlob = (m_vecVals.size() > BLOB_SIZE);
+	if(m_pChunks)
+	{
+		tl::log_err("4d data stored in chunks on disk is too large to be saved in a session.");
+		return false;
+	}
 
-	const std::vector<double>* vecs[] = {&m_vecVals, &m_vecErrs};
+	UpdateStats();
+	const bool bSaveInBlob = (std::size_t(m_iWidth)*m_iHeight*m_iDepth*m_iDepth2 > BLOB_SIZE);
+
+	const std::vector<double>* vecs[] = {&m_vecVals.Get(), &m_vecErrs.Get()};
 	std::string strs[] = {"vals", "errs"};
 
+	// the file format stays dense
+	std::vector<double> vecVals, vecErrs;
+	if(m_pSparse)
+	{
+		vecVals.resize(m_pSparse->GetSize());
+		vecErrs.resize(m_bUseErrs ? vecVals.size() : 0);
+		m_pSparse->GetDense(vecVals.data(), m_bUseErrs ? vecErrs.data() : 0);
+		vecs[0] = &vecVals;
+		vecs[1] = &vecErrs;
+	}
+
 	save_xml_vecs(m_bUseErrs?2:1, vecs, strs, ostr, ostrBlob, bSaveInBlob);
 
 	ostr << "<min> " << m_dMin << " </min>\n";
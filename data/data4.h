@@ -15,10 +15,30 @@ class Data4 : public DataInterface, public XYRange
 {
 protected:
 	uint m_iDepth, m_iDepth2;
-	std::vector<double> m_vecVals;
-	std::vector<double> m_vecErrs;
-	double m_dMin, m_dMax;
-	double m_dTotal;	// sum of all values
+	// shared between copies until written to
+	CowVector<double> m_vecVals;
+	CowVector<double> m_vecErrs;
+
+	// only the non-zero bins of weakly occupied data; the dense buffers are empty then
+	std::shared_ptr<const SparseData> m_pSparse;
+	// data too large for the memory is kept in chunks on disk, see chunked_min_size();
+	// the dense buffers are empty then, too
+	std::shared_ptr<ChunkedData> m_pChunks;
+	ChunkedData& WriteChunks();
+	void AllocStorage();
+
+	// statistics, recalculated on demand if the data version has changed
+	mutable double m_dMin, m_dMax;
+	mutable double m_dTotal;	// sum of all values
+	mutable std::size_t m_iStatsVersion = 0;
+	std::size_t m_iVersion = 0;
+
+	void UpdateStats() const { if(m_iStatsVersion != m_iVersion) CalcStats(); }
+	void CalcStats() const;
+
+	// integral images of the slices, built on first use and dropped on writes
+	mutable std::shared_ptr<const SumTable> m_pSumTable;
+	void InvalidateCaches() { ++m_iVersion; std::atomic_store(&m_pSumTable, std::shared_ptr<const SumTable>()); }
 
 	std::vector<double> m_vecPhases;
 	bool m_bUseErrs;
@@ -46,25 +66,54 @@ public:
 	void SetErr(uint iX, uint iY, uint iD, uint iD2, double dVal);
 	void SetVals(const double *pDat, const double *pErr=0);
 	void SetVals(uint iD2, const double *pDat, const double *pErr=0);
+	// [t][y][x] data of the time channels [iD, iD+iNum) of a foil
+	void SetSlices(uint iD2, uint iD, uint iNum, const double *pDat, const double *pErr=0);
 
 	void SetHasPhases(bool bHas) { m_vecPhases.resize(bHas ? m_iDepth2 : 0);  }
 	bool HasPhases() const { return (m_vecPhases.size()==m_iDepth2); }
 	const std::vector<double>& GetPhases() const { return m_vecPhases; }
 	void SetPhases(const std::vector<double>& vec) { m_vecPhases = vec; }
 
-	double GetMin() const { return m_dMin; }
-	double GetMax() const { return m_dMax; }
+	double GetMin() const { UpdateStats(); return m_dMin; }
+	double GetMax() const { UpdateStats(); return m_dMax; }
 
-	double GetTotal() const { return m_dTotal; }
-	void SetTotal(double dTot) { m_dTotal = dTot; }
+	double GetTotal() const { UpdateStats(); return m_dTotal; }
+	// overrides the total until the next change of the data
+	void SetTotal(double dTot) { UpdateStats(); m_dTotal = dTot; }
+
+	// incremented on every change of the data
+	std::size_t GetVersion() const { return m_iVersion; }
+
+	// contiguous [foil][t][y][x] buffers, no errors if they are not used;
+	// null for sparse and chunked data
+	const double* GetValsRaw() const { return m_pSparse || m_pChunks ? 0 : m_vecVals.data(); }
+	const double* GetErrsRaw() const { return m_bUseErrs && !m_pSparse && !m_pChunks ? m_vecErrs.data() : 0; }
+
+	bool IsSparse() const { return bool(m_pSparse); }
+	std::shared_ptr<const SparseData> GetSparse() const { return m_pSparse; }
+
+	bool IsChunked() const { return bool(m_pChunks); }
+	std::shared_ptr<const ChunkedData> GetChunks() const { return m_pChunks; }
+
+	// chunked data only counts its cached chunks
+	virtual std::size_t GetMemory() const override;
+
+	// stores the data sparsely if few bins are occupied, see sparse_threshold()
+	void SelectStorage();
+	// writing to sparse data converts it back to dense buffers
+	void MakeDense();
+	// null for chunked data, whose sums are streamed instead
+	std::shared_ptr<const SumTable> GetSumTable() const;
 
 	Data3 GetVal(uint iD2) const;
 	Data2 GetVal(uint iD, uint iD2) const;
 	Data1 GetXYSum(uint iD2) const;
+	std::vector<Data1> GetXYSums() const;	// of all foils
 	Data1 GetXYD2(uint iX, uint iY, uint iD2) const;
 
 	void RecalcMinMaxTotal();
-	void ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts=false);
+	void ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts=false,
+		ResampleMode mode=RESAMPLE_AUTO);
 
 	virtual bool LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase) override;
 	virtual bool SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const override;
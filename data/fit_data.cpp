@@ -23,6 +23,22 @@
 #include "helper/mieze.h"
 #include "helper/mfourier.h"
 #include "helper/misc.h"
+#include "helper/workpool.h"
+
+
+// Minuit doesn't handle errors that are exactly 0
+static void assume_errors(unsigned int iLen, const double *py, double *pyerr)
+{
+	if(iLen == 0)
+		return;
+
+	const double dMaxY = *std::max_element(py, py+iLen);
+	for(unsigned int iErr=0; iErr<iLen; ++iErr)
+	{
+		if(pyerr[iErr] < std::numeric_limits<double>::min())
+			pyerr[iErr] = dMaxY * 0.001;
+	}
+}
 
 
 bool FitData::fit(const Data1& dat, const FitDataParams& params, tl::FitterFuncModel<double>** pFkt)
@@ -39,17 +55,8 @@ bool FitData::fit(const Data1& dat, const FitDataParams& params, tl::FitterFuncM
 	const unsigned int iLen = pvecDatX->size();
 
 
-	// Minuit doesn't handle errors that are exactly 0
 	if(params.bAssumeErrorIfZero)
-	{
-		double dMinY = *std::min_element(py, py+iLen);
-		double dMaxY = *std::max_element(py, py+iLen);
-		for(unsigned int iErr=0; iErr<iLen; ++iErr)
-		{
-			if(pyerr[iErr] < std::numeric_limits<double>::min())
-				pyerr[iErr] = dMaxY * 0.001;
-		}
-	}
+		assume_errors(iLen, py, pyerr);
 
 	*pFkt = 0;
 	bool bOk = 0;
@@ -94,6 +101,19 @@ bool FitData::fit(const Data1& dat, const FitDataParams& params, tl::FitterFuncM
 		bOk = ::get_multigauss(iLen, px, py, pyerr, &pModel, iNumPeaks);
 		*pFkt = pModel;
 	}
+	else if(params.iFkt == FIT_USER_DEFINED)
+	{
+		std::vector<std::string> vecFittedNames;
+		std::vector<double> vecFittedParams;
+		std::vector<double> vecFittedErrs;
+
+		FreeFktModel *pModel = 0;
+		bOk = ::get_freefit(iLen, px, py, pyerr, params.strFkt.c_str(),
+			params.strLimits.length() ? params.strLimits.c_str() : 0,
+			params.strHints.length() ? params.strHints.c_str() : 0,
+			vecFittedNames, vecFittedParams, vecFittedErrs, &pModel);
+		*pFkt = pModel;
+	}
 	else
 	{
 		tl::log_err("Unknown fit function selected.");
@@ -109,6 +129,185 @@ bool FitData::fit(const Data1& dat, const FitDataParams& params, tl::FitterFuncM
 	return bOk;
 }
 
+double FitData::chi2(const Data1& dat, const FitDataParams& params, const tl::FitterFuncModel<double>& fkt)
+{
+	const std::vector<double> *pvecDatX, *pvecDatY, *pvecDatYErr;
+	const_cast<Data1&>(dat).GetData(&pvecDatX, &pvecDatY, &pvecDatYErr);
+
+	const unsigned int iLen = pvecDatX->size();
+	std::vector<double> vecErr = *pvecDatYErr;
+	if(params.bAssumeErrorIfZero)
+		assume_errors(iLen, pvecDatY->data(), vecErr.data());
+
+	double dChi2 = 0.;
+	for(unsigned int i=0; i<iLen; ++i)
+	{
+		double dErr = vecErr[i];
+		if(std::fabs(dErr) < std::numeric_limits<double>::min())
+			dErr = std::numeric_limits<double>::min();
+
+		const double dDiff = ((*pvecDatY)[i] - fkt((*pvecDatX)[i])) / dErr;
+		dChi2 += dDiff*dDiff;
+	}
+	return dChi2;
+}
+
+bool FitData::fit_batch(const std::vector<const Data1*>& vecDat, const FitDataParams& params,
+	FitBatchResult& res, const std::vector<double>* pvecX,
+	std::vector<tl::FitterFuncModel<double>*>* pvecModels,
+	const t_fktProgress& fktProgress)
+{
+	const unsigned int iNumSets = vecDat.size();
+
+	res = FitBatchResult();
+	if(pvecX && pvecX->size() != iNumSets)
+	{
+		tl::log_err("Batch fit: Got ", pvecX->size(), " x values for ",
+			iNumSets, " data sets.");
+		return false;
+	}
+
+	if(pvecX)
+	{
+		res.vecX = *pvecX;
+	}
+	else
+	{
+		res.vecX.resize(iNumSets);
+		for(unsigned int iSet=0; iSet<iNumSets; ++iSet)
+			res.vecX[iSet] = double(iSet);
+	}
+	res.vecChi2.resize(iNumSets, 0.);
+	res.vecHasModel.resize(iNumSets, 0);
+	res.vecConverged.resize(iNumSets, 0);
+
+	std::vector<tl::FitterFuncModel<double>*> vecModels(iNumSets, 0);
+
+
+	// every task only writes to its own row
+	WorkPool pool;
+	for(unsigned int iSet=0; iSet<iNumSets; ++iSet)
+	{
+		const Data1 *pDat = vecDat[iSet];
+		if(!pDat)
+			continue;
+
+		pool.AddTask([iSet, pDat, &params, &res, &vecModels]()
+		{
+			tl::FitterFuncModel<double> *pFkt = 0;
+			res.vecConverged[iSet] = FitData::fit(*pDat, params, &pFkt);
+
+			if(pFkt)
+			{
+				res.vecHasModel[iSet] = 1;
+				res.vecChi2[iSet] = FitData::chi2(*pDat, params, *pFkt);
+			}
+			vecModels[iSet] = pFkt;
+		}, double(pDat->GetLength()));
+	}
+
+	pool.Start();
+
+	const unsigned int iNumTasks = pool.GetNumTasks();
+	for(unsigned int iDone=0; iDone<iNumTasks;)
+	{
+		iDone = pool.WaitProgress(iDone);
+		if(fktProgress)
+			fktProgress(iDone, iNumTasks);
+	}
+
+	pool.Join();
+
+
+	// parameter columns, all models are of the same kind
+	for(unsigned int iSet=0; iSet<iNumSets; ++iSet)
+	{
+		if(!vecModels[iSet])
+			continue;
+
+		if(res.vecParamNames.empty())
+		{
+			res.vecParamNames = vecModels[iSet]->GetParamNames();
+			res.vecVals.assign(res.vecParamNames.size(), std::vector<double>(iNumSets, 0.));
+			res.vecErrs.assign(res.vecParamNames.size(), std::vector<double>(iNumSets, 0.));
+		}
+
+		const std::vector<double> vecVals = vecModels[iSet]->GetParamValues();
+		const std::vector<double> vecErrs = vecModels[iSet]->GetParamErrors();
+		if(vecVals.size() != res.vecParamNames.size() || vecErrs.size() != vecVals.size())
+		{
+			tl::log_err("Parameter count mismatch in data set ", iSet, ".");
+			res.vecHasModel[iSet] = 0;
+			continue;
+		}
+
+		for(unsigned int iParam=0; iParam<vecVals.size(); ++iParam)
+		{
+			res.vecVals[iParam][iSet] = vecVals[iParam];
+			res.vecErrs[iParam][iSet] = vecErrs[iParam];
+		}
+	}
+
+	if(pvecModels)
+	{
+		*pvecModels = vecModels;
+	}
+	else
+	{
+		for(tl::FitterFuncModel<double> *pFkt : vecModels)
+			if(pFkt) delete pFkt;
+	}
+
+	const unsigned int iNumConverged = std::count(res.vecConverged.begin(), res.vecConverged.end(), 1);
+	tl::log_info("Batch fit: ", iNumConverged, " of ", iNumSets, " fits converged, ",
+		pool.GetNumThreads(), " threads.");
+	return iNumConverged == iNumSets;
+}
+
+
+int FitBatchResult::GetParamIdx(const std::string& strParam) const
+{
+	for(unsigned int iParam=0; iParam<vecParamNames.size(); ++iParam)
+		if(vecParamNames[iParam] == strParam)
+			return int(iParam);
+	return -1;
+}
+
+Data1 FitBatchResult::GetParam(unsigned int iParam) const
+{
+	if(iParam >= vecVals.size())
+		return Data1();
+
+	std::vector<double> vecColX, vecColY, vecColErr;
+	for(unsigned int iSet=0; iSet<GetNumSets(); ++iSet)
+	{
+		if(!vecHasModel[iSet])
+			continue;
+
+		vecColX.push_back(vecX[iSet]);
+		vecColY.push_back(vecVals[iParam][iSet]);
+		vecColErr.push_back(vecErrs[iParam][iSet]);
+	}
+
+	return Data1(vecColX.size(), vecColX.data(), vecColY.data(), vecColErr.data());
+}
+
+Data1 FitBatchResult::GetChi2() const
+{
+	std::vector<double> vecColX, vecColY;
+	for(unsigned int iSet=0; iSet<GetNumSets(); ++iSet)
+	{
+		if(!vecHasModel[iSet])
+			continue;
+
+		vecColX.push_back(vecX[iSet]);
+		vecColY.push_back(vecChi2[iSet]);
+	}
+
+	return Data1(vecColX.size(), vecColX.data(), vecColY.data());
+}
+
+
 Data1 FitData::mieze_sum_foils(const std::vector<Data1>& vecFoils, const std::vector<double>* pvecFoilPhases)
 {
 	if(vecFoils.size() == 0)
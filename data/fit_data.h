@@ -13,6 +13,8 @@
 #include "tlibs/fit/minuit.h"
 
 #include <vector>
+#include <string>
+#include <functional>
 
 
 #define FIT_MIEZE_SINE 					0
@@ -20,6 +22,7 @@
 #define FIT_MULTI_GAUSSIAN 				2
 #define FIT_MIEZE_EXP 					3
 #define FIT_MIEZE_EXP_FIXEDP0			4
+#define FIT_USER_DEFINED				5
 #define FIT_INVALID						-1
 
 #define FIT_MIEZE_SINE_PIXELWISE 		0
@@ -31,15 +34,48 @@ struct FitDataParams
 	bool bAssumeErrorIfZero;
 	int iNumPeaks;
 
+	// only for FIT_USER_DEFINED
+	std::string strFkt, strLimits, strHints;
+
 	FitDataParams()
 		: iFkt(FIT_INVALID), bAssumeErrorIfZero(1), iNumPeaks(1)
 	{}
 };
 
+// column-wise results of a batch fit, one row per data set
+struct FitBatchResult
+{
+	std::vector<double> vecX;					// abscissa of each data set, e.g. tau
+	std::vector<std::string> vecParamNames;
+	std::vector<std::vector<double> > vecVals, vecErrs;	// [param][data set]
+	std::vector<double> vecChi2;
+	std::vector<unsigned char> vecHasModel, vecConverged;
+
+	unsigned int GetNumSets() const { return vecX.size(); }
+	int GetParamIdx(const std::string& strParam) const;
+
+	// parameter and chi^2 against the abscissa, only data sets with a model
+	Data1 GetParam(unsigned int iParam) const;
+	Data1 GetChi2() const;
+};
+
 class FitData
 {
 public:
+	typedef std::function<void(unsigned int iDone, unsigned int iTotal)> t_fktProgress;
+
 	static bool fit(const Data1& dat, const FitDataParams& params, tl::FitterFuncModel<double>** pFkt);
+
+	// fits all data sets with the same model in parallel; the progress
+	// function is called from the calling thread; if pvecModels is given,
+	// it receives the fitted models (or 0), which the caller has to delete;
+	// if pvecX is given, it has to hold one x value per data set
+	static bool fit_batch(const std::vector<const Data1*>& vecDat, const FitDataParams& params,
+		FitBatchResult& res, const std::vector<double>* pvecX=0,
+		std::vector<tl::FitterFuncModel<double>*>* pvecModels=0,
+		const t_fktProgress& fktProgress=t_fktProgress());
+
+	static double chi2(const Data1& dat, const FitDataParams& params, const tl::FitterFuncModel<double>& fkt);
 	static Data1 mieze_sum_foils(const std::vector<Data1>& vecFoils, const std::vector<double>* pvecFoilPhases=0);
 };
 
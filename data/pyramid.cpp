@@ -0,0 +1,59 @@
+/**
+ * mieze-tool
+ * count-conserving image pyramids
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "pyramid.h"
+#include "resample.h"
+
+
+Pyramid::Pyramid(unsigned int iNumSlices, unsigned int iW, unsigned int iH,
+	const double *pVals, const double *pErrs)
+	: m_iW(iW), m_iH(iH), m_iNumSlices(iNumSlices)
+{
+	if(!iNumSlices || !iW || !iH)
+		return;
+
+	while(iW > 1 || iH > 1)
+	{
+		PyramidLevel level;
+		level.iW = (iW+1) / 2;
+		level.iH = (iH+1) / 2;
+		level.dPixelArea = double(m_iW)*double(m_iH) / (double(level.iW)*double(level.iH));
+
+		level.vecVals.resize(std::size_t(iNumSlices)*level.iW*level.iH);
+		if(pErrs)
+			level.vecErrs.resize(level.vecVals.size());
+
+		// odd sizes are rebinned by fractional pixels, which also conserves the counts
+		resample_slices(RESAMPLE_REBIN, 1, iNumSlices, iW, iH, pVals, pErrs,
+			level.iW, level.iH, level.vecVals.data(), pErrs ? level.vecErrs.data() : 0);
+
+		m_vecLevels.push_back(std::move(level));
+
+		const PyramidLevel& levelLast = *m_vecLevels.rbegin();
+		iW = levelLast.iW;
+		iH = levelLast.iH;
+		pVals = levelLast.vecVals.data();
+		pErrs = pErrs ? levelLast.vecErrs.data() : 0;
+	}
+}
+
+unsigned int Pyramid::ChooseLevel(unsigned int iW, unsigned int iH,
+	unsigned int iScreenW, unsigned int iScreenH)
+{
+	unsigned int iLevel = 0;
+	while(iW > 1 || iH > 1)
+	{
+		// same level sizes as in the constructor
+		iW = (iW+1) / 2;
+		iH = (iH+1) / 2;
+		if(iW < iScreenW || iH < iScreenH)
+			break;
+		++iLevel;
+	}
+	return iLevel;
+}
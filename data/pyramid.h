@@ -0,0 +1,56 @@
+/**
+ * mieze-tool
+ * count-conserving image pyramids
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_PYRAMID__
+#define __MIEZE_PYRAMID__
+
+#include <vector>
+
+struct PyramidLevel
+{
+	unsigned int iW, iH;
+
+	// original pixels per pixel of this level
+	double dPixelArea;
+
+	// iNumSlices consecutive iW x iH slices; sums, not means
+	std::vector<double> vecVals;
+	std::vector<double> vecErrs;	// empty if there are no errors
+};
+
+
+/*
+ * halves iNumSlices consecutive iW x iH slices down to a single pixel;
+ * level 0 is the data itself and is not stored
+ */
+class Pyramid
+{
+protected:
+	unsigned int m_iW, m_iH, m_iNumSlices;
+	std::vector<PyramidLevel> m_vecLevels;	// levels 1, 2, ...
+
+public:
+	Pyramid(unsigned int iNumSlices, unsigned int iW, unsigned int iH,
+		const double *pVals, const double *pErrs=0);
+
+	unsigned int GetNumLevels() const { return m_vecLevels.size() + 1; }
+	unsigned int GetNumSlices() const { return m_iNumSlices; }
+
+	// 1 <= iLevel < GetNumLevels(), throws std::out_of_range otherwise
+	const PyramidLevel& GetLevel(unsigned int iLevel) const { return m_vecLevels.at(iLevel-1); }
+
+	// coarsest level still at least as large as iScreenW x iScreenH
+	unsigned int ChooseLevel(unsigned int iScreenW, unsigned int iScreenH) const
+	{ return ChooseLevel(m_iW, m_iH, iScreenW, iScreenH); }
+
+	// the same from the data size alone, without building the pyramid
+	static unsigned int ChooseLevel(unsigned int iW, unsigned int iH,
+		unsigned int iScreenW, unsigned int iScreenH);
+};
+
+#endif
@@ -0,0 +1,672 @@
+/**
+ * mieze-tool
+ * sums and means over axes of 3d and 4d data
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "reduce.h"
+#include "helper/workpool.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+// input values per task; smaller reductions run in the calling thread
+#define REDUCE_BLOCK (1<<16)
+
+
+// pixels to use and, per row, the range [begin, end) containing them
+struct RoiMask
+{
+	std::vector<unsigned char> vecMask;
+	std::vector<uint> vecRowBegin, vecRowEnd;
+};
+
+static void make_roi_mask(const RoiFlags& roi, const XYRange& range, uint iW, uint iH, RoiMask& mask)
+{
+	mask.vecMask.assign(std::size_t(iW)*iH, 0);
+	mask.vecRowBegin.assign(iH, iW);
+	mask.vecRowEnd.assign(iH, 0);
+
+	// only test the pixels in the bounding rectangle of the roi
+	int iXStart=0, iXEnd=iW, iYStart=0, iYEnd=iH;
+	if(roi.IsRoiActive(0))
+	{
+		const BoundingRect br = roi.GetRoi(0).GetBoundingRect();
+		iXStart = std::max(0, int(std::floor(range.GetPixelXPos(br.bottomleft[0]))));
+		iYStart = std::max(0, int(std::floor(range.GetPixelYPos(br.bottomleft[1]))));
+		iXEnd = std::min(int(iW), int(std::ceil(range.GetPixelXPos(br.topright[0])))+1);
+		iYEnd = std::min(int(iH), int(std::ceil(range.GetPixelYPos(br.topright[1])))+1);
+	}
+
+	for(int iY=iYStart; iY<iYEnd; ++iY)
+	{
+		const double dY = range.GetRangeYPos(iY);
+		for(int iX=iXStart; iX<iXEnd; ++iX)
+		{
+			if(!roi.IsInsideRoi(range.GetRangeXPos(iX), dY))
+				continue;
+
+			mask.vecMask[std::size_t(iY)*iW + iX] = 1;
+			mask.vecRowBegin[iY] = std::min<uint>(mask.vecRowBegin[iY], iX);
+			mask.vecRowEnd[iY] = std::max<uint>(mask.vecRowEnd[iY], iX+1);
+		}
+	}
+}
+
+
+// pOut[x] += v[x] for x in [iBegin, iEnd), the variances likewise
+static inline void add_row(double *pOut, double *pOutVar,
+	const double *pVals, const double *pErrs, const unsigned char *pMask,
+	uint iBegin, uint iEnd)
+{
+	if(pMask)
+	{
+		for(uint iX=iBegin; iX<iEnd; ++iX)
+			pOut[iX] += pMask[iX] * pVals[iX];
+		if(pErrs)
+			for(uint iX=iBegin; iX<iEnd; ++iX)
+				pOutVar[iX] += pMask[iX] * pErrs[iX]*pErrs[iX];
+	}
+	else
+	{
+		for(uint iX=iBegin; iX<iEnd; ++iX)
+			pOut[iX] += pVals[iX];
+		if(pErrs)
+			for(uint iX=iBegin; iX<iEnd; ++iX)
+				pOutVar[iX] += pErrs[iX]*pErrs[iX];
+	}
+}
+
+// *pOut += sum of v[x] for x in [iBegin, iEnd), the variances likewise
+static inline void sum_row(double *pOut, double *pOutVar,
+	const double *pVals, const double *pErrs, const unsigned char *pMask,
+	uint iBegin, uint iEnd)
+{
+	double dSum = 0., dVar = 0.;
+	if(pMask)
+	{
+		for(uint iX=iBegin; iX<iEnd; ++iX)
+			dSum += pMask[iX] * pVals[iX];
+		if(pErrs)
+			for(uint iX=iBegin; iX<iEnd; ++iX)
+				dVar += pMask[iX] * pErrs[iX]*pErrs[iX];
+	}
+	else
+	{
+		for(uint iX=iBegin; iX<iEnd; ++iX)
+			dSum += pVals[iX];
+		if(pErrs)
+			for(uint iX=iBegin; iX<iEnd; ++iX)
+				dVar += pErrs[iX]*pErrs[iX];
+	}
+
+	*pOut += dSum;
+	if(pErrs)
+		*pOutVar += dVar;
+}
+
+
+/*
+ * normalises the sums for means and converts the variances to errors;
+ * res holds the sums over the pixels in the mask
+ */
+static void finish_reduce(const uint *piDims, const RoiMask *pMask,
+	const ReduceParams& params, ReduceResult& res)
+{
+	if(params.op == REDUCE_MEAN)
+	{
+		const uint iW = piDims[0], iH = piDims[1], iD = piDims[2], iD2 = piDims[3];
+		const bool bKeepX = !(params.iAxes & AXIS_X);
+		const bool bKeepY = !(params.iAxes & AXIS_Y);
+		const bool bKeepT = !(params.iAxes & AXIS_T) && params.iT < 0;
+		const bool bKeepF = !(params.iAxes & AXIS_FOIL) && params.iFoil < 0;
+
+		// summed slices per output plane
+		const uint iNumT = bKeepT ? 1 : (params.iT >= 0 ? (uint(params.iT) < iD) : iD);
+		const uint iNumF = bKeepF ? 1 : (params.iFoil >= 0 ? (uint(params.iFoil) < iD2) : iD2);
+
+		const uint oW = res.iDims[0];
+		const std::size_t iPlaneSize = std::size_t(res.iDims[0])*res.iDims[1];
+
+		// number of summed pixels per output pixel
+		std::vector<double> vecCnt(iPlaneSize, 0.);
+		for(uint iY=0; iY<iH; ++iY)
+			for(uint iX=0; iX<iW; ++iX)
+				vecCnt[(bKeepY ? iY : 0)*oW + (bKeepX ? iX : 0)] +=
+					pMask ? pMask->vecMask[std::size_t(iY)*iW + iX] : 1;
+
+		const bool bErrs = res.vecErrs.size() != 0;
+		for(std::size_t iOut=0; iOut<res.vecVals.size(); ++iOut)
+		{
+			const double dCnt = vecCnt[iOut % iPlaneSize] * iNumT * iNumF;
+			const double dNorm = dCnt > 0. ? 1./dCnt : 0.;
+
+			res.vecVals[iOut] *= dNorm;
+			if(bErrs)
+				res.vecErrs[iOut] *= dNorm*dNorm;
+		}
+	}
+
+	for(double& dVar : res.vecErrs)
+		dVar = std::sqrt(dVar);
+}
+
+
+/*
+ * the input is [foil][t][y][x]; every task handles one output (t, foil)
+ * combination and a block of rows, so tasks never write to the same
+ * output, and partial sums over y are added in block order afterwards,
+ * which keeps the result independent of the number of threads
+ */
+static void reduce_raw(const double *pVals, const double *pErrs, const uint *piDims,
+	const RoiMask *pMask, const ReduceParams& params, ReduceResult& res)
+{
+	const uint iW = piDims[0], iH = piDims[1], iD = piDims[2], iD2 = piDims[3];
+
+	const bool bKeepX = !(params.iAxes & AXIS_X);
+	const bool bKeepY = !(params.iAxes & AXIS_Y);
+	const bool bKeepT = !(params.iAxes & AXIS_T) && params.iT < 0;
+	const bool bKeepF = !(params.iAxes & AXIS_FOIL) && params.iFoil < 0;
+
+	// contributing time channels and foils
+	uint iTBegin = 0, iTEnd = iD, iFBegin = 0, iFEnd = iD2;
+	if(params.iT >= 0)
+	{
+		iTBegin = std::min<uint>(params.iT, iD);
+		iTEnd = std::min<uint>(params.iT+1, iD);
+	}
+	if(params.iFoil >= 0)
+	{
+		iFBegin = std::min<uint>(params.iFoil, iD2);
+		iFEnd = std::min<uint>(params.iFoil+1, iD2);
+	}
+
+	const uint oW = bKeepX ? iW : 1;
+	const uint oH = bKeepY ? iH : 1;
+	const uint oD = bKeepT ? iD : 1;
+	const uint oD2 = bKeepF ? iD2 : 1;
+	res.iDims[0] = oW; res.iDims[1] = oH;
+	res.iDims[2] = oD; res.iDims[3] = oD2;
+
+	const std::size_t iPlaneSize = std::size_t(oW)*oH;
+	const std::size_t iOutSize = iPlaneSize*oD*oD2;
+	res.vecVals.assign(iOutSize, 0.);
+	res.vecErrs.assign(pErrs ? iOutSize : 0, 0.);	// variances until the end
+
+	if(!iW || !iH || !iOutSize)
+		return;
+
+	// slices summed into every output plane
+	const uint iNumT = bKeepT ? 1 : iTEnd-iTBegin;
+	const uint iNumF = bKeepF ? 1 : iFEnd-iFBegin;
+	const std::size_t iSliceSize = std::size_t(iW)*iH;
+
+	const uint iRowsPerBlock = std::max<std::size_t>(1, REDUCE_BLOCK / std::max<std::size_t>(1, std::size_t(iW)*iNumT*iNumF));
+	const uint iNumBlocks = (iH + iRowsPerBlock - 1) / iRowsPerBlock;
+	const uint iNumPlanes = oD*oD2;
+
+	// per plane and block, if y is reduced
+	std::vector<double> vecPartial(bKeepY ? 0 : std::size_t(iNumPlanes)*iNumBlocks*oW, 0.);
+	std::vector<double> vecPartialVar(bKeepY || !pErrs ? 0 : vecPartial.size(), 0.);
+
+	auto task = [&](uint iPlane, uint iBlock)
+	{
+		const uint iOT = iPlane % oD, iOF = iPlane / oD;
+		const uint iY0 = iBlock*iRowsPerBlock;
+		const uint iY1 = std::min(iY0 + iRowsPerBlock, iH);
+
+		const uint iT0 = bKeepT ? iOT : iTBegin, iT1 = bKeepT ? iOT+1 : iTEnd;
+		const uint iF0 = bKeepF ? iOF : iFBegin, iF1 = bKeepF ? iOF+1 : iFEnd;
+
+		const std::size_t iPartial = (std::size_t(iPlane)*iNumBlocks + iBlock)*oW;
+
+		for(uint iF=iF0; iF<iF1; ++iF)
+		for(uint iT=iT0; iT<iT1; ++iT)
+		{
+			const std::size_t iSlice = (std::size_t(iF)*iD + iT)*iSliceSize;
+
+			for(uint iY=iY0; iY<iY1; ++iY)
+			{
+				uint iXBegin = 0, iXEnd = iW;
+				const unsigned char *pMaskRow = 0;
+				if(pMask)
+				{
+					iXBegin = pMask->vecRowBegin[iY];
+					iXEnd = pMask->vecRowEnd[iY];
+					if(iXBegin >= iXEnd)
+						continue;
+					pMaskRow = pMask->vecMask.data() + std::size_t(iY)*iW;
+				}
+
+				const double *pValRow = pVals + iSlice + std::size_t(iY)*iW;
+				const double *pErrRow = pErrs ? pErrs + iSlice + std::size_t(iY)*iW : 0;
+
+				double *pOut, *pOutVar = 0;
+				if(bKeepY)
+				{
+					const std::size_t iOut = iPlane*iPlaneSize + std::size_t(iY)*oW;
+					pOut = res.vecVals.data() + iOut;
+					if(pErrs) pOutVar = res.vecErrs.data() + iOut;
+				}
+				else
+				{
+					pOut = vecPartial.data() + iPartial;
+					if(pErrs) pOutVar = vecPartialVar.data() + iPartial;
+				}
+
+				if(bKeepX)
+					add_row(pOut, pOutVar, pValRow, pErrRow, pMaskRow, iXBegin, iXEnd);
+				else
+					sum_row(pOut, pOutVar, pValRow, pErrRow, pMaskRow, iXBegin, iXEnd);
+			}
+		}
+	};
+
+	const double dWork = double(iSliceSize)*iNumT*iNumF*iNumPlanes;
+	if(dWork <= REDUCE_BLOCK)
+	{
+		for(uint iPlane=0; iPlane<iNumPlanes; ++iPlane)
+			for(uint iBlock=0; iBlock<iNumBlocks; ++iBlock)
+				task(iPlane, iBlock);
+	}
+	else
+	{
+		WorkPool pool;
+		for(uint iPlane=0; iPlane<iNumPlanes; ++iPlane)
+			for(uint iBlock=0; iBlock<iNumBlocks; ++iBlock)
+			{
+				const uint iRows = std::min(iRowsPerBlock, iH - iBlock*iRowsPerBlock);
+				pool.AddTask([&task, iPlane, iBlock]() { task(iPlane, iBlock); },
+					double(iRows)*iW*iNumT*iNumF);
+			}
+		pool.Start();
+		pool.Join();
+	}
+
+	if(!bKeepY)
+	{
+		for(uint iPlane=0; iPlane<iNumPlanes; ++iPlane)
+			for(uint iBlock=0; iBlock<iNumBlocks; ++iBlock)
+			{
+				const std::size_t iPartial = (std::size_t(iPlane)*iNumBlocks + iBlock)*oW;
+				for(uint iX=0; iX<oW; ++iX)
+				{
+					res.vecVals[iPlane*iPlaneSize + iX] += vecPartial[iPartial + iX];
+					if(pErrs)
+						res.vecErrs[iPlane*iPlaneSize + iX] += vecPartialVar[iPartial + iX];
+				}
+			}
+	}
+
+	finish_reduce(piDims, pMask, params, res);
+}
+
+
+/*
+ * the same for sparse data, only visiting the non-zero bins of the
+ * pixels in the mask
+ */
+static void reduce_sparse(const SparseData& sparse, const RoiMask *pMask,
+	const ReduceParams& params, ReduceResult& res)
+{
+	const uint iW = sparse.GetWidth(), iH = sparse.GetHeight();
+	const uint iD = sparse.GetDepth(), iD2 = sparse.GetDepth2();
+	const uint piDims[4] = { iW, iH, iD, iD2 };
+
+	const bool bKeepX = !(params.iAxes & AXIS_X);
+	const bool bKeepY = !(params.iAxes & AXIS_Y);
+	const bool bKeepT = !(params.iAxes & AXIS_T) && params.iT < 0;
+	const bool bKeepF = !(params.iAxes & AXIS_FOIL) && params.iFoil < 0;
+
+	uint iTBegin = 0, iTEnd = iD, iFBegin = 0, iFEnd = iD2;
+	if(params.iT >= 0)
+	{
+		iTBegin = std::min<uint>(params.iT, iD);
+		iTEnd = std::min<uint>(params.iT+1, iD);
+	}
+	if(params.iFoil >= 0)
+	{
+		iFBegin = std::min<uint>(params.iFoil, iD2);
+		iFEnd = std::min<uint>(params.iFoil+1, iD2);
+	}
+
+	const uint oW = bKeepX ? iW : 1;
+	const uint oH = bKeepY ? iH : 1;
+	const uint oD = bKeepT ? iD : 1;
+	const uint oD2 = bKeepF ? iD2 : 1;
+	res.iDims[0] = oW; res.iDims[1] = oH;
+	res.iDims[2] = oD; res.iDims[3] = oD2;
+
+	const bool bErrs = sparse.HasErrs();
+	const std::size_t iPlaneSize = std::size_t(oW)*oH;
+	res.vecVals.assign(iPlaneSize*oD*oD2, 0.);
+	res.vecErrs.assign(bErrs ? res.vecVals.size() : 0, 0.);	// variances until the end
+
+	const unsigned int *pT = sparse.GetT();
+	const double *pVals = sparse.GetVals();
+	const double *pErrs = sparse.GetErrs();
+
+	for(uint iF=iFBegin; iF<iFEnd; ++iF)
+	{
+		const std::size_t iOutF = std::size_t(bKeepF ? iF : 0)*oD;
+
+		for(uint iY=0; iY<iH; ++iY)
+		{
+			uint iXBegin = 0, iXEnd = iW;
+			const unsigned char *pMaskRow = 0;
+			if(pMask)
+			{
+				iXBegin = pMask->vecRowBegin[iY];
+				iXEnd = pMask->vecRowEnd[iY];
+				pMaskRow = pMask->vecMask.data() + std::size_t(iY)*iW;
+			}
+
+			for(uint iX=iXBegin; iX<iXEnd; ++iX)
+			{
+				if(pMaskRow && !pMaskRow[iX])
+					continue;
+
+				const std::size_t iPixel = sparse.GetPixel(iX, iY, iF);
+				const std::size_t iOutXY = std::size_t(bKeepY ? iY : 0)*oW + (bKeepX ? iX : 0);
+
+				for(std::size_t iBin=sparse.GetPixelBegin(iPixel); iBin<sparse.GetPixelEnd(iPixel); ++iBin)
+				{
+					const uint iT = pT[iBin];
+					if(iT < iTBegin || iT >= iTEnd)
+						continue;
+
+					const std::size_t iOut = (iOutF + (bKeepT ? iT : 0))*iPlaneSize + iOutXY;
+					res.vecVals[iOut] += pVals[iBin];
+					if(bErrs)
+						res.vecErrs[iOut] += pErrs[iBin]*pErrs[iBin];
+				}
+			}
+		}
+	}
+
+	finish_reduce(piDims, pMask, params, res);
+}
+
+
+/*
+ * the same for chunked data, streaming the chunks of the selected time
+ * channels and foils from the disk one after the other
+ */
+static void reduce_chunked(const ChunkedData& chunks, const RoiMask *pMask,
+	const ReduceParams& params, ReduceResult& res)
+{
+	const uint iW = chunks.GetWidth(), iH = chunks.GetHeight();
+	const uint iD = chunks.GetDepth(), iD2 = chunks.GetDepth2();
+	const uint piDims[4] = { iW, iH, iD, iD2 };
+
+	const bool bKeepX = !(params.iAxes & AXIS_X);
+	const bool bKeepY = !(params.iAxes & AXIS_Y);
+	const bool bKeepT = !(params.iAxes & AXIS_T) && params.iT < 0;
+	const bool bKeepF = !(params.iAxes & AXIS_FOIL) && params.iFoil < 0;
+
+	uint iTBegin = 0, iTEnd = iD, iFBegin = 0, iFEnd = iD2;
+	if(params.iT >= 0)
+	{
+		iTBegin = std::min<uint>(params.iT, iD);
+		iTEnd = std::min<uint>(params.iT+1, iD);
+	}
+	if(params.iFoil >= 0)
+	{
+		iFBegin = std::min<uint>(params.iFoil, iD2);
+		iFEnd = std::min<uint>(params.iFoil+1, iD2);
+	}
+
+	const uint oW = bKeepX ? iW : 1;
+	const uint oH = bKeepY ? iH : 1;
+	const uint oD = bKeepT ? iD : 1;
+	const uint oD2 = bKeepF ? iD2 : 1;
+	res.iDims[0] = oW; res.iDims[1] = oH;
+	res.iDims[2] = oD; res.iDims[3] = oD2;
+
+	const bool bErrs = chunks.HasErrs();
+	const std::size_t iPlaneSize = std::size_t(oW)*oH;
+	res.vecVals.assign(iPlaneSize*oD*oD2, 0.);
+	res.vecErrs.assign(bErrs ? res.vecVals.size() : 0, 0.);	// variances until the end
+
+	for(uint iF=iFBegin; iF<iFEnd; ++iF)
+	for(uint iCT=iTBegin/CHUNK_T*CHUNK_T; iCT<iTEnd; iCT+=CHUNK_T)
+	for(uint iCY=0; iCY<iH; iCY+=CHUNK_XY)
+	for(uint iCX=0; iCX<iW; iCX+=CHUNK_XY)
+	{
+		std::shared_ptr<const DataChunk> pChunk = chunks.GetChunk(chunks.GetChunkIndex(iCX, iCY, iCT, iF));
+		const DataChunk& chunk = *pChunk;
+
+		const uint iT0 = std::max(iTBegin, chunk.iD0);
+		const uint iT1 = std::min(iTEnd, chunk.iD0+chunk.iD);
+		for(uint iT=iT0; iT<iT1; ++iT)
+		{
+			const std::size_t iOutPlane = (std::size_t(bKeepF ? iF : 0)*oD + (bKeepT ? iT : 0))*iPlaneSize;
+
+			for(uint iY=0; iY<chunk.iH; ++iY)
+			{
+				const uint iYData = chunk.iY0 + iY;
+
+				// columns within the chunk, restricted to the ones in the mask
+				uint iXBegin = 0, iXEnd = chunk.iW;
+				const unsigned char *pMaskRow = 0;
+				if(pMask)
+				{
+					const uint iMaskBegin = pMask->vecRowBegin[iYData];
+					const uint iMaskEnd = pMask->vecRowEnd[iYData];
+					iXBegin = iMaskBegin > chunk.iX0 ? iMaskBegin - chunk.iX0 : 0;
+					iXEnd = std::min(iXEnd, iMaskEnd > chunk.iX0 ? iMaskEnd - chunk.iX0 : 0);
+					if(iXBegin >= iXEnd)
+						continue;
+					pMaskRow = pMask->vecMask.data() + std::size_t(iYData)*iW + chunk.iX0;
+				}
+
+				const std::size_t iIn = (std::size_t(iT-chunk.iD0)*chunk.iH + iY)*chunk.iW;
+				const double *pValRow = chunk.vecVals.data() + iIn;
+				const double *pErrRow = bErrs ? chunk.vecErrs.data() + iIn : 0;
+
+				const std::size_t iOut = iOutPlane + std::size_t(bKeepY ? iYData : 0)*oW +
+					(bKeepX ? chunk.iX0 : 0);
+				double *pOut = res.vecVals.data() + iOut;
+				double *pOutVar = bErrs ? res.vecErrs.data() + iOut : 0;
+
+				if(bKeepX)
+					add_row(pOut, pOutVar, pValRow, pErrRow, pMaskRow, iXBegin, iXEnd);
+				else
+					sum_row(pOut, pOutVar, pValRow, pErrRow, pMaskRow, iXBegin, iXEnd);
+			}
+		}
+	}
+
+	finish_reduce(piDims, pMask, params, res);
+}
+
+
+/*
+ * sums over x and y from the summed-area tables, i.e. a few lookups per
+ * rectangle of the roi and per slice instead of a loop over all pixels
+ */
+static void reduce_xy_table(const SumTable& tab, const std::vector<PixelRect>& vecRects,
+	const uint *piDims, const ReduceParams& params, ReduceResult& res)
+{
+	const uint iD = piDims[2], iD2 = piDims[3];
+	const bool bKeepT = !(params.iAxes & AXIS_T) && params.iT < 0;
+	const bool bKeepF = !(params.iAxes & AXIS_FOIL) && params.iFoil < 0;
+
+	const uint oD = bKeepT ? iD : 1;
+	const uint oD2 = bKeepF ? iD2 : 1;
+	res.iDims[0] = res.iDims[1] = 1;
+	res.iDims[2] = oD; res.iDims[3] = oD2;
+
+	const bool bErrs = tab.HasErrs();
+	res.vecVals.assign(std::size_t(oD)*oD2, 0.);
+	res.vecErrs.assign(bErrs ? res.vecVals.size() : 0, 0.);	// variances until the end
+
+	uint iTBegin = 0, iTEnd = iD, iFBegin = 0, iFEnd = iD2;
+	if(params.iT >= 0)
+	{
+		iTBegin = std::min<uint>(params.iT, iD);
+		iTEnd = std::min<uint>(params.iT+1, iD);
+	}
+	if(params.iFoil >= 0)
+	{
+		iFBegin = std::min<uint>(params.iFoil, iD2);
+		iFEnd = std::min<uint>(params.iFoil+1, iD2);
+	}
+
+	std::vector<double> vecSums(iD), vecVars(iD);
+	for(uint iF=iFBegin; iF<iFEnd; ++iF)
+	{
+		tab.GetSums(vecRects, iF*iD, (iF+1)*iD, vecSums.data(), vecVars.data());
+
+		for(uint iT=iTBegin; iT<iTEnd; ++iT)
+		{
+			const std::size_t iOut = std::size_t(bKeepF ? iF : 0)*oD + (bKeepT ? iT : 0);
+			res.vecVals[iOut] += vecSums[iT];
+			if(bErrs)
+				res.vecErrs[iOut] += vecVars[iT];
+		}
+	}
+
+	if(params.op == REDUCE_MEAN)
+	{
+		const double dCnt = double(get_rects_area(vecRects)) *
+			(bKeepT ? 1 : iTEnd-iTBegin) * (bKeepF ? 1 : iFEnd-iFBegin);
+		const double dNorm = dCnt > 0. ? 1./dCnt : 0.;
+
+		for(double& dVal : res.vecVals)
+			dVal *= dNorm;
+		for(double& dVar : res.vecErrs)
+			dVar *= dNorm*dNorm;
+	}
+
+	for(double& dVar : res.vecErrs)
+		dVar = std::sqrt(dVar);
+}
+
+template<class t_data>
+static void reduce_data(const t_data& dat, const uint *piDims,
+	const ReduceParams& params, ReduceResult& res)
+{
+	const bool bRoi = params.bUseRoi && dat.IsAnyRoiActive();
+
+	if((params.iAxes & (AXIS_X|AXIS_Y)) == (AXIS_X|AXIS_Y) && use_sum_tables())
+	{
+		std::vector<PixelRect> vecRects;
+		if(bRoi)
+			get_roi_rects(dat, dat, piDims[0], piDims[1], vecRects);
+		else
+			vecRects.push_back(PixelRect{0, 0, piDims[0], piDims[1]});
+
+		reduce_xy_table(*dat.GetSumTable(), vecRects, piDims, params, res);
+		return;
+	}
+
+	RoiMask mask;
+	if(bRoi)
+		make_roi_mask(dat, dat, piDims[0], piDims[1], mask);
+
+	reduce_raw(dat.GetValsRaw(), dat.GetErrsRaw(), piDims, bRoi ? &mask : 0, params, res);
+}
+
+// AXIS_* flags of the axes that are neither reduced nor selected
+static uint kept_axes(uint iAllAxes, const ReduceParams& params)
+{
+	uint iKept = iAllAxes & ~params.iAxes;
+	if(params.iT >= 0)
+		iKept &= ~uint(AXIS_T);
+	if(params.iFoil >= 0)
+		iKept &= ~uint(AXIS_FOIL);
+	return iKept;
+}
+
+void reduce(const Data3& dat, const ReduceParams& params, ReduceResult& res)
+{
+	const uint iDims[4] = { dat.GetWidth(), dat.GetHeight(), dat.GetDepth(), 1 };
+	res.iKeptAxes = kept_axes(AXIS_X|AXIS_Y|AXIS_T, params);
+	reduce_data(dat, iDims, params, res);
+}
+
+void reduce(const Data4& dat, const ReduceParams& params, ReduceResult& res)
+{
+	const uint iDims[4] = { dat.GetWidth(), dat.GetHeight(), dat.GetDepth(), dat.GetDepth2() };
+	res.iKeptAxes = kept_axes(AXIS_X|AXIS_Y|AXIS_T|AXIS_FOIL, params);
+
+	// the empty bins of sparse data are skipped instead of being expanded,
+	// chunked data is streamed from the disk
+	std::shared_ptr<const SparseData> pSparse = dat.GetSparse();
+	std::shared_ptr<const ChunkedData> pChunks = dat.GetChunks();
+	if(pSparse || pChunks)
+	{
+		const bool bRoi = params.bUseRoi && dat.IsAnyRoiActive();
+
+		RoiMask mask;
+		if(bRoi)
+			make_roi_mask(dat, dat, iDims[0], iDims[1], mask);
+
+		if(pSparse)
+			reduce_sparse(*pSparse, bRoi ? &mask : 0, params, res);
+		else
+			reduce_chunked(*pChunks, bRoi ? &mask : 0, params, res);
+		return;
+	}
+
+	reduce_data(dat, iDims, params, res);
+}
+
+
+// sizes of the first iNum kept axes, padded with 1; kept axes of size 1 are counted
+static void remaining_axes(const uint *piDims, uint iKeptAxes, uint iNum, uint *piSizes)
+{
+	uint iFound = 0;
+	for(uint iAxis=0; iAxis<4 && iFound<iNum; ++iAxis)
+		if(iKeptAxes & (1u<<iAxis))
+			piSizes[iFound++] = piDims[iAxis];
+	for(; iFound<iNum; ++iFound)
+		piSizes[iFound] = 1;
+}
+
+
+Data1 ReduceResult::GetLine(uint iLine) const
+{
+	uint iLen;
+	remaining_axes(iDims, iKeptAxes, 1, &iLen);
+
+	const std::size_t iOffs = std::size_t(iLine)*iLen;
+	if(iOffs + iLen > vecVals.size())
+		return Data1();
+
+	std::vector<double> vecX(iLen);
+	for(uint i=0; i<iLen; ++i)
+		vecX[i] = i;
+
+	return Data1(iLen, vecX.data(), vecVals.data() + iOffs,
+		vecErrs.size() ? vecErrs.data() + iOffs : 0);
+}
+
+Data2 ReduceResult::GetImage(uint iImage) const
+{
+	uint iSizes[2];
+	remaining_axes(iDims, iKeptAxes, 2, iSizes);
+
+	const std::size_t iOffs = std::size_t(iImage)*iSizes[0]*iSizes[1];
+	if(iOffs + std::size_t(iSizes[0])*iSizes[1] > vecVals.size())
+		return Data2(iSizes[0], iSizes[1]);
+
+	return Data2(iSizes[0], iSizes[1], vecVals.data() + iOffs,
+		vecErrs.size() ? vecErrs.data() + iOffs : 0);
+}
+
+Data3 ReduceResult::GetVolume() const
+{
+	uint iSizes[3];
+	remaining_axes(iDims, iKeptAxes, 3, iSizes);
+
+	if(std::size_t(iSizes[0])*iSizes[1]*iSizes[2] > vecVals.size())
+		return Data3(iSizes[0], iSizes[1], iSizes[2]);
+
+	return Data3(iSizes[0], iSizes[1], iSizes[2], vecVals.data(),
+		vecErrs.size() ? vecErrs.data() : 0);
+}
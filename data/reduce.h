@@ -0,0 +1,67 @@
+/**
+ * mieze-tool
+ * sums and means over axes of 3d and 4d data
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_REDUCE__
+#define __MIEZE_REDUCE__
+
+#include "data.h"
+
+// axes, in order of increasing stride
+enum ReduceAxis
+{
+	AXIS_X = 1<<0,
+	AXIS_Y = 1<<1,
+	AXIS_T = 1<<2,		// time channels
+	AXIS_FOIL = 1<<3
+};
+
+enum ReduceOp
+{
+	REDUCE_SUM,
+	REDUCE_MEAN
+};
+
+struct ReduceParams
+{
+	unsigned int iAxes = 0;		// AXIS_* flags of the axes to reduce
+	ReduceOp op = REDUCE_SUM;
+
+	// only use this time channel or foil, -1: all
+	int iT = -1, iFoil = -1;
+
+	// only use the pixels inside the roi and outside the anti-roi
+	bool bUseRoi = 0;
+};
+
+/*
+ * the result has the layout of the input, with reduced or selected
+ * axes of size 1; the errors are propagated in quadrature
+ */
+struct ReduceResult
+{
+	uint iDims[4] = {0, 0, 0, 0};		// x, y, t, foil
+	uint iKeptAxes = 0;			// AXIS_* flags of the axes neither reduced nor selected
+	std::vector<double> vecVals;
+	std::vector<double> vecErrs;		// empty if the data has no errors
+
+	// the iLine-th line along the first remaining axis
+	Data1 GetLine(uint iLine=0) const;
+	// the iImage-th image spanned by the first two remaining axes
+	Data2 GetImage(uint iImage=0) const;
+	// the volume spanned by the first three remaining axes
+	Data3 GetVolume() const;
+};
+
+
+// sums over both x and y use the summed-area tables of the data, if enabled;
+// sparse 4d data is reduced over its non-zero bins only, chunked 4d data
+// chunk by chunk
+extern void reduce(const Data3& dat, const ReduceParams& params, ReduceResult& res);
+extern void reduce(const Data4& dat, const ReduceParams& params, ReduceResult& res);
+
+#endif
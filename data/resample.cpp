@@ -0,0 +1,218 @@
+/**
+ * mieze-tool
+ * separable resampling of 2d slices
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "resample.h"
+#include "helper/workpool.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+// values per task; smaller images are resampled in the calling thread
+#define RESAMPLE_BLOCK (1<<16)
+
+
+// keys' cubic convolution kernel with a = -0.5
+static inline double cubic_weight(double t)
+{
+	t = std::fabs(t);
+	if(t <= 1.)
+		return (1.5*t - 2.5)*t*t + 1.;
+	if(t < 2.)
+		return ((-0.5*t + 2.5)*t - 4.)*t + 2.;
+	return 0.;
+}
+
+ResampleAxis::ResampleAxis(ResampleMode mode, unsigned int iOld, unsigned int iNew, bool bKeepTotal)
+{
+	if(mode == RESAMPLE_AUTO)
+		mode = (iNew < iOld) ? RESAMPLE_REBIN : RESAMPLE_BILINEAR;
+
+	vecStart.reserve(iNew+1);
+	vecStart.push_back(0);
+	if(iOld == 0 || iNew == 0)
+		return;
+
+	// size of a new pixel in old pixels
+	const double dScale = double(iOld) / double(iNew);
+
+	auto add = [this, iOld](int iIdx, double dWeight)
+	{
+		iIdx = std::min(std::max(iIdx, 0), int(iOld)-1);
+
+		// taps clamped onto the same border pixel are one tap with the summed weight,
+		// otherwise the variance would get w1^2 + w2^2 instead of (w1 + w2)^2
+		for(std::size_t iTap=vecStart.back(); iTap<vecIdx.size(); ++iTap)
+		{
+			if(vecIdx[iTap] == (unsigned int)iIdx)
+			{
+				vecWeight[iTap] += dWeight;
+				return;
+			}
+		}
+
+		vecIdx.push_back(iIdx);
+		vecWeight.push_back(dWeight);
+	};
+
+	for(unsigned int iNewIdx=0; iNewIdx<iNew; ++iNewIdx)
+	{
+		if(mode == RESAMPLE_REBIN)
+		{
+			// overlap of the new pixel [dBegin, dEnd) with the old ones
+			const double dBegin = iNewIdx*dScale;
+			const double dEnd = (iNewIdx+1)*dScale;
+			const double dNorm = bKeepTotal ? 1. : 1./dScale;
+
+			for(unsigned int iOldIdx=(unsigned int)dBegin; iOldIdx<iOld && double(iOldIdx)<dEnd; ++iOldIdx)
+			{
+				const double dOverlap = std::min(dEnd, double(iOldIdx+1)) - std::max(dBegin, double(iOldIdx));
+				if(dOverlap > 0.)
+					add(iOldIdx, dOverlap*dNorm);
+			}
+		}
+		else
+		{
+			// pixel centre of the new pixel in old pixel coordinates
+			const double dPos = (iNewIdx+0.5)*dScale - 0.5;
+			const double dFloor = std::floor(dPos);
+			const double t = dPos - dFloor;
+			const int i0 = int(dFloor);
+			const double dNorm = bKeepTotal ? dScale : 1.;
+
+			if(mode == RESAMPLE_BICUBIC)
+			{
+				for(int iTap=-1; iTap<=2; ++iTap)
+					add(i0+iTap, cubic_weight(t - iTap)*dNorm);
+			}
+			else
+			{
+				add(i0, (1.-t)*dNorm);
+				add(i0+1, t*dNorm);
+			}
+		}
+
+		vecStart.push_back(vecIdx.size());
+	}
+}
+
+
+/*
+ * calls fkt(iSlice, iRowBegin, iRowEnd) for blocks of rows of all slices
+ */
+template<class t_fkt>
+static void for_row_blocks(unsigned int iNumSlices, unsigned int iRows, unsigned int iRowLen,
+	const t_fkt& fkt)
+{
+	const double dTotal = double(iNumSlices)*double(iRows)*double(iRowLen);
+	if(dTotal <= RESAMPLE_BLOCK)
+	{
+		for(unsigned int iSlice=0; iSlice<iNumSlices; ++iSlice)
+			fkt(iSlice, 0, iRows);
+		return;
+	}
+
+	const unsigned int iRowsPerTask = std::max<unsigned int>(1, RESAMPLE_BLOCK / std::max<unsigned int>(1, iRowLen));
+
+	WorkPool pool;
+	for(unsigned int iSlice=0; iSlice<iNumSlices; ++iSlice)
+		for(unsigned int iRow=0; iRow<iRows; iRow+=iRowsPerTask)
+		{
+			const unsigned int iRowEnd = std::min(iRow+iRowsPerTask, iRows);
+			pool.AddTask([&fkt, iSlice, iRow, iRowEnd]()
+			{
+				fkt(iSlice, iRow, iRowEnd);
+			}, double(iRowEnd-iRow)*double(iRowLen));
+		}
+	pool.Start();
+	pool.Join();
+}
+
+void resample_slices(ResampleMode mode, bool bKeepTotal,
+	unsigned int iNumSlices, unsigned int iW, unsigned int iH,
+	const double *pVals, const double *pErrs,
+	unsigned int iNewW, unsigned int iNewH,
+	double *pNewVals, double *pNewErrs)
+{
+	if(!iNumSlices || !iW || !iH || !iNewW || !iNewH)
+		return;
+
+	const bool bErrs = pErrs && pNewErrs;
+	const ResampleAxis axisX(mode, iW, iNewW, bKeepTotal);
+	const ResampleAxis axisY(mode, iH, iNewH, bKeepTotal);
+
+	// x pass: iH rows of iNewW values per slice; the errors are carried as variances
+	std::vector<double> vecTmp(std::size_t(iNumSlices)*iH*iNewW);
+	std::vector<double> vecTmpVar(bErrs ? vecTmp.size() : 0);
+
+	for_row_blocks(iNumSlices, iH, iNewW,
+		[&](unsigned int iSlice, unsigned int iRowBegin, unsigned int iRowEnd)
+	{
+		for(unsigned int iY=iRowBegin; iY<iRowEnd; ++iY)
+		{
+			const std::size_t iOldRow = (std::size_t(iSlice)*iH + iY)*iW;
+			const std::size_t iTmpRow = (std::size_t(iSlice)*iH + iY)*iNewW;
+
+			for(unsigned int iX=0; iX<iNewW; ++iX)
+			{
+				double dVal = 0., dVar = 0.;
+				for(unsigned int k=axisX.vecStart[iX]; k<axisX.vecStart[iX+1]; ++k)
+				{
+					const double dW = axisX.vecWeight[k];
+					dVal += dW * pVals[iOldRow + axisX.vecIdx[k]];
+					if(bErrs)
+					{
+						const double dErr = pErrs[iOldRow + axisX.vecIdx[k]];
+						dVar += dW*dW * dErr*dErr;
+					}
+				}
+
+				vecTmp[iTmpRow + iX] = dVal;
+				if(bErrs)
+					vecTmpVar[iTmpRow + iX] = dVar;
+			}
+		}
+	});
+
+	// y pass: whole rows are weighted and added, the inner loops are contiguous
+	for_row_blocks(iNumSlices, iNewH, iNewW,
+		[&](unsigned int iSlice, unsigned int iRowBegin, unsigned int iRowEnd)
+	{
+		for(unsigned int iY=iRowBegin; iY<iRowEnd; ++iY)
+		{
+			double *pRow = pNewVals + (std::size_t(iSlice)*iNewH + iY)*iNewW;
+			double *pErrRow = bErrs ? pNewErrs + (std::size_t(iSlice)*iNewH + iY)*iNewW : 0;
+
+			std::fill(pRow, pRow+iNewW, 0.);
+			if(bErrs)
+				std::fill(pErrRow, pErrRow+iNewW, 0.);
+
+			for(unsigned int k=axisY.vecStart[iY]; k<axisY.vecStart[iY+1]; ++k)
+			{
+				const double dW = axisY.vecWeight[k];
+				const std::size_t iTmpRow = (std::size_t(iSlice)*iH + axisY.vecIdx[k])*iNewW;
+
+				const double *pTmp = vecTmp.data() + iTmpRow;
+				for(unsigned int iX=0; iX<iNewW; ++iX)
+					pRow[iX] += dW * pTmp[iX];
+
+				if(bErrs)
+				{
+					const double dW2 = dW*dW;
+					const double *pTmpVar = vecTmpVar.data() + iTmpRow;
+					for(unsigned int iX=0; iX<iNewW; ++iX)
+						pErrRow[iX] += dW2 * pTmpVar[iX];
+				}
+			}
+
+			if(bErrs)
+				for(unsigned int iX=0; iX<iNewW; ++iX)
+					pErrRow[iX] = std::sqrt(pErrRow[iX]);
+		}
+	});
+}
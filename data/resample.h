@@ -0,0 +1,49 @@
+/**
+ * mieze-tool
+ * separable resampling of 2d slices
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_RESAMPLE__
+#define __MIEZE_RESAMPLE__
+
+#include <vector>
+
+enum ResampleMode
+{
+	RESAMPLE_AUTO,		// rebin along shrinking axes, bilinear along growing ones
+	RESAMPLE_REBIN,		// area-conserving box rebinning, also for fractional factors
+	RESAMPLE_BILINEAR,
+	RESAMPLE_BICUBIC
+};
+
+
+/*
+ * weights of one axis: new pixel i is the sum over
+ * k in [vecStart[i], vecStart[i+1]) of vecWeight[k] * old pixel vecIdx[k]
+ */
+struct ResampleAxis
+{
+	std::vector<unsigned int> vecStart;
+	std::vector<unsigned int> vecIdx;
+	std::vector<double> vecWeight;
+
+	// bKeepTotal: sums instead of means, i.e. the counts are conserved
+	ResampleAxis(ResampleMode mode, unsigned int iOld, unsigned int iNew, bool bKeepTotal);
+};
+
+
+/*
+ * resamples iNumSlices consecutive iW x iH images to iNewW x iNewH;
+ * errors are propagated as sqrt(sum w^2 err^2), pErr/pNewErr may be null;
+ * the slices and rows are distributed over the cpus
+ */
+extern void resample_slices(ResampleMode mode, bool bKeepTotal,
+	unsigned int iNumSlices, unsigned int iW, unsigned int iH,
+	const double *pVals, const double *pErrs,
+	unsigned int iNewW, unsigned int iNewH,
+	double *pNewVals, double *pNewErrs);
+
+#endif
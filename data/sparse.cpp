@@ -0,0 +1,187 @@
+/**
+ * mieze-tool
+ * sparse storage of weakly occupied tof data
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "sparse.h"
+
+#include <algorithm>
+#include <atomic>
+
+
+static std::atomic<double> s_dSparseThreshold(0.25);
+
+double sparse_threshold() { return s_dSparseThreshold; }
+void set_sparse_threshold(double dThreshold) { s_dSparseThreshold = dThreshold; }
+
+
+static inline bool is_nonzero(const double *pVals, const double *pErrs, std::size_t i)
+{
+	return pVals[i] != 0. || (pErrs && pErrs[i] != 0.);
+}
+
+double get_occupancy(const double *pVals, const double *pErrs, std::size_t iLen)
+{
+	if(!iLen || !pVals)
+		return 0.;
+
+	std::size_t iNonZero = 0;
+	for(std::size_t i=0; i<iLen; ++i)
+		iNonZero += is_nonzero(pVals, pErrs, i);
+
+	return double(iNonZero) / double(iLen);
+}
+
+
+SparseData::SparseData(unsigned int iW, unsigned int iH, unsigned int iD, unsigned int iD2,
+	const double *pVals, const double *pErrs)
+	: m_iW(iW), m_iH(iH), m_iD(iD), m_iD2(iD2)
+{
+	const std::size_t iSliceSize = std::size_t(iW)*iH;
+	const std::size_t iNumPixels = iSliceSize*iD2;
+	m_vecPixelStart.assign(iNumPixels+1, 0);
+
+	if(!pVals)
+		return;
+
+	// the input is read contiguously in both passes, the bins of a pixel
+	// therefore arrive in ascending time channel order
+
+	// first pass: bins per pixel
+	for(unsigned int iF=0; iF<iD2; ++iF)
+		for(unsigned int iT=0; iT<iD; ++iT)
+		{
+			const std::size_t iSlice = (std::size_t(iF)*iD + iT)*iSliceSize;
+			std::size_t *pCnt = m_vecPixelStart.data() + 1 + iF*iSliceSize;
+
+			for(std::size_t i=0; i<iSliceSize; ++i)
+				pCnt[i] += is_nonzero(pVals, pErrs, iSlice+i);
+		}
+
+	for(std::size_t iPixel=0; iPixel<iNumPixels; ++iPixel)
+		m_vecPixelStart[iPixel+1] += m_vecPixelStart[iPixel];
+
+	const std::size_t iNonZero = m_vecPixelStart[iNumPixels];
+	m_vecT.resize(iNonZero);
+	m_vecVals.resize(iNonZero);
+	if(pErrs)
+		m_vecErrs.resize(iNonZero);
+
+	// second pass: fill in the bins
+	std::vector<std::size_t> vecPos(m_vecPixelStart.begin(), m_vecPixelStart.end()-1);
+	for(unsigned int iF=0; iF<iD2; ++iF)
+		for(unsigned int iT=0; iT<iD; ++iT)
+		{
+			const std::size_t iSlice = (std::size_t(iF)*iD + iT)*iSliceSize;
+			std::size_t *pPos = vecPos.data() + iF*iSliceSize;
+
+			for(std::size_t i=0; i<iSliceSize; ++i)
+			{
+				if(!is_nonzero(pVals, pErrs, iSlice+i))
+					continue;
+
+				const std::size_t iBin = pPos[i]++;
+				m_vecT[iBin] = iT;
+				m_vecVals[iBin] = pVals[iSlice+i];
+				if(pErrs)
+					m_vecErrs[iBin] = pErrs[iSlice+i];
+			}
+		}
+}
+
+std::size_t SparseData::GetMemory() const
+{
+	return m_vecPixelStart.size()*sizeof(std::size_t) +
+		m_vecT.size()*sizeof(unsigned int) +
+		(m_vecVals.size() + m_vecErrs.size())*sizeof(double);
+}
+
+
+double SparseData::GetVal(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2) const
+{
+	const std::size_t iPixel = GetPixel(iX, iY, iD2);
+	const unsigned int *pBegin = m_vecT.data() + GetPixelBegin(iPixel);
+	const unsigned int *pEnd = m_vecT.data() + GetPixelEnd(iPixel);
+
+	const unsigned int *pT = std::lower_bound(pBegin, pEnd, iD);
+	if(pT==pEnd || *pT!=iD)
+		return 0.;
+	return m_vecVals[pT - m_vecT.data()];
+}
+
+double SparseData::GetErr(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2) const
+{
+	if(!HasErrs())
+		return 0.;
+
+	const std::size_t iPixel = GetPixel(iX, iY, iD2);
+	const unsigned int *pBegin = m_vecT.data() + GetPixelBegin(iPixel);
+	const unsigned int *pEnd = m_vecT.data() + GetPixelEnd(iPixel);
+
+	const unsigned int *pT = std::lower_bound(pBegin, pEnd, iD);
+	if(pT==pEnd || *pT!=iD)
+		return 0.;
+	return m_vecErrs[pT - m_vecT.data()];
+}
+
+
+void SparseData::GetFoil(unsigned int iD2, double *pVals, double *pErrs) const
+{
+	const std::size_t iSliceSize = std::size_t(m_iW)*m_iH;
+	std::fill(pVals, pVals + iSliceSize*m_iD, 0.);
+	if(pErrs)
+		std::fill(pErrs, pErrs + iSliceSize*m_iD, 0.);
+
+	if(iD2 >= m_iD2)
+		return;
+
+	const std::size_t iFirstPixel = iD2*iSliceSize;
+	for(std::size_t i=0; i<iSliceSize; ++i)
+	{
+		for(std::size_t iBin=GetPixelBegin(iFirstPixel+i); iBin<GetPixelEnd(iFirstPixel+i); ++iBin)
+		{
+			const std::size_t iIdx = m_vecT[iBin]*iSliceSize + i;
+			pVals[iIdx] = m_vecVals[iBin];
+			if(pErrs && HasErrs())
+				pErrs[iIdx] = m_vecErrs[iBin];
+		}
+	}
+}
+
+void SparseData::GetSlice(unsigned int iD, unsigned int iD2, double *pVals, double *pErrs) const
+{
+	const std::size_t iSliceSize = std::size_t(m_iW)*m_iH;
+	std::fill(pVals, pVals + iSliceSize, 0.);
+	if(pErrs)
+		std::fill(pErrs, pErrs + iSliceSize, 0.);
+
+	if(iD >= m_iD || iD2 >= m_iD2)
+		return;
+
+	const std::size_t iFirstPixel = iD2*iSliceSize;
+	for(std::size_t i=0; i<iSliceSize; ++i)
+	{
+		const unsigned int *pBegin = m_vecT.data() + GetPixelBegin(iFirstPixel+i);
+		const unsigned int *pEnd = m_vecT.data() + GetPixelEnd(iFirstPixel+i);
+		if(pBegin == pEnd)
+			continue;
+
+		const unsigned int *pT = std::lower_bound(pBegin, pEnd, iD);
+		if(pT==pEnd || *pT!=iD)
+			continue;
+
+		pVals[i] = m_vecVals[pT - m_vecT.data()];
+		if(pErrs && HasErrs())
+			pErrs[i] = m_vecErrs[pT - m_vecT.data()];
+	}
+}
+
+void SparseData::GetDense(double *pVals, double *pErrs) const
+{
+	const std::size_t iFoilSize = std::size_t(m_iW)*m_iH*m_iD;
+	for(unsigned int iD2=0; iD2<m_iD2; ++iD2)
+		GetFoil(iD2, pVals + iD2*iFoilSize, pErrs ? pErrs + iD2*iFoilSize : 0);
+}
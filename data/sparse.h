@@ -0,0 +1,78 @@
+/**
+ * mieze-tool
+ * sparse storage of weakly occupied tof data
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_SPARSE__
+#define __MIEZE_SPARSE__
+
+#include <vector>
+#include <cstddef>
+
+
+/*
+ * the non-zero bins of [foil][t][y][x] data, compressed per pixel:
+ * every (foil, y, x) pixel is one row holding its non-zero time channels
+ */
+class SparseData
+{
+protected:
+	unsigned int m_iW, m_iH, m_iD, m_iD2;
+
+	// first bin of every pixel, plus one entry for the end
+	std::vector<std::size_t> m_vecPixelStart;
+
+	// time channel of every bin, ascending within a pixel
+	std::vector<unsigned int> m_vecT;
+	std::vector<double> m_vecVals;
+	std::vector<double> m_vecErrs;		// empty if there are no errors
+
+public:
+	// bins with a value or an error different from zero are kept
+	SparseData(unsigned int iW, unsigned int iH, unsigned int iD, unsigned int iD2,
+		const double *pVals, const double *pErrs=0);
+
+	unsigned int GetWidth() const { return m_iW; }
+	unsigned int GetHeight() const { return m_iH; }
+	unsigned int GetDepth() const { return m_iD; }
+	unsigned int GetDepth2() const { return m_iD2; }
+	bool HasErrs() const { return m_vecErrs.size() != 0; }
+
+	// number of bins of the dense data and of the stored ones
+	std::size_t GetSize() const { return std::size_t(m_iD2)*m_iD*m_iH*m_iW; }
+	std::size_t GetNumNonZero() const { return m_vecVals.size(); }
+	std::size_t GetMemory() const;		// in bytes
+
+	std::size_t GetPixel(unsigned int iX, unsigned int iY, unsigned int iD2) const
+	{ return (std::size_t(iD2)*m_iH + iY)*m_iW + iX; }
+
+	// bins [begin, end) of a pixel, indices into GetT(), GetVals() and GetErrs()
+	std::size_t GetPixelBegin(std::size_t iPixel) const { return m_vecPixelStart[iPixel]; }
+	std::size_t GetPixelEnd(std::size_t iPixel) const { return m_vecPixelStart[iPixel+1]; }
+
+	const unsigned int* GetT() const { return m_vecT.data(); }
+	const double* GetVals() const { return m_vecVals.data(); }
+	const double* GetErrs() const { return HasErrs() ? m_vecErrs.data() : 0; }
+
+	double GetVal(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2) const;
+	double GetErr(unsigned int iX, unsigned int iY, unsigned int iD, unsigned int iD2) const;
+
+	// dense [t][y][x] data of a foil, dense [y][x] image of a slice and all
+	// dense [foil][t][y][x] data; the error buffers may be null
+	void GetFoil(unsigned int iD2, double *pVals, double *pErrs=0) const;
+	void GetSlice(unsigned int iD, unsigned int iD2, double *pVals, double *pErrs=0) const;
+	void GetDense(double *pVals, double *pErrs=0) const;
+};
+
+
+// fraction of the bins with a value or an error different from zero
+extern double get_occupancy(const double *pVals, const double *pErrs, std::size_t iLen);
+
+// 4d data with a lower occupancy is stored sparsely, 0: never
+extern double sparse_threshold();
+extern void set_sparse_threshold(double dThreshold);
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * mieze-tool
+ * statistics of large data arrays
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "stats.h"
+#include "helper/workpool.h"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+
+// values per block, whose statistics are combined afterwards
+#define STATS_BLOCK (1<<14)
+// blocks per task; smaller arrays are handled in the calling thread
+#define STATS_BLOCKS_PER_TASK 16
+// independent accumulators, so that the inner loop can be vectorised
+#define STATS_LANES 8
+
+
+static DataStats block_stats(const double *pVals, std::size_t iLen)
+{
+	double dMin[STATS_LANES], dMax[STATS_LANES], dSum[STATS_LANES];
+	for(unsigned int j=0; j<STATS_LANES; ++j)
+	{
+		dMin[j] = std::numeric_limits<double>::max();
+		dMax[j] = -std::numeric_limits<double>::max();
+		dSum[j] = 0.;
+	}
+
+	std::size_t i = 0;
+	for(; i+STATS_LANES<=iLen; i+=STATS_LANES)
+	{
+		for(unsigned int j=0; j<STATS_LANES; ++j)
+		{
+			const double dVal = pVals[i+j];
+			dSum[j] += dVal;
+			dMin[j] = dVal < dMin[j] ? dVal : dMin[j];
+			dMax[j] = dVal > dMax[j] ? dVal : dMax[j];
+		}
+	}
+	for(unsigned int j=0; i<iLen; ++i, ++j)
+	{
+		dSum[j] += pVals[i];
+		dMin[j] = std::min(dMin[j], pVals[i]);
+		dMax[j] = std::max(dMax[j], pVals[i]);
+	}
+
+	// lanes pairwise
+	for(unsigned int iStep=1; iStep<STATS_LANES; iStep*=2)
+		for(unsigned int j=0; j+iStep<STATS_LANES; j+=2*iStep)
+		{
+			dSum[j] += dSum[j+iStep];
+			dMin[j] = std::min(dMin[j], dMin[j+iStep]);
+			dMax[j] = std::max(dMax[j], dMax[j+iStep]);
+		}
+
+	return DataStats{dMin[0], dMax[0], dSum[0]};
+}
+
+// pairwise sum of the block totals in [iBegin, iEnd)
+static double pairwise_sum(const std::vector<DataStats>& vecBlocks, std::size_t iBegin, std::size_t iEnd)
+{
+	if(iEnd - iBegin == 1)
+		return vecBlocks[iBegin].dTotal;
+
+	const std::size_t iMid = iBegin + (iEnd-iBegin)/2;
+	return pairwise_sum(vecBlocks, iBegin, iMid) + pairwise_sum(vecBlocks, iMid, iEnd);
+}
+
+DataStats get_stats(const double *pVals, std::size_t iLen)
+{
+	DataStats stats{std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), 0.};
+	if(!iLen || !pVals)
+		return stats;
+
+	const std::size_t iNumBlocks = (iLen + STATS_BLOCK - 1) / STATS_BLOCK;
+	std::vector<DataStats> vecBlocks(iNumBlocks);
+
+	auto task = [&](std::size_t iBlockBegin, std::size_t iBlockEnd)
+	{
+		for(std::size_t iBlock=iBlockBegin; iBlock<iBlockEnd; ++iBlock)
+		{
+			const std::size_t iBegin = iBlock*STATS_BLOCK;
+			vecBlocks[iBlock] = block_stats(pVals + iBegin, std::min<std::size_t>(STATS_BLOCK, iLen-iBegin));
+		}
+	};
+
+	if(iNumBlocks <= STATS_BLOCKS_PER_TASK)
+	{
+		task(0, iNumBlocks);
+	}
+	else
+	{
+		WorkPool pool;
+		for(std::size_t iBlock=0; iBlock<iNumBlocks; iBlock+=STATS_BLOCKS_PER_TASK)
+		{
+			const std::size_t iBlockEnd = std::min<std::size_t>(iBlock+STATS_BLOCKS_PER_TASK, iNumBlocks);
+			pool.AddTask([&task, iBlock, iBlockEnd]() { task(iBlock, iBlockEnd); },
+				double(iBlockEnd-iBlock));
+		}
+		pool.Start();
+		pool.Join();
+	}
+
+	for(const DataStats& block : vecBlocks)
+	{
+		stats.dMin = std::min(stats.dMin, block.dMin);
+		stats.dMax = std::max(stats.dMax, block.dMax);
+	}
+	stats.dTotal = pairwise_sum(vecBlocks, 0, iNumBlocks);
+
+	return stats;
+}
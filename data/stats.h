@@ -0,0 +1,28 @@
+/**
+ * mieze-tool
+ * statistics of large data arrays
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_STATS__
+#define __MIEZE_STATS__
+
+#include <cstddef>
+
+struct DataStats
+{
+	double dMin, dMax;
+	double dTotal;		// sum of all values
+};
+
+/*
+ * one pass over the values, in blocks on all cpus; the block sums are
+ * added pairwise in a fixed order, so the total is accurate for large
+ * count totals and does not depend on the number of threads.
+ * no values give min = DBL_MAX, max = -DBL_MAX
+ */
+extern DataStats get_stats(const double *pVals, std::size_t iLen);
+
+#endif
@@ -0,0 +1,183 @@
+/**
+ * mieze-tool
+ * summed-area tables for fast rectangular sums
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "sumtable.h"
+#include "data.h"
+#include "helper/workpool.h"
+
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+
+
+// pixels per task; smaller tables are built in the calling thread
+#define SUMTABLE_BLOCK (1<<16)
+
+
+static std::atomic<bool> s_bUseSumTables(0);
+
+bool use_sum_tables() { return s_bUseSumTables; }
+void set_use_sum_tables(bool bUse) { s_bUseSumTables = bUse; }
+
+
+// integral image of one slice, pOut has (iW+1) x (iH+1) entries
+static void integrate_slice(unsigned int iW, unsigned int iH,
+	const double *pIn, bool bSquare, double *pOut)
+{
+	std::fill(pOut, pOut+iW+1, 0.);
+
+	for(unsigned int iY=0; iY<iH; ++iY)
+	{
+		const double *pRow = pIn + std::size_t(iY)*iW;
+		const double *pAbove = pOut + std::size_t(iY)*(iW+1);
+		double *pCur = pOut + std::size_t(iY+1)*(iW+1);
+
+		double dRowSum = 0.;
+		pCur[0] = 0.;
+		for(unsigned int iX=0; iX<iW; ++iX)
+		{
+			dRowSum += bSquare ? pRow[iX]*pRow[iX] : pRow[iX];
+			pCur[iX+1] = pAbove[iX+1] + dRowSum;
+		}
+	}
+}
+
+SumTable::SumTable(unsigned int iNumSlices, unsigned int iW, unsigned int iH,
+	const double *pVals, const double *pErrs)
+	: m_iW(iW), m_iH(iH), m_iNumSlices(iNumSlices)
+{
+	const std::size_t iSliceSize = std::size_t(iW)*iH;
+	const std::size_t iTabSize = std::size_t(iW+1)*(iH+1);
+
+	m_vecSums.resize(iTabSize*iNumSlices);
+	if(pErrs)
+		m_vecVars.resize(m_vecSums.size());
+
+	auto build = [&](unsigned int iSlice)
+	{
+		integrate_slice(iW, iH, pVals + iSlice*iSliceSize, 0, m_vecSums.data() + iSlice*iTabSize);
+		if(pErrs)
+			integrate_slice(iW, iH, pErrs + iSlice*iSliceSize, 1, m_vecVars.data() + iSlice*iTabSize);
+	};
+
+	if(double(iSliceSize)*iNumSlices <= SUMTABLE_BLOCK)
+	{
+		for(unsigned int iSlice=0; iSlice<iNumSlices; ++iSlice)
+			build(iSlice);
+		return;
+	}
+
+	WorkPool pool;
+	for(unsigned int iSlice=0; iSlice<iNumSlices; ++iSlice)
+		pool.AddTask([&build, iSlice]() { build(iSlice); }, double(iSliceSize));
+	pool.Start();
+	pool.Join();
+}
+
+void SumTable::GetSums(const std::vector<PixelRect>& vecRects,
+	unsigned int iSliceBegin, unsigned int iSliceEnd,
+	double *pSums, double *pVars) const
+{
+	iSliceEnd = std::min(iSliceEnd, m_iNumSlices);
+
+	for(unsigned int iSlice=iSliceBegin; iSlice<iSliceEnd; ++iSlice)
+	{
+		double dSum = 0., dVar = 0.;
+
+		for(const PixelRect& rect : vecRects)
+		{
+			const std::size_t i00 = Idx(iSlice, rect.iX0, rect.iY0);
+			const std::size_t i10 = Idx(iSlice, rect.iX1, rect.iY0);
+			const std::size_t i01 = Idx(iSlice, rect.iX0, rect.iY1);
+			const std::size_t i11 = Idx(iSlice, rect.iX1, rect.iY1);
+
+			dSum += m_vecSums[i11] - m_vecSums[i10] - m_vecSums[i01] + m_vecSums[i00];
+			if(pVars && HasErrs())
+				dVar += m_vecVars[i11] - m_vecVars[i10] - m_vecVars[i01] + m_vecVars[i00];
+		}
+
+		pSums[iSlice-iSliceBegin] = dSum;
+		if(pVars)
+			pVars[iSlice-iSliceBegin] = std::max(dVar, 0.);
+	}
+}
+
+
+void get_roi_rects(const RoiFlags& roi, const XYRange& range,
+	unsigned int iW, unsigned int iH, std::vector<PixelRect>& vecRects)
+{
+	vecRects.clear();
+	if(!iW || !iH)
+		return;
+
+	if(!roi.IsAnyRoiActive())
+	{
+		vecRects.push_back(PixelRect{0, 0, iW, iH});
+		return;
+	}
+
+	// only test the pixels in the bounding rectangle of the roi
+	int iXStart=0, iXEnd=iW, iYStart=0, iYEnd=iH;
+	if(roi.IsRoiActive(0))
+	{
+		const BoundingRect br = roi.GetRoi(0).GetBoundingRect();
+		iXStart = std::max(0, int(std::floor(range.GetPixelXPos(br.bottomleft[0]))));
+		iYStart = std::max(0, int(std::floor(range.GetPixelYPos(br.bottomleft[1]))));
+		iXEnd = std::min(int(iW), int(std::ceil(range.GetPixelXPos(br.topright[0])))+1);
+		iYEnd = std::min(int(iH), int(std::ceil(range.GetPixelYPos(br.topright[1])))+1);
+	}
+
+	// runs of the previous row are continued if the current row has the same ones
+	std::vector<std::size_t> vecOpen, vecNowOpen;
+
+	for(int iY=iYStart; iY<iYEnd; ++iY)
+	{
+		const double dY = range.GetRangeYPos(iY);
+		vecNowOpen.clear();
+
+		for(int iX=iXStart; iX<iXEnd; )
+		{
+			if(!roi.IsInsideRoi(range.GetRangeXPos(iX), dY))
+			{
+				++iX;
+				continue;
+			}
+
+			const int iRunBegin = iX;
+			while(iX<iXEnd && roi.IsInsideRoi(range.GetRangeXPos(iX), dY))
+				++iX;
+
+			auto iterOpen = std::find_if(vecOpen.begin(), vecOpen.end(),
+				[&vecRects, iRunBegin, iX](std::size_t iRect) -> bool
+				{
+					return int(vecRects[iRect].iX0)==iRunBegin && int(vecRects[iRect].iX1)==iX;
+				});
+
+			if(iterOpen != vecOpen.end())
+			{
+				vecRects[*iterOpen].iY1 = iY+1;
+				vecNowOpen.push_back(*iterOpen);
+			}
+			else
+			{
+				vecRects.push_back(PixelRect{unsigned(iRunBegin), unsigned(iY), unsigned(iX), unsigned(iY+1)});
+				vecNowOpen.push_back(vecRects.size()-1);
+			}
+		}
+
+		vecOpen.swap(vecNowOpen);
+	}
+}
+
+std::size_t get_rects_area(const std::vector<PixelRect>& vecRects)
+{
+	std::size_t iArea = 0;
+	for(const PixelRect& rect : vecRects)
+		iArea += std::size_t(rect.iX1-rect.iX0) * (rect.iY1-rect.iY0);
+	return iArea;
+}
@@ -0,0 +1,74 @@
+/**
+ * mieze-tool
+ * summed-area tables for fast rectangular sums
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_SUMTABLE__
+#define __MIEZE_SUMTABLE__
+
+#include <vector>
+#include <cstddef>
+
+class RoiFlags;
+class XYRange;
+
+
+// pixels [iX0, iX1) x [iY0, iY1)
+struct PixelRect
+{
+	unsigned int iX0, iY0, iX1, iY1;
+};
+
+
+/*
+ * integral images of iNumSlices consecutive iW x iH slices: every sum over
+ * a rectangle of a slice is four lookups instead of a loop over its pixels
+ */
+class SumTable
+{
+protected:
+	unsigned int m_iW, m_iH, m_iNumSlices;
+
+	// (w+1) x (h+1) per slice, with a leading row and column of zeros
+	std::vector<double> m_vecSums;
+	// likewise for the squared errors, empty if there are no errors
+	std::vector<double> m_vecVars;
+
+	std::size_t Idx(unsigned int iSlice, unsigned int iX, unsigned int iY) const
+	{
+		return (std::size_t(iSlice)*(m_iH+1) + iY)*(m_iW+1) + iX;
+	}
+
+public:
+	SumTable(unsigned int iNumSlices, unsigned int iW, unsigned int iH,
+		const double *pVals, const double *pErrs=0);
+
+	bool HasErrs() const { return m_vecVars.size() != 0; }
+	unsigned int GetNumSlices() const { return m_iNumSlices; }
+
+	// sum and variance over the rectangles in slices [iSliceBegin, iSliceEnd);
+	// the rectangles must not overlap, pVars may be null
+	void GetSums(const std::vector<PixelRect>& vecRects,
+		unsigned int iSliceBegin, unsigned int iSliceEnd,
+		double *pSums, double *pVars=0) const;
+};
+
+
+/*
+ * the pixels inside the roi and outside the anti-roi as non-overlapping
+ * rectangles; an axis-aligned rectangular roi gives a single rectangle
+ */
+extern void get_roi_rects(const RoiFlags& roi, const XYRange& range,
+	unsigned int iW, unsigned int iH, std::vector<PixelRect>& vecRects);
+
+extern std::size_t get_rects_area(const std::vector<PixelRect>& vecRects);
+
+
+// use summed-area tables for the roi sums
+extern bool use_sum_tables();
+extern void set_use_sum_tables(bool bUse);
+
+#endif
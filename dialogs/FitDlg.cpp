@@ -11,6 +11,7 @@
 #include "fitter/models/freefit.h"
 #include "fitter/models/msin.h"
 #include "fitter/models/gauss.h"
+#include "fitter/models/workspace.h"
 
 #include "tlibs/string/string.h"
 #include "tlibs/helper/misc.h"
@@ -25,11 +26,13 @@
 #include "helper/mieze.h"
 #include "helper/mfourier.h"
 #include "helper/misc.h"
+#include "data/reduce.h"
 
 #include "main/settings.h"
 
 #include <QtGui/QMdiSubWindow>
 #include <QtGui/QMessageBox>
+#include <QtCore/QCoreApplication>
 
 #include <set>
 #include <vector>
@@ -462,7 +465,7 @@ void FitDlg::UpdateHint(const std::string& str, double dVal, double dErr)
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
-SpecialFitResult FitDlg::DoSpecialFit(SubWindowBase* pSWB, int iFkt, int iParam)
+SpecialFitResult FitDlg::PrepareSpecialFit(SubWindowBase* pSWB, int iFkt, int iParam)
 {
 	SpecialFitResult res;
 
@@ -485,37 +488,50 @@ SpecialFitResult FitDlg::DoSpecialFit(SubWindowBase* pSWB, int iFkt, int iParam)
 		return res;
 	}
 
-	Data1& dat = res.pPlot->GetData(0).dat;
-	tl::FitterFuncModel<double>* pFkt = 0;
-	FitDataParams fitparams;
-	fitparams.iFkt = iFkt;
-	fitparams.iNumPeaks = iParam;
-	FitData::fit(dat, fitparams, &pFkt);
+	return res;
+}
+
+void FitDlg::FinishSpecialFit(SpecialFitResult& res, int iFkt, tl::FitterFuncModel<double>* pFkt)
+{
+	if(!pFkt)
+		return;
 
-	if(pFkt)
+	if(iFkt == FIT_MIEZE_SINE) 				// MIEZE sine
 	{
-		if(iFkt == FIT_MIEZE_SINE) 				// MIEZE sine
-		{
-			MiezeSinModel *pModel = (MiezeSinModel*)pFkt;
+		MiezeSinModel *pModel = (MiezeSinModel*)pFkt;
 
-			//std::cout << "C = " << pModel->GetContrast() << " +- " << pModel->GetContrastErr()
-			//				<< ", phase = " << pModel->GetPhase()/M_PI*180. << " +- " << pModel->GetPhaseErr()/M_PI*180.
-			//				<< std::endl;
+		//std::cout << "C = " << pModel->GetContrast() << " +- " << pModel->GetContrastErr()
+		//				<< ", phase = " << pModel->GetPhase()/M_PI*180. << " +- " << pModel->GetPhaseErr()/M_PI*180.
+		//				<< std::endl;
 
-			std::ostringstream ostrTitle;
-			ostrTitle.precision(3);
-			ostrTitle << "Contrast: " << pModel->GetContrast() << "+-" << pModel->GetContrastErr()
-					  << ", Phase: " << pModel->GetPhase() << "+-" << pModel->GetPhaseErr();
-			res.pPlot->SetTitle(ostrTitle.str().c_str());
-		}
+		std::ostringstream ostrTitle;
+		ostrTitle.precision(3);
+		ostrTitle << "Contrast: " << pModel->GetContrast() << "+-" << pModel->GetContrastErr()
+				  << ", Phase: " << pModel->GetPhase() << "+-" << pModel->GetPhaseErr();
+		res.pPlot->SetTitle(ostrTitle.str().c_str());
+	}
 
-		res.pPlot->plot_fkt(*pFkt);
-		res.pPlot->RefreshPlot();
-		res.bOk = 1;
+	res.pPlot->plot_fkt(*pFkt);
+	res.pPlot->RefreshPlot();
+	res.bOk = 1;
 
-		delete pFkt;
-	}
+	delete pFkt;
+}
+
+SpecialFitResult FitDlg::DoSpecialFit(SubWindowBase* pSWB, int iFkt, int iParam)
+{
+	SpecialFitResult res = PrepareSpecialFit(pSWB, iFkt, iParam);
+	if(!res.pPlot || res.pPlot->GetDataCount() == 0)
+		return res;
+
+	Data1& dat = res.pPlot->GetData(0).dat;
+	tl::FitterFuncModel<double>* pFkt = 0;
+	FitDataParams fitparams;
+	fitparams.iFkt = iFkt;
+	fitparams.iNumPeaks = iParam;
+	FitData::fit(dat, fitparams, &pFkt);
 
+	FinishSpecialFit(res, iFkt, pFkt);
 	return res;
 }
 
@@ -523,11 +539,16 @@ void FitDlg::DoSpecialFit()
 {
 	UpdateSourceList();
 	const int iFkt = comboSpecialFkt->currentIndex();
+	const int iParam = spinParam->value();
+
+	// converting and plotting happen here, only the fits run in parallel
+	std::vector<SpecialFitResult> vecRes;
+	std::vector<const Data1*> vecDat;
 
 	for(int iWnd=0; iWnd<listGraphs->count(); ++iWnd)
 	{
 		SubWindowBase* pSWB = ((ListGraphsItem*)listGraphs->item(iWnd))->subWnd();
-		SpecialFitResult res = DoSpecialFit(pSWB, iFkt, spinParam->value());
+		SpecialFitResult res = PrepareSpecialFit(pSWB, iFkt, iParam);
 
 		if(!res.pPlot)
 		{
@@ -536,8 +557,63 @@ void FitDlg::DoSpecialFit()
 			continue;
 		}
 
-		if(res.bCreatedNewPlot)
-			emit AddSubWindow(res.pPlot);
+		vecDat.push_back(res.pPlot->GetDataCount() ? &res.pPlot->GetData(0).dat : 0);
+		vecRes.push_back(res);
+	}
+
+	FitDataParams fitparams;
+	fitparams.iFkt = iFkt;
+	fitparams.iNumPeaks = iParam;
+
+	FitBatchResult batch;
+	std::vector<tl::FitterFuncModel<double>*> vecModels;
+	FitData::fit_batch(vecDat, fitparams, batch, 0, &vecModels,
+		[this](unsigned int iDone, unsigned int iTotal) { ShowFitProgress(iDone, iTotal); });
+
+	for(unsigned int iRes=0; iRes<vecRes.size(); ++iRes)
+	{
+		FinishSpecialFit(vecRes[iRes], iFkt, vecModels[iRes]);
+
+		if(vecRes[iRes].bCreatedNewPlot)
+			emit AddSubWindow(vecRes[iRes].pPlot);
+	}
+
+	if(checkParamPlots->isChecked())
+		AddParamPlots(batch, comboSpecialFkt->currentText().toStdString());
+}
+
+void FitDlg::ShowFitProgress(unsigned int iDone, unsigned int iTotal)
+{
+	std::ostringstream ostrStatus;
+	ostrStatus << "Fitted " << iDone << " of " << iTotal << ".";
+	labelStatus->setText(ostrStatus.str().c_str());
+
+	QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+}
+
+void FitDlg::AddParamPlots(const FitBatchResult& res, const std::string& strFkt)
+{
+	for(unsigned int iParam=0; iParam<res.vecParamNames.size(); ++iParam)
+	{
+		const std::string& strParam = res.vecParamNames[iParam];
+		std::string strTitle = strFkt + " -> " + strParam;
+
+		Plot *pPlot = new Plot(0, strTitle.c_str());
+		pPlot->plot(res.GetParam(iParam));
+		pPlot->SetLabels("Data source", strParam.c_str());
+
+		emit AddSubWindow(pPlot);
+	}
+
+	if(res.vecParamNames.size())
+	{
+		std::string strTitle = strFkt + " -> chi^2";
+
+		Plot *pPlot = new Plot(0, strTitle.c_str());
+		pPlot->plot(res.GetChi2());
+		pPlot->SetLabels("Data source", "chi^2");
+
+		emit AddSubWindow(pPlot);
 	}
 }
 
@@ -575,14 +651,29 @@ SpecialFitPixelResult FitDlg::DoSpecialFitPixel(SubWindowBase* pSWB, int iFoil,
 	if(iFkt == FIT_MIEZE_SINE_PIXELWISE_FFT)
 		pFFT = new MFourier(iTCnt);
 
+	// shared by all pixel fits
+	FitWorkspace ws;
+	MiezeSinModel model;
+
+	// counts per pixel, to skip the empty ones before extracting them
+	ReduceResult resCounts;
+	if(pPlot3d->IsCountData())
+	{
+		ReduceParams params;
+		params.iAxes = AXIS_T;
+		params.bUseRoi = 1;
+		reduce(dat3, params, resCounts);
+	}
+
 	for(unsigned int iY=0; iY<iH; ++iY)
 	{
 		for(unsigned int iX=0; iX<iW; ++iX)
 		{
+			if(resCounts.vecVals.size() && resCounts.vecVals[iY*iW + iX]<dMinCts)
+				continue;
+
 			bool bOk=0;
 			Data1 dat1 = dat3.GetXY(iX, iY);
-			if(pPlot3d->IsCountData() && dat1.SumY()<dMinCts)
-				continue;
 
 			dat1.ToArray<double>(px, py, pyerr);
 
@@ -597,16 +688,16 @@ SpecialFitPixelResult FitDlg::DoSpecialFitPixel(SubWindowBase* pSWB, int iFoil,
 			if(iFkt == FIT_MIEZE_SINE_PIXELWISE)
 			{
 				double dThisNumOsc = dNumOsc;
-				MiezeSinModel *pModel = 0;
 				double dFreq = ::get_mieze_freq(px, dat1.GetLength(), dThisNumOsc);
-				bOk = ::get_mieze_contrast(dFreq, dThisNumOsc, dat1.GetLength(), px, py, pyerr, &pModel);
+				bOk = ::get_mieze_contrast(dFreq, dThisNumOsc, dat1.GetLength(), px, py, pyerr, model, ws);
 
-				dC = pModel->GetContrast();
-				dCErr = pModel->GetContrastErr();
-				dPh = pModel->GetPhase();
-				dPhErr = pModel->GetPhaseErr();
-
-				if(pModel) delete pModel;
+				if(ws.bHasModel)
+				{
+					dC = model.GetContrast();
+					dCErr = model.GetContrastErr();
+					dPh = model.GetPhase();
+					dPhErr = model.GetPhaseErr();
+				}
 			}
 			else if(iFkt == FIT_MIEZE_SINE_PIXELWISE_FFT)
 			{
@@ -707,6 +798,10 @@ void FitDlg::DoFit()
 
 	if(comboFitType->currentIndex() == 0)		// 1d fit
 	{
+		std::vector<Plot*> vecPlots;
+		std::vector<bool> vecCreatedNewPlot;
+		std::vector<const Data1*> vecDat;
+
 		for(int iWnd=0; iWnd<listGraphs->count(); ++iWnd)
 		{
 			SubWindowBase* pSWB = ((ListGraphsItem*)listGraphs->item(iWnd))->subWnd();
@@ -720,64 +815,63 @@ void FitDlg::DoFit()
 				continue;
 			}
 
+			vecPlots.push_back(pPlot);
+			vecCreatedNewPlot.push_back(bCreatedNewPlot);
+
 			if(pPlot->GetDataCount() == 0)
 			{
 				//QMessageBox::critical(this, "Error", "No data found.");
+				vecDat.push_back(0);
 				continue;
 			}
 
-			Data1& dat = pPlot->GetData(0).dat;
-			const std::vector<double> *pvecDatX, *pvecDatY, *pvecDatYErr;
-			dat.GetData(&pvecDatX, &pvecDatY, &pvecDatYErr);
+			vecDat.push_back(&pPlot->GetData(0).dat);
+		}
 
-			double *px = tl::vec_to_array<double>(*pvecDatX);
-			double *py = tl::vec_to_array<double>(*pvecDatY);
-			double *pyerr = tl::vec_to_array<double>(*pvecDatYErr);
-			autodeleter<double> _a0(px, 1);
-			autodeleter<double> _a1(py, 1);
-			autodeleter<double> _a2(pyerr, 1);
-			const unsigned int iLen = pvecDatX->size();
+		FitDataParams fitparams;
+		fitparams.iFkt = FIT_USER_DEFINED;
+		fitparams.bAssumeErrorIfZero = bAssumeErrorIfZero;
+		fitparams.strFkt = strFkt;
+		if(bLimits) fitparams.strLimits = strLimits;
+		if(bHints) fitparams.strHints = strHints;
 
-			if(bAssumeErrorIfZero)
-			{
-				double dMaxY = *std::max_element(py, py+iLen);
-				for(unsigned int iErr=0; iErr<iLen; ++iErr)
-				{
-					if(pyerr[iErr] < std::numeric_limits<double>::min())
-						pyerr[iErr] = dMaxY * 0.1;
-				}
-			}
+		FitBatchResult batch;
+		std::vector<tl::FitterFuncModel<double>*> vecModels;
+		FitData::fit_batch(vecDat, fitparams, batch, 0, &vecModels,
+			[this](unsigned int iDone, unsigned int iTotal) { ShowFitProgress(iDone, iTotal); });
 
-			std::vector<std::string> vecFittedNames;
-			std::vector<double> vecFittedParams;
-			std::vector<double> vecFittedErrs;
+		for(unsigned int iPlot=0; iPlot<vecPlots.size(); ++iPlot)
+		{
+			Plot *pPlot = vecPlots[iPlot];
+			tl::FitterFuncModel<double> *pModel = vecModels[iPlot];
 
-			FreeFktModel *pModel;
-			bool bOk = ::get_freefit(iLen, px, py, pyerr,
-				strFkt.c_str(), bLimits?strLimits.c_str():0, bHints?strHints.c_str():0,
-				vecFittedNames, vecFittedParams, vecFittedErrs,
-				&pModel);
+			if(pModel)
+			{
+				//std::cout << "Fit " << (batch.vecConverged[iPlot] ? "ok" : "failed") << ": "
+				//			<< *pModel << std::endl;
 
-			 if(pModel)
-			 {
-                 //std::cout << "Fit " << (bOk ? "ok" : "failed") << ": "
-                 //           << *pModel << std::endl;
+				if(bUpdateHints)
+				{
+					const std::vector<std::string> vecFittedNames = pModel->GetParamNames();
+					const std::vector<double> vecFittedParams = pModel->GetParamValues();
+					const std::vector<double> vecFittedErrs = pModel->GetParamErrors();
 
-				 if(bUpdateHints)
-				 {
-					 for(unsigned int iParam=0; iParam<vecFittedNames.size(); ++iParam)
-						 UpdateHint(vecFittedNames[iParam], vecFittedParams[iParam], vecFittedErrs[iParam]);
-				 }
+					for(unsigned int iParam=0; iParam<vecFittedNames.size(); ++iParam)
+						UpdateHint(vecFittedNames[iParam], vecFittedParams[iParam], vecFittedErrs[iParam]);
+				}
 
 				pPlot->plot_fkt(*pModel);
 				pPlot->RefreshPlot();
 
 				delete pModel;
-			 }
+			}
 
-			if(bCreatedNewPlot)
+			if(vecCreatedNewPlot[iPlot])
 				emit AddSubWindow(pPlot);
 		}
+
+		if(checkParamPlots->isChecked())
+			AddParamPlots(batch, strFkt);
 	}
 	else if(comboFitType->currentIndex() == 1)		// 2d fit
 	{
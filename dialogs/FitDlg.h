@@ -59,6 +59,12 @@ struct FitParams
 	 void DoSpecialFit();
 	 void DoSpecialFitPixelwise();
 
+	 void ShowFitProgress(unsigned int iDone, unsigned int iTotal);
+	 void AddParamPlots(const FitBatchResult& res, const std::string& strFkt);
+
+	 static SpecialFitResult PrepareSpecialFit(SubWindowBase* pSWB, int iFkt, int iParam);
+	 static void FinishSpecialFit(SpecialFitResult& res, int iFkt, tl::FitterFuncModel<double>* pFkt);
+
 	 std::string GetTableString(QTableWidget* pTable) const;
 	 void UpdateSourceList();
 	 void UpdateHint(const std::string& str, double dVal, double dErr);
@@ -9,12 +9,14 @@
 #include <QtGui/QMessageBox>
 
 #include <set>
+#include <vector>
 
 #include "PsdPhaseDlg.h"
 #include "ListDlg.h"
 #include "main/settings.h"
 #include "helper/mieze.h"
 #include "helper/mfourier.h"
+#include "data/reduce.h"
 
 #include "tlibs/phys/mieze.h"
 #include "tlibs/math/math.h"
@@ -22,6 +24,7 @@
 #include "tlibs/log/log.h"
 
 #include "fitter/models/msin.h"
+#include "fitter/models/workspace.h"
 
 
 namespace units = boost::units;
@@ -388,6 +391,8 @@ Plot3d* PsdPhaseCorrDlg::DoPhaseCorr(const Plot2d* pPhasesPlot, const Plot3d* pD
 	const double dNumOsc = Settings::Get<double>("mieze/num_osc");
 
 	MFourier fourier(pDat->GetDepth());
+	FitWorkspace ws;
+	MiezeSinModel model;
 	double *pdMem = new double[pDat->GetDepth()*5];
 	double *pdY = pdMem;
 	double *pdY_shift = pdMem + 1*pDat->GetDepth();
@@ -395,10 +400,32 @@ Plot3d* PsdPhaseCorrDlg::DoPhaseCorr(const Plot2d* pPhasesPlot, const Plot3d* pD
 	double *pdYErr_shift = pdMem + 3*pDat->GetDepth();
 	double *pdX = pdMem + 4*pDat->GetDepth();
 
+	// counts per pixel; pixels below the minimum are skipped before being
+	// extracted, the copy already holds their values
+	ReduceResult resCounts;
+	if(pDatPlot->IsCountData())
+	{
+		ReduceParams params;
+		params.iAxes = AXIS_T;
+		params.bUseRoi = 1;
+		reduce(*pDat, params, resCounts);
+	}
+
+	// the corrected volume is collected here and written back in one go
+	const std::size_t iSliceSize = std::size_t(pDat->GetWidth())*pDat->GetHeight();
+	const std::size_t iSize = iSliceSize*pDat->GetDepth();
+	std::vector<double> vecVals(pDat->GetValsRaw(), pDat->GetValsRaw()+iSize);
+	std::vector<double> vecErrs(iSize, 0.);
+	if(pDat->GetErrsRaw())
+		vecErrs.assign(pDat->GetErrsRaw(), pDat->GetErrsRaw()+iSize);
+
 	unsigned int iUnfittedPixels=0;
 	for(unsigned int iY=0; iY<pDat->GetHeight(); ++iY)
 		for(unsigned int iX=0; iX<pDat->GetWidth(); ++iX)
 		{
+			if(resCounts.vecVals.size() && resCounts.vecVals[iY*pDat->GetWidth() + iX]<dMinCounts)
+				continue;
+
 			Data1 dat = pDat->GetXY(iX, iY);
 			for(unsigned int iT=0; iT<dat.GetLength(); ++iT)
 			{
@@ -407,55 +434,44 @@ Plot3d* PsdPhaseCorrDlg::DoPhaseCorr(const Plot2d* pPhasesPlot, const Plot3d* pD
 				pdX[iT] = dat.GetX(iT);
 			}
 
-			if(pDatPlot->IsCountData() && dat.SumY()<dMinCounts)
+			double dPhase = 0.;
+
+			if(meth == METH_THEO)
+				dPhase = pPhases->GetVal(iX, iY);
+			else if(meth == METH_FFT)
 			{
-				for(unsigned int iT=0; iT<dat.GetLength(); ++iT)
-				{
-					pdY_shift[iT] = pdY[iT];
-					pdYErr_shift[iT] = pdYErr[iT];
-				}
+				double dC;
+				fourier.get_contrast(dNumOsc, pdY, dC, dPhase);
+				//dPhase *= dNumOsc;
 			}
-			else
+			else if(meth == METH_FIT)
 			{
-				double dPhase = 0.;
-
-				if(meth == METH_THEO)
-					dPhase = pPhases->GetVal(iX, iY);
-				else if(meth == METH_FFT)
-				{
-					double dC;
-					fourier.get_contrast(dNumOsc, pdY, dC, dPhase);
-					//dPhase *= dNumOsc;
-				}
-				else if(meth == METH_FIT)
-				{
-					double dFreq = ::get_mieze_freq(pdX, dat.GetLength(), dNumOsc);
-					double dThisNumOsc = dNumOsc;
-
-					MiezeSinModel* pModel = 0;
-					bool bOk = ::get_mieze_contrast(dFreq, dThisNumOsc, dat.GetLength(), pdX, pdY, pdYErr, &pModel);
-					if(bOk && pModel)
-						dPhase = pModel->GetPhase();
-					else
-						++iUnfittedPixels;
-
-					delete pModel;
-				}
+				double dFreq = ::get_mieze_freq(pdX, dat.GetLength(), dNumOsc);
+				double dThisNumOsc = dNumOsc;
 
-				fourier.phase_correction_0(pdY, pdY_shift, dPhase/dNumOsc);
-				fourier.phase_correction_0(pdYErr, pdYErr_shift, dPhase/dNumOsc);
+				bool bOk = ::get_mieze_contrast(dFreq, dThisNumOsc, dat.GetLength(), pdX, pdY, pdYErr, model, ws);
+				if(bOk && ws.bHasModel)
+					dPhase = model.GetPhase();
+				else
+					++iUnfittedPixels;
 			}
 
+			fourier.phase_correction_0(pdY, pdY_shift, dPhase/dNumOsc);
+			fourier.phase_correction_0(pdYErr, pdYErr_shift, dPhase/dNumOsc);
+
 			for(unsigned int iT=0; iT<pDat->GetDepth(); ++iT)
 			{
 				if(pdY_shift[iT] < 0.) pdY_shift[iT] = 0.;
 				pdYErr_shift[iT] = std::fabs(pdYErr_shift[iT]);
 
-				pDat_shifted->SetVal(iX, iY, iT, pdY_shift[iT]);
-				pDat_shifted->SetErr(iX, iY, iT, pdYErr_shift[iT]);
+				const std::size_t iIdx = iT*iSliceSize + iY*pDat->GetWidth() + iX;
+				vecVals[iIdx] = pdY_shift[iT];
+				vecErrs[iIdx] = pdYErr_shift[iT];
 			}
 		}
 
+	pDat_shifted->SetVals(vecVals.data(), vecErrs.data());
+
 	if(iUnfittedPixels)
 	{
 		tl::log_err("PSD phase correction: Could not fit ", iUnfittedPixels, " pixels.");
@@ -490,6 +506,8 @@ Plot4d* PsdPhaseCorrDlg::DoPhaseCorr(const Plot2d* pPhasesPlot, const Plot4d* pD
 	const double dNumOsc = Settings::Get<double>("mieze/num_osc");
 
 	MFourier fourier(pDat->GetDepth());
+	FitWorkspace ws;
+	MiezeSinModel model;
 	double *pdMem = new double[pDat->GetDepth()*5];
 	double *pdY = pdMem;
 	double *pdY_shift = pdMem + 1*pDat->GetDepth();
@@ -497,11 +515,41 @@ Plot4d* PsdPhaseCorrDlg::DoPhaseCorr(const Plot2d* pPhasesPlot, const Plot4d* pD
 	double *pdYErr_shift = pdMem + 3*pDat->GetDepth();
 	double *pdX = pdMem + 4*pDat->GetDepth();
 
+	// counts per pixel and foil, only visiting the occupied bins of sparse data;
+	// pixels below the minimum are skipped, the copy already holds their values
+	ReduceResult resCounts;
+	if(pDatPlot->IsCountData())
+	{
+		ReduceParams params;
+		params.iAxes = AXIS_T;
+		params.bUseRoi = 1;
+		reduce(*pDat, params, resCounts);
+	}
+
+	// each corrected foil is collected here and written back in one go;
+	// skipped pixels take their values over from the source
+	const std::size_t iSliceSize = std::size_t(pDat->GetWidth())*pDat->GetHeight();
+	std::vector<double> vecVals(iSliceSize*pDat->GetDepth());
+	std::vector<double> vecErrs(iSliceSize*pDat->GetDepth());
+
 	unsigned int iUnfittedPixels=0;
 	for(unsigned int iFoil=0; iFoil<pDat->GetDepth2(); ++iFoil)
+	{
 		for(unsigned int iY=0; iY<pDat->GetHeight(); ++iY)
 			for(unsigned int iX=0; iX<pDat->GetWidth(); ++iX)
 			{
+				if(resCounts.vecVals.size() &&
+					resCounts.vecVals[(iFoil*pDat->GetHeight() + iY)*pDat->GetWidth() + iX]<dMinCounts)
+				{
+					for(unsigned int iT=0; iT<pDat->GetDepth(); ++iT)
+					{
+						const std::size_t iIdx = iT*iSliceSize + iY*pDat->GetWidth() + iX;
+						vecVals[iIdx] = pDat->GetValRaw(iX, iY, iT, iFoil);
+						vecErrs[iIdx] = pDat->GetErrRaw(iX, iY, iT, iFoil);
+					}
+					continue;
+				}
+
 				Data1 dat = pDat->GetXYD2(iX, iY, iFoil);
 				for(unsigned int iT=0; iT<dat.GetLength(); ++iT)
 				{
@@ -510,55 +558,45 @@ Plot4d* PsdPhaseCorrDlg::DoPhaseCorr(const Plot2d* pPhasesPlot, const Plot4d* pD
 					pdX[iT] = dat.GetX(iT);
 				}
 
-				if(pDatPlot->IsCountData() && dat.SumY()<dMinCounts)
+				double dPhase = 0.;
+
+				if(meth == METH_THEO)
+					dPhase = pPhases->GetVal(iX, iY);
+				else if(meth == METH_FFT)
 				{
-					for(unsigned int iT=0; iT<dat.GetLength(); ++iT)
-					{
-						pdY_shift[iT] = pdY[iT];
-						pdYErr_shift[iT] = pdYErr[iT];
-					}
+					double dC;
+					fourier.get_contrast(dNumOsc, pdY, dC, dPhase);
+					//dPhase *= dNumOsc;
 				}
-				else
+				else if(meth == METH_FIT)
 				{
-					double dPhase = 0.;
-
-					if(meth == METH_THEO)
-						dPhase = pPhases->GetVal(iX, iY);
-					else if(meth == METH_FFT)
-					{
-						double dC;
-						fourier.get_contrast(dNumOsc, pdY, dC, dPhase);
-						//dPhase *= dNumOsc;
-					}
-					else if(meth == METH_FIT)
-					{
-						double dFreq = ::get_mieze_freq(pdX, dat.GetLength(), dNumOsc);
-						double dThisNumOsc = dNumOsc;
-
-						MiezeSinModel* pModel = 0;
-						bool bOk = ::get_mieze_contrast(dFreq, dThisNumOsc, dat.GetLength(), pdX, pdY, pdYErr, &pModel);
-						if(bOk && pModel)
-							dPhase = pModel->GetPhase();
-						else
-							++iUnfittedPixels;
-
-						delete pModel;
-					}
+					double dFreq = ::get_mieze_freq(pdX, dat.GetLength(), dNumOsc);
+					double dThisNumOsc = dNumOsc;
 
-					fourier.phase_correction_0(pdY, pdY_shift, dPhase/dNumOsc);
-					fourier.phase_correction_0(pdYErr, pdYErr_shift, dPhase/dNumOsc);
+					bool bOk = ::get_mieze_contrast(dFreq, dThisNumOsc, dat.GetLength(), pdX, pdY, pdYErr, model, ws);
+					if(bOk && ws.bHasModel)
+						dPhase = model.GetPhase();
+					else
+						++iUnfittedPixels;
 				}
 
+				fourier.phase_correction_0(pdY, pdY_shift, dPhase/dNumOsc);
+				fourier.phase_correction_0(pdYErr, pdYErr_shift, dPhase/dNumOsc);
+
 				for(unsigned int iT=0; iT<pDat->GetDepth(); ++iT)
 				{
 					if(pdY_shift[iT] < 0.) pdY_shift[iT] = 0.;
 					pdYErr_shift[iT] = std::fabs(pdYErr_shift[iT]);
 
-					pDat_shifted->SetVal(iX, iY, iT, iFoil, pdY_shift[iT]);
-					pDat_shifted->SetErr(iX, iY, iT, iFoil, pdYErr_shift[iT]);
+					const std::size_t iIdx = iT*iSliceSize + iY*pDat->GetWidth() + iX;
+					vecVals[iIdx] = pdY_shift[iT];
+					vecErrs[iIdx] = pdYErr_shift[iT];
 				}
 			}
 
+		pDat_shifted->SetSlices(iFoil, 0, pDat->GetDepth(), vecVals.data(), vecErrs.data());
+	}
+
 	if(iUnfittedPixels)
 	{
 		tl::log_err("PSD phase correction: Could not fit ", iUnfittedPixels, " pixels.");
@@ -567,6 +605,7 @@ Plot4d* PsdPhaseCorrDlg::DoPhaseCorr(const Plot2d* pPhasesPlot, const Plot4d* pD
 	delete[] pdMem;
 
 	pDat_shifted->RecalcMinMaxTotal();
+	pDat_shifted->SelectStorage();
 	pDatPlot_shifted->RefreshTFSlice(0,0);
 	return pDatPlot_shifted;
 }
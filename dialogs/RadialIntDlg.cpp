@@ -140,18 +140,10 @@ void RadialIntDlg::Calc()
 	uint iOldH = info.iHeight;
 	const double dResScale = spinScale->value();
 
+	// the xy range and therefore the centre, radii and rois
+	// stay in the coordinates of the original data
 	if(dResScale != 1.)
-	{
 		pInterp->ChangeResolution(uint(iOldW*dResScale), uint(iOldH*dResScale), 1);
-		dXStart *= dResScale;
-		dYStart *= dResScale;
-		dRadius *= dResScale;
-		dInc *= dResScale;
-
-		Roi *pAntiRoi = pInterp->GetROI(1);
-		if(pAntiRoi)
-			pInterp->GetROI(1)->Scale(dResScale);
-	}
 
 	Data1 dat1d;
 
@@ -209,12 +201,7 @@ void RadialIntDlg::Calc()
 				const Data4& dat = pPlot->GetData();
 				pPlot->SetROI(&roi);
 
-				std::vector<Data1> foils;
-				for(unsigned int iFoil=0; iFoil<dat.GetDepth2(); ++iFoil)
-				{
-					Data1 dat1 = dat.GetXYSum(iFoil);
-					foils.push_back(dat1);
-				}
+				std::vector<Data1> foils = dat.GetXYSums();
 
 				const std::vector<double> *pvecPhases = 0;
 				if(dat.HasPhases())
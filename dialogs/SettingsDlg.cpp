@@ -7,9 +7,8 @@
 
 #include "SettingsDlg.h"
 #include "main/settings.h"
+#include "main/globals.h"
 #include "tlibs/string/string.h"
-#include "tlibs/log/log.h"
-#include "fitter/parser.h"
 
 #include <iostream>
 #include <sstream>
@@ -33,13 +32,7 @@ void SettingsDlg::accept()
 
 void SettingsDlg::set_global_defaults()
 {
-	int iDebugLevel = Settings::Get<int>("misc/debug_level");
-
-	tl::log_debug.SetEnabled(iDebugLevel>=4);
-	tl::log_info.SetEnabled(iDebugLevel>=3);
-	tl::log_warn.SetEnabled(iDebugLevel>=2);
-	tl::log_err.SetEnabled(iDebugLevel>=1);
-	tl::log_crit.SetEnabled(1);
+	apply_global_settings();
 }
 
 
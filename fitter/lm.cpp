@@ -0,0 +1,32 @@
+/**
+ * Levenberg-Marquardt least-squares solver for small fits
+ *
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "lm.h"
+
+#include <set>
+#include <mutex>
+
+
+static std::mutex g_mtxSolver;
+static std::set<std::string> g_setLMModels;
+
+
+bool use_lm_solver(const std::string& strModelName)
+{
+	std::lock_guard<std::mutex> lock(g_mtxSolver);
+	return g_setLMModels.find(strModelName) != g_setLMModels.end();
+}
+
+void set_lm_solver(const std::string& strModelName, bool bUseLM)
+{
+	std::lock_guard<std::mutex> lock(g_mtxSolver);
+	if(bUseLM)
+		g_setLMModels.insert(strModelName);
+	else
+		g_setLMModels.erase(strModelName);
+}
@@ -0,0 +1,352 @@
+/**
+ * Levenberg-Marquardt least-squares solver for small fits
+ *
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_LM_H__
+#define __MIEZE_LM_H__
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+
+#define LM_MAX_PARAMS 32
+
+
+// per model (by GetModelName()) selection of the LM solver instead of Minuit
+bool use_lm_solver(const std::string& strModelName);
+void set_lm_solver(const std::string& strModelName, bool bUseLM);
+
+
+/*
+ * solves A*x = b for a symmetric positive definite n x n matrix,
+ * A is overwritten by its Cholesky factor
+ */
+static inline bool lm_cholesky_solve(double *pA, double *pB, unsigned int n, unsigned int iStride)
+{
+	for(unsigned int j=0; j<n; ++j)
+	{
+		double dDiag = pA[j*iStride + j];
+		for(unsigned int k=0; k<j; ++k)
+			dDiag -= pA[j*iStride + k]*pA[j*iStride + k];
+		if(!(dDiag > 0.))
+			return false;
+		dDiag = std::sqrt(dDiag);
+		pA[j*iStride + j] = dDiag;
+
+		for(unsigned int i=j+1; i<n; ++i)
+		{
+			double dVal = pA[i*iStride + j];
+			for(unsigned int k=0; k<j; ++k)
+				dVal -= pA[i*iStride + k]*pA[j*iStride + k];
+			pA[i*iStride + j] = dVal / dDiag;
+		}
+	}
+
+	// L*y = b, L^T*x = y
+	for(unsigned int i=0; i<n; ++i)
+	{
+		for(unsigned int k=0; k<i; ++k)
+			pB[i] -= pA[i*iStride + k]*pB[k];
+		pB[i] /= pA[i*iStride + i];
+	}
+	for(unsigned int i=n; i-- > 0;)
+	{
+		for(unsigned int k=i+1; k<n; ++k)
+			pB[i] -= pA[k*iStride + i]*pB[k];
+		pB[i] /= pA[i*iStride + i];
+	}
+
+	return true;
+}
+
+
+/*
+ * minimises chi^2 = sum_i ((y_i - f(x_i)) / dy_i)^2 using the model's
+ * analytical parameter gradient (see Chi2GradFunction for the model contract);
+ * all work space is part of the object, nothing is allocated while fitting
+ */
+template<class t_model>
+class LMFitter
+{
+	protected:
+		t_model m_model;
+		unsigned int m_iLen;
+		const double *m_px, *m_py, *m_pdy;
+
+		unsigned int m_iNumParams;
+		std::vector<double> m_vecParams;	// as given to SetParams
+		double m_dLower[LM_MAX_PARAMS], m_dUpper[LM_MAX_PARAMS];
+		bool m_bFixed[LM_MAX_PARAMS];
+
+		unsigned int m_iNumFree = 0;
+		unsigned int m_iFree[LM_MAX_PARAMS];
+
+		// normal equations of the free parameters
+		double m_dJTJ[LM_MAX_PARAMS*LM_MAX_PARAMS];
+		double m_dJTr[LM_MAX_PARAMS];
+		double m_dA[LM_MAX_PARAMS*LM_MAX_PARAMS];
+		double m_dStep[LM_MAX_PARAMS];
+		double m_dGrad[LM_MAX_PARAMS];
+		double m_dTrial[LM_MAX_PARAMS];
+		double m_dErrs[LM_MAX_PARAMS];
+
+		double m_dChi2 = 0.;
+		unsigned int m_iNumIter = 0;
+		bool m_bValid = 0;
+
+		double Weight(unsigned int i) const
+		{
+			if(!m_pdy) return 1.;
+			const double dErr = std::max(std::fabs(m_pdy[i]), std::numeric_limits<double>::min());
+			return 1./(dErr*dErr);
+		}
+
+		void SetModelParams(const double *pdFree)
+		{
+			for(unsigned int iFree=0; iFree<m_iNumFree; ++iFree)
+				m_vecParams[m_iFree[iFree]] = pdFree[iFree];
+			m_model.SetParams(m_vecParams);
+		}
+
+		double Chi2()
+		{
+			double dChi2 = 0.;
+			for(unsigned int i=0; i<m_iLen; ++i)
+			{
+				const double dDiff = m_py[i] - m_model(m_px[i]);
+				dChi2 += dDiff*dDiff * Weight(i);
+			}
+			return dChi2;
+		}
+
+		// J^T W J and J^T W r at the current model parameters, returns chi^2
+		double BuildNormalEquations()
+		{
+			const unsigned int n = m_iNumFree;
+			std::fill(m_dJTJ, m_dJTJ + n*LM_MAX_PARAMS, 0.);
+			std::fill(m_dJTr, m_dJTr + n, 0.);
+
+			double dChi2 = 0.;
+			for(unsigned int i=0; i<m_iLen; ++i)
+			{
+				const double dDiff = m_py[i] - m_model(m_px[i]);
+				const double dW = Weight(i);
+				dChi2 += dDiff*dDiff * dW;
+
+				m_model.ParamGradient(m_px[i], m_dGrad);
+				for(unsigned int j=0; j<n; ++j)
+				{
+					const double dWJ = dW * m_dGrad[m_iFree[j]];
+					m_dJTr[j] += dWJ * dDiff;
+					for(unsigned int k=0; k<=j; ++k)
+						m_dJTJ[j*LM_MAX_PARAMS + k] += dWJ * m_dGrad[m_iFree[k]];
+				}
+			}
+
+			for(unsigned int j=0; j<n; ++j)
+				for(unsigned int k=0; k<j; ++k)
+					m_dJTJ[k*LM_MAX_PARAMS + j] = m_dJTJ[j*LM_MAX_PARAMS + k];
+
+			return dChi2;
+		}
+
+		// errors from the diagonal of the covariance matrix (J^T W J)^-1
+		bool CalcErrors()
+		{
+			const unsigned int n = m_iNumFree;
+			std::fill(m_dErrs, m_dErrs + m_iNumParams, 0.);
+
+			// without point errors, scale by the residual variance
+			double dScale = 1.;
+			if(!m_pdy && m_iLen > n)
+				dScale = m_dChi2 / double(m_iLen - n);
+
+			for(unsigned int iCol=0; iCol<n; ++iCol)
+			{
+				std::copy(m_dJTJ, m_dJTJ + n*LM_MAX_PARAMS, m_dA);
+				std::fill(m_dStep, m_dStep + n, 0.);
+				m_dStep[iCol] = 1.;
+
+				if(!lm_cholesky_solve(m_dA, m_dStep, n, LM_MAX_PARAMS))
+					return false;
+				m_dErrs[m_iFree[iCol]] = std::sqrt(std::fabs(m_dStep[iCol]) * dScale);
+			}
+			return true;
+		}
+
+		void Init(unsigned int iNumParams)
+		{
+			m_iNumParams = std::min<unsigned int>(iNumParams, LM_MAX_PARAMS);
+			m_vecParams.assign(m_iNumParams, 0.);
+
+			for(unsigned int iParam=0; iParam<m_iNumParams; ++iParam)
+			{
+				m_dLower[iParam] = -std::numeric_limits<double>::infinity();
+				m_dUpper[iParam] = std::numeric_limits<double>::infinity();
+				m_bFixed[iParam] = 0;
+				m_dErrs[iParam] = 0.;
+			}
+
+			m_iNumFree = 0;
+			m_dChi2 = 0.;
+			m_iNumIter = 0;
+			m_bValid = 0;
+		}
+
+	public:
+		LMFitter(const t_model& model, unsigned int iNumParams, unsigned int iLen,
+			const double *px, const double *py, const double *pdy)
+			: m_model(model), m_iLen(iLen), m_px(px), m_py(py), m_pdy(pdy)
+		{
+			Init(iNumParams);
+		}
+
+		// prepares a new fit, reusing the parameter and model storage
+		void Reset(const t_model& model, unsigned int iNumParams, unsigned int iLen,
+			const double *px, const double *py, const double *pdy)
+		{
+			m_model = model;
+			m_iLen = iLen;
+			m_px = px; m_py = py; m_pdy = pdy;
+			Init(iNumParams);
+		}
+
+		void SetParam(unsigned int iParam, double dVal)
+		{
+			if(iParam < m_iNumParams)
+				m_vecParams[iParam] = dVal;
+		}
+
+		void SetLimits(unsigned int iParam, double dLower, double dUpper)
+		{
+			if(iParam >= m_iNumParams)
+				return;
+			if(dLower > dUpper)
+				std::swap(dLower, dUpper);
+			m_dLower[iParam] = dLower;
+			m_dUpper[iParam] = dUpper;
+		}
+
+		void SetLowerLimit(unsigned int iParam, double dLower)
+		{
+			if(iParam < m_iNumParams)
+				m_dLower[iParam] = dLower;
+		}
+
+		void RemoveLimits()
+		{
+			for(unsigned int iParam=0; iParam<m_iNumParams; ++iParam)
+			{
+				m_dLower[iParam] = -std::numeric_limits<double>::infinity();
+				m_dUpper[iParam] = std::numeric_limits<double>::infinity();
+			}
+		}
+
+		void Fix(unsigned int iParam, bool bFix=1)
+		{
+			if(iParam < m_iNumParams)
+				m_bFixed[iParam] = bFix;
+		}
+
+		bool Fit(unsigned int iMaxIter=250)
+		{
+			m_bValid = 0;
+			m_iNumIter = 0;
+			m_iNumFree = 0;
+			for(unsigned int iParam=0; iParam<m_iNumParams; ++iParam)
+			{
+				m_vecParams[iParam] = std::min(std::max(m_vecParams[iParam],
+					m_dLower[iParam]), m_dUpper[iParam]);
+				if(!m_bFixed[iParam])
+					m_iFree[m_iNumFree++] = iParam;
+			}
+
+			const unsigned int n = m_iNumFree;
+			m_model.SetParams(m_vecParams);
+			m_dChi2 = BuildNormalEquations();
+			if(n == 0)
+				return m_bValid = std::isfinite(m_dChi2);
+
+			double dLambda = 1e-3;
+			bool bConverged = 0;
+
+			for(m_iNumIter=0; m_iNumIter<iMaxIter && !bConverged; ++m_iNumIter)
+			{
+				// damped normal equations, scaled by the diagonal
+				std::copy(m_dJTJ, m_dJTJ + n*LM_MAX_PARAMS, m_dA);
+				for(unsigned int j=0; j<n; ++j)
+				{
+					const double dDiag = std::max(m_dJTJ[j*LM_MAX_PARAMS + j], 1e-12);
+					m_dA[j*LM_MAX_PARAMS + j] += dLambda * dDiag;
+				}
+				std::copy(m_dJTr, m_dJTr + n, m_dStep);
+
+				if(!lm_cholesky_solve(m_dA, m_dStep, n, LM_MAX_PARAMS))
+				{
+					dLambda *= 10.;
+					if(dLambda > 1e16) break;
+					continue;
+				}
+
+				bool bStepSmall = 1;
+				for(unsigned int j=0; j<n; ++j)
+				{
+					const unsigned int iParam = m_iFree[j];
+					const double dOld = m_vecParams[iParam];
+					m_dTrial[j] = std::min(std::max(dOld + m_dStep[j],
+						m_dLower[iParam]), m_dUpper[iParam]);
+
+					if(std::fabs(m_dTrial[j]-dOld) > 1e-12*(std::fabs(dOld) + 1e-12))
+						bStepSmall = 0;
+				}
+				if(bStepSmall)
+				{
+					bConverged = 1;
+					break;
+				}
+
+				// keep the accepted parameters to go back to
+				double dOld[LM_MAX_PARAMS];
+				for(unsigned int j=0; j<n; ++j)
+					dOld[j] = m_vecParams[m_iFree[j]];
+
+				SetModelParams(m_dTrial);
+				const double dChi2Trial = Chi2();
+
+				if(std::isfinite(dChi2Trial) && dChi2Trial <= m_dChi2)
+				{
+					const double dImprovement = m_dChi2 - dChi2Trial;
+					m_dChi2 = BuildNormalEquations();
+					dLambda = std::max(dLambda*0.1, 1e-15);
+
+					if(dImprovement <= 1e-12*m_dChi2 + std::numeric_limits<double>::min())
+						bConverged = 1;
+				}
+				else
+				{
+					SetModelParams(dOld);
+					dLambda *= 10.;
+					if(dLambda > 1e16)
+						break;		// stalled, no descent found: not converged
+				}
+			}
+
+			m_bValid = bConverged && std::isfinite(m_dChi2) && CalcErrors();
+			return m_bValid;
+		}
+
+		double GetValue(unsigned int iParam) const { return m_vecParams[iParam]; }
+		double GetError(unsigned int iParam) const { return m_dErrs[iParam]; }
+		double GetChi2() const { return m_dChi2; }
+		unsigned int GetNumIter() const { return m_iNumIter; }
+		bool IsValid() const { return m_bValid; }
+};
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * chi^2 function with analytical gradient for the built-in models
+ *
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __CHI2_GRAD__
+#define __CHI2_GRAD__
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <limits>
+
+#include <Minuit2/FCNGradientBase.h>
+#include <Minuit2/FunctionMinimum.h>
+#include <Minuit2/MnMigrad.h>
+#include <Minuit2/MnUserParameters.h>
+
+
+/*
+ * t_model needs a copy constructor, SetParams() and
+ * ParamGradient(x, pdGrad), which writes df/dp for all parameters
+ * in the order given to SetParams();
+ * evaluations share one working copy of the model, so one object
+ * must not be used by several minimisations at the same time
+ */
+template<class t_model>
+class Chi2GradFunction : public ROOT::Minuit2::FCNGradientBase
+{
+	protected:
+		const t_model *m_pModel;
+		unsigned int m_iLen;
+		const double *m_px, *m_py, *m_pdy;
+		double m_dSigma;
+
+		// working copy, only made once Minuit calls us
+		mutable std::unique_ptr<t_model> m_pWork;
+		mutable std::vector<double> m_vecDf;
+
+		t_model& GetWork(const std::vector<double>& vecParams) const
+		{
+			if(!m_pWork)
+				m_pWork.reset(new t_model(*m_pModel));
+			m_pWork->SetParams(vecParams);
+			return *m_pWork;
+		}
+
+		// same error handling as in tl::chi2
+		double GetErr(unsigned int i, double dDiff) const
+		{
+			double dErr = m_pdy ? m_pdy[i] : 0.1*dDiff;
+			if(std::fabs(dErr) < std::numeric_limits<double>::min())
+				dErr = std::numeric_limits<double>::min();
+			return dErr;
+		}
+
+	public:
+		Chi2GradFunction(const t_model *pModel, unsigned int iLen,
+			const double *px, const double *py, const double *pdy)
+			: m_pModel(pModel), m_iLen(iLen), m_px(px), m_py(py), m_pdy(pdy),
+			  m_dSigma(1.)
+		{}
+		virtual ~Chi2GradFunction() {}
+
+		virtual double operator()(const std::vector<double>& vecParams) const override
+		{
+			const t_model& mod = GetWork(vecParams);
+
+			double dChi2 = 0.;
+			for(unsigned int i=0; i<m_iLen; ++i)
+			{
+				double dDiff = m_py[i] - mod(m_px[i]);
+				dDiff /= GetErr(i, dDiff);
+				dChi2 += dDiff*dDiff;
+			}
+			return dChi2;
+		}
+
+		// d(chi^2)/dp_k = sum_i -2 * (y_i - f_i)/dy_i^2 * df_i/dp_k
+		virtual std::vector<double> Gradient(const std::vector<double>& vecParams) const override
+		{
+			const t_model& mod = GetWork(vecParams);
+
+			const unsigned int iNumParams = vecParams.size();
+			std::vector<double> vecGrad(iNumParams, 0.);
+			m_vecDf.resize(iNumParams);
+
+			for(unsigned int i=0; i<m_iLen; ++i)
+			{
+				const double dDiff = m_py[i] - mod(m_px[i]);
+				const double dErr = GetErr(i, dDiff);
+				const double dWeight = -2. * dDiff / (dErr*dErr);
+
+				mod.ParamGradient(m_px[i], m_vecDf.data());
+				for(unsigned int iParam=0; iParam<iNumParams; ++iParam)
+					vecGrad[iParam] += dWeight * m_vecDf[iParam];
+			}
+
+			return vecGrad;
+		}
+
+		virtual double Up() const override { return m_dSigma*m_dSigma; }
+		void SetSigma(double dSigma) { m_dSigma = dSigma; }
+};
+
+
+// migrad with either a numerical or an analytical gradient fcn
+template<class t_fcn>
+ROOT::Minuit2::FunctionMinimum chi2_migrad(const t_fcn& fkt,
+	const ROOT::Minuit2::MnUserParameters& params, unsigned int iStrategy)
+{
+	ROOT::Minuit2::MnMigrad migrad(fkt, params, iStrategy);
+	return migrad();
+}
+
+/*
+ * uses the analytical gradient if the points have errors;
+ * otherwise the error estimate depends on the residuals and
+ * the chi^2 gradient is not that of a smooth function
+ */
+template<class t_fcn, class t_fcngrad>
+ROOT::Minuit2::FunctionMinimum chi2_migrad(const t_fcn& fkt, const t_fcngrad& fktgrad,
+	bool bUseGrad, const ROOT::Minuit2::MnUserParameters& params, unsigned int iStrategy)
+{
+	if(bUseGrad)
+		return chi2_migrad(fktgrad, params, iStrategy);
+	return chi2_migrad(fkt, params, iStrategy);
+}
+
+#endif
@@ -17,6 +17,8 @@
 #include <Minuit2/MnPrint.h>
 
 #include "freefit.h"
+#include "chi2grad.h"
+#include "fitter/lm.h"
 #include "tlibs/log/log.h"
 
 //----------------------------------------------------------------------
@@ -49,6 +51,7 @@ FreeFktModel::FreeFktModel(const FreeFktModel& model)
 const FreeFktModel& FreeFktModel::operator=(const FreeFktModel& model)
 {
 	this->m_parser = model.m_parser;
+	this->m_vecDerivs = model.m_vecDerivs;
 	return *this;
 }
 
@@ -73,12 +76,77 @@ bool FreeFktModel::SetParams(const std::vector<double>& vecParams)
 	for(unsigned int i=0; i<vecParams.size(); ++i)
 		syms[i].dVal = vecParams[i];
 
+	// the derivatives share the symbol table layout
+	for(Parser& parserDeriv : m_vecDerivs)
+	{
+		std::vector<Symbol>& symsDeriv = parserDeriv.GetSymbols();
+		for(unsigned int i=0; i<vecParams.size() && i<symsDeriv.size(); ++i)
+			symsDeriv[i].dVal = vecParams[i];
+	}
+
 	return true;
 }
 
 double FreeFktModel::operator()(double x) const
 {
-	return const_cast<Parser&>(m_parser).EvalTree(x);	// !!
+	return m_parser.EvalTree(x);
+}
+
+bool FreeFktModel::EvalArray(const double *px, std::size_t iLen, double *pdOut) const
+{
+	return m_parser.EvalArray(px, iLen, pdOut);
+}
+
+bool FreeFktModel::EvalArray(const double *px, std::size_t iLen, double *pdOut,
+	const std::vector<double>& vecParams, ParserEnv *pEnv) const
+{
+	if(vecParams.size() != m_parser.GetSymbols().size())
+	{
+		tl::log_err(m_parser.GetSymbols().size(), " symbols in table, but ",
+			vecParams.size(), " symbols supplied.");
+		return false;
+	}
+
+	return m_parser.EvalArraySyms(&px, iLen, pdOut, vecParams.data(), pEnv);
+}
+
+bool FreeFktModel::InitGradient()
+{
+	m_vecDerivs.clear();
+
+	const std::vector<Symbol>& syms = m_parser.GetSymbols();
+	std::vector<Parser> vecDerivs(syms.size());
+
+	for(unsigned int iSym=0; iSym<syms.size(); ++iSym)
+	{
+		if(!m_parser.GetDerivative(syms[iSym].strIdent, vecDerivs[iSym]))
+		{
+			tl::log_warn("No symbolic derivative for parameter \"", syms[iSym].strIdent,
+				"\", using numerical gradient.");
+			return false;
+		}
+
+		tl::log_debug("d/d", syms[iSym].strIdent, " = ",
+			vecDerivs[iSym].GetExpression(false, false));
+	}
+
+	m_vecDerivs = std::move(vecDerivs);
+	return true;
+}
+
+bool FreeFktModel::EvalGradArray(unsigned int iParam, const double *px, std::size_t iLen,
+	double *pdOut, const std::vector<double>& vecParams, ParserEnv *pEnv) const
+{
+	if(iParam >= m_vecDerivs.size() || vecParams.size() != m_parser.GetSymbols().size())
+		return false;
+
+	return m_vecDerivs[iParam].EvalArraySyms(&px, iLen, pdOut, vecParams.data(), pEnv);
+}
+
+void FreeFktModel::ParamGradient(double x, double *pdGrad) const
+{
+	for(unsigned int iParam=0; iParam<m_vecDerivs.size(); ++iParam)
+		pdGrad[iParam] = m_vecDerivs[iParam].EvalTree(x);
 }
 
 tl::FitterFuncModel<double>* FreeFktModel::copy() const
@@ -95,6 +163,83 @@ std::string FreeFktModel::print(bool bFillInSyms) const
 
 
 
+//----------------------------------------------------------------------
+// chi^2
+
+double freefit_chi2(std::size_t iLen, const double *py, const double *pdy, const double *pdModel)
+{
+	double dChi2 = 0.;
+	for(std::size_t i=0; i<iLen; ++i)
+	{
+		double dDiff = py[i] - pdModel[i];
+		double dErr = pdy ? pdy[i] : 0.1*dDiff;
+		if(std::fabs(dErr) < std::numeric_limits<double>::min())
+			dErr = std::numeric_limits<double>::min();
+
+		dDiff /= dErr;
+		dChi2 += dDiff*dDiff;
+	}
+	return dChi2;
+}
+
+FreeFktChi2::FreeFktChi2(const FreeFktModel *pModel, std::size_t iLen,
+	const double *px, const double *py, const double *pdy)
+	: m_pModel(pModel), m_iLen(iLen), m_px(px), m_py(py), m_pdy(pdy),
+	  m_dSigma(1.)
+{}
+
+double FreeFktChi2::operator()(const std::vector<double>& vecParams) const
+{
+	std::vector<double> vecModel(m_iLen);
+	if(!m_pModel->EvalArray(m_px, m_iLen, vecModel.data(), vecParams))
+		return std::numeric_limits<double>::max();
+
+	return freefit_chi2(m_iLen, m_py, m_pdy, vecModel.data());
+}
+
+
+FreeFktChi2Grad::FreeFktChi2Grad(const FreeFktModel *pModel, std::size_t iLen,
+	const double *px, const double *py, const double *pdy)
+	: m_chi2(pModel, iLen, px, py, pdy),
+	  m_pModel(pModel), m_iLen(iLen), m_px(px), m_py(py), m_pdy(pdy)
+{}
+
+// d(chi^2)/dp_k = sum_i -2 * (y_i - f_i)/dy_i^2 * df_i/dp_k
+std::vector<double> FreeFktChi2Grad::Gradient(const std::vector<double>& vecParams) const
+{
+	std::vector<double> vecGrad(vecParams.size(), 0.);
+	std::vector<double> vecWeights(m_iLen), vecDeriv(m_iLen);
+	ParserEnv env;
+
+	if(!m_pModel->EvalArray(m_px, m_iLen, vecWeights.data(), vecParams, &env))
+		return vecGrad;
+
+	for(std::size_t i=0; i<m_iLen; ++i)
+	{
+		double dErr = m_pdy ? m_pdy[i] : 1.;
+		if(std::fabs(dErr) < std::numeric_limits<double>::min())
+			dErr = std::numeric_limits<double>::min();
+
+		vecWeights[i] = -2. * (m_py[i] - vecWeights[i]) / (dErr*dErr);
+	}
+
+	for(unsigned int iParam=0; iParam<vecParams.size(); ++iParam)
+	{
+		if(!m_pModel->EvalGradArray(iParam, m_px, m_iLen, vecDeriv.data(), vecParams, &env))
+			continue;
+
+		double dSum = 0.;
+		for(std::size_t i=0; i<m_iLen; ++i)
+			dSum += vecWeights[i] * vecDeriv[i];
+		vecGrad[iParam] = dSum;
+	}
+
+	return vecGrad;
+}
+//----------------------------------------------------------------------
+
+
+
 void freefit_get_hint(const std::string& strIdent, double& dHint, double &dErr,
 					 const std::vector<ParameterHints>& vecHints)
 {
@@ -159,7 +304,16 @@ bool get_freefit(unsigned int iLen,
 		tl::log_err("Free function model could not be created.");
 		return 0;
 	}
-	tl::Chi2Function<double> fkt(&freemod, iLen, px, py, pdy);
+	FreeFktChi2 fkt(&freemod, iLen, px, py, pdy);
+	FreeFktChi2Grad fktgrad(&freemod, iLen, px, py, pdy);
+
+	// without errors the chi^2 is not a smooth function of the parameters
+	const bool bUseGrad = pdy && freemod.InitGradient();
+
+	// the LM solver always needs the analytical gradient
+	const bool bUseLM = use_lm_solver(freemod.GetModelName()) &&
+		freemod.GetSymbols().size() <= LM_MAX_PARAMS &&
+		(freemod.HasGradient() || freemod.InitGradient());
 
 	const double *pdMax = std::max_element(py,py+iLen),
 				  dMin = *std::min_element(py,py+iLen);
@@ -179,89 +333,127 @@ bool get_freefit(unsigned int iLen,
 	std::vector<Symbol>& syms = freemod.GetSymbols();
 
 
-	ROOT::Minuit2::MnUserParameters params;
-	for(const Symbol& sym : syms)
+	std::vector<ROOT::Minuit2::FunctionMinimum> minis;
+	minis.reserve(2);
+	std::vector<std::string> vecParamNames;
+
+	if(bUseLM)
 	{
-		double dHint = sym.dVal;
-		double dErr = dHint*0.1;
-		freefit_get_hint(sym.strIdent, dHint, dErr, vecHints);
+		LMFitter<FreeFktModel> lm(freemod, syms.size(), iLen, px, py, pdy);
+		for(unsigned int iSym=0; iSym<syms.size(); ++iSym)
+		{
+			const Symbol& sym = syms[iSym];
+			double dHint = sym.dVal;
+			double dErr = dHint*0.1;
+			freefit_get_hint(sym.strIdent, dHint, dErr, vecHints);
+			lm.SetParam(iSym, dHint);
+
+			double dMinLim, dMaxLim;
+			if(freefit_get_limits(sym.strIdent, dMinLim, dMaxLim, vecLimits) && dMinLim != dMaxLim)
+				lm.SetLimits(iSym, dMinLim, dMaxLim);
+		}
+		lm.Fit();
 
-		params.Add(sym.strIdent.c_str(), dHint, dErr);
+		lm.RemoveLimits();
+		bValidFit = lm.Fit();
 
-		double dMinLim, dMaxLim;
-		if(freefit_get_limits(sym.strIdent, dMinLim, dMaxLim, vecLimits))
+		for(unsigned int iSym=0; iSym<syms.size(); ++iSym)
 		{
-			if(dMinLim > dMaxLim)
-			{
-				double dTmpLim = dMinLim;
-				dMinLim = dMaxLim;
-				dMaxLim = dTmpLim;
-			}
+			Symbol& sym = syms[iSym];
+			const double dVal = lm.GetValue(iSym);
 
-			if(dMinLim != dMaxLim)
-				params.SetLimits(sym.strIdent, dMinLim, dMaxLim);
-			//else
-			//	params.Fix(sym.strIdent);
+			vecFittedNames.push_back(sym.strIdent);
+			vecParamNames.push_back(sym.strIdent);
+			vecFittedParams.push_back(dVal);
+			vecFittedErrs.push_back(fabs(lm.GetError(iSym)));
+
+			// also write found values back into the symbol table
+			sym.dVal = dVal;
 		}
+
+		tl::log_debug("User-defined LM fit: ", lm.GetNumIter(), " iterations, chi2 = ", lm.GetChi2());
 	}
+	else
+	{
+		ROOT::Minuit2::MnUserParameters params;
+		for(const Symbol& sym : syms)
+		{
+			double dHint = sym.dVal;
+			double dErr = dHint*0.1;
+			freefit_get_hint(sym.strIdent, dHint, dErr, vecHints);
+
+			params.Add(sym.strIdent.c_str(), dHint, dErr);
+
+			double dMinLim, dMaxLim;
+			if(freefit_get_limits(sym.strIdent, dMinLim, dMaxLim, vecLimits))
+			{
+				if(dMinLim > dMaxLim)
+				{
+					double dTmpLim = dMinLim;
+					dMinLim = dMaxLim;
+					dMaxLim = dTmpLim;
+				}
+
+				if(dMinLim != dMaxLim)
+					params.SetLimits(sym.strIdent, dMinLim, dMaxLim);
+				//else
+				//	params.Fix(sym.strIdent);
+			}
+		}
 
 
-	std::vector<ROOT::Minuit2::FunctionMinimum> minis;
-	minis.reserve(2);
 	
-	{
-		// step 1: free fit (limited)
-		
-		ROOT::Minuit2::MnMigrad migrad(fkt, params, /*MINUIT_STRATEGY*/1);
-		ROOT::Minuit2::FunctionMinimum mini = migrad();
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
-		//if(bValidFit)
 		{
-			for(const Symbol& sym : syms)
+			// step 1: free fit (limited)
+		
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/1);
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
+			//if(bValidFit)
 			{
-				params.SetValue(sym.strIdent.c_str(), mini.UserState().Value(sym.strIdent.c_str()));
-				params.SetError(sym.strIdent.c_str(), mini.UserState().Error(sym.strIdent.c_str()));
+				for(const Symbol& sym : syms)
+				{
+					params.SetValue(sym.strIdent.c_str(), mini.UserState().Value(sym.strIdent.c_str()));
+					params.SetError(sym.strIdent.c_str(), mini.UserState().Error(sym.strIdent.c_str()));
+				}
 			}
-		}
 
-		minis.push_back(mini);
-	}
+			minis.push_back(mini);
+		}
 
 
-	{
-		// step 2: free fit (unlimited)
+		{
+			// step 2: free fit (unlimited)
 
-		for(const Symbol& sym : syms)
-			params.RemoveLimits(sym.strIdent.c_str());
+			for(const Symbol& sym : syms)
+				params.RemoveLimits(sym.strIdent.c_str());
 
-		ROOT::Minuit2::MnMigrad migrad2(fkt, params, /*MINUIT_STRATEGY*/2);
-		ROOT::Minuit2::FunctionMinimum mini = migrad2();
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/2);
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
 
-		minis.push_back(mini);
-	}
+			minis.push_back(mini);
+		}
 
 
-	const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
+		const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
 
 
-	std::vector<std::string> vecParamNames;
-	for(Symbol& sym : syms)
-	{
-		vecFittedNames.push_back(sym.strIdent);
+		for(Symbol& sym : syms)
+		{
+			vecFittedNames.push_back(sym.strIdent);
 
 
-		double dVal = lastmini.UserState().Value(sym.strIdent.c_str());
-		double dErr = lastmini.UserState().Error(sym.strIdent.c_str());
-		dErr = fabs(dErr);
+			double dVal = lastmini.UserState().Value(sym.strIdent.c_str());
+			double dErr = lastmini.UserState().Error(sym.strIdent.c_str());
+			dErr = fabs(dErr);
 
-		vecParamNames.push_back(sym.strIdent);
-		vecFittedParams.push_back(dVal);
-		vecFittedErrs.push_back(dErr);
+			vecParamNames.push_back(sym.strIdent);
+			vecFittedParams.push_back(dVal);
+			vecFittedErrs.push_back(dErr);
 
 
-		// also write found values back into the symbol table
-		sym.dVal = dVal;
+			// also write found values back into the symbol table
+			sym.dVal = dVal;
+		}
 	}
 
 
@@ -12,6 +12,9 @@
 #include "tlibs/fit/minuit.h"
 #include "../parser.h"
 
+#include <Minuit2/FCNBase.h>
+#include <Minuit2/FCNGradientBase.h>
+
 
 // fit to a user-entered function
 class FreeFktModel : public tl::FitterFuncModel<double>
@@ -22,6 +25,9 @@ class FreeFktModel : public tl::FitterFuncModel<double>
 		std::vector<double> m_vecParamVals;
 		std::vector<double> m_vecParamErrs;
 
+		// partial derivatives with respect to the symbols
+		std::vector<Parser> m_vecDerivs;
+
 	public:
 		FreeFktModel();
 		FreeFktModel(const FreeFktModel& model);
@@ -33,6 +39,19 @@ class FreeFktModel : public tl::FitterFuncModel<double>
 
 		virtual bool SetParams(const std::vector<double>& vecParams);
 		virtual double operator()(double x) const;
+		bool EvalArray(const double *px, std::size_t iLen, double *pdOut) const;
+
+		// evaluation with external parameters, safe to call from several threads
+		bool EvalArray(const double *px, std::size_t iLen, double *pdOut,
+			const std::vector<double>& vecParams, ParserEnv *pEnv=0) const;
+
+		// symbolic partial derivatives
+		bool InitGradient();
+		bool HasGradient() const { return !m_vecDerivs.empty(); }
+		bool EvalGradArray(unsigned int iParam, const double *px, std::size_t iLen,
+			double *pdOut, const std::vector<double>& vecParams, ParserEnv *pEnv=0) const;
+		// df/dp at x for the current parameters, needs InitGradient()
+		void ParamGradient(double x, double *pdGrad) const;
 
 		virtual tl::FitterFuncModel<double>* copy() const;
 		virtual std::string print(bool bFillInSyms=1) const;
@@ -61,6 +80,51 @@ class FreeFktModel : public tl::FitterFuncModel<double>
 				FreeFktModel** pFinalModel);
 };
 
+// chi^2 of a free function, evaluating the model for all points at once;
+// the model is not modified, so it may be shared between threads
+class FreeFktChi2 : public ROOT::Minuit2::FCNBase
+{
+	protected:
+		const FreeFktModel *m_pModel;
+		std::size_t m_iLen;
+		const double *m_px, *m_py, *m_pdy;
+		double m_dSigma;
+
+	public:
+		FreeFktChi2(const FreeFktModel *pModel, std::size_t iLen,
+			const double *px, const double *py, const double *pdy);
+		virtual ~FreeFktChi2() {}
+
+		virtual double operator()(const std::vector<double>& vecParams) const override;
+		virtual double Up() const override { return m_dSigma*m_dSigma; }
+
+		void SetSigma(double dSigma) { m_dSigma = dSigma; }
+};
+
+// chi^2 with analytical gradient from the model's symbolic derivatives
+class FreeFktChi2Grad : public ROOT::Minuit2::FCNGradientBase
+{
+	protected:
+		FreeFktChi2 m_chi2;
+		const FreeFktModel *m_pModel;
+		std::size_t m_iLen;
+		const double *m_px, *m_py, *m_pdy;
+
+	public:
+		FreeFktChi2Grad(const FreeFktModel *pModel, std::size_t iLen,
+			const double *px, const double *py, const double *pdy);
+		virtual ~FreeFktChi2Grad() {}
+
+		virtual double operator()(const std::vector<double>& vecParams) const override
+		{ return m_chi2(vecParams); }
+		virtual double Up() const override { return m_chi2.Up(); }
+		virtual std::vector<double> Gradient(const std::vector<double>& vecParams) const override;
+
+		void SetSigma(double dSigma) { m_chi2.SetSigma(dSigma); }
+};
+
+double freefit_chi2(std::size_t iLen, const double *py, const double *pdy, const double *pdModel);
+
 void freefit_get_hint(const std::string& strIdent, double& dHint, double &dErr,
 					 const std::vector<ParameterHints>& vecHints);
 bool freefit_get_limits(const std::string& strIdent, double &dMinLim, double& dMaxLim,
@@ -22,7 +22,9 @@
 #include <Minuit2/MnPrint.h>
 
 #include "gauss.h"
-#include "main/settings.h"
+#include "chi2grad.h"
+#include "fitter/lm.h"
+#include "workspace.h"
 
 
 //----------------------------------------------------------------------
@@ -111,6 +113,34 @@ double GaussModel::operator()(double x) const
 		* exp(-0.5 * ((x-m_x0)/m_spread)*((x-m_x0)/m_spread)) + m_offs;
 }
 
+// derivatives of a single peak by amp, spread, x0
+static inline void gauss_param_gradient(double x, double dAmp, double dSpread, double dX0,
+	bool bNormalized, double *pdGrad)
+{
+	const double dU = (x-dX0)/dSpread;
+	double dNorm = 1.;
+	double dNormDeriv = 0.;		// d(log norm)/d spread
+
+	if(bNormalized)
+	{
+		dNorm = 1./(sqrt(2.*M_PI*fabs(dSpread)));
+		dNormDeriv = -0.5/dSpread;
+	}
+
+	const double dG = dNorm * exp(-0.5*dU*dU);
+
+	pdGrad[0] = dG;
+	pdGrad[1] = dAmp*dG * (dU*dU/dSpread + dNormDeriv);
+	pdGrad[2] = dAmp*dG * dU/dSpread;
+}
+
+// derivatives by amp, spread, x0, offs
+void GaussModel::ParamGradient(double x, double *pdGrad) const
+{
+	gauss_param_gradient(x, m_amp, m_spread, m_x0, m_bNormalized, pdGrad);
+	pdGrad[3] = 1.;
+}
+
 tl::FitterFuncModel<double>* GaussModel::copy() const
 {
 	return new GaussModel(m_amp, m_spread, m_x0,
@@ -159,12 +189,25 @@ bool get_gauss(unsigned int iLen,
 					const double *px, const double *py, const double *pdy,
 					GaussModel **pmodel)
 {
-	std::vector<double> vecMaximaX;
-	std::vector<double> vecMaximaSize;
-	std::vector<double> vecMaximaWidth;
+	FitWorkspace ws;
+	GaussModel model;
+
+	bool bOk = get_gauss(iLen, px, py, pdy, model, ws);
+	*pmodel = ws.bHasModel ? new GaussModel(model) : 0;
+	return bOk;
+}
 
-	const int iDegree = Settings::Get<int>("interpolation/spline_degree");
-	tl::find_peaks<double>(iLen, px, py, iDegree, vecMaximaX, vecMaximaSize, vecMaximaWidth);
+bool get_gauss(unsigned int iLen,
+					const double *px, const double *py, const double *pdy,
+					GaussModel& model, FitWorkspace& ws)
+{
+	ws.bHasModel = 0;
+
+	std::vector<double>& vecMaximaX = ws.vecMaximaX;
+	std::vector<double>& vecMaximaSize = ws.vecMaximaSize;
+	std::vector<double>& vecMaximaWidth = ws.vecMaximaWidth;
+
+	tl::find_peaks<double>(iLen, px, py, ws.iSplineDegree, vecMaximaX, vecMaximaSize, vecMaximaWidth);
 
 	bool bPrefitOk = 1;
 	if(vecMaximaX.size() < 1)
@@ -180,6 +223,9 @@ bool get_gauss(unsigned int iLen,
 
 	GaussModel gmod;
 	tl::Chi2Function<double> fkt(&gmod, iLen, px, py, pdy);
+	Chi2GradFunction<GaussModel> fktgrad(&gmod, iLen, px, py, pdy);
+	const bool bUseGrad = (pdy != 0);
+	const bool bUseLM = use_lm_solver(gmod.GetModelName());
 
 	typedef std::pair<const double*, const double*> t_minmax;
 	t_minmax minmax_x = boost::minmax_element(px, px+iLen);
@@ -218,120 +264,149 @@ bool get_gauss(unsigned int iLen,
 		dx0 = vecMaximaX[0];
 	}
 
-	ROOT::Minuit2::MnUserParameters params;
-	params.Add("amp", dAmp, dAmpErr);
-	params.Add("spread", dSpread, dSpreadErr);
-	params.Add("x0", dx0, 0.1*dx0);
-	params.Add("offs", dMin, 0.1*dMin);
-
-	//params.SetLimits("amp", 0., dMax*(sqrt(2.*M_PI)*fabs(dSpread)));
-	params.SetLowerLimit("spread", 0.);
-	params.SetLimits("x0", dXMin, dXMax);
-	params.SetLimits("offs", dMin, dMax);
-
 	bool bValidFit=false;
-	std::vector<ROOT::Minuit2::FunctionMinimum> minis;
+	std::vector<ROOT::Minuit2::FunctionMinimum>& minis = ws.minis;
+	minis.clear();
+	double doffs = dMin, dx0Err = 0., doffserr = 0.;
 
+	if(bUseLM)
+	{
+		LMFitter<GaussModel>& lm = FitWorkspace::GetLM(ws.pLMGauss, gmod, 4, iLen, px, py, pdy);
+		lm.SetParam(0, dAmp);
+		lm.SetParam(1, dSpread);
+		lm.SetParam(2, dx0);
+		lm.SetParam(3, doffs);
+
+		lm.SetLowerLimit(1, 0.);
+		lm.SetLimits(2, dXMin, dXMax);
+		lm.SetLimits(3, dMin, dMax);
+		lm.Fit();
+
+		lm.RemoveLimits();
+		bValidFit = lm.Fit();
+
+		dAmp = lm.GetValue(0);
+		dSpread = lm.GetValue(1);
+		dx0 = lm.GetValue(2);
+		doffs = lm.GetValue(3);
+
+		dAmpErr = lm.GetError(0);
+		dSpreadErr = lm.GetError(1);
+		dx0Err = lm.GetError(2);
+		doffserr = lm.GetError(3);
+
+		tl::log_debug("Gauss LM fit: ", lm.GetNumIter(), " iterations, chi2 = ", lm.GetChi2());
+	}
+	else
 	{
-		// step 1: find amp & spread
-		//params.Fix("amp");
-		//params.Fix("spread");
-		params.Fix("x0");
-		params.Fix("offs");
+		ROOT::Minuit2::MnUserParameters params;
+		params.Add("amp", dAmp, dAmpErr);
+		params.Add("spread", dSpread, dSpreadErr);
+		params.Add("x0", dx0, 0.1*dx0);
+		params.Add("offs", dMin, 0.1*dMin);
 
-		ROOT::Minuit2::MnMigrad migrad(fkt, params, /*MINUIT_STRATEGY*/0);
-		ROOT::Minuit2::FunctionMinimum mini = migrad();
+		//params.SetLimits("amp", 0., dMax*(sqrt(2.*M_PI)*fabs(dSpread)));
+		params.SetLowerLimit("spread", 0.);
+		params.SetLimits("x0", dXMin, dXMax);
+		params.SetLimits("offs", dMin, dMax);
 
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
-		//if(bValidFit)
 		{
-			params.SetValue("spread", mini.UserState().Value("spread"));
-			params.SetError("spread", mini.UserState().Error("spread"));
+			// step 1: find amp & spread
+			//params.Fix("amp");
+			//params.Fix("spread");
+			params.Fix("x0");
+			params.Fix("offs");
 
-			params.SetValue("amp", mini.UserState().Value("amp"));
-			params.SetError("amp", mini.UserState().Error("amp"));
-		}
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/0);
 
-		minis.push_back(mini);
-	}
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
+			//if(bValidFit)
+			{
+				params.SetValue("spread", mini.UserState().Value("spread"));
+				params.SetError("spread", mini.UserState().Error("spread"));
 
-	{
-		// step 1.5: find amp & offs
-		params.Release("amp");
-		params.Release("offs");
-		params.Fix("spread");
-		params.Fix("x0");
+				params.SetValue("amp", mini.UserState().Value("amp"));
+				params.SetError("amp", mini.UserState().Error("amp"));
+			}
 
-		ROOT::Minuit2::MnMigrad migrad(fkt, params, /*MINUIT_STRATEGY*/0);
-		ROOT::Minuit2::FunctionMinimum mini = migrad();
+			minis.push_back(mini);
+		}
 
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
-		//if(bValidFit)
 		{
-			params.SetValue("amp", mini.UserState().Value("amp"));
-			params.SetError("amp", mini.UserState().Error("amp"));
+			// step 1.5: find amp & offs
+			params.Release("amp");
+			params.Release("offs");
+			params.Fix("spread");
+			params.Fix("x0");
 
-			params.SetValue("offs", mini.UserState().Value("offs"));
-			params.SetError("offs", mini.UserState().Error("offs"));
-		}
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/0);
 
-		minis.push_back(mini);
-	}
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
+			//if(bValidFit)
+			{
+				params.SetValue("amp", mini.UserState().Value("amp"));
+				params.SetError("amp", mini.UserState().Error("amp"));
 
-	{
-		// step 2: free fit (limited)
-		params.Release("amp");
-		params.Release("spread");
-		params.Release("x0");
-		params.Release("offs");
+				params.SetValue("offs", mini.UserState().Value("offs"));
+				params.SetError("offs", mini.UserState().Error("offs"));
+			}
 
-		ROOT::Minuit2::MnMigrad migrad2(fkt, params, /*MINUIT_STRATEGY*/1);
-		ROOT::Minuit2::FunctionMinimum mini2 = migrad2();
-		bValidFit = mini2.IsValid() && mini2.HasValidParameters();
+			minis.push_back(mini);
+		}
 
-		//if(bValidFit)
 		{
-			params.SetValue("amp", mini2.UserState().Value("amp"));
-			params.SetError("amp", mini2.UserState().Error("amp"));
+			// step 2: free fit (limited)
+			params.Release("amp");
+			params.Release("spread");
+			params.Release("x0");
+			params.Release("offs");
 
-			params.SetValue("spread", mini2.UserState().Value("spread"));
-			params.SetError("spread", mini2.UserState().Error("spread"));
+			ROOT::Minuit2::FunctionMinimum mini2 = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/1);
+			bValidFit = mini2.IsValid() && mini2.HasValidParameters();
 
-			params.SetValue("x0", mini2.UserState().Value("x0"));
-			params.SetError("x0", mini2.UserState().Error("x0"));
-		}
+			//if(bValidFit)
+			{
+				params.SetValue("amp", mini2.UserState().Value("amp"));
+				params.SetError("amp", mini2.UserState().Error("amp"));
 
-		minis.push_back(mini2);
-	}
+				params.SetValue("spread", mini2.UserState().Value("spread"));
+				params.SetError("spread", mini2.UserState().Error("spread"));
 
+				params.SetValue("x0", mini2.UserState().Value("x0"));
+				params.SetError("x0", mini2.UserState().Error("x0"));
+			}
 
-	{
-		// step 3: free fit (unlimited)
-		params.RemoveLimits("amp");
-		params.RemoveLimits("spread");
-		params.RemoveLimits("x0");
-		params.RemoveLimits("offs");
+			minis.push_back(mini2);
+		}
 
-		ROOT::Minuit2::MnMigrad migrad3(fkt, params, /*MINUIT_STRATEGY*/2);
-		ROOT::Minuit2::FunctionMinimum mini3 = migrad3();
-		bValidFit = mini3.IsValid() && mini3.HasValidParameters();
 
-		minis.push_back(mini3);
-	}
+		{
+			// step 3: free fit (unlimited)
+			params.RemoveLimits("amp");
+			params.RemoveLimits("spread");
+			params.RemoveLimits("x0");
+			params.RemoveLimits("offs");
+
+			ROOT::Minuit2::FunctionMinimum mini3 = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/2);
+			bValidFit = mini3.IsValid() && mini3.HasValidParameters();
+
+			minis.push_back(mini3);
+		}
 
 
-	const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
+		const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
 
 
-	dAmp = lastmini.UserState().Value("amp");
-	dSpread = lastmini.UserState().Value("spread");
-	dx0 = lastmini.UserState().Value("x0");
-	double doffs =lastmini.UserState().Value("offs");
+		dAmp = lastmini.UserState().Value("amp");
+		dSpread = lastmini.UserState().Value("spread");
+		dx0 = lastmini.UserState().Value("x0");
+		doffs = lastmini.UserState().Value("offs");
 
-	dAmpErr = lastmini.UserState().Error("amp");
-	dSpreadErr = lastmini.UserState().Error("spread");
-	double dx0Err = lastmini.UserState().Error("x0");
-	double doffserr =lastmini.UserState().Error("offs");
+		dAmpErr = lastmini.UserState().Error("amp");
+		dSpreadErr = lastmini.UserState().Error("spread");
+		dx0Err = lastmini.UserState().Error("x0");
+		doffserr = lastmini.UserState().Error("offs");
+	}
 
 
 	dSpread = fabs(dSpread);
@@ -356,8 +431,9 @@ bool get_gauss(unsigned int iLen,
 	}
 
 
-	*pmodel = new GaussModel(dAmp, dSpread, dx0, dAmpErr, dSpreadErr, dx0Err, bNormalized, doffs, doffserr);
-	(*pmodel)->Normalize();
+	model = GaussModel(dAmp, dSpread, dx0, dAmpErr, dSpreadErr, dx0Err, bNormalized, doffs, doffserr);
+	model.Normalize();
+	ws.bHasModel = 1;
 
 	return bValidFit;
 }
@@ -508,31 +584,33 @@ bool MultiGaussModel::SetParams(const std::vector<double>& vecParams)
 
 double MultiGaussModel::operator()(double x) const
 {
-	double *dNorm = new double[m_vecParams.size()];
-
-	if(m_bNormalized)
-	{
-		for(unsigned int i=0; i<m_vecParams.size(); ++i)
-			dNorm[i] = 1./(sqrt(2.*M_PI*fabs(m_vecParams[i].m_spread)));
-	}
-	else
-	{
-		for(unsigned int i=0; i<m_vecParams.size(); ++i)
-			dNorm[i] = 1.;
-	}
-
 	double dRes = 0.;
 
 	for(unsigned int i=0; i<m_vecParams.size(); ++i)
-		dRes += m_vecParams[i].m_amp * dNorm[i]
+	{
+		double dNorm = 1.;
+		if(m_bNormalized)
+			dNorm = 1./(sqrt(2.*M_PI*fabs(m_vecParams[i].m_spread)));
+
+		dRes += m_vecParams[i].m_amp * dNorm
 		                 * exp(-0.5 * ((x-m_vecParams[i].m_x0)/m_vecParams[i].m_spread)*((x-m_vecParams[i].m_x0)/m_vecParams[i].m_spread));
+	}
 
 	dRes += m_offs;
-
-	delete[] dNorm;
 	return dRes;
 }
 
+// derivatives by amp_i, spread_i, x0_i of every peak, then offs;
+// each peak only depends on its own three parameters
+void MultiGaussModel::ParamGradient(double x, double *pdGrad) const
+{
+	for(unsigned int i=0; i<m_vecParams.size(); ++i)
+		gauss_param_gradient(x, m_vecParams[i].m_amp, m_vecParams[i].m_spread,
+			m_vecParams[i].m_x0, m_bNormalized, pdGrad + i*3);
+
+	pdGrad[m_vecParams.size()*3] = 1.;
+}
+
 tl::FitterFuncModel<double>* MultiGaussModel::copy() const
 {
 	return new MultiGaussModel(*this);
@@ -563,12 +641,25 @@ bool get_multigauss(unsigned int iLen,
 					const double *px, const double *py, const double *pdy,
 					MultiGaussModel **pmodel, unsigned int iNumGauss)
 {
-	std::vector<double> vecMaximaX;
-	std::vector<double> vecMaximaSize;
-	std::vector<double> vecMaximaWidth;
+	FitWorkspace ws;
+	MultiGaussModel model(iNumGauss);
 
-	const int iDegree = Settings::Get<int>("interpolation/spline_degree");
-	tl::find_peaks<double>(iLen, px, py, iDegree, vecMaximaX, vecMaximaSize, vecMaximaWidth);
+	bool bOk = get_multigauss(iLen, px, py, pdy, model, ws, iNumGauss);
+	*pmodel = ws.bHasModel ? new MultiGaussModel(model) : 0;
+	return bOk;
+}
+
+bool get_multigauss(unsigned int iLen,
+					const double *px, const double *py, const double *pdy,
+					MultiGaussModel& model, FitWorkspace& ws, unsigned int iNumGauss)
+{
+	ws.bHasModel = 0;
+
+	std::vector<double>& vecMaximaX = ws.vecMaximaX;
+	std::vector<double>& vecMaximaSize = ws.vecMaximaSize;
+	std::vector<double>& vecMaximaWidth = ws.vecMaximaWidth;
+
+	tl::find_peaks<double>(iLen, px, py, ws.iSplineDegree, vecMaximaX, vecMaximaSize, vecMaximaWidth);
 
 	if(vecMaximaX.size() < iNumGauss)
 		vecMaximaX.resize(iNumGauss);
@@ -578,8 +669,16 @@ bool get_multigauss(unsigned int iLen,
 		vecMaximaWidth.resize(iNumGauss);
 
 
-	MultiGaussModel gmod(iNumGauss);
+	// the result model doubles as the starting model, reset it to an unfitted state
+	MultiGaussModel& gmod = model;
+	gmod.m_vecParams.assign(iNumGauss, MultiGaussParams());
+	gmod.m_offs = gmod.m_offserr = 0.;
+	gmod.m_bNormalized = 0;
+
 	tl::Chi2Function<double> fkt(&gmod, iLen, px, py, pdy);
+	Chi2GradFunction<MultiGaussModel> fktgrad(&gmod, iLen, px, py, pdy);
+	const bool bUseGrad = (pdy != 0);
+	const bool bUseLM = use_lm_solver(gmod.GetModelName()) && iNumGauss*3 + 1 <= LM_MAX_PARAMS;
 
 	typedef std::pair<const double*, const double*> t_minmax;
 	//t_minmax minmax_x = boost::minmax_element(px, px+iLen);
@@ -595,124 +694,51 @@ bool get_multigauss(unsigned int iLen,
 		return 0;
 	}
 
-	ROOT::Minuit2::MnUserParameters params;
-
-	for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
-	{
-		std::ostringstream ostrAmp, ostrSpread, ostrX0;
-		ostrAmp << "amp_" << iGauss;
-		ostrSpread << "spread_" << iGauss;
-		ostrX0 << "x0_" << iGauss;
-
-		params.Add(ostrAmp.str(), vecMaximaSize[iGauss], vecMaximaSize[iGauss]/10.);
-		params.Add(ostrSpread.str(), HWHM2SIGMA*vecMaximaWidth[iGauss], HWHM2SIGMA*vecMaximaWidth[iGauss]/10.);
-		params.Add(ostrX0.str(), vecMaximaX[iGauss], vecMaximaX[iGauss]/10.);
-
-		params.SetLimits(ostrAmp.str(), dMin, dMax);
-		params.SetLowerLimit(ostrSpread.str(), 0.);
-	}
-
-	params.Add("offs", dMin, (dMax-dMin)/10.);
-	params.SetLimits("offs", dMin, dMax);
-
 	bool bValidFit=false;
-	std::vector<ROOT::Minuit2::FunctionMinimum> minis;
+	std::vector<ROOT::Minuit2::FunctionMinimum>& minis = ws.minis;
+	minis.clear();
+	std::vector<MultiGaussParams>& vecMultiParams = ws.vecMultiParams;
+	vecMultiParams.resize(iNumGauss);
+	double doffs = dMin, doffserr = 0.;
 
-	for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
+	if(bUseLM)
 	{
-		std::ostringstream ostrAmp, ostrSpread, ostrX0;
-		ostrAmp << "amp_" << iGauss;
-		ostrSpread << "spread_" << iGauss;
-		ostrX0 << "x0_" << iGauss;
-
-		// fix all other peaks
-		for(unsigned int iGaussOther=0; iGaussOther<iNumGauss; ++iGaussOther)
+		LMFitter<MultiGaussModel>& lm = FitWorkspace::GetLM(ws.pLMMultiGauss, gmod, iNumGauss*3 + 1, iLen, px, py, pdy);
+		for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
 		{
-			if(iGaussOther == iGauss)
-				continue;
-
-			std::ostringstream ostrAmpO, ostrSpreadO, ostrX0O;
-			ostrAmpO << "amp_" << iGaussOther;
-			ostrSpreadO << "spread_" << iGaussOther;
-			ostrX0O << "x0_" << iGaussOther;
+			lm.SetParam(iGauss*3 + 0, vecMaximaSize[iGauss]);
+			lm.SetParam(iGauss*3 + 1, HWHM2SIGMA*vecMaximaWidth[iGauss]);
+			lm.SetParam(iGauss*3 + 2, vecMaximaX[iGauss]);
 
-			params.Fix(ostrAmpO.str());
-			params.Fix(ostrSpreadO.str());
-			params.Fix(ostrX0O.str());
+			lm.SetLimits(iGauss*3 + 0, dMin, dMax);
+			lm.SetLowerLimit(iGauss*3 + 1, 0.);
 		}
+		lm.SetParam(iNumGauss*3, dMin);
+		lm.SetLimits(iNumGauss*3, dMin, dMax);
+		lm.Fit();
 
-		params.Release(ostrAmp.str());
-		params.Release(ostrSpread.str());
-		params.Fix(ostrX0.str());
-
-		params.Fix("offs");
-
-		ROOT::Minuit2::MnMigrad migrad(fkt, params, /*MINUIT_STRATEGY*/2);
-		ROOT::Minuit2::FunctionMinimum mini = migrad();
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
-
-		params.SetValue(ostrAmp.str(), mini.UserState().Value(ostrAmp.str()));
-		params.SetError(ostrAmp.str(), mini.UserState().Error(ostrAmp.str()));
+		lm.RemoveLimits();
+		bValidFit = lm.Fit();
 
-		params.SetValue(ostrSpread.str(), mini.UserState().Value(ostrSpread.str()));
-		params.SetError(ostrSpread.str(), mini.UserState().Error(ostrSpread.str()));
-
-		//params.SetValue(ostrX0.str(), mini.UserState().Value(ostrX0.str()));
-		//params.SetError(ostrX0.str(), mini.UserState().Error(ostrX0.str()));
-
-		//params.SetValue("offs", mini.UserState().Value("offs"));
-		//params.SetError("offs", mini.UserState().Error("offs"));
-
-		minis.push_back(mini);
-	}
-
-	
-	for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
-	{
-		std::ostringstream ostrAmp, ostrSpread, ostrX0;
-		ostrAmp << "amp_" << iGauss;
-		ostrSpread << "spread_" << iGauss;
-		ostrX0 << "x0_" << iGauss;
-
-		// fix all other peaks
-		for(unsigned int iGaussOther=0; iGaussOther<iNumGauss; ++iGaussOther)
+		for(unsigned int iPara=0; iPara<iNumGauss; ++iPara)
 		{
-			if(iGaussOther == iGauss)
-				continue;
-
-			std::ostringstream ostrAmpO, ostrSpreadO, ostrX0O;
-			ostrAmpO << "amp_" << iGaussOther;
-			ostrSpreadO << "spread_" << iGaussOther;
-			ostrX0O << "x0_" << iGaussOther;
+			vecMultiParams[iPara].m_amp = lm.GetValue(iPara*3 + 0);
+			vecMultiParams[iPara].m_spread = fabs(lm.GetValue(iPara*3 + 1));
+			vecMultiParams[iPara].m_x0 = lm.GetValue(iPara*3 + 2);
 
-			params.Fix(ostrAmpO.str());
-			params.Fix(ostrSpreadO.str());
-			params.Fix(ostrX0O.str());
+			vecMultiParams[iPara].m_amperr = fabs(lm.GetError(iPara*3 + 0));
+			vecMultiParams[iPara].m_spreaderr = fabs(lm.GetError(iPara*3 + 1));
+			vecMultiParams[iPara].m_x0err = fabs(lm.GetError(iPara*3 + 2));
 		}
+		doffs = lm.GetValue(iNumGauss*3);
+		doffserr = lm.GetError(iNumGauss*3);
 
-		params.Fix(ostrAmp.str());
-		params.Fix(ostrSpread.str());
-		params.Release(ostrX0.str());
-
-		params.Release("offs");
-
-		ROOT::Minuit2::MnMigrad migrad(fkt, params, /*MINUIT_STRATEGY*/2);
-		ROOT::Minuit2::FunctionMinimum mini = migrad();
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
-
-		params.SetValue(ostrX0.str(), mini.UserState().Value(ostrX0.str()));
-		params.SetError(ostrX0.str(), mini.UserState().Error(ostrX0.str()));
-
-		params.SetValue("offs", mini.UserState().Value("offs"));
-		params.SetError("offs", mini.UserState().Error("offs"));
-
-		minis.push_back(mini);
+		tl::log_debug("Multi-Gauss LM fit: ", lm.GetNumIter(), " iterations, chi2 = ", lm.GetChi2());
 	}
-
-
-	// release all parameters
-    //if(0)
+	else
 	{
+		ROOT::Minuit2::MnUserParameters params;
+
 		for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
 		{
 			std::ostringstream ostrAmp, ostrSpread, ostrX0;
@@ -720,16 +746,17 @@ bool get_multigauss(unsigned int iLen,
 			ostrSpread << "spread_" << iGauss;
 			ostrX0 << "x0_" << iGauss;
 
-			params.Release(ostrAmp.str());
-			params.Release(ostrSpread.str());
-			params.Release(ostrX0.str());
+			params.Add(ostrAmp.str(), vecMaximaSize[iGauss], vecMaximaSize[iGauss]/10.);
+			params.Add(ostrSpread.str(), HWHM2SIGMA*vecMaximaWidth[iGauss], HWHM2SIGMA*vecMaximaWidth[iGauss]/10.);
+			params.Add(ostrX0.str(), vecMaximaX[iGauss], vecMaximaX[iGauss]/10.);
 
-			params.Release("offs");
+			params.SetLimits(ostrAmp.str(), dMin, dMax);
+			params.SetLowerLimit(ostrSpread.str(), 0.);
 		}
 
-		ROOT::Minuit2::MnMigrad migrad(fkt, params, /*MINUIT_STRATEGY*/2);
-		ROOT::Minuit2::FunctionMinimum mini = migrad();
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
+		params.Add("offs", dMin, (dMax-dMin)/10.);
+		params.SetLimits("offs", dMin, dMax);
+
 
 		for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
 		{
@@ -738,26 +765,47 @@ bool get_multigauss(unsigned int iLen,
 			ostrSpread << "spread_" << iGauss;
 			ostrX0 << "x0_" << iGauss;
 
+			// fix all other peaks
+			for(unsigned int iGaussOther=0; iGaussOther<iNumGauss; ++iGaussOther)
+			{
+				if(iGaussOther == iGauss)
+					continue;
+
+				std::ostringstream ostrAmpO, ostrSpreadO, ostrX0O;
+				ostrAmpO << "amp_" << iGaussOther;
+				ostrSpreadO << "spread_" << iGaussOther;
+				ostrX0O << "x0_" << iGaussOther;
+
+				params.Fix(ostrAmpO.str());
+				params.Fix(ostrSpreadO.str());
+				params.Fix(ostrX0O.str());
+			}
+
+			params.Release(ostrAmp.str());
+			params.Release(ostrSpread.str());
+			params.Fix(ostrX0.str());
+
+			params.Fix("offs");
+
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/2);
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
+
 			params.SetValue(ostrAmp.str(), mini.UserState().Value(ostrAmp.str()));
 			params.SetError(ostrAmp.str(), mini.UserState().Error(ostrAmp.str()));
 
 			params.SetValue(ostrSpread.str(), mini.UserState().Value(ostrSpread.str()));
 			params.SetError(ostrSpread.str(), mini.UserState().Error(ostrSpread.str()));
 
-			params.SetValue(ostrX0.str(), mini.UserState().Value(ostrX0.str()));
-			params.SetError(ostrX0.str(), mini.UserState().Error(ostrX0.str()));
-		}
-
-		params.SetValue("offs", mini.UserState().Value("offs"));
-		params.SetError("offs", mini.UserState().Error("offs"));
+			//params.SetValue(ostrX0.str(), mini.UserState().Value(ostrX0.str()));
+			//params.SetError(ostrX0.str(), mini.UserState().Error(ostrX0.str()));
 
-		minis.push_back(mini);
-	}
+			//params.SetValue("offs", mini.UserState().Value("offs"));
+			//params.SetError("offs", mini.UserState().Error("offs"));
 
+			minis.push_back(mini);
+		}
 
-	// release all limits
-    //if(0)
-	{
+	
 		for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
 		{
 			std::ostringstream ostrAmp, ostrSpread, ostrX0;
@@ -765,70 +813,156 @@ bool get_multigauss(unsigned int iLen,
 			ostrSpread << "spread_" << iGauss;
 			ostrX0 << "x0_" << iGauss;
 
-			params.RemoveLimits(ostrAmp.str());
-			params.RemoveLimits(ostrSpread.str());
-			params.RemoveLimits(ostrX0.str());
-		}
-		params.RemoveLimits("offs");
+			// fix all other peaks
+			for(unsigned int iGaussOther=0; iGaussOther<iNumGauss; ++iGaussOther)
+			{
+				if(iGaussOther == iGauss)
+					continue;
 
+				std::ostringstream ostrAmpO, ostrSpreadO, ostrX0O;
+				ostrAmpO << "amp_" << iGaussOther;
+				ostrSpreadO << "spread_" << iGaussOther;
+				ostrX0O << "x0_" << iGaussOther;
 
-		ROOT::Minuit2::MnMigrad migrad(fkt, params, /*MINUIT_STRATEGY*/2);
-		ROOT::Minuit2::FunctionMinimum mini = migrad();
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
+				params.Fix(ostrAmpO.str());
+				params.Fix(ostrSpreadO.str());
+				params.Fix(ostrX0O.str());
+			}
 
-		for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
-		{
-			std::ostringstream ostrAmp, ostrSpread, ostrX0;
-			ostrAmp << "amp_" << iGauss;
-			ostrSpread << "spread_" << iGauss;
-			ostrX0 << "x0_" << iGauss;
+			params.Fix(ostrAmp.str());
+			params.Fix(ostrSpread.str());
+			params.Release(ostrX0.str());
 
-			params.SetValue(ostrAmp.str(), mini.UserState().Value(ostrAmp.str()));
-			params.SetError(ostrAmp.str(), mini.UserState().Error(ostrAmp.str()));
+			params.Release("offs");
 
-			params.SetValue(ostrSpread.str(), mini.UserState().Value(ostrSpread.str()));
-			params.SetError(ostrSpread.str(), mini.UserState().Error(ostrSpread.str()));
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/2);
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
 
 			params.SetValue(ostrX0.str(), mini.UserState().Value(ostrX0.str()));
 			params.SetError(ostrX0.str(), mini.UserState().Error(ostrX0.str()));
+
+			params.SetValue("offs", mini.UserState().Value("offs"));
+			params.SetError("offs", mini.UserState().Error("offs"));
+
+			minis.push_back(mini);
 		}
 
-		params.SetValue("offs", mini.UserState().Value("offs"));
-		params.SetError("offs", mini.UserState().Error("offs"));
 
-		minis.push_back(mini);
-	}
+		// release all parameters
+	    //if(0)
+		{
+			for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
+			{
+				std::ostringstream ostrAmp, ostrSpread, ostrX0;
+				ostrAmp << "amp_" << iGauss;
+				ostrSpread << "spread_" << iGauss;
+				ostrX0 << "x0_" << iGauss;
 
-	const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
+				params.Release(ostrAmp.str());
+				params.Release(ostrSpread.str());
+				params.Release(ostrX0.str());
 
+				params.Release("offs");
+			}
 
-	std::vector<MultiGaussParams> vecMultiParams;
-	vecMultiParams.resize(iNumGauss);
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/2);
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
 
-	for(unsigned int iPara=0; iPara<iNumGauss; ++iPara)
-	{
-		std::ostringstream ostrPara;
-		ostrPara << iPara;
-		std::string strPara = ostrPara.str();
+			for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
+			{
+				std::ostringstream ostrAmp, ostrSpread, ostrX0;
+				ostrAmp << "amp_" << iGauss;
+				ostrSpread << "spread_" << iGauss;
+				ostrX0 << "x0_" << iGauss;
+
+				params.SetValue(ostrAmp.str(), mini.UserState().Value(ostrAmp.str()));
+				params.SetError(ostrAmp.str(), mini.UserState().Error(ostrAmp.str()));
+
+				params.SetValue(ostrSpread.str(), mini.UserState().Value(ostrSpread.str()));
+				params.SetError(ostrSpread.str(), mini.UserState().Error(ostrSpread.str()));
+
+				params.SetValue(ostrX0.str(), mini.UserState().Value(ostrX0.str()));
+				params.SetError(ostrX0.str(), mini.UserState().Error(ostrX0.str()));
+			}
+
+			params.SetValue("offs", mini.UserState().Value("offs"));
+			params.SetError("offs", mini.UserState().Error("offs"));
 
-		vecMultiParams[iPara].m_amp = lastmini.UserState().Value("amp_" + strPara);
-		vecMultiParams[iPara].m_spread = lastmini.UserState().Value("spread_" + strPara);
-		vecMultiParams[iPara].m_x0 = lastmini.UserState().Value("x0_" + strPara);
+			minis.push_back(mini);
+		}
+
+
+		// release all limits
+	    //if(0)
+		{
+			for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
+			{
+				std::ostringstream ostrAmp, ostrSpread, ostrX0;
+				ostrAmp << "amp_" << iGauss;
+				ostrSpread << "spread_" << iGauss;
+				ostrX0 << "x0_" << iGauss;
+
+				params.RemoveLimits(ostrAmp.str());
+				params.RemoveLimits(ostrSpread.str());
+				params.RemoveLimits(ostrX0.str());
+			}
+			params.RemoveLimits("offs");
+
+
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/2);
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
+
+			for(unsigned int iGauss=0; iGauss<iNumGauss; ++iGauss)
+			{
+				std::ostringstream ostrAmp, ostrSpread, ostrX0;
+				ostrAmp << "amp_" << iGauss;
+				ostrSpread << "spread_" << iGauss;
+				ostrX0 << "x0_" << iGauss;
+
+				params.SetValue(ostrAmp.str(), mini.UserState().Value(ostrAmp.str()));
+				params.SetError(ostrAmp.str(), mini.UserState().Error(ostrAmp.str()));
+
+				params.SetValue(ostrSpread.str(), mini.UserState().Value(ostrSpread.str()));
+				params.SetError(ostrSpread.str(), mini.UserState().Error(ostrSpread.str()));
+
+				params.SetValue(ostrX0.str(), mini.UserState().Value(ostrX0.str()));
+				params.SetError(ostrX0.str(), mini.UserState().Error(ostrX0.str()));
+			}
 
-		vecMultiParams[iPara].m_amperr = lastmini.UserState().Error("amp_" + strPara);
-		vecMultiParams[iPara].m_spreaderr = lastmini.UserState().Error("spread_" + strPara);
-		vecMultiParams[iPara].m_x0err = lastmini.UserState().Error("x0_" + strPara);
+			params.SetValue("offs", mini.UserState().Value("offs"));
+			params.SetError("offs", mini.UserState().Error("offs"));
+
+			minis.push_back(mini);
+		}
+
+		const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
 
+		for(unsigned int iPara=0; iPara<iNumGauss; ++iPara)
+		{
+			std::ostringstream ostrPara;
+			ostrPara << iPara;
+			std::string strPara = ostrPara.str();
 
-		vecMultiParams[iPara].m_spread = fabs(vecMultiParams[iPara].m_spread);
+			vecMultiParams[iPara].m_amp = lastmini.UserState().Value("amp_" + strPara);
+			vecMultiParams[iPara].m_spread = lastmini.UserState().Value("spread_" + strPara);
+			vecMultiParams[iPara].m_x0 = lastmini.UserState().Value("x0_" + strPara);
+
+			vecMultiParams[iPara].m_amperr = lastmini.UserState().Error("amp_" + strPara);
+			vecMultiParams[iPara].m_spreaderr = lastmini.UserState().Error("spread_" + strPara);
+			vecMultiParams[iPara].m_x0err = lastmini.UserState().Error("x0_" + strPara);
+
+
+			vecMultiParams[iPara].m_spread = fabs(vecMultiParams[iPara].m_spread);
+
+			vecMultiParams[iPara].m_amperr = fabs(vecMultiParams[iPara].m_amperr);
+			vecMultiParams[iPara].m_spreaderr = fabs(vecMultiParams[iPara].m_spreaderr);
+			vecMultiParams[iPara].m_x0err = fabs(vecMultiParams[iPara].m_x0err);
+		}
 
-		vecMultiParams[iPara].m_amperr = fabs(vecMultiParams[iPara].m_amperr);
-		vecMultiParams[iPara].m_spreaderr = fabs(vecMultiParams[iPara].m_spreaderr);
-		vecMultiParams[iPara].m_x0err = fabs(vecMultiParams[iPara].m_x0err);
+		doffs =lastmini.UserState().Value("offs");
+		doffserr =lastmini.UserState().Error("offs");
 	}
 
-	double doffs =lastmini.UserState().Value("offs");
-	double doffserr =lastmini.UserState().Error("offs");
 	bool bNormalized = gmod.IsNormalized();
 
 
@@ -846,12 +980,12 @@ bool get_multigauss(unsigned int iLen,
 	}
 
 
-	*pmodel = new MultiGaussModel(gmod);
-	(*pmodel)->m_vecParams = vecMultiParams;
-	(*pmodel)->m_offs = doffs;
-	(*pmodel)->m_offserr = doffserr;
-	(*pmodel)->m_bNormalized = bNormalized;
-	(*pmodel)->Normalize();
+	model.m_vecParams = vecMultiParams;
+	model.m_offs = doffs;
+	model.m_offserr = doffserr;
+	model.m_bNormalized = bNormalized;
+	model.Normalize();
+	ws.bHasModel = 1;
 
 	return bValidFit;
 }
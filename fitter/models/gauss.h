@@ -12,6 +12,9 @@
 #include "tlibs/fit/minuit.h"
 
 
+struct FitWorkspace;
+
+
 // gauss model
 class GaussModel : public tl::FitterFuncModel<double>
 {
@@ -30,6 +33,7 @@ class GaussModel : public tl::FitterFuncModel<double>
 
 		virtual bool SetParams(const std::vector<double>& vecParams);
 		virtual double operator()(double x) const;
+		virtual void ParamGradient(double x, double *pdGrad) const;
 		virtual tl::FitterFuncModel<double>* copy() const;
 		virtual std::string print(bool bFillInSyms=true) const;
 
@@ -85,6 +89,7 @@ class MultiGaussModel : public tl::FitterFuncModel<double>
 
 		virtual bool SetParams(const std::vector<double>& vecParams);
 		virtual double operator()(double x) const;
+		virtual void ParamGradient(double x, double *pdGrad) const;
 		virtual tl::FitterFuncModel<double>* copy() const;
 		virtual std::string print(bool bFillInSyms=true) const;
 
@@ -114,7 +119,7 @@ class MultiGaussModel : public tl::FitterFuncModel<double>
 
 		friend bool get_multigauss(unsigned int iLen,
 				const double *px, const double *py, const double *pdy,
-				MultiGaussModel **pmodel, unsigned int iNumGauss);
+				MultiGaussModel& model, FitWorkspace& ws, unsigned int iNumGauss);
 };
 
 
@@ -126,4 +131,13 @@ extern bool get_multigauss(unsigned int iLen,
 					const double *px, const double *py, const double *pdy,
 					MultiGaussModel **pmodel, unsigned int iNumGauss=2);
 
+// for repeated fits: reuse the buffers in ws and write the result into model
+extern bool get_gauss(unsigned int iLen,
+					const double *px, const double *py, const double *pdy,
+					GaussModel& model, FitWorkspace& ws);
+
+extern bool get_multigauss(unsigned int iLen,
+					const double *px, const double *py, const double *pdy,
+					MultiGaussModel& model, FitWorkspace& ws, unsigned int iNumGauss=2);
+
 #endif
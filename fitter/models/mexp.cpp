@@ -22,6 +22,8 @@
 #include <Minuit2/MnPrint.h>
 
 #include "mexp.h"
+#include "chi2grad.h"
+#include "fitter/lm.h"
 #include "tlibs/helper/misc.h"
 #include "tlibs/phys/units.h"
 
@@ -62,6 +64,15 @@ double MiezeExpModel::operator()(double dTau) const
 	return m_dP0 * std::exp(-m_dGamma * dTau / s_dhbar);
 }
 
+// derivatives by P0, Gamma
+void MiezeExpModel::ParamGradient(double dTau, double *pdGrad) const
+{
+	const double dExp = std::exp(-m_dGamma * dTau / s_dhbar);
+
+	pdGrad[0] = dExp;
+	pdGrad[1] = -m_dP0 * dTau / s_dhbar * dExp;
+}
+
 tl::FitterFuncModel<double>* MiezeExpModel::copy() const
 {
 	return new MiezeExpModel(m_dP0, m_dGamma, m_dP0Err, m_dGammaErr);
@@ -102,6 +113,9 @@ bool get_mieze_gamma(unsigned int iLen,
 
 	MiezeExpModel expmod{};
 	tl::Chi2Function<double> fkt(&expmod, iLen, px, py, pdy);
+	Chi2GradFunction<MiezeExpModel> fktgrad(&expmod, iLen, px, py, pdy);
+	const bool bUseGrad = (pdy != 0);
+	const bool bUseLM = use_lm_solver(expmod.GetModelName());
 
 
 	typedef std::pair<const double*, const double*> t_minmax;
@@ -116,83 +130,105 @@ bool get_mieze_gamma(unsigned int iLen,
 	double dP0 = 1.;
 	double dGamma = MiezeExpModel::s_dhbar / (dMax-dMin);
 
-	ROOT::Minuit2::MnUserParameters params;
-	params.Add("P0", dP0, 0.25*dP0);
-	params.Add("Gamma", dGamma, 0.25*dGamma);
-
-	params.SetLimits("P0", 0., 1.);
-	params.SetLowerLimit("Gamma", 0.);
-
-	if(bFixP0)
-	{
-		params.SetValue("P0", 1.);
-		params.SetError("P0", 0.);
-		params.Fix("P0");
-	}
-
 	bool bValidFit = false;
 	std::vector<ROOT::Minuit2::FunctionMinimum> minis;
 	minis.reserve(4);
+	double dP0Err = 0., dGammaErr = 0.;
 
-	if(!bFixP0)
+	if(bUseLM)
 	{
-		// get P0
-		params.Fix("Gamma");
+		LMFitter<MiezeExpModel> lm(expmod, 2, iLen, px, py, pdy);
+		lm.SetParam(0, bFixP0 ? 1. : dP0);
+		lm.SetParam(1, dGamma);
+		lm.Fix(0, bFixP0);
 
-		ROOT::Minuit2::MnMigrad migrad(fkt, params, /*MINUIT_STRATEGY*/ 0);
-		//migrad.SetPrecision(std::numeric_limits<double>::epsilon());
-		ROOT::Minuit2::FunctionMinimum mini = migrad();
+		lm.SetLimits(0, 0., 1.);
+		lm.SetLowerLimit(1, 0.);
+		lm.Fit();
 
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
-		//if(bValidFit)
-		{
-			params.SetValue("P0", mini.UserState().Value("P0"));
-			params.SetError("P0", mini.UserState().Error("P0"));
-		}
+		lm.RemoveLimits();
+		bValidFit = lm.Fit();
 
-		minis.push_back(mini);
-	}
+		dP0 = lm.GetValue(0);
+		dGamma = lm.GetValue(1);
 
+		dP0Err = lm.GetError(0);
+		dGammaErr = lm.GetError(1);
+
+		tl::log_debug("MIEZE exponential LM fit: ", lm.GetNumIter(), " iterations, chi2 = ", lm.GetChi2());
+	}
+	else
 	{
-		// free fit (limited)
-		params.Release("Gamma");
+		ROOT::Minuit2::MnUserParameters params;
+		params.Add("P0", dP0, 0.25*dP0);
+		params.Add("Gamma", dGamma, 0.25*dGamma);
+
+		params.SetLimits("P0", 0., 1.);
+		params.SetLowerLimit("Gamma", 0.);
 
-		ROOT::Minuit2::MnMigrad migrad3(fkt, params, /*MINUIT_STRATEGY*/1);
-		ROOT::Minuit2::FunctionMinimum mini3 = migrad3();
-		bValidFit = mini3.IsValid() && mini3.HasValidParameters();
-		//if(bValidFit)
+		if(bFixP0)
 		{
-			params.SetValue("P0", mini3.UserState().Value("P0"));
-			params.SetError("P0", mini3.UserState().Error("P0"));
+			params.SetValue("P0", 1.);
+			params.SetError("P0", 0.);
+			params.Fix("P0");
+		}
+
+		if(!bFixP0)
+		{
+			// get P0
+			params.Fix("Gamma");
+
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/ 0);
 
-			params.SetValue("Gamma", mini3.UserState().Value("Gamma"));
-			params.SetError("Gamma", mini3.UserState().Error("Gamma"));
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
+			//if(bValidFit)
+			{
+				params.SetValue("P0", mini.UserState().Value("P0"));
+				params.SetError("P0", mini.UserState().Error("P0"));
+			}
+
+			minis.push_back(mini);
 		}
 
-		minis.push_back(mini3);
-	}
+		{
+			// free fit (limited)
+			params.Release("Gamma");
 
+			ROOT::Minuit2::FunctionMinimum mini3 = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/1);
+			bValidFit = mini3.IsValid() && mini3.HasValidParameters();
+			//if(bValidFit)
+			{
+				params.SetValue("P0", mini3.UserState().Value("P0"));
+				params.SetError("P0", mini3.UserState().Error("P0"));
 
-	{
-		// free fit (unlimited)
-		params.RemoveLimits("P0");
-		params.RemoveLimits("Gamma");
+				params.SetValue("Gamma", mini3.UserState().Value("Gamma"));
+				params.SetError("Gamma", mini3.UserState().Error("Gamma"));
+			}
 
-		ROOT::Minuit2::MnMigrad migrad4(fkt, params, /*MINUIT_STRATEGY*/2);
-		ROOT::Minuit2::FunctionMinimum mini4 = migrad4();
-		bValidFit = mini4.IsValid() && mini4.HasValidParameters();
+			minis.push_back(mini3);
+		}
 
-		minis.push_back(mini4);
-	}
 
+		{
+			// free fit (unlimited)
+			params.RemoveLimits("P0");
+			params.RemoveLimits("Gamma");
+
+			ROOT::Minuit2::FunctionMinimum mini4 = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/2);
+			bValidFit = mini4.IsValid() && mini4.HasValidParameters();
+
+			minis.push_back(mini4);
+		}
 
-	const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
 
-	dP0 = lastmini.UserState().Value("P0");
-	dGamma = lastmini.UserState().Value("Gamma");
+		const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
 
-	double dP0Err = lastmini.UserState().Error("P0");
-	double dGammaErr = lastmini.UserState().Error("Gamma");
+		dP0 = lastmini.UserState().Value("P0");
+		dGamma = lastmini.UserState().Value("Gamma");
+
+		dP0Err = lastmini.UserState().Error("P0");
+		dGammaErr = lastmini.UserState().Error("Gamma");
+	}
 
 	dP0Err = fabs(dP0Err);
 	dGammaErr = fabs(dGammaErr);
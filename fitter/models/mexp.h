@@ -28,6 +28,7 @@ class MiezeExpModel : public tl::FitterFuncModel<double>
 
 		virtual bool SetParams(const std::vector<double>& vecParams);
 		virtual double operator()(double x) const;
+		virtual void ParamGradient(double x, double *pdGrad) const;
 		virtual tl::FitterFuncModel<double>* copy() const;
 		virtual std::string print(bool bFillInSyms=true) const;
 
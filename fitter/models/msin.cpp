@@ -22,8 +22,11 @@
 #include <Minuit2/MnPrint.h>
 
 #include "msin.h"
+#include "chi2grad.h"
+#include "fitter/lm.h"
 #include "tlibs/helper/misc.h"
 #include "helper/mfourier.h"
+#include "workspace.h"
 
 
 //----------------------------------------------------------------------
@@ -68,6 +71,17 @@ double MiezeSinModel::operator()(double x) const
 	return m_damp*sin(m_dfreq*x + m_dphase) + m_doffs;
 }
 
+// derivatives by amp, phase, offs; wrapping the phase by 2*pi changes neither
+// the function nor its derivatives, so the limited phase range needs no special care
+void MiezeSinModel::ParamGradient(double x, double *pdGrad) const
+{
+	const double dArg = m_dfreq*x + m_dphase;
+
+	pdGrad[0] = sin(dArg);
+	pdGrad[1] = m_damp*cos(dArg);
+	pdGrad[2] = 1.;
+}
+
 tl::FitterFuncModel<double>* MiezeSinModel::copy() const
 {
 	return new MiezeSinModel(m_dfreq, m_damp, m_dphase, m_doffs,
@@ -111,6 +125,20 @@ bool get_mieze_contrast(double& dFreq, double& dNumOsc, unsigned int iLen,
 					const double* px, const double* py, const double *pdy,
 					MiezeSinModel** pmodel)
 {
+	FitWorkspace ws;
+	MiezeSinModel model;
+
+	bool bOk = get_mieze_contrast(dFreq, dNumOsc, iLen, px, py, pdy, model, ws);
+	*pmodel = ws.bHasModel ? new MiezeSinModel(model) : 0;
+	return bOk;
+}
+
+bool get_mieze_contrast(double& dFreq, double& dNumOsc, unsigned int iLen,
+					const double* px, const double* py, const double *pdy,
+					MiezeSinModel& model, FitWorkspace& ws)
+{
+	ws.bHasModel = 0;
+
 	/*std::ofstream ofstrDbg("/tmp/msin_dbg.dat");
 	for(unsigned int iDbg=0; iDbg<iLen; ++iDbg)
 		ofstrDbg << px[iDbg] << " " << py[iDbg] << " " << pdy[iDbg] << "\n";
@@ -123,7 +151,6 @@ bool get_mieze_contrast(double& dFreq, double& dNumOsc, unsigned int iLen,
 		dNumOsc = 2.;
 	}
 
-	double* pdx_predef = 0;
 	if(dFreq < 0.)
 	{
 		dFreq = 2.*M_PI/double(iLen) * dNumOsc;
@@ -134,17 +161,16 @@ bool get_mieze_contrast(double& dFreq, double& dNumOsc, unsigned int iLen,
 
 	if(!px)
 	{
-		pdx_predef = new double[iLen];
-		for(unsigned int iIdx=0; iIdx<iLen; ++iIdx)
-			pdx_predef[iIdx] = iIdx;
-
-		px = pdx_predef;
+		px = ws.GetPredefX(iLen);
 
 		tl::log_warn("Using predefined x values.");
 	}
 
 	MiezeSinModel sinmod(dFreq);
 	tl::Chi2Function<double> fkt(&sinmod, iLen, px, py, pdy);
+	Chi2GradFunction<MiezeSinModel> fktgrad(&sinmod, iLen, px, py, pdy);
+	const bool bUseGrad = (pdy != 0);
+	const bool bUseLM = use_lm_solver(sinmod.GetModelName());
 
 
 	typedef std::pair<const double*, const double*> t_minmax;
@@ -163,8 +189,7 @@ bool get_mieze_contrast(double& dFreq, double& dNumOsc, unsigned int iLen,
 	double dPhase = 0.;
 	double dContrast_tmp = 0.;
 
-	MFourier fourier(iLen);
-	fourier.get_contrast(dNumOsc, py, dContrast_tmp, dPhase);
+	ws.GetFourier(iLen).get_contrast(dNumOsc, py, dContrast_tmp, dPhase);
 
 	// shift phase half a bin for correct alignment with mcstas data
 	dPhase -= 0.5/double(iLen) * 2.*M_PI * dNumOsc;
@@ -178,106 +203,131 @@ bool get_mieze_contrast(double& dFreq, double& dNumOsc, unsigned int iLen,
 
 	//std::cerr << "hints: amp=" << dAmp << ", phase=" << dPhase << ", offs=" << dOffs << std::endl;
 
-	ROOT::Minuit2::MnUserParameters params;
-	params.Add("amp", dAmp, 0.1*dAmp);
-	params.Add("phase", dPhase, 0.1*M_PI);
-	params.Add("offs", dOffs, 0.1*dOffs);
-
-	params.SetLimits("amp", 0., dMax);
-	params.SetLimits("phase", -M_PI, M_PI);
-	params.SetLimits("offs", dMin, dMax);
-
 	bool bValidFit = false;
-	std::vector<ROOT::Minuit2::FunctionMinimum> minis;
-	minis.reserve(4);
+	std::vector<ROOT::Minuit2::FunctionMinimum>& minis = ws.minis;
+	minis.clear();
+	double dAmpErr = 0., dPhaseErr = 0., dOffsErr = 0.;
 
+	if(bUseLM)
 	{
-		// first step: get phase
-		params.Fix("amp");
-		params.Fix("offs");
+		// limited, then unlimited fit, as in the last two Minuit steps
+		LMFitter<MiezeSinModel>& lm = FitWorkspace::GetLM(ws.pLMSin, sinmod, 3, iLen, px, py, pdy);
+		lm.SetParam(0, dAmp);
+		lm.SetParam(1, dPhase);
+		lm.SetParam(2, dOffs);
 
-		ROOT::Minuit2::MnMigrad migrad(fkt, params, /*MINUIT_STRATEGY*/ 0);
-		//migrad.SetPrecision(std::numeric_limits<double>::epsilon());
-		ROOT::Minuit2::FunctionMinimum mini = migrad();
+		lm.SetLimits(0, 0., dMax);
+		lm.SetLimits(1, -M_PI, M_PI);
+		lm.SetLimits(2, dMin, dMax);
+		lm.Fit();
 
-		bValidFit = mini.IsValid() && mini.HasValidParameters();
-		//if(bValidFit)
-		{
-			params.SetValue("phase", mini.UserState().Value("phase"));
-			params.SetError("phase", mini.UserState().Error("phase"));
-		}
+		lm.RemoveLimits();
+		bValidFit = lm.Fit();
 
-		minis.push_back(mini);
-	}
+		dAmp = lm.GetValue(0);
+		dPhase = lm.GetValue(1);
+		dOffs = lm.GetValue(2);
+
+		dAmpErr = lm.GetError(0);
+		dPhaseErr = lm.GetError(1);
+		dOffsErr = lm.GetError(2);
 
+		tl::log_debug("MIEZE sinus LM fit: ", lm.GetNumIter(), " iterations, chi2 = ", lm.GetChi2());
+	}
+	else
 	{
-		// second step: get amp & offs
-		params.Release("amp");
-		params.Release("offs");
-		params.Fix("phase");
+		ROOT::Minuit2::MnUserParameters params;
+		params.Add("amp", dAmp, 0.1*dAmp);
+		params.Add("phase", dPhase, 0.1*M_PI);
+		params.Add("offs", dOffs, 0.1*dOffs);
 
-		ROOT::Minuit2::MnMigrad migrad2(fkt, params, /*MINUIT_STRATEGY*/ 0);
-		ROOT::Minuit2::FunctionMinimum mini2 = migrad2();
+		params.SetLimits("amp", 0., dMax);
+		params.SetLimits("phase", -M_PI, M_PI);
+		params.SetLimits("offs", dMin, dMax);
 
-		bValidFit = mini2.IsValid() && mini2.HasValidParameters();
-		//if(bValidFit)
 		{
-			params.SetValue("amp", mini2.UserState().Value("amp"));
-			params.SetError("amp", mini2.UserState().Error("amp"));
+			// first step: get phase
+			params.Fix("amp");
+			params.Fix("offs");
 
-			params.SetValue("offs", mini2.UserState().Value("offs"));
-			params.SetError("offs", mini2.UserState().Error("offs"));
+			ROOT::Minuit2::FunctionMinimum mini = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/ 0);
+
+			bValidFit = mini.IsValid() && mini.HasValidParameters();
+			//if(bValidFit)
+			{
+				params.SetValue("phase", mini.UserState().Value("phase"));
+				params.SetError("phase", mini.UserState().Error("phase"));
+			}
+
+			minis.push_back(mini);
 		}
 
-		minis.push_back(mini2);
-	}
+		{
+			// second step: get amp & offs
+			params.Release("amp");
+			params.Release("offs");
+			params.Fix("phase");
 
+			ROOT::Minuit2::FunctionMinimum mini2 = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/ 0);
+
+			bValidFit = mini2.IsValid() && mini2.HasValidParameters();
+			//if(bValidFit)
+			{
+				params.SetValue("amp", mini2.UserState().Value("amp"));
+				params.SetError("amp", mini2.UserState().Error("amp"));
+
+				params.SetValue("offs", mini2.UserState().Value("offs"));
+				params.SetError("offs", mini2.UserState().Error("offs"));
+			}
+
+			minis.push_back(mini2);
+		}
 
-	{
-		// third step: free fit (limited)
-		params.Release("phase");
 
-		ROOT::Minuit2::MnMigrad migrad3(fkt, params, /*MINUIT_STRATEGY*/1);
-		ROOT::Minuit2::FunctionMinimum mini3 = migrad3();
-		bValidFit = mini3.IsValid() && mini3.HasValidParameters();
-		//if(bValidFit)
 		{
-			params.SetValue("amp", mini3.UserState().Value("amp"));
-			params.SetError("amp", mini3.UserState().Error("amp"));
+			// third step: free fit (limited)
+			params.Release("phase");
 
-			params.SetValue("offs", mini3.UserState().Value("offs"));
-			params.SetError("offs", mini3.UserState().Error("offs"));
+			ROOT::Minuit2::FunctionMinimum mini3 = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/1);
+			bValidFit = mini3.IsValid() && mini3.HasValidParameters();
+			//if(bValidFit)
+			{
+				params.SetValue("amp", mini3.UserState().Value("amp"));
+				params.SetError("amp", mini3.UserState().Error("amp"));
 
-			params.SetValue("phase", mini3.UserState().Value("phase"));
-			params.SetError("phase", mini3.UserState().Error("phase"));
-		}
+				params.SetValue("offs", mini3.UserState().Value("offs"));
+				params.SetError("offs", mini3.UserState().Error("offs"));
 
-		minis.push_back(mini3);
-	}
+				params.SetValue("phase", mini3.UserState().Value("phase"));
+				params.SetError("phase", mini3.UserState().Error("phase"));
+			}
 
+			minis.push_back(mini3);
+		}
 
-	{
-		// fourth step: free fit (unlimited)
-		params.RemoveLimits("amp");
-		params.RemoveLimits("offs");
-		params.RemoveLimits("phase");
 
-		ROOT::Minuit2::MnMigrad migrad4(fkt, params, /*MINUIT_STRATEGY*/2);
-		ROOT::Minuit2::FunctionMinimum mini4 = migrad4();
-		bValidFit = mini4.IsValid() && mini4.HasValidParameters();
+		{
+			// fourth step: free fit (unlimited)
+			params.RemoveLimits("amp");
+			params.RemoveLimits("offs");
+			params.RemoveLimits("phase");
 
-		minis.push_back(mini4);
-	}
+			ROOT::Minuit2::FunctionMinimum mini4 = chi2_migrad(fkt, fktgrad, bUseGrad, params, /*MINUIT_STRATEGY*/2);
+			bValidFit = mini4.IsValid() && mini4.HasValidParameters();
 
-	const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
+			minis.push_back(mini4);
+		}
+
+		const ROOT::Minuit2::FunctionMinimum& lastmini = *minis.rbegin();
 
-	dAmp = lastmini.UserState().Value("amp");
-	dPhase = lastmini.UserState().Value("phase");
-	dOffs = lastmini.UserState().Value("offs");
+		dAmp = lastmini.UserState().Value("amp");
+		dPhase = lastmini.UserState().Value("phase");
+		dOffs = lastmini.UserState().Value("offs");
 
-	double dAmpErr = lastmini.UserState().Error("amp");
-	double dPhaseErr = lastmini.UserState().Error("phase");
-	double dOffsErr = lastmini.UserState().Error("offs");
+		dAmpErr = lastmini.UserState().Error("amp");
+		dPhaseErr = lastmini.UserState().Error("phase");
+		dOffsErr = lastmini.UserState().Error("offs");
+	}
 
 	dAmpErr = fabs(dAmpErr);
 	dPhaseErr = fabs(dPhaseErr);
@@ -306,17 +356,16 @@ bool get_mieze_contrast(double& dFreq, double& dNumOsc, unsigned int iLen,
 		tl::log_info("values max: ", dMax, ", min: ", dMin, ", nchan=", iLen);
 	}
 
-	*pmodel = new MiezeSinModel(dFreq, dAmp, dPhase, dOffs,
-								0., dAmpErr, dPhaseErr, dOffsErr);
+	model = MiezeSinModel(dFreq, dAmp, dPhase, dOffs,
+						0., dAmpErr, dPhaseErr, dOffsErr);
+	ws.bHasModel = 1;
 
-	double dContrast = (*pmodel)->GetContrast();
-	double dContrastError = (*pmodel)->GetContrastErr();
+	double dContrast = model.GetContrast();
+	double dContrastError = model.GetContrastErr();
 
 	if (tl::is_nan_or_inf(dContrast) || tl::is_nan_or_inf(dContrastError) ||
 		tl::is_nan_or_inf(dPhase) || tl::is_nan_or_inf(dPhaseErr))
 		bValidFit = 0;
 
-	if(pdx_predef) delete[] pdx_predef;
-
 	return bValidFit;
 }
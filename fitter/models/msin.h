@@ -28,6 +28,7 @@ class MiezeSinModel : public tl::FitterFuncModel<double>
 
 		virtual bool SetParams(const std::vector<double>& vecParams);
 		virtual double operator()(double x) const;
+		virtual void ParamGradient(double x, double *pdGrad) const;
 		virtual tl::FitterFuncModel<double>* copy() const;
 		virtual std::string print(bool bFillInSyms=true) const;
 
@@ -56,4 +57,10 @@ bool get_mieze_contrast(double& dFreq, double& dNumOsc, unsigned int iLen,
 					const double* px, const double* py, const double *pdy,
 					MiezeSinModel** pmodel);
 
+// for repeated fits: reuses the buffers in ws and writes the result into model
+struct FitWorkspace;
+bool get_mieze_contrast(double& dFreq, double& dNumOsc, unsigned int iLen,
+					const double* px, const double* py, const double *pdy,
+					MiezeSinModel& model, FitWorkspace& ws);
+
 #endif
@@ -0,0 +1,43 @@
+/**
+ * reusable scratch space for many fits of the same kind, e.g. pixel-wise fits
+ *
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "workspace.h"
+#include "main/settings.h"
+
+
+FitWorkspace::FitWorkspace()
+	: iSplineDegree(Settings::Get<int>("interpolation/spline_degree"))
+{}
+
+FitWorkspace::~FitWorkspace()
+{}
+
+const double* FitWorkspace::GetPredefX(unsigned int iLen)
+{
+	if(vecXPredef.size() != iLen)
+	{
+		vecXPredef.resize(iLen);
+		for(unsigned int iIdx=0; iIdx<iLen; ++iIdx)
+			vecXPredef[iIdx] = iIdx;
+	}
+
+	return vecXPredef.data();
+}
+
+MFourier& FitWorkspace::GetFourier(unsigned int iLen)
+{
+	if(!pFourier || iFourierSize != iLen)
+	{
+		// free the old plan first, both need the planner lock
+		pFourier.reset();
+		pFourier.reset(new MFourier(iLen));
+		iFourierSize = iLen;
+	}
+
+	return *pFourier;
+}
@@ -0,0 +1,76 @@
+/**
+ * reusable scratch space for many fits of the same kind, e.g. pixel-wise fits
+ *
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __FIT_WORKSPACE__
+#define __FIT_WORKSPACE__
+
+#include <vector>
+#include <memory>
+
+#include <Minuit2/FunctionMinimum.h>
+
+#include "msin.h"
+#include "gauss.h"
+#include "fitter/lm.h"
+#include "helper/mfourier.h"
+
+
+/*
+ * everything get_mieze_contrast, get_gauss and get_multigauss would
+ * otherwise allocate per call; the buffers only grow, so after the first
+ * fit of a given size the lm solver path does not touch the heap anymore.
+ * a workspace must not be shared between threads.
+ */
+struct FitWorkspace
+{
+	// read once, not per fit
+	int iSplineDegree;
+
+	// x values 0..n-1 for data without an x axis
+	std::vector<double> vecXPredef;
+
+	// fft of the phase hints, re-planned only if the length changes
+	std::unique_ptr<MFourier> pFourier;
+	unsigned int iFourierSize = 0;
+
+	// peak hints
+	std::vector<double> vecMaximaX, vecMaximaSize, vecMaximaWidth;
+	std::vector<MultiGaussParams> vecMultiParams;
+
+	// steps of the last Minuit fit
+	std::vector<ROOT::Minuit2::FunctionMinimum> minis;
+
+	// whether the last fit got far enough to fill in the model
+	bool bHasModel = 0;
+
+	// lm solvers, created on first use
+	std::unique_ptr<LMFitter<MiezeSinModel>> pLMSin;
+	std::unique_ptr<LMFitter<GaussModel>> pLMGauss;
+	std::unique_ptr<LMFitter<MultiGaussModel>> pLMMultiGauss;
+
+
+	FitWorkspace();
+	~FitWorkspace();
+
+	const double* GetPredefX(unsigned int iLen);
+	MFourier& GetFourier(unsigned int iLen);
+
+	template<class t_model>
+	static LMFitter<t_model>& GetLM(std::unique_ptr<LMFitter<t_model>>& pLM,
+		const t_model& model, unsigned int iNumParams, unsigned int iLen,
+		const double *px, const double *py, const double *pdy)
+	{
+		if(pLM)
+			pLM->Reset(model, iNumParams, iLen, px, py, pdy);
+		else
+			pLM.reset(new LMFitter<t_model>(model, iNumParams, iLen, px, py, pdy));
+		return *pLM;
+	}
+};
+
+#endif
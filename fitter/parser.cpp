@@ -23,6 +23,8 @@ namespace fus = boost::fusion;
 #include <boost/math/special_functions/sign.hpp>
 
 #include <ctype.h>
+#include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <map>
@@ -34,11 +36,15 @@ namespace fus = boost::fusion;
 #include "tlibs/log/log.h"
 
 #ifdef USE_JIT
-	#include <llvm/ExecutionEngine/GenericValue.h>
-	#include <llvm/Support/ManagedStatic.h>
-	#include <llvm/Support/TargetSelect.h>
-	#include <llvm/IR/LegacyPassManager.h>
-	#include <llvm/LinkAllPasses.h>
+	#include <cstdio>
+	#include <cstdlib>
+	#include <fstream>
+	#include <limits>
+	#include <cerrno>
+	#include <dlfcn.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+	#include <sys/types.h>
 #endif
 
 
@@ -94,6 +100,26 @@ enum
 	NODE_DIV_INV
 };
 
+// instructions of the compiled program
+enum
+{
+	OP_CONST=1,
+	OP_FREE,
+	OP_SYM,
+
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_NEG,
+	OP_POW,
+	OP_SQR,
+
+	OP_CALL0,
+	OP_CALL1,
+	OP_CALL2
+};
+
 
 BOOST_FUSION_ADAPT_STRUCT
 (
@@ -164,6 +190,12 @@ static t_map_fkt2 g_map_fkt2 =
 	t_map_fkt2::value_type("rand_norm", tl::rand_norm<double>),
 	t_map_fkt2::value_type("rand_real", tl::rand_real<double>)
 };
+
+// functions which must not be evaluated at compile time
+static const std::unordered_map<std::string, bool> g_map_nonpure =
+{
+	{"rand01", 1}, {"rand_poisson", 1}, {"rand_norm", 1}, {"rand_real", 1}
+};
 //----------------------------------------
 
 static std::string get_op_name(int iOp)
@@ -958,17 +990,680 @@ static bool parse_expression(Node& node, std::vector<Symbol>& syms, const std::s
 }
 
 
+//======================================================================
+// symbolic differentiation
+
+static Node make_double(double dVal)
+{
+	Node node;
+	node.iType = NODE_DOUBLE;
+	node.dVal = dVal;
+	return node;
+}
+
+static Node make_op(int iType, const Node& node1)
+{
+	Node node;
+	node.iType = iType;
+	node.vecChildren.push_back(node1);
+	return node;
+}
+
+static Node make_op(int iType, const Node& node1, const Node& node2)
+{
+	Node node = make_op(iType, node1);
+	node.vecChildren.push_back(node2);
+	return node;
+}
+
+static Node make_call(const char* pcFkt, const Node& nodeArg)
+{
+	Node node = make_op(NODE_CALL, nodeArg);
+	node.strIdent = pcFkt;
+	return node;
+}
+
+static bool is_double(const Node& node, double dVal)
+{
+	return node.iType == NODE_DOUBLE && node.dVal == dVal;
+}
+
+/*
+ * removes terms that are zero or one, folds constant operands;
+ * keeps the derivative trees from growing with every application of the product rule
+ */
+static void simplify_node(Node& n)
+{
+	for(Node& child : n.vecChildren)
+		simplify_node(child);
+
+	std::vector<Node>& vecCh = n.vecChildren;
+
+	if(n.iType == NODE_PLUS || n.iType == NODE_MULT)
+	{
+		const bool bPlus = (n.iType == NODE_PLUS);
+		const double dNeutral = bPlus ? 0. : 1.;
+
+		double dConst = dNeutral;
+		std::vector<Node> vecNew;
+		for(const Node& child : vecCh)
+		{
+			if(child.iType == NODE_DOUBLE)
+				dConst = bPlus ? dConst+child.dVal : dConst*child.dVal;
+			else
+				vecNew.push_back(child);
+		}
+
+		if(!bPlus && dConst == 0.)
+			vecNew.clear();
+		if(dConst != dNeutral || vecNew.empty())
+			vecNew.insert(vecNew.begin(), make_double(dConst));
+
+		if(vecNew.size() == 1)
+		{
+			Node tmp = vecNew[0];
+			n = tmp;
+		}
+		else
+			vecCh = vecNew;
+	}
+	else if(n.iType == NODE_MINUS)
+	{
+		if(vecCh.size() == 1)
+		{
+			if(vecCh[0].iType == NODE_DOUBLE)
+				n = make_double(-vecCh[0].dVal);
+			return;
+		}
+
+		std::vector<Node> vecNew{vecCh[0]};
+		for(unsigned int i=1; i<vecCh.size(); ++i)
+			if(!is_double(vecCh[i], 0.))
+				vecNew.push_back(vecCh[i]);
+
+		if(vecNew.size() == 1)
+		{
+			Node tmp = vecNew[0];
+			n = tmp;
+		}
+		else if(is_double(vecNew[0], 0.) && vecNew.size() == 2)
+		{
+			Node tmp = make_op(NODE_MINUS, vecNew[1]);
+			n = tmp;
+			simplify_node(n);
+		}
+		else
+			vecCh = vecNew;
+	}
+	else if(n.iType == NODE_DIV)
+	{
+		if(is_double(vecCh[0], 0.))
+		{
+			n = make_double(0.);
+			return;
+		}
+
+		std::vector<Node> vecNew{vecCh[0]};
+		for(unsigned int i=1; i<vecCh.size(); ++i)
+			if(!is_double(vecCh[i], 1.))
+				vecNew.push_back(vecCh[i]);
+
+		if(vecNew.size() == 1)
+		{
+			Node tmp = vecNew[0];
+			n = tmp;
+		}
+		else
+			vecCh = vecNew;
+	}
+	else if(n.iType == NODE_POW && vecCh.size() == 2)
+	{
+		if(is_double(vecCh[1], 0.))
+			n = make_double(1.);
+		else if(is_double(vecCh[1], 1.))
+		{
+			Node tmp = vecCh[0];
+			n = tmp;
+		}
+		else if(vecCh[0].iType == NODE_DOUBLE && vecCh[1].iType == NODE_DOUBLE)
+			n = make_double(std::pow(vecCh[0].dVal, vecCh[1].dVal));
+	}
+}
+
+// derivatives of the functions in g_map_fkt1, u is the argument
+static bool diff_call1(const std::string& strFkt, const Node& u, Node& nodeRes)
+{
+	const Node one = make_double(1.);
+	const Node u2 = make_op(NODE_POW, u, make_double(2.));
+
+	if(strFkt == "sin") nodeRes = make_call("cos", u);
+	else if(strFkt == "cos") nodeRes = make_op(NODE_MINUS, make_call("sin", u));
+	else if(strFkt == "tan") nodeRes = make_op(NODE_DIV, one, make_op(NODE_POW, make_call("cos", u), make_double(2.)));
+	else if(strFkt == "asin") nodeRes = make_op(NODE_DIV, one, make_call("sqrt", make_op(NODE_MINUS, one, u2)));
+	else if(strFkt == "acos") nodeRes = make_op(NODE_MINUS, make_op(NODE_DIV, one, make_call("sqrt", make_op(NODE_MINUS, one, u2))));
+	else if(strFkt == "atan") nodeRes = make_op(NODE_DIV, one, make_op(NODE_PLUS, one, u2));
+	else if(strFkt == "sinh") nodeRes = make_call("cosh", u);
+	else if(strFkt == "cosh") nodeRes = make_call("sinh", u);
+	else if(strFkt == "tanh") nodeRes = make_op(NODE_MINUS, one, make_op(NODE_POW, make_call("tanh", u), make_double(2.)));
+	else if(strFkt == "asinh") nodeRes = make_op(NODE_DIV, one, make_call("sqrt", make_op(NODE_PLUS, u2, one)));
+	else if(strFkt == "acosh") nodeRes = make_op(NODE_DIV, one, make_call("sqrt", make_op(NODE_MINUS, u2, one)));
+	else if(strFkt == "atanh") nodeRes = make_op(NODE_DIV, one, make_op(NODE_MINUS, one, u2));
+	else if(strFkt == "exp") nodeRes = make_call("exp", u);
+	else if(strFkt == "log") nodeRes = make_op(NODE_DIV, one, u);
+	else if(strFkt == "log10") nodeRes = make_op(NODE_DIV, make_double(1./std::log(10.)), u);
+	else if(strFkt == "sqrt") nodeRes = make_op(NODE_DIV, make_double(0.5), make_call("sqrt", u));
+	else if(strFkt == "abs" || strFkt == "fabs") nodeRes = make_call("sign", u);
+	else if(strFkt == "erf") nodeRes = make_op(NODE_MULT, make_double(2./std::sqrt(M_PI)), make_call("exp", make_op(NODE_MINUS, u2)));
+	else if(strFkt == "erf_inv") nodeRes = make_op(NODE_MULT, make_double(std::sqrt(M_PI)/2.),
+		make_call("exp", make_op(NODE_POW, make_call("erf_inv", u), make_double(2.))));
+	// piecewise constant or random
+	else if(strFkt == "ceil" || strFkt == "floor" || strFkt == "round" ||
+		strFkt == "sign" || strFkt == "rand_poisson") nodeRes = make_double(0.);
+	else return false;
+
+	return true;
+}
+
+static bool diff_node(const Node& n, const std::string& strVar, Node& nodeRes);
+
+// d(u^v) for the sub-trees u and v
+static bool diff_pow(const Node& u, const Node& v, const std::string& strVar, Node& nodeRes)
+{
+	Node du, dv;
+	if(!diff_node(u, strVar, du) || !diff_node(v, strVar, dv))
+		return false;
+
+	if(is_double(dv, 0.))
+	{
+		// v * u^(v-1) * u'
+		nodeRes = make_op(NODE_MULT, v, make_op(NODE_POW, u, make_op(NODE_MINUS, v, make_double(1.))));
+		nodeRes.vecChildren.push_back(du);
+	}
+	else
+	{
+		// u^v * (v' * log(u) + v * u' / u)
+		Node nodeSum = make_op(NODE_PLUS,
+			make_op(NODE_MULT, dv, make_call("log", u)),
+			make_op(NODE_DIV, make_op(NODE_MULT, v, du), u));
+		nodeRes = make_op(NODE_MULT, make_op(NODE_POW, u, v), nodeSum);
+	}
+
+	simplify_node(nodeRes);
+	return true;
+}
+
+// derivative of a product of the given factors
+static bool diff_product(const std::vector<Node>& vecFact, const std::string& strVar, Node& nodeRes)
+{
+	nodeRes = Node();
+	nodeRes.iType = NODE_PLUS;
+
+	for(unsigned int i=0; i<vecFact.size(); ++i)
+	{
+		Node nodeDiff;
+		if(!diff_node(vecFact[i], strVar, nodeDiff))
+			return false;
+		if(is_double(nodeDiff, 0.))
+			continue;
+
+		Node nodeTerm;
+		nodeTerm.iType = NODE_MULT;
+		for(unsigned int j=0; j<vecFact.size(); ++j)
+			nodeTerm.vecChildren.push_back(i==j ? nodeDiff : vecFact[j]);
+		nodeRes.vecChildren.push_back(nodeTerm);
+	}
+
+	if(nodeRes.vecChildren.empty())
+		nodeRes = make_double(0.);
+	simplify_node(nodeRes);
+	return true;
+}
+
+/*
+ * derivative of the syntax tree with respect to the identifier strVar;
+ * all other identifiers are treated as constants
+ */
+static bool diff_node(const Node& n, const std::string& strVar, Node& nodeRes)
+{
+	const std::vector<Node>& vecCh = n.vecChildren;
+
+	if(n.iType == NODE_DOUBLE || n.iType == NODE_NOP)
+	{
+		nodeRes = make_double(0.);
+	}
+	else if(n.iType == NODE_IDENT)
+	{
+		nodeRes = make_double(n.strIdent == strVar ? 1. : 0.);
+	}
+	else if(n.iType == NODE_PLUS || n.iType == NODE_MINUS)
+	{
+		nodeRes = Node();
+		nodeRes.iType = n.iType;
+		for(const Node& child : vecCh)
+		{
+			Node nodeDiff;
+			if(!diff_node(child, strVar, nodeDiff))
+				return false;
+			nodeRes.vecChildren.push_back(nodeDiff);
+		}
+	}
+	else if(n.iType == NODE_MULT)
+	{
+		return diff_product(vecCh, strVar, nodeRes);
+	}
+	else if(n.iType == NODE_DIV)
+	{
+		if(vecCh.size() < 2)
+			return false;
+
+		// u / (v1*v2*...) => (u'*v - u*v') / v^2
+		const Node& u = vecCh[0];
+		Node v;
+		if(vecCh.size() == 2)
+			v = vecCh[1];
+		else
+		{
+			v.iType = NODE_MULT;
+			v.vecChildren.assign(vecCh.begin()+1, vecCh.end());
+		}
+
+		Node du, dv;
+		if(!diff_node(u, strVar, du))
+			return false;
+		if(!diff_node(v, strVar, dv))
+			return false;
+
+		if(is_double(dv, 0.))
+			nodeRes = make_op(NODE_DIV, du, v);
+		else
+			nodeRes = make_op(NODE_DIV,
+				make_op(NODE_MINUS, make_op(NODE_MULT, du, v), make_op(NODE_MULT, u, dv)),
+				make_op(NODE_POW, v, make_double(2.)));
+	}
+	else if(n.iType == NODE_POW)
+	{
+		if(vecCh.size() != 2)
+			return false;
+		return diff_pow(vecCh[0], vecCh[1], strVar, nodeRes);
+	}
+	else if(n.iType == NODE_CALL)
+	{
+		if(vecCh.size() == 0)
+		{
+			nodeRes = make_double(0.);
+		}
+		else if(vecCh.size() == 1)
+		{
+			Node du, dfkt;
+			if(!diff_node(vecCh[0], strVar, du))
+				return false;
+
+			if(is_double(du, 0.))
+				nodeRes = make_double(0.);
+			else if(diff_call1(n.strIdent, vecCh[0], dfkt))
+				nodeRes = make_op(NODE_MULT, dfkt, du);		// chain rule
+			else
+			{
+				tl::log_err("Cannot differentiate function \"", n.strIdent, "\".");
+				return false;
+			}
+		}
+		else if(vecCh.size() == 2)
+		{
+			const Node& u = vecCh[0];
+			const Node& v = vecCh[1];
+
+			if(n.strIdent == "pow")
+				return diff_pow(u, v, strVar, nodeRes);
+
+			Node du, dv;
+			if(!diff_node(u, strVar, du) || !diff_node(v, strVar, dv))
+				return false;
+
+			if(n.strIdent == "atan2")
+			{
+				// (v*u' - u*v') / (u^2 + v^2)
+				nodeRes = make_op(NODE_DIV,
+					make_op(NODE_MINUS, make_op(NODE_MULT, v, du), make_op(NODE_MULT, u, dv)),
+					make_op(NODE_PLUS, make_op(NODE_POW, u, make_double(2.)), make_op(NODE_POW, v, make_double(2.))));
+			}
+			else if(n.strIdent == "fmod")
+			{
+				// u' - trunc(u/v)*v', with trunc(u/v) = (u - fmod(u,v)) / v
+				Node nodeFmod = n;
+				nodeRes = make_op(NODE_MINUS, du, make_op(NODE_MULT,
+					make_op(NODE_DIV, make_op(NODE_MINUS, u, nodeFmod), v), dv));
+			}
+			else if(n.strIdent == "rand_norm" || n.strIdent == "rand_real")
+			{
+				nodeRes = make_double(0.);
+			}
+			else
+			{
+				tl::log_err("Cannot differentiate function \"", n.strIdent, "\".");
+				return false;
+			}
+		}
+		else
+			return false;
+	}
+	else
+	{
+		return false;
+	}
+
+	simplify_node(nodeRes);
+	return true;
+}
+
+
+//======================================================================
+// bytecode
+
+static inline double run_program(const Instr *pProg, std::size_t iLen,
+	const double *pdFree, const double *pdSyms, double *pdStack)
+{
+	std::size_t iSp = 0;
+
+	for(const Instr *pInstr=pProg; pInstr!=pProg+iLen; ++pInstr)
+	{
+		switch(pInstr->iOp)
+		{
+			case OP_CONST: pdStack[iSp++] = pInstr->dVal; break;
+			case OP_FREE: pdStack[iSp++] = pdFree[pInstr->iIdx]; break;
+			case OP_SYM: pdStack[iSp++] = pdSyms[pInstr->iIdx]; break;
+
+			case OP_ADD: --iSp; pdStack[iSp-1] += pdStack[iSp]; break;
+			case OP_SUB: --iSp; pdStack[iSp-1] -= pdStack[iSp]; break;
+			case OP_MUL: --iSp; pdStack[iSp-1] *= pdStack[iSp]; break;
+			case OP_DIV: --iSp; pdStack[iSp-1] /= pdStack[iSp]; break;
+			case OP_NEG: pdStack[iSp-1] = -pdStack[iSp-1]; break;
+			case OP_POW: --iSp; pdStack[iSp-1] = std::pow(pdStack[iSp-1], pdStack[iSp]); break;
+			case OP_SQR: pdStack[iSp-1] *= pdStack[iSp-1]; break;
+
+			case OP_CALL0: pdStack[iSp++] = pInstr->pFkt0(); break;
+			case OP_CALL1: pdStack[iSp-1] = pInstr->pFkt1(pdStack[iSp-1]); break;
+			case OP_CALL2: --iSp; pdStack[iSp-1] = pInstr->pFkt2(pdStack[iSp-1], pdStack[iSp]); break;
+		}
+	}
+
+	return pdStack[0];
+}
+
+/*
+ * column-wise version: every stack slot holds a block of points, so that
+ * each instruction is a simple loop the compiler can vectorise
+ */
+#define PARSER_BLOCK 256
+
+static void run_program_block(const Instr *pProg, std::size_t iLen,
+	const double* const* ppFree, std::size_t iOffs, std::size_t iNum,
+	const double *pdSyms, double *pdStack, double *pdOut)
+{
+	std::size_t iSp = 0;
+
+	for(const Instr *pInstr=pProg; pInstr!=pProg+iLen; ++pInstr)
+	{
+		double *pdTop = pdStack + iSp*PARSER_BLOCK;				// next free slot
+		double *pdB = pdStack + (iSp>0 ? iSp-1 : 0)*PARSER_BLOCK;	// right operand
+		double *pdA = pdStack + (iSp>1 ? iSp-2 : 0)*PARSER_BLOCK;	// left operand, result
+
+		switch(pInstr->iOp)
+		{
+			case OP_CONST:
+				std::fill(pdTop, pdTop+iNum, pInstr->dVal); ++iSp; break;
+			case OP_FREE:
+				std::copy(ppFree[pInstr->iIdx]+iOffs, ppFree[pInstr->iIdx]+iOffs+iNum, pdTop); ++iSp; break;
+			case OP_SYM:
+				std::fill(pdTop, pdTop+iNum, pdSyms[pInstr->iIdx]); ++iSp; break;
+
+			case OP_ADD: for(std::size_t i=0; i<iNum; ++i) pdA[i] += pdB[i]; --iSp; break;
+			case OP_SUB: for(std::size_t i=0; i<iNum; ++i) pdA[i] -= pdB[i]; --iSp; break;
+			case OP_MUL: for(std::size_t i=0; i<iNum; ++i) pdA[i] *= pdB[i]; --iSp; break;
+			case OP_DIV: for(std::size_t i=0; i<iNum; ++i) pdA[i] /= pdB[i]; --iSp; break;
+			case OP_NEG: for(std::size_t i=0; i<iNum; ++i) pdB[i] = -pdB[i]; break;
+			case OP_POW: for(std::size_t i=0; i<iNum; ++i) pdA[i] = std::pow(pdA[i], pdB[i]); --iSp; break;
+			case OP_SQR: for(std::size_t i=0; i<iNum; ++i) pdB[i] *= pdB[i]; break;
+
+			case OP_CALL0: for(std::size_t i=0; i<iNum; ++i) pdTop[i] = pInstr->pFkt0(); ++iSp; break;
+			case OP_CALL1: for(std::size_t i=0; i<iNum; ++i) pdB[i] = pInstr->pFkt1(pdB[i]); break;
+			case OP_CALL2: for(std::size_t i=0; i<iNum; ++i) pdA[i] = pInstr->pFkt2(pdA[i], pdB[i]); --iSp; break;
+		}
+	}
+
+	std::copy(pdStack, pdStack+iNum, pdOut);
+}
+
+static Instr make_instr(int iOp, unsigned int iIdx=0, double dVal=0.)
+{
+	Instr instr;
+	instr.iOp = iOp;
+	instr.iIdx = iIdx;
+	instr.dVal = dVal;
+	return instr;
+}
+
+/*
+ * appends an operation taking iNumArgs stack values;
+ * if all of them are constants, it is evaluated right away
+ */
+static void emit_op(std::vector<Instr>& vecProg, const Instr& instr, unsigned int iNumArgs, bool bPure=true)
+{
+	bool bFold = bPure && vecProg.size() >= iNumArgs;
+	for(unsigned int iArg=0; iArg<iNumArgs && bFold; ++iArg)
+		if(vecProg[vecProg.size()-1-iArg].iOp != OP_CONST)
+			bFold = false;
+
+	if(!bFold)
+	{
+		vecProg.push_back(instr);
+		return;
+	}
+
+	std::vector<Instr> vecConst(vecProg.end()-iNumArgs, vecProg.end());
+	vecConst.push_back(instr);
+	double dStack[3];
+	double dVal = run_program(vecConst.data(), vecConst.size(), nullptr, nullptr, dStack);
+
+	vecProg.resize(vecProg.size()-iNumArgs);
+	vecProg.push_back(make_instr(OP_CONST, 0, dVal));
+}
+
+static bool compile_node(const Node& node, const std::vector<Symbol>& syms,
+	const std::vector<Symbol>& vecFreeParams, std::vector<Instr>& vecProg)
+{
+	const unsigned int iNumChildren = node.vecChildren.size();
+
+	if(node.iType == NODE_PLUS || node.iType == NODE_MINUS ||
+		node.iType == NODE_MULT || node.iType == NODE_DIV)
+	{
+		if(iNumChildren == 0)
+			return false;
+
+		int iOp = OP_ADD;
+		if(node.iType == NODE_MINUS) iOp = OP_SUB;
+		else if(node.iType == NODE_MULT) iOp = OP_MUL;
+		else if(node.iType == NODE_DIV) iOp = OP_DIV;
+
+		for(unsigned int iChild=0; iChild<iNumChildren; ++iChild)
+		{
+			if(!compile_node(node.vecChildren[iChild], syms, vecFreeParams, vecProg))
+				return false;
+			if(iChild > 0)
+				emit_op(vecProg, make_instr(iOp), 2);
+		}
+
+		// unary minus
+		if(node.iType == NODE_MINUS && iNumChildren == 1)
+			emit_op(vecProg, make_instr(OP_NEG), 1);
+
+		return true;
+	}
+	else if(node.iType == NODE_POW)
+	{
+		if(iNumChildren != 2)
+		{
+			tl::log_err("operation 'pow' needs exactly two operands.");
+			return false;
+		}
+
+		if(!compile_node(node.vecChildren[0], syms, vecFreeParams, vecProg) ||
+			!compile_node(node.vecChildren[1], syms, vecFreeParams, vecProg))
+			return false;
+
+		// x^2 is by far the most common power in fit functions
+		if(vecProg.back().iOp == OP_CONST && vecProg.back().dVal == 2.)
+		{
+			vecProg.pop_back();
+			emit_op(vecProg, make_instr(OP_SQR), 1);
+		}
+		else
+		{
+			emit_op(vecProg, make_instr(OP_POW), 2);
+		}
+		return true;
+	}
+	else if(node.iType == NODE_DOUBLE)
+	{
+		vecProg.push_back(make_instr(OP_CONST, 0, node.dVal));
+		return true;
+	}
+	else if(node.iType == NODE_NOP)
+	{
+		vecProg.push_back(make_instr(OP_CONST, 0, 0.));
+		return true;
+	}
+	else if(node.iType == NODE_IDENT)
+	{
+		// same lookup order as in eval_tree, resolved once to indices
+		for(unsigned int iFree=0; iFree<vecFreeParams.size(); ++iFree)
+		{
+			if(vecFreeParams[iFree].strIdent == node.strIdent)
+			{
+				vecProg.push_back(make_instr(OP_FREE, iFree));
+				return true;
+			}
+		}
+
+		t_syms::const_iterator iter_c = g_syms.find(node.strIdent);
+		if(iter_c != g_syms.end())
+		{
+			vecProg.push_back(make_instr(OP_CONST, 0, iter_c->second));
+			return true;
+		}
+
+		for(unsigned int iSym=0; iSym<syms.size(); ++iSym)
+		{
+			if(syms[iSym].strIdent == node.strIdent)
+			{
+				vecProg.push_back(make_instr(OP_SYM, iSym));
+				return true;
+			}
+		}
+
+		tl::log_err("Symbol \"", node.strIdent, "\" is not in map!");
+		return false;
+	}
+	else if(node.iType == NODE_CALL)
+	{
+		for(const Node& child : node.vecChildren)
+			if(!compile_node(child, syms, vecFreeParams, vecProg))
+				return false;
+
+		const bool bPure = (g_map_nonpure.find(node.strIdent) == g_map_nonpure.end());
+		Instr instr = make_instr(OP_CALL0);
+
+		if(iNumChildren == 0)
+		{
+			t_map_fkt0::const_iterator iter0 = g_map_fkt0.find(node.strIdent);
+			if(iter0 != g_map_fkt0.end())
+			{
+				instr.pFkt0 = iter0->second;
+				vecProg.push_back(instr);
+				return true;
+			}
+		}
+		else if(iNumChildren == 1)
+		{
+			t_map_fkt1::const_iterator iter1 = g_map_fkt1.find(node.strIdent);
+			if(iter1 != g_map_fkt1.end())
+			{
+				instr.iOp = OP_CALL1;
+				instr.pFkt1 = iter1->second;
+				emit_op(vecProg, instr, 1, bPure);
+				return true;
+			}
+		}
+		else if(iNumChildren == 2)
+		{
+			t_map_fkt2::const_iterator iter2 = g_map_fkt2.find(node.strIdent);
+			if(iter2 != g_map_fkt2.end())
+			{
+				instr.iOp = OP_CALL2;
+				instr.pFkt2 = iter2->second;
+				emit_op(vecProg, instr, 2, bPure);
+				return true;
+			}
+		}
+
+		tl::log_err("No function \"", node.strIdent, "\" taking ", iNumChildren, " arguments known.");
+		return false;
+	}
+
+	return false;
+}
+
+// maximum number of values on the stack while running the program
+static std::size_t get_stack_depth(const std::vector<Instr>& vecProg)
+{
+	std::size_t iSp = 0, iMaxSp = 0;
+	for(const Instr& instr : vecProg)
+	{
+		switch(instr.iOp)
+		{
+			case OP_CONST: case OP_FREE: case OP_SYM: case OP_CALL0:
+				++iSp; break;
+			case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+			case OP_POW: case OP_CALL2:
+				--iSp; break;
+		}
+		iMaxSp = std::max(iMaxSp, iSp);
+	}
+	return iMaxSp;
+}
+
+// stack storage for the usual small sizes, heap otherwise
+template<std::size_t N>
+class LocalBuf
+{
+	protected:
+		double m_dLocal[N];
+		std::vector<double> m_vecHeap;
+		double *m_pd;
+
+	public:
+		LocalBuf(std::size_t iSize) : m_pd(m_dLocal)
+		{
+			if(iSize > N)
+			{
+				m_vecHeap.resize(iSize);
+				m_pd = m_vecHeap.data();
+			}
+		}
+
+		LocalBuf(const LocalBuf&) = delete;
+		LocalBuf& operator=(const LocalBuf&) = delete;
+
+		double* data() { return m_pd; }
+};
+
+
 //======================================================================
 // class interface
 
 Parser::Parser(const std::vector<Symbol>* pvecFreeParams)
 	: m_bOk(false)
 {
-#ifdef USE_JIT
-	if(s_iInstances++ == 0)
-		llvm::InitializeNativeTarget();
-#endif
-
 	// set "x" as default free param if no others given
 	if(!pvecFreeParams)
 	{
@@ -981,11 +1676,6 @@ Parser::Parser(const std::vector<Symbol>* pvecFreeParams)
 
 Parser::Parser(const Parser& parser)
 {
-#ifdef USE_JIT
-	if(s_iInstances++ == 0)
-		llvm::InitializeNativeTarget();
-#endif
-
 	this->operator=(parser);
 }
 
@@ -996,25 +1686,22 @@ Parser& Parser::operator=(const Parser& parser)
 	this->m_vecFreeParams = parser.m_vecFreeParams;
 	this->m_bOk = parser.m_bOk;
 
-	// TODO: Copy already compiled bitcode
+	// an already compiled native function is found again in the cache
 	this->Compile();
 
 	return *this;
 }
 
 Parser::~Parser()
-{
-#ifdef USE_JIT
-	DeinitJIT();
-
-	if(--s_iInstances == 0)
-		llvm::llvm_shutdown();
-#endif
-}
+{}
 
 void Parser::SetFreeParams(const std::vector<Symbol>& vecFreeParams)
 {
 	m_vecFreeParams = vecFreeParams;
+
+	// free parameter indices have changed
+	if(m_bOk)
+		Compile();
 }
 
 void Parser::clear(bool bClearFreeParams)
@@ -1026,6 +1713,9 @@ void Parser::clear(bool bClearFreeParams)
 
 	if(bClearFreeParams)
 		m_vecFreeParams.clear();
+
+	m_vecProg.clear();
+	m_iStackDepth = 0;
 }
 
 Node& Parser::GetRootNode() { return m_node; }
@@ -1060,25 +1750,85 @@ bool Parser::ParseExpression(const std::string& str)
 
 
 
-// evaluate the syntax tree
-#ifndef USE_JIT
-double Parser::Eval()
+// evaluate the compiled program; nothing in the parser is modified,
+// so several threads may evaluate the same expression concurrently
+double Parser::EvalSyms(const double *px, const double *pdSyms) const
 {
-	return ::eval_tree(m_node, m_syms, m_vecFreeParams);
+	// fall back to the tree if the expression could not be compiled
+	if(m_vecProg.empty())
+	{
+		std::vector<Symbol> syms = m_syms;
+		std::vector<Symbol> vecFreeParams = m_vecFreeParams;
+		for(std::size_t iSym=0; iSym<syms.size(); ++iSym)
+			syms[iSym].dVal = pdSyms[iSym];
+		if(px)
+		{
+			for(std::size_t iParam=0; iParam<vecFreeParams.size(); ++iParam)
+				vecFreeParams[iParam].dVal = px[iParam];
+		}
+		return ::eval_tree(m_node, syms, vecFreeParams);
+	}
+
+	LocalBuf<8> bufFree(px ? 0 : m_vecFreeParams.size());
+	if(!px)
+	{
+		for(std::size_t iParam=0; iParam<m_vecFreeParams.size(); ++iParam)
+			bufFree.data()[iParam] = m_vecFreeParams[iParam].dVal;
+		px = bufFree.data();
+	}
+
+	LocalBuf<32> bufStack(m_iStackDepth);
+	return run_program(m_vecProg.data(), m_vecProg.size(), px, pdSyms, bufStack.data());
 }
-#endif
 
-double Parser::EvalTree(const double *px)
+bool Parser::EvalArraySyms(const double* const* ppx, std::size_t iLen, double *pdOut,
+	const double *pdSyms, ParserEnv *pEnv) const
 {
-	if(px)
+	if(m_vecProg.empty())
+	{
+		// tree fallback, point by point
+		std::vector<double> vecX(m_vecFreeParams.size());
+		for(std::size_t iPt=0; iPt<iLen; ++iPt)
+		{
+			for(std::size_t iParam=0; iParam<vecX.size(); ++iParam)
+				vecX[iParam] = ppx[iParam][iPt];
+			pdOut[iPt] = EvalSyms(vecX.data(), pdSyms);
+		}
+		return m_bOk;
+	}
+
+#ifdef USE_JIT
+	if(t_native_fkt pNative = GetNative(iLen))
+	{
+		pNative(ppx, 0, iLen, pdSyms, m_vecNativeFkts.data(), pdOut);
+		return true;
+	}
+#endif
+
+	ParserEnv envLocal;
+	ParserEnv& env = pEnv ? *pEnv : envLocal;
+	if(env.vecStack.size() < m_iStackDepth*PARSER_BLOCK)
+		env.vecStack.resize(m_iStackDepth*PARSER_BLOCK);
+
+	for(std::size_t iOffs=0; iOffs<iLen; iOffs+=PARSER_BLOCK)
 	{
-		for(unsigned int i=0; i<m_vecFreeParams.size(); ++i)
-			m_vecFreeParams[i].dVal = px[i];
+		const std::size_t iNum = std::min<std::size_t>(PARSER_BLOCK, iLen-iOffs);
+		run_program_block(m_vecProg.data(), m_vecProg.size(), ppx, iOffs, iNum,
+			pdSyms, env.vecStack.data(), pdOut+iOffs);
 	}
-	return Eval();
+	return true;
 }
 
-double Parser::EvalTree(double x)
+double Parser::EvalTree(const double *px) const
+{
+	LocalBuf<32> bufSyms(m_syms.size());
+	for(std::size_t iSym=0; iSym<m_syms.size(); ++iSym)
+		bufSyms.data()[iSym] = m_syms[iSym].dVal;
+
+	return EvalSyms(px, bufSyms.data());
+}
+
+double Parser::EvalTree(double x) const
 {
 	if(m_vecFreeParams.size() != 1)
 	{
@@ -1086,8 +1836,47 @@ double Parser::EvalTree(double x)
 		return 0.;
 	}
 
-	m_vecFreeParams[0].dVal = x;
-	return Eval();
+	return EvalTree(&x);
+}
+
+bool Parser::EvalArray(const double* const* ppx, std::size_t iLen, double *pdOut, ParserEnv *pEnv) const
+{
+	std::vector<double> vecSyms;
+	vecSyms.reserve(m_syms.size());
+	for(const Symbol& sym : m_syms)
+		vecSyms.push_back(sym.dVal);
+
+	return EvalArraySyms(ppx, iLen, pdOut, vecSyms.data(), pEnv);
+}
+
+bool Parser::EvalArray(const double *px, std::size_t iLen, double *pdOut, ParserEnv *pEnv) const
+{
+	if(m_vecFreeParams.size() != 1)
+	{
+		tl::log_err("Symbol table has more than one free parameter, but only one given!");
+		return false;
+	}
+
+	return EvalArray(&px, iLen, pdOut, pEnv);
+}
+
+// derivative of the expression with respect to a symbol or free parameter,
+// sharing this parser's symbol table layout
+bool Parser::GetDerivative(const std::string& strVar, Parser& parserDeriv) const
+{
+	if(!m_bOk)
+		return false;
+
+	parserDeriv.clear(false);
+	parserDeriv.m_vecFreeParams = m_vecFreeParams;
+	parserDeriv.m_syms = m_syms;
+
+	if(!::diff_node(m_node, strVar, parserDeriv.m_node))
+		return false;
+
+	parserDeriv.m_bOk = true;
+	parserDeriv.Compile();
+	return true;
 }
 
 // get a string representation of the syntax tree's expression
@@ -1119,231 +1908,358 @@ bool Parser::CheckValidLexemes(const std::string& str)
 
 
 //======================================================================
-// using LLVM JIT compiler
+// native code backend: the stack program is translated to C, compiled
+// by the system compiler into a shared object and loaded with dlopen;
+// the objects are cached on disk by a hash of their source
 
-// llvm-codegen: clang -c -emit-llvm -o 0.ll 0.cpp && llc -march=cpp -o 0.cxx 0.ll
 #ifdef USE_JIT
 
-int Parser::s_iInstances = 0;
+static std::string g_strNativeCompiler = "cc -O2 -march=native -fno-math-errno";
+static std::string g_strNativeCacheDir;
+static std::size_t g_iNativeHotPoints = std::size_t(1) << 16;
 
-void Parser::InitJIT()
+// loaded functions by source hash, also remembers failed compilations
+static std::mutex g_mtxNative;
+static std::unordered_map<std::string, void*> g_mapNative;
+
+void Parser::SetNativeOptions(const std::string& strCompiler,
+	const std::string& strCacheDir, std::size_t iHotPoints)
+{
+	std::lock_guard<std::mutex> lock(g_mtxNative);
+	g_strNativeCompiler = strCompiler;
+	g_strNativeCacheDir = strCacheDir;
+	g_iNativeHotPoints = iHotPoints;
+}
+
+static std::string get_native_cache_dir()
 {
-	DeinitJIT();
+	if(g_strNativeCacheDir != "")
+		return g_strNativeCacheDir;
 
-	m_pVMContext = new llvm::LLVMContext();
-	m_pVMModule = new llvm::Module("parser", *m_pVMContext);
+	const char* pcCache = std::getenv("XDG_CACHE_HOME");
+	if(pcCache && *pcCache)
+		return std::string(pcCache) + "/cattus";
 
-	llvm::FunctionType* pFuncTy = llvm::FunctionType::get(
-			llvm::Type::getDoubleTy(*m_pVMContext),
-			std::vector<llvm::Type*>(), false);
-	m_pVMFunc = llvm::Function::Create(pFuncTy,
-			llvm::GlobalValue::LinkageTypes::InternalLinkage, "func", m_pVMModule);
-	m_pVMBlock = llvm::BasicBlock::Create(*m_pVMContext, "block", m_pVMFunc);
+	const char* pcHome = std::getenv("HOME");
+	if(pcHome && *pcHome)
+		return std::string(pcHome) + "/.cache/cattus";
 
-	m_pVMBuilder = new llvm::IRBuilder<true>(m_pVMBlock);
+	return "/tmp/cattus-" + std::to_string(geteuid());
 }
 
-void Parser::DeinitJIT()
+// only objects that nobody else can have written are loaded
+static bool is_private_path(const std::string& strPath)
 {
-	if(m_pVMBuilder) { delete m_pVMBuilder; m_pVMBuilder = nullptr; }
-	if(m_pVMBlock) { /*delete m_pVMBlock;*/ m_pVMBlock = nullptr; }
-	if(m_pVMFunc) { /*delete m_pVMFunc;*/ m_pVMFunc = nullptr; }
-	if(m_pVMExec) { /*delete m_pVMExec;*/ m_pVMExec = nullptr; }
-	if(m_pVMModule) { delete m_pVMModule; m_pVMModule = nullptr; }
-	if(m_pVMContext) { delete m_pVMContext; m_pVMContext = nullptr; }
+	struct stat st;
+	if(lstat(strPath.c_str(), &st) != 0)
+		return false;
+	if(S_ISLNK(st.st_mode) || st.st_uid != geteuid())
+		return false;
+	return (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
 }
 
-static llvm::LoadInst* get_fkt_ptr(llvm::Module* pMod, llvm::BasicBlock *pBlock,
-		const std::string& strName, unsigned int iNumArgs)
+// creates the directory and its parents, the last one only accessible by the user
+static bool make_native_cache_dir(const std::string& strDir)
 {
-	std::vector<llvm::Type*> vecArgs;
-	vecArgs.reserve(iNumArgs);
-	for(unsigned int iArg=0; iArg<iNumArgs; ++iArg)
-		vecArgs.push_back(llvm::Type::getDoubleTy(pMod->getContext()));
+	for(std::size_t iPos=strDir.find('/', 1); ; iPos=strDir.find('/', iPos+1))
+	{
+		const std::string strSub = strDir.substr(0, iPos);
+		const bool bLast = (iPos == std::string::npos);
+		if(mkdir(strSub.c_str(), bLast ? 0700 : 0755) != 0 && errno != EEXIST)
+			return false;
+		if(bLast)
+			break;
+	}
 
-	llvm::FunctionType* pFuncTy = llvm::FunctionType::get(
-			llvm::Type::getDoubleTy(pMod->getContext()), vecArgs, false);
-	const void *pvFunc = nullptr;
+	return is_private_path(strDir);
+}
 
-	if(iNumArgs == 0)
+// 64 bit FNV-1a, stable across runs unlike std::hash
+static std::string get_native_hash(const std::string& str)
+{
+	unsigned long long iHash = 14695981039346656037ull;
+	for(unsigned char c : str)
 	{
-		typename decltype(g_map_fkt0)::const_iterator iter = g_map_fkt0.find(strName);
-		if(iter != g_map_fkt0.end())
-			pvFunc = (const void*)iter->second;
+		iHash ^= c;
+		iHash *= 1099511628211ull;
 	}
-	else if(iNumArgs == 1)
+
+	char pcHash[17];
+	std::snprintf(pcHash, sizeof(pcHash), "%016llx", iHash);
+	return pcHash;
+}
+
+// C name of a built-in function pointer if it is available in math.h
+static const char* get_native_fkt_name(const Instr& instr)
+{
+	static const std::unordered_map<std::string, const char*> mapCFkts =
 	{
-		typename decltype(g_map_fkt1)::const_iterator iter = g_map_fkt1.find(strName);
-		if(iter != g_map_fkt1.end())
-			pvFunc = (const void*)iter->second;
-	}
-	else if(iNumArgs == 2)
+		{"abs", "fabs"}, {"fabs", "fabs"}, {"sin", "sin"}, {"cos", "cos"}, {"tan", "tan"},
+		{"asin", "asin"}, {"acos", "acos"}, {"atan", "atan"},
+		{"sinh", "sinh"}, {"cosh", "cosh"}, {"tanh", "tanh"},
+		{"asinh", "asinh"}, {"acosh", "acosh"}, {"atanh", "atanh"},
+		{"exp", "exp"}, {"log", "log"}, {"log10", "log10"}, {"sqrt", "sqrt"},
+		{"ceil", "ceil"}, {"floor", "floor"}, {"round", "round"}, {"erf", "erf"},
+		{"atan2", "atan2"}, {"pow", "pow"}, {"fmod", "fmod"}
+	};
+
+	std::string strFkt;
+	if(instr.iOp == OP_CALL1)
 	{
-		typename decltype(g_map_fkt2)::const_iterator iter = g_map_fkt2.find(strName);
-		if(iter != g_map_fkt2.end())
-			pvFunc = (const void*)iter->second;
+		for(const t_map_fkt1::value_type& pair : g_map_fkt1)
+			if(pair.second == instr.pFkt1)
+				strFkt = pair.first;
 	}
-
-	if(pvFunc)
+	else if(instr.iOp == OP_CALL2)
 	{
-		llvm::PointerType* ptrtyFkt = llvm::PointerType::get(pFuncTy, 0);
-		llvm::AllocaInst* ptrFkt = new llvm::AllocaInst(ptrtyFkt, "pFkt", pBlock);
-		ptrFkt->setAlignment(8);
-
-		llvm::Value *pValFkt = llvm::ConstantInt::get(pMod->getContext(),
-				llvm::APInt(sizeof(void*)*8, long(pvFunc)));
-		llvm::StoreInst *pStore = new llvm::StoreInst(pValFkt, ptrFkt, false, pBlock);
-		pStore->setAlignment(8);
-
-		llvm::LoadInst *pLoadInst = new llvm::LoadInst(ptrFkt, "fkt", false, pBlock);
-		return pLoadInst;
+		for(const t_map_fkt2::value_type& pair : g_map_fkt2)
+			if(pair.second == instr.pFkt2)
+				strFkt = pair.first;
 	}
 
-	tl::log_err("No such function: \"", strName, "\"");
-	return nullptr;
-
-/*
-	// try externally linked functions
-	llvm::Function* pFunc = llvm::Function::Create(pFuncTy, llvm::GlobalValue::ExternalLinkage, strName, pMod);
-	return pFunc;
-*/
+	auto iter = mapCFkts.find(strFkt);
+	return iter == mapCFkts.end() ? nullptr : iter->second;
 }
 
-static llvm::LoadInst* deref_dbl_ptr(llvm::Module* pMod, llvm::BasicBlock *pBlock,
-		const double *pd)
+/*
+ * the stack depth at each instruction is known beforehand,
+ * so every stack slot becomes a local variable
+ */
+static std::string emit_native_source(const std::vector<Instr>& vecProg,
+	std::size_t iStackDepth, std::vector<void*>& vecFkts)
 {
-	llvm::PointerType* ptrtyDbl = llvm::PointerType::get(
-			llvm::Type::getDoubleTy(pMod->getContext()), 0);
+	std::ostringstream ostr;
+	ostr.precision(std::numeric_limits<double>::max_digits10);
+
+	ostr << "#include <math.h>\n#include <stddef.h>\n\n";
+	ostr << "void cattus_expr(const double* const* ppFree, size_t iOffs, size_t iNum,\n"
+		<< "\tconst double *pdSyms, void* const* ppFkts, double *pdOut)\n{\n";
+	ostr << "\tfor(size_t i=0; i<iNum; ++i)\n\t{\n";
+	for(std::size_t iSlot=0; iSlot<iStackDepth; ++iSlot)
+		ostr << "\t\tdouble s" << iSlot << ";\n";
 
-	llvm::AllocaInst* ptrDbl = new llvm::AllocaInst(ptrtyDbl, "pSym", pBlock);
-	ptrDbl->setAlignment(8);
+	std::size_t iSp = 0;
+	for(const Instr& instr : vecProg)
+	{
+		const std::size_t iA = iSp>1 ? iSp-2 : 0, iB = iSp>0 ? iSp-1 : 0;
+		ostr << "\t\t";
 
-	llvm::Value *pVal = llvm::ConstantInt::get(pMod->getContext(),
-			llvm::APInt(sizeof(double*)*8, long(pd)));
-	llvm::StoreInst* pStore = new llvm::StoreInst(pVal, ptrDbl, false, pBlock);
-	pStore->setAlignment(8);
+		switch(instr.iOp)
+		{
+			case OP_CONST:
+				// hex float literals are exact
+				char pcVal[64];
+				std::snprintf(pcVal, sizeof(pcVal), "%a", instr.dVal);
+				if(std::isfinite(instr.dVal))
+					ostr << "s" << iSp << " = " << pcVal << ";";
+				else
+					ostr << "s" << iSp << " = " << (std::isnan(instr.dVal) ? "NAN" :
+						(instr.dVal < 0. ? "-INFINITY" : "INFINITY")) << ";";
+				++iSp;
+				break;
+			case OP_FREE: ostr << "s" << iSp << " = ppFree[" << instr.iIdx << "][iOffs+i];"; ++iSp; break;
+			case OP_SYM: ostr << "s" << iSp << " = pdSyms[" << instr.iIdx << "];"; ++iSp; break;
+
+			case OP_ADD: ostr << "s" << iA << " += s" << iB << ";"; --iSp; break;
+			case OP_SUB: ostr << "s" << iA << " -= s" << iB << ";"; --iSp; break;
+			case OP_MUL: ostr << "s" << iA << " *= s" << iB << ";"; --iSp; break;
+			case OP_DIV: ostr << "s" << iA << " /= s" << iB << ";"; --iSp; break;
+			case OP_NEG: ostr << "s" << iB << " = -s" << iB << ";"; break;
+			case OP_POW: ostr << "s" << iA << " = pow(s" << iA << ", s" << iB << ");"; --iSp; break;
+			case OP_SQR: ostr << "s" << iB << " *= s" << iB << ";"; break;
+
+			case OP_CALL0:
+				ostr << "s" << iSp << " = ((double(*)(void))ppFkts[" << vecFkts.size() << "])();";
+				vecFkts.push_back((void*)instr.pFkt0);
+				++iSp;
+				break;
+			case OP_CALL1:
+				if(const char* pcFkt = get_native_fkt_name(instr))
+					ostr << "s" << iB << " = " << pcFkt << "(s" << iB << ");";
+				else
+				{
+					ostr << "s" << iB << " = ((double(*)(double))ppFkts[" << vecFkts.size() << "])(s" << iB << ");";
+					vecFkts.push_back((void*)instr.pFkt1);
+				}
+				break;
+			case OP_CALL2:
+				if(const char* pcFkt = get_native_fkt_name(instr))
+					ostr << "s" << iA << " = " << pcFkt << "(s" << iA << ", s" << iB << ");";
+				else
+				{
+					ostr << "s" << iA << " = ((double(*)(double, double))ppFkts[" << vecFkts.size()
+						<< "])(s" << iA << ", s" << iB << ");";
+					vecFkts.push_back((void*)instr.pFkt2);
+				}
+				--iSp;
+				break;
+		}
+		ostr << "\n";
+	}
 
-	return new llvm::LoadInst(new llvm::LoadInst(ptrDbl, "", false, pBlock),
-			"", false, pBlock);
+	ostr << "\t\tpdOut[i] = s0;\n\t}\n}\n";
+	return ostr.str();
 }
 
-llvm::Value* Parser::Compile(const Node& node)
+// builds (if not yet cached) and loads the shared object, returns the entry point
+static void* load_native_source(const std::string& strSrc)
 {
-	const unsigned int iNumSub = node.vecChildren.size();
+	const std::string strHash = get_native_hash(g_strNativeCompiler + "\n" + strSrc);
 
-	std::vector<llvm::Value*> vecSub;
-	vecSub.reserve(iNumSub);
+	auto iter = g_mapNative.find(strHash);
+	if(iter != g_mapNative.end())
+		return iter->second;
+	void*& pvFkt = g_mapNative[strHash];
 
-	for(const Node& child : node.vecChildren)
-		vecSub.push_back(Compile(child));
-
-	if(node.iType == NODE_CALL)
+	// the paths are quoted for the shell in the compiler command
+	const std::string strDir = get_native_cache_dir();
+	if(strDir.find('\'') != std::string::npos || !make_native_cache_dir(strDir))
 	{
-		llvm::LoadInst *pFkt = get_fkt_ptr(m_pVMModule, m_pVMBlock, node.strIdent, vecSub.size());
-		return m_pVMBuilder->CreateCall(pFkt, vecSub, node.strIdent);
-		//return llvm::CallInst::Create(pFkt, vecSub, node.strIdent, m_pVMBlock);
+		tl::log_warn("Expression cache \"", strDir, "\" is not a private directory, using interpreter.");
+		return nullptr;
 	}
+	const std::string strSo = strDir + "/expr_" + strHash + ".so";
 
-	if(iNumSub==0)
+	if(access(strSo.c_str(), R_OK) != 0)
 	{
-		if(node.iType == NODE_DOUBLE)
-			return llvm::ConstantFP::get(*m_pVMContext, llvm::APFloat(node.dVal));
-		else if(node.iType == NODE_IDENT)
+		// build under a unique name and move it into place, so that concurrent
+		// instances never load a half-written object
+		const std::string strTmp = strDir + "/expr_" + strHash + "." + std::to_string(getpid());
 		{
-			const double *pSym = get_symbol_ptr(m_syms, node.strIdent, m_vecFreeParams);
-			if(!pSym)
+			std::ofstream ofstrSrc(strTmp + ".c");
+			ofstrSrc << strSrc;
+			if(!ofstrSrc)
 			{
-				tl::log_err("Invalid symbol: \"", node.strIdent, "\"");
+				tl::log_warn("Cannot write expression source to \"", strTmp, ".c\".");
 				return nullptr;
 			}
-
-			return deref_dbl_ptr(m_pVMModule, m_pVMBlock, pSym);
 		}
-		else if(node.iType == NODE_NOP)
+
+		const std::string strCmd = g_strNativeCompiler + " -fPIC -shared -o '" + strTmp + ".so' '"
+			+ strTmp + ".c' -lm 2>/dev/null";
+		const bool bCompiled = (std::system(strCmd.c_str()) == 0);
+		std::remove((strTmp + ".c").c_str());
+
+		if(!bCompiled || std::rename((strTmp + ".so").c_str(), strSo.c_str()) != 0)
 		{
-			// nop: 0+0
-			llvm::Value* pZero = llvm::ConstantFP::get(*m_pVMContext, llvm::APFloat(0.));
-			return m_pVMBuilder->CreateFAdd(pZero, pZero, get_op_name(node.iType));
+			std::remove((strTmp + ".so").c_str());
+			tl::log_warn("Cannot compile expression using \"", g_strNativeCompiler, "\", using interpreter.");
+			return nullptr;
 		}
 	}
-	else if(iNumSub==1)		// unary operators
-	{
-		//llvm::Value *pValZero = llvm::ConstantFP::get(*m_pVMContext, llvm::APFloat(0.));
-		if(node.iType == NODE_PLUS)
-			return vecSub[0];
-			//return m_pVMBuilder->CreateFAdd(vecSub[0], pValZero, get_op_name(node.iType));
-		else if(node.iType == NODE_MINUS)
-			return m_pVMBuilder->CreateFNeg(vecSub[0], get_op_name(node.iType));
-			//return m_pVMBuilder->CreateFSub(pValZero, vecSub[0], get_op_name(node.iType));
-	}
-	else if(iNumSub==2)		// binary operators
-	{
-		if(node.iType == NODE_PLUS)
-			return m_pVMBuilder->CreateFAdd(vecSub[0], vecSub[1], get_op_name(node.iType));
-		else if(node.iType == NODE_MINUS)
-			return m_pVMBuilder->CreateFSub(vecSub[0], vecSub[1], get_op_name(node.iType));
-		else if(node.iType == NODE_MULT)
-			return m_pVMBuilder->CreateFMul(vecSub[0], vecSub[1], get_op_name(node.iType));
-		else if(node.iType == NODE_DIV)
-			return m_pVMBuilder->CreateFDiv(vecSub[0], vecSub[1], get_op_name(node.iType));
-		else if(node.iType == NODE_POW)
-		{
-			llvm::LoadInst *pPow = get_fkt_ptr(m_pVMModule, m_pVMBlock, "pow", 2);
-			return m_pVMBuilder->CreateCall(pPow, vecSub, "pow");
-		}
-		else if(node.iType == NODE_MINUS_INV)
-			return m_pVMBuilder->CreateFSub(vecSub[1], vecSub[0], get_op_name(node.iType));
-		else if(node.iType == NODE_DIV_INV)
-			return m_pVMBuilder->CreateFDiv(vecSub[1], vecSub[0], get_op_name(node.iType));
+
+	if(!is_private_path(strSo))
+	{
+		tl::log_warn("Compiled expression \"", strSo, "\" is not owned by the user, using interpreter.");
+		return nullptr;
 	}
 
-	tl::log_err("Cannot compile node \"", get_op_name(node.iType),
-			"\" having ", iNumSub, " children.");
-	return nullptr;
+	// the handle stays open, other parsers may share the function
+	void *pLib = dlopen(strSo.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if(!pLib)
+	{
+		tl::log_warn("Cannot load compiled expression: ", dlerror());
+		return nullptr;
+	}
+
+	pvFkt = dlsym(pLib, "cattus_expr");
+	if(!pvFkt)
+		tl::log_warn("Compiled expression has no entry point.");
+	else
+		tl::log_debug("Loaded native expression \"", strSo, "\".");
+
+	return pvFkt;
 }
 
-bool Parser::Compile()
+void Parser::ResetNative()
 {
-	tl::log_info("Using JIT compiler");
-	InitJIT();
+	std::lock_guard<std::mutex> lock(m_mtxNative);
+	m_pNative = nullptr;
+	m_iNativeHotness = 0;
+	m_bNativeTried = false;
+	m_vecNativeFkts.clear();
+}
 
-	m_pVMBuilder->CreateRet(Compile(m_node));
+bool Parser::CompileNative() const
+{
+	std::lock_guard<std::mutex> lock(m_mtxNative);
+	if(m_bNativeTried)
+		return m_pNative != nullptr;
+	m_bNativeTried = true;
 
-	llvm::EngineBuilder builder(m_pVMModule);
-	builder.setEngineKind(llvm::EngineKind::JIT);
-	builder.setOptLevel(llvm::CodeGenOpt::Default);
-	m_pVMExec = builder.create();
+	if(m_vecProg.empty())
+		return false;
 
-	/*// optimisation
-	m_pVMModule->setDataLayout(m_pVMExec->getDataLayout());
-	llvm::legacy::FunctionPassManager fpm(m_pVMModule);
-	//fpm.add(llvm::createInstructionCombiningPass());
-	fpm.add(llvm::createGVNPass());
-	fpm.add(llvm::createSCCPPass());
-	fpm.add(llvm::createCFGSimplificationPass());
-	fpm.run(*m_pVMFunc);*/
+	std::vector<void*> vecFkts;
+	const std::string strSrc = emit_native_source(m_vecProg, m_iStackDepth, vecFkts);
 
-	m_pFunc = (double(*)())m_pVMExec->getPointerToFunction(m_pVMFunc);
-	return 1;
+	void *pvFkt = nullptr;
+	{
+		std::lock_guard<std::mutex> lockGlobal(g_mtxNative);
+		pvFkt = load_native_source(strSrc);
+	}
+	if(!pvFkt)
+		return false;
+
+	// the function table has to be in place before other threads see the function
+	m_vecNativeFkts = std::move(vecFkts);
+	m_pNative = (t_native_fkt)pvFkt;
+	return true;
 }
 
-double Parser::Eval()
+// native function if the expression has become hot enough
+Parser::t_native_fkt Parser::GetNative(std::size_t iLen) const
 {
-	if(m_pFunc)
-		return m_pFunc();
-	else
+	t_native_fkt pFkt = m_pNative;
+	if(pFkt || m_vecProg.empty())
+		return pFkt;
+
+	std::size_t iHotPoints;
 	{
-		llvm::GenericValue gv = m_pVMExec->runFunction(m_pVMFunc,
-				std::vector<llvm::GenericValue>());
-		return double(gv.DoubleVal);
+		std::lock_guard<std::mutex> lock(g_mtxNative);
+		iHotPoints = g_iNativeHotPoints;
 	}
+	if(iHotPoints == 0)
+		return nullptr;
+
+	if((m_iNativeHotness += iLen) < iHotPoints)
+		return nullptr;
+
+	CompileNative();
+	return m_pNative;
 }
 
-#else
+#endif
 
-bool Parser::Compile() { return 0; }
 
+bool Parser::Compile()
+{
+#ifdef USE_JIT
+	ResetNative();
 #endif
+	return CompileProgram();
+}
+
+// compile the syntax tree into the stack program
+bool Parser::CompileProgram()
+{
+	m_vecProg.clear();
+	m_iStackDepth = 0;
+
+	if(!m_bOk)
+		return 0;
+
+	std::vector<Instr> vecProg;
+	if(!::compile_node(m_node, m_syms, m_vecFreeParams, vecProg))
+	{
+		tl::log_warn("Cannot compile expression, using syntax tree.");
+		return 0;
+	}
+
+	m_iStackDepth = ::get_stack_depth(vecProg);
+	m_vecProg = std::move(vecProg);
+	return 1;
+}
 
 
 //======================================================================
@@ -1518,7 +2434,7 @@ std::vector<ParameterHints> parse_parameter_hints(const std::string& str)
 
 /*
 // test
-// clang -I.. -o parsertst -DUSE_JIT parser.cpp ../tlibs/helper/log.cpp ../tlibs/math/rand.cpp -std=c++11 -lstdc++ -lm -L/usr/lib64/llvm -lLLVM-3.5
+// clang -I.. -o parsertst -DUSE_JIT parser.cpp ../tlibs/helper/log.cpp ../tlibs/math/rand.cpp -std=c++11 -lstdc++ -lm -ldl
 #include <iostream>
 #include <limits>
 
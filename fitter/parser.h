@@ -10,16 +10,11 @@
 
 #include <string>
 #include <vector>
+#include <cstddef>
 
 #ifdef USE_JIT
-	#define __STDC_CONSTANT_MACROS
-	#define __STDC_FORMAT_MACROS
-	#define __STDC_LIMIT_MACROS
-
-	#include <llvm/IR/LLVMContext.h>
-	#include <llvm/IR/Module.h>
-	#include <llvm/IR/IRBuilder.h>
-	#include <llvm/ExecutionEngine/JIT.h>
+	#include <atomic>
+	#include <mutex>
 #endif
 
 
@@ -44,6 +39,27 @@ struct Symbol
 	double dVal;
 };
 
+// instruction of the compiled expression program
+struct Instr
+{
+	int iOp;
+	unsigned int iIdx;		// free parameter or symbol index
+
+	union
+	{
+		double dVal;		// immediate constant
+		double (*pFkt0)();
+		double (*pFkt1)(double);
+		double (*pFkt2)(double, double);
+	};
+};
+
+// scratch space for evaluating expressions; one per thread
+struct ParserEnv
+{
+	std::vector<double> vecStack;
+};
+
 
 //----------------------------------------------------------------------
 
@@ -56,27 +72,28 @@ class Parser
 
 		bool m_bOk = false;
 
-#ifdef USE_JIT
-		static int s_iInstances;
-
-		llvm::Module *m_pVMModule = nullptr;
-		llvm::LLVMContext *m_pVMContext = nullptr;
-		llvm::IRBuilder<> *m_pVMBuilder = nullptr;
-
-		llvm::Function *m_pVMFunc = nullptr;
-		llvm::BasicBlock *m_pVMBlock = nullptr;
+		// flat program compiled from the syntax tree, not modified by evaluation
+		std::vector<Instr> m_vecProg;
+		std::size_t m_iStackDepth = 0;
 
-		llvm::ExecutionEngine *m_pVMExec = nullptr;
-
-		double (*m_pFunc)() = nullptr;
-
-		void InitJIT();
-		void DeinitJIT();
-		llvm::Value* Compile(const Node& node);
+#ifdef USE_JIT
+		// native code compiled from m_vecProg once the expression is hot
+		typedef void (*t_native_fkt)(const double* const* ppFree, std::size_t iOffs, std::size_t iNum,
+			const double *pdSyms, void* const* ppFkts, double *pdOut);
+
+		mutable std::mutex m_mtxNative;
+		mutable std::atomic<t_native_fkt> m_pNative{nullptr};
+		mutable std::atomic<std::size_t> m_iNativeHotness{0};
+		mutable bool m_bNativeTried = false;
+		mutable std::vector<void*> m_vecNativeFkts;
+
+		void ResetNative();
+		t_native_fkt GetNative(std::size_t iLen) const;
+		bool CompileNative() const;
 #endif
 
+		bool CompileProgram();
 		bool Compile();
-		double Eval();
 
 	public:
 		Parser(const std::vector<Symbol>* pvecFreeParams=0);
@@ -102,9 +119,22 @@ class Parser
 		// create a syntax tree out of a expression string
 		bool ParseExpression(const std::string& str);
 
-		// evaluate the syntax tree
-		double EvalTree(const double *px=0);
-		double EvalTree(double x);
+		// evaluate the syntax tree using the values in the symbol table
+		double EvalTree(const double *px=0) const;
+		double EvalTree(double x) const;
+
+		// evaluate for iLen points at once, ppx[iFreeParam][iPoint]
+		bool EvalArray(const double* const* ppx, std::size_t iLen, double *pdOut, ParserEnv *pEnv=0) const;
+		// ... for a single free parameter
+		bool EvalArray(const double *px, std::size_t iLen, double *pdOut, ParserEnv *pEnv=0) const;
+
+		// evaluate using external symbol values (in the order of GetSymbols())
+		double EvalSyms(const double *px, const double *pdSyms) const;
+		bool EvalArraySyms(const double* const* ppx, std::size_t iLen, double *pdOut,
+			const double *pdSyms, ParserEnv *pEnv=0) const;
+
+		// symbolic derivative with respect to a symbol or free parameter
+		bool GetDerivative(const std::string& strVar, Parser& parserDeriv) const;
 
 		// get a string representation of the syntax tree's expression
 		std::string GetExpression(bool bFillInSyms=false, bool bGnuPlotSyntax=true) const;
@@ -116,6 +146,13 @@ class Parser
 		void PrintSymbolMap() const;
 
 		static bool CheckValidLexemes(const std::string& str);
+
+#ifdef USE_JIT
+		// compiler command, e.g. "cc -O2 -march=native", and directory for the compiled expressions;
+		// array evaluations are compiled after iHotPoints points, 0 disables native code
+		static void SetNativeOptions(const std::string& strCompiler,
+			const std::string& strCacheDir, std::size_t iHotPoints);
+#endif
 };
 
 
@@ -6,28 +6,52 @@
  */
 
 #include "blob.h"
+#include "workpool.h"
 #include "tlibs/log/log.h"
+#include "tlibs/file/comp.h"
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 
 
 Blob::Blob(const char* pcFile) : m_file(QString(pcFile))
 {
-	m_file.open(QIODevice::ReadOnly);
+	if(!m_file.open(QIODevice::ReadOnly))
+		return;
+
+	m_iMapLen = m_file.size();
+	if(m_iMapLen > 0)
+		m_pMap = m_file.map(0, m_iMapLen);
+	if(!m_pMap)
+		m_iMapLen = 0;
 }
 
+Blob::Blob(Blob* pParent, qint64 iOffs) : m_pParent(pParent), m_iOffs(iOffs)
+{}
+
 Blob::~Blob()
 {
+	if(m_pMap)
+	{
+		m_file.unmap(m_pMap);
+		m_pMap = 0;
+	}
 	m_file.close();
 }
 
 
 bool Blob::IsOpen() const
 {
+	if(m_pParent)
+		return m_pParent->IsOpen();
 	return m_file.isOpen();
 }
 
 void* Blob::map(qint64 iStart, qint64 iLen)
 {
+	if(m_pParent)
+		return m_pParent->map(m_iOffs + iStart, iLen);
+
 	qint64 iSize = m_file.size();
 	if(iStart+iLen > iSize)
 	{
@@ -35,11 +59,24 @@ void* Blob::map(qint64 iStart, qint64 iLen)
 		return 0;
 	}
 
+	if(m_pMap)
+		return m_pMap + iStart;
+
 	return m_file.map(iStart, iLen);
 }
 
 void Blob::unmap(void *pv)
 {
+	if(m_pParent)
+	{
+		m_pParent->unmap(pv);
+		return;
+	}
+
+	// regions of the whole-file mapping stay valid until destruction
+	if(m_pMap && (uchar*)pv >= m_pMap && (uchar*)pv < m_pMap+m_iMapLen)
+		return;
+
 	m_file.unmap((uchar*)pv);
 }
 
@@ -50,3 +87,144 @@ void Blob::memcpy(qint64 iStart, qint64 iLen, void* pvStart)
 	::memcpy(pvStart, p, iLen);
 	unmap(p);
 }
+
+
+
+// --------------------------------------------------------------------------------
+// blob format v2
+
+BlobCodec get_blob_codec(const std::ostream& ostrBlob)
+{
+	const BlobOStream *pBlobOStr = dynamic_cast<const BlobOStream*>(&ostrBlob);
+	if(pBlobOStr)
+		return pBlobOStr->GetCodec();
+	return BlobCodec::FAST;
+}
+
+static tl::Compressor get_compressor(BlobCodec codec)
+{
+	if(codec == BlobCodec::RATIO)
+		return tl::Compressor::BZ2;
+	return tl::Compressor::GZ;
+}
+
+bool blob_compress_to_stream(const void* pvMem, qint64 iLen, std::ostream& ostr, BlobCodec codec)
+{
+	return tl::comp_mem_to_stream<char>((void*)pvMem, iLen, ostr, get_compressor(codec));
+}
+
+/*
+ * layout: number of chunks, uncompressed chunk size,
+ * compressed size of each chunk, chunk data
+ */
+bool blob_write_chunked(std::ostream& ostrBlob, const void* pvMem, qint64 iLen, BlobCodec codec)
+{
+	const qint64 iChunkLen = BLOB_CHUNK_SIZE;
+	const qint64 iNumChunks = (iLen + iChunkLen-1) / iChunkLen;
+	std::vector<std::string> vecChunks(iNumChunks);
+	std::vector<int> vecOk(iNumChunks, 0);
+
+	// called from the session save tasks, the pool only gets the calling worker's share of the cores
+	WorkPool pool;
+	for(qint64 iChunk=0; iChunk<iNumChunks; ++iChunk)
+	{
+		pool.AddTask([pvMem, iLen, iChunkLen, iChunk, codec, &vecChunks, &vecOk]()
+		{
+			const qint64 iStart = iChunk*iChunkLen;
+			const qint64 iCurLen = std::min(iChunkLen, iLen-iStart);
+
+			std::ostringstream ostrChunk(std::ios_base::out | std::ios_base::binary);
+			vecOk[iChunk] = blob_compress_to_stream((const char*)pvMem + iStart, iCurLen, ostrChunk, codec);
+			vecChunks[iChunk] = ostrChunk.str();
+		});
+	}
+	pool.Start();
+	pool.Join();
+
+	if(std::count(vecOk.begin(), vecOk.end(), 0))
+	{
+		tl::log_err("Cannot compress data chunk in blob.");
+		return false;
+	}
+
+	ostrBlob.write((const char*)&iNumChunks, sizeof(iNumChunks));
+	ostrBlob.write((const char*)&iChunkLen, sizeof(iChunkLen));
+	for(const std::string& strChunk : vecChunks)
+	{
+		qint64 iChunkCompLen = strChunk.size();
+		ostrBlob.write((const char*)&iChunkCompLen, sizeof(iChunkCompLen));
+	}
+	for(const std::string& strChunk : vecChunks)
+		ostrBlob.write(strChunk.data(), strChunk.size());
+
+	return ostrBlob.good();
+}
+
+bool blob_read_chunked(Blob& blob, qint64 iStart, qint64 iLenBlob,
+	void* pvOut, qint64 iLenOut, BlobCodec codec)
+{
+	if(iLenBlob < qint64(2*sizeof(qint64)))
+	{
+		tl::log_err("Blob entry too small for chunk index.");
+		return false;
+	}
+
+	const char *pcBlob = (const char*)blob.map(iStart, iLenBlob);
+	if(!pcBlob)
+		return false;
+
+	bool bOk = true;
+	const qint64 iNumChunks = *(const qint64*)pcBlob;
+	const qint64 iChunkLen = *((const qint64*)pcBlob + 1);
+	const qint64 *piChunkCompLens = (const qint64*)pcBlob + 2;
+	const qint64 iHeaderLen = (2 + iNumChunks) * sizeof(qint64);
+
+	if(iChunkLen <= 0 || iNumChunks != (iLenOut + iChunkLen-1) / iChunkLen || iHeaderLen > iLenBlob)
+	{
+		tl::log_err("Invalid chunk index in blob.");
+		bOk = false;
+	}
+
+	// chunk offsets from the index, so that all chunks can be decompressed independently
+	std::vector<qint64> vecChunkOffs(bOk ? iNumChunks+1 : 1, iHeaderLen);
+	for(qint64 iChunk=0; bOk && iChunk<iNumChunks; ++iChunk)
+		vecChunkOffs[iChunk+1] = vecChunkOffs[iChunk] + piChunkCompLens[iChunk];
+	if(bOk && vecChunkOffs[iNumChunks] > iLenBlob)
+	{
+		tl::log_err("Chunks exceed blob entry.");
+		bOk = false;
+	}
+
+	if(bOk)
+	{
+		const tl::Compressor comp = get_compressor(codec);
+		std::vector<int> vecOk(iNumChunks, 0);
+
+		WorkPool pool;
+		for(qint64 iChunk=0; iChunk<iNumChunks; ++iChunk)
+		{
+			pool.AddTask([=, &vecChunkOffs, &vecOk]()
+			{
+				const qint64 iOutStart = iChunk*iChunkLen;
+				const qint64 iCurLen = std::min(iChunkLen, iLenOut-iOutStart);
+
+				vecOk[iChunk] = tl::decomp_mem_to_mem_fix<char>(
+					(void*)(pcBlob + vecChunkOffs[iChunk]),
+					(unsigned int)(vecChunkOffs[iChunk+1]-vecChunkOffs[iChunk]),
+					(void*)((char*)pvOut + iOutStart), (unsigned int)iCurLen, comp);
+			});
+		}
+		pool.Start();
+		pool.Join();
+
+		if(std::count(vecOk.begin(), vecOk.end(), 0))
+		{
+			tl::log_err("Cannot decompress data chunk in blob.");
+			bOk = false;
+		}
+	}
+
+	blob.unmap((void*)pcBlob);
+	return bOk;
+}
+// --------------------------------------------------------------------------------
@@ -10,16 +10,43 @@
 
 #include <QtCore/QFile>
 #include <vector>
+#include <sstream>
+
+
+// compression of session blob data
+enum class BlobCodec
+{
+	NONE = 0,
+	FAST = 1,
+	RATIO = 2
+};
+
+// uncompressed bytes per independently compressed chunk (blob format v2)
+#define BLOB_CHUNK_SIZE (1<<20)
+
 
 class Blob
 {
 	protected:
 		QFile m_file;
 
+		// view into a window's part of a parent blob
+		Blob *m_pParent = 0;
+		qint64 m_iOffs = 0;
+
+		// the whole file is kept mapped for random access by several threads,
+		// regions are only mapped individually if this fails
+		uchar *m_pMap = 0;
+		qint64 m_iMapLen = 0;
+
 	public:
 		Blob(const char* pcFile);
+		Blob(Blob* pParent, qint64 iOffs);
 		virtual ~Blob();
 
+		Blob(const Blob&) = delete;
+		Blob& operator=(const Blob&) = delete;
+
 		bool IsOpen() const;
 
 		void* map(qint64 iStart, qint64 iLen);
@@ -53,4 +80,31 @@ class Blob
 		void memcpy(qint64 iStart, qint64 iLen, void* pvStart);
 };
 
+
+// in-memory blob output of one window, carrying the session's codec
+class BlobOStream : public std::ostringstream
+{
+	protected:
+		BlobCodec m_codec;
+
+	public:
+		BlobOStream(BlobCodec codec=BlobCodec::FAST)
+			: std::ostringstream(std::ios_base::out | std::ios_base::binary),
+			  m_codec(codec)
+		{}
+
+		BlobCodec GetCodec() const { return m_codec; }
+};
+
+// codec to use for a blob output stream, BlobCodec::FAST for plain streams
+extern BlobCodec get_blob_codec(const std::ostream& ostrBlob);
+
+// compresses a single memory block with the codec's compressor (BlobCodec::NONE compresses fast)
+extern bool blob_compress_to_stream(const void* pvMem, qint64 iLen, std::ostream& ostr, BlobCodec codec);
+
+// blob format v2: a chunk index followed by the independently compressed chunks
+extern bool blob_write_chunked(std::ostream& ostrBlob, const void* pvMem, qint64 iLen, BlobCodec codec);
+extern bool blob_read_chunked(Blob& blob, qint64 iStart, qint64 iLenBlob,
+	void* pvOut, qint64 iLenOut, BlobCodec codec);
+
 #endif
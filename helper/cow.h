@@ -0,0 +1,100 @@
+/**
+ * copy-on-write arrays
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_COW_H__
+#define __MIEZE_COW_H__
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+
+
+/*
+ * a vector whose copies share their memory until one of them is written to;
+ * all writes go through Write(), which first makes a private copy if the
+ * memory is shared, so reading never copies
+ */
+template<class T>
+class CowVector
+{
+public:
+	typedef std::vector<T> t_vec;
+
+protected:
+	std::shared_ptr<t_vec> m_pVec;
+
+	void Detach()
+	{
+		if(!m_pVec)
+			m_pVec = std::make_shared<t_vec>();
+		else if(m_pVec.use_count() > 1)
+			m_pVec = std::make_shared<t_vec>(*m_pVec);
+	}
+
+public:
+	CowVector() : m_pVec(std::make_shared<t_vec>()) {}
+	CowVector(const CowVector<T>& vec) = default;
+	CowVector<T>& operator=(const CowVector<T>& vec) = default;
+
+
+	// reading
+	const t_vec& Get() const { return *m_pVec; }
+	std::size_t size() const { return m_pVec->size(); }
+	bool empty() const { return m_pVec->empty(); }
+	const T* data() const { return m_pVec->data(); }
+	const T& operator[](std::size_t i) const { return (*m_pVec)[i]; }
+	typename t_vec::const_iterator begin() const { return m_pVec->begin(); }
+	typename t_vec::const_iterator end() const { return m_pVec->end(); }
+
+	bool IsShared() const { return m_pVec.use_count() > 1; }
+
+
+	// writing
+	t_vec& Write() { Detach(); return *m_pVec; }
+	T* WriteData() { return Write().data(); }
+
+	void resize(std::size_t iSize)
+	{
+		if(iSize == size())
+			return;
+
+		// the old contents don't need to be copied if they are shared
+		if(IsShared())
+		{
+			std::shared_ptr<t_vec> pVec = std::make_shared<t_vec>(iSize);
+			std::copy(begin(), begin() + std::min(iSize, size()), pVec->begin());
+			m_pVec = pVec;
+		}
+		else
+		{
+			m_pVec->resize(iSize);
+		}
+	}
+
+	// overwrites all elements, without copying them first if they are shared
+	void fill(const T& val)
+	{
+		if(IsShared())
+			m_pVec = std::make_shared<t_vec>(size(), val);
+		else
+			std::fill(m_pVec->begin(), m_pVec->end(), val);
+	}
+
+	void assign(const T* pBegin, const T* pEnd)
+	{
+		if(IsShared())
+			m_pVec = std::make_shared<t_vec>(pBegin, pEnd);
+		else
+			m_pVec->assign(pBegin, pEnd);
+	}
+
+	// takes over the contents of vec
+	void Replace(t_vec&& vec) { m_pVec = std::make_shared<t_vec>(std::move(vec)); }
+};
+
+#endif
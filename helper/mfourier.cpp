@@ -8,12 +8,22 @@
 
 #include "mfourier.h"
 
-MFourier::MFourier(unsigned int iSize) : tl::Fourier<double>(iSize)
+std::mutex FourierPlanLock::s_mtxPlan;
+
+MFourier::MFourier(unsigned int iSize)
+	: MFourier(iSize, std::unique_lock<std::mutex>(s_mtxPlan))
 {}
 
-MFourier::~MFourier()
+MFourier::MFourier(unsigned int iSize, std::unique_lock<std::mutex>&&)
+	: FourierPlanLock(), tl::Fourier<double>(iSize)
 {}
 
+MFourier::~MFourier()
+{
+	// released by ~FourierPlanLock after ~Fourier has freed the plans
+	m_lockFree = std::unique_lock<std::mutex>(s_mtxPlan);
+}
+
 bool MFourier::shift_sin(double dNumOsc, const double* pDatIn,
 				double *pDataOut, double dPhase)
 {
@@ -10,6 +10,7 @@
 #define __MIEZE_FOURIER__
 
 #include "tlibs/math/fourier.h"
+#include <mutex>
 
 
 //------------------------------------------------------------------------------
@@ -35,8 +36,21 @@ std::complex<T> phase_correction_1(const std::complex<T>& c,
 
 
 //------------------------------------------------------------------------------
-class MFourier : public tl::Fourier<double>
+// the fftw planner is not thread-safe, plans are only made and freed while holding the lock;
+// this base is destroyed last, so a lock taken in the derived destructor covers the freeing
+class FourierPlanLock
 {
+	protected:
+		static std::mutex s_mtxPlan;
+		std::unique_lock<std::mutex> m_lockFree;
+};
+
+class MFourier : protected FourierPlanLock, public tl::Fourier<double>
+{
+	protected:
+		// the plans are made while lockPlan is held, it is also released if this throws
+		MFourier(unsigned int iSize, std::unique_lock<std::mutex>&& lockPlan);
+
 	public:
 		MFourier(unsigned int iSize);
 		virtual ~MFourier();
@@ -12,6 +12,7 @@
 
 #ifndef NO_COMP
 	#include "tlibs/file/comp.h"
+	#include "blob.h"
 #endif
 
 StringMap::StringMap(const char* pcKeyValSep, const char* pcComment)
@@ -139,7 +140,8 @@ bool StringMap::Serialize(std::ostream& ostrSer) const
 		iCurIdx += strVal.length()+1;
 	}
 
-	bool bOk = tl::comp_mem_to_stream<char>(pcMem, iLen, ostrSer, tl::Compressor::BZ2);
+	// compressor chosen for the session, Deserialize detects it
+	bool bOk = blob_compress_to_stream(pcMem, iLen, ostrSer, get_blob_codec(ostrSer));
 	delete[] pcMem;
 
 	return bOk;
@@ -0,0 +1,190 @@
+/**
+ * work-stealing thread pool for cost-weighted tasks
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_WORKPOOL_H__
+#define __MIEZE_WORKPOOL_H__
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/*
+ * tasks are added with an estimated cost and handed out largest first
+ * (greedy assignment to the least-loaded queue); an idle worker steals
+ * the cheapest remaining task from the back of another worker's queue
+ */
+class WorkPool
+{
+public:
+	typedef std::function<void()> t_task;
+
+protected:
+	struct Task
+	{
+		t_task fkt;
+		double dCost;
+	};
+
+	struct Queue
+	{
+		std::mutex mtx;
+		std::deque<Task> tasks;
+		double dLoad = 0.;
+	};
+
+	std::vector<Task> m_vecPending;
+	std::vector<std::unique_ptr<Queue>> m_vecQueues;
+	std::vector<std::thread> m_vecThreads;
+
+	std::mutex m_mtxDone;
+	std::condition_variable m_cvDone;
+	unsigned int m_iNumTasks = 0;
+	unsigned int m_iNumDone = 0;
+
+	// cores available to this pool, shared among its workers for nested pools
+	unsigned int m_iBudget = 1;
+
+	// thread count for pools created in the current thread, 0: not a worker
+	static unsigned int& NestedThreads()
+	{
+		static thread_local unsigned int iNumThreads = 0;
+		return iNumThreads;
+	}
+
+	bool PopOwn(unsigned int iQueue, Task& task)
+	{
+		Queue& queue = *m_vecQueues[iQueue];
+		std::lock_guard<std::mutex> lock(queue.mtx);
+		if(queue.tasks.empty())
+			return false;
+
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		return true;
+	}
+
+	bool Steal(unsigned int iThief, Task& task)
+	{
+		const unsigned int iNumQueues = m_vecQueues.size();
+		for(unsigned int iOffs=1; iOffs<iNumQueues; ++iOffs)
+		{
+			Queue& queue = *m_vecQueues[(iThief+iOffs) % iNumQueues];
+			std::lock_guard<std::mutex> lock(queue.mtx);
+			if(queue.tasks.empty())
+				continue;
+
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			return true;
+		}
+		return false;
+	}
+
+	void Work(unsigned int iQueue, unsigned int iNested)
+	{
+		NestedThreads() = iNested;
+
+		Task task;
+		while(PopOwn(iQueue, task) || Steal(iQueue, task))
+		{
+			task.fkt();
+
+			std::lock_guard<std::mutex> lock(m_mtxDone);
+			++m_iNumDone;
+			m_cvDone.notify_all();
+		}
+	}
+
+public:
+	/*
+	 * iNumThreads = 0: all cores, or, for a pool created inside another
+	 * pool's task, that worker's share of the cores
+	 */
+	WorkPool(unsigned int iNumThreads=0)
+	{
+		m_iBudget = NestedThreads();
+		if(m_iBudget == 0)
+			m_iBudget = std::thread::hardware_concurrency();
+		if(m_iBudget == 0)
+			m_iBudget = 1;
+
+		if(iNumThreads == 0)
+			iNumThreads = m_iBudget;
+
+		for(unsigned int iTh=0; iTh<iNumThreads; ++iTh)
+			m_vecQueues.emplace_back(new Queue);
+	}
+
+	~WorkPool() { Join(); }
+
+	WorkPool(const WorkPool&) = delete;
+	WorkPool& operator=(const WorkPool&) = delete;
+
+	// only valid before Start()
+	void AddTask(const t_task& fkt, double dCost=1.)
+	{
+		m_vecPending.push_back(Task{fkt, dCost});
+	}
+
+	void Start()
+	{
+		std::stable_sort(m_vecPending.begin(), m_vecPending.end(),
+			[](const Task& task1, const Task& task2) -> bool
+			{ return task1.dCost > task2.dCost; });
+
+		for(Task& task : m_vecPending)
+		{
+			auto iterMin = std::min_element(m_vecQueues.begin(), m_vecQueues.end(),
+				[](const std::unique_ptr<Queue>& q1, const std::unique_ptr<Queue>& q2) -> bool
+				{ return q1->dLoad < q2->dLoad; });
+
+			(*iterMin)->dLoad += task.dCost;
+			(*iterMin)->tasks.push_back(std::move(task));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mtxDone);
+			m_iNumTasks = m_vecPending.size();
+		}
+		m_vecPending.clear();
+
+		// no need for more threads than tasks
+		const unsigned int iNumThreads = std::min<unsigned int>(m_vecQueues.size(), m_iNumTasks);
+		// pools nested in the tasks don't oversubscribe the cores
+		const unsigned int iNested = std::max<unsigned int>(m_iBudget / std::max(iNumThreads, 1u), 1u);
+		for(unsigned int iTh=0; iTh<iNumThreads; ++iTh)
+			m_vecThreads.emplace_back(&WorkPool::Work, this, iTh, iNested);
+	}
+
+	// blocks until more than iLastDone tasks are finished, returns the new count
+	unsigned int WaitProgress(unsigned int iLastDone)
+	{
+		std::unique_lock<std::mutex> lock(m_mtxDone);
+		m_cvDone.wait(lock, [this, iLastDone]() -> bool
+			{ return m_iNumDone > iLastDone || m_iNumDone >= m_iNumTasks; });
+		return m_iNumDone;
+	}
+
+	void Join()
+	{
+		for(std::thread& th : m_vecThreads)
+			if(th.joinable())
+				th.join();
+		m_vecThreads.clear();
+	}
+
+	unsigned int GetNumTasks() const { return m_iNumTasks; }
+	unsigned int GetNumThreads() const { return m_vecQueues.size(); }
+};
+
+#endif
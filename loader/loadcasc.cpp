@@ -99,7 +99,7 @@ TofFile::~TofFile()
 
 void TofFile::LoadParams()
 {
-	qint64 iDataLen = qint64(GetWidth()*GetHeight()*GetImgCnt()*sizeof(int));
+	qint64 iDataLen = qint64(GetWidth())*GetHeight()*GetImgCnt()*qint64(sizeof(int));
 	qint64 iFileLen = m_file.size();
 	qint64 iParamLen = iFileLen-iDataLen;
 
@@ -168,8 +168,8 @@ const unsigned int* TofFile::GetData(unsigned int iFoil)
 	std::vector<unsigned int> vecStartIndices = GetStartIndices();
 	const unsigned int iStartIdx = vecStartIndices[iFoil];
 
-	qint64 iStart = qint64(iStartIdx*iW*iH*sizeof(int));
-	qint64 iLen = qint64(iW*iH*iTcCnt*sizeof(int));
+	qint64 iStart = qint64(iStartIdx)*iW*iH*qint64(sizeof(int));
+	qint64 iLen = qint64(iW)*iH*iTcCnt*qint64(sizeof(int));
 
 	qint64 iSize = m_file.size();
 	if(iStart+iLen > iSize)
@@ -0,0 +1,45 @@
+/**
+ * mieze-tool
+ * applies the global settings to the data and fitter modules
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "globals.h"
+#include "settings.h"
+#include "tlibs/log/log.h"
+#include "fitter/parser.h"
+#include "fitter/lm.h"
+#include "data/sumtable.h"
+#include "data/sparse.h"
+#include "data/chunked.h"
+
+#include <string>
+
+void apply_global_settings()
+{
+	int iDebugLevel = Settings::Get<int>("misc/debug_level");
+
+	tl::log_debug.SetEnabled(iDebugLevel>=4);
+	tl::log_info.SetEnabled(iDebugLevel>=3);
+	tl::log_warn.SetEnabled(iDebugLevel>=2);
+	tl::log_err.SetEnabled(iDebugLevel>=1);
+	tl::log_crit.SetEnabled(1);
+
+#ifdef USE_JIT
+	Parser::SetNativeOptions(Settings::Get<QString>("jit/compiler").toStdString(),
+		Settings::Get<QString>("jit/cache_dir").toStdString(),
+		Settings::Get<unsigned int>("jit/hot_points"));
+#endif
+
+	// Levenberg-Marquardt instead of Minuit for the selected models
+	for(const char* pcModel : {"mieze_sine", "mieze_exp", "gaussian", "multi_gaussian", "user_defined"})
+		set_lm_solver(pcModel, Settings::Get<int>((std::string("fit/lm_") + pcModel).c_str()));
+
+	set_use_sum_tables(Settings::Get<int>("misc/sum_tables"));
+	set_sparse_threshold(Settings::Get<double>("misc/sparse_threshold"));
+	set_chunked_min_size(Settings::Get<qint64>("misc/chunked_min_size"));
+	set_chunk_cache_size(Settings::Get<qint64>("misc/chunk_cache_size"));
+	set_chunk_dir(Settings::Get<QString>("misc/spill_dir").toStdString());
+}
@@ -0,0 +1,15 @@
+/**
+ * mieze-tool
+ * applies the global settings to the data and fitter modules
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_GLOBALS__
+#define __MIEZE_GLOBALS__
+
+// log levels, fitter and storage options; also used by the headless tools
+extern void apply_global_settings();
+
+#endif
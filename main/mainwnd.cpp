@@ -14,6 +14,7 @@
 #include <QtGui/QFileDialog>
 #include <QtGui/QMessageBox>
 #include <QtGui/QStatusBar>
+#include <QtGui/QActionGroup>
 #include <QtCore/QSignalMapper>
 
 #include <iostream>
@@ -52,7 +53,8 @@ MiezeMainWnd::MiezeMainWnd()
 	  m_pphasecorrdlg(0), m_pradialintdlg(0),
 	  m_pformuladlg(0),	m_pplotpropdlg(0),
 	  m_prebindlg(0), m_pexportdlg(0),
-	  m_pnormdlg(0)
+	  m_pnormdlg(0),
+	  m_iSessGeneration(0), m_iSessBlobLen(0)
 {
 	this->setWindowIcon(QIcon("res/mainicon.png"));
 	this->setWindowTitle(WND_TITLE);
@@ -126,6 +128,21 @@ MiezeMainWnd::MiezeMainWnd()
 	m_pRetainSession->setCheckable(1);
 	pMenuFile->addAction(m_pRetainSession);
 
+	QMenu *pMenuSessCodec = new QMenu(this);
+	pMenuSessCodec->setTitle("Session Compression");
+	QActionGroup *pGroupSessCodec = new QActionGroup(this);
+	const char* pcCodecs[] = {"None", "Fast", "Best Ratio"};
+	for(unsigned int iCodec=0; iCodec<3; ++iCodec)
+	{
+		m_pSessCodec[iCodec] = new QAction(this);
+		m_pSessCodec[iCodec]->setText(pcCodecs[iCodec]);
+		m_pSessCodec[iCodec]->setCheckable(1);
+		pGroupSessCodec->addAction(m_pSessCodec[iCodec]);
+		pMenuSessCodec->addAction(m_pSessCodec[iCodec]);
+	}
+	pMenuFile->addMenu(pMenuSessCodec);
+	SetSessionCodec(BlobCodec(Settings::Get<int>("misc/session_codec")));
+
 
 	QAction *pSettings = new QAction(this);
 	pSettings->setText("Settings...");
@@ -410,6 +427,8 @@ MiezeMainWnd::MiezeMainWnd()
 	pStatusBar->addWidget(m_pStatusLabelLeft, 1);
 	pStatusBar->addWidget(m_pStatusLabelMiddle, 1);
 	pStatusBar->addWidget(m_pStatusLabelRight, 1);
+	m_pStatusLabelMem = new QLabel(this);
+	pStatusBar->addPermanentWidget(m_pStatusLabelMem);
 	//--------------------------------------------------------------------------------
 
 
@@ -422,6 +441,7 @@ MiezeMainWnd::MiezeMainWnd()
 	QObject::connect(pLoadSess, SIGNAL(triggered()), this, SLOT(SessionLoadTriggered()));
 	QObject::connect(pSaveSess, SIGNAL(triggered()), this, SLOT(SessionSaveTriggered()));
 	QObject::connect(pSaveSessAs, SIGNAL(triggered()), this, SLOT(SessionSaveAsTriggered()));
+	QObject::connect(pGroupSessCodec, SIGNAL(triggered(QAction*)), this, SLOT(SessionCodecTriggered()));
 
 	QObject::connect(pNorm, SIGNAL(triggered()), this, SLOT(NormalizeTriggered()));
 	QObject::connect(pShowT, SIGNAL(triggered()), this, SLOT(ShowTimeChannels()));
@@ -486,6 +506,9 @@ MiezeMainWnd::MiezeMainWnd()
 
 MiezeMainWnd::~MiezeMainWnd()
 {
+	// the saved index refers to the uncompacted blob, a pending compaction is discarded
+	ResetSessionIndex();
+
 	if(m_pcombinedlg) delete m_pcombinedlg;
 	if(m_pfitdlg) delete m_pfitdlg;
 	if(m_proidlg) delete m_proidlg;
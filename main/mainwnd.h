@@ -16,7 +16,9 @@
 
 #include <vector>
 #include <string>
+#include <map>
 #include <mutex>
+#include <future>
 
 #include "subwnd.h"
 #include "plot/plot.h"
@@ -46,6 +48,29 @@ enum InterpFkt
 	INTERP_BSPLINE
 };
 
+// saved state of a window in the current session file
+struct SessionWndEntry
+{
+	unsigned int iOrder = 0;
+	unsigned long iVersion = 0;
+
+	std::string strGeo;
+	int iGeoX = 0, iGeoY = 0;
+	bool bHasGeo = 0;
+
+	std::string strXml;			// window xml, blob offsets relative to its region
+	qint64 iBlobOffs = 0, iBlobLen = 0;	// region in the session blob
+};
+
+// result of copying the live blob regions into a new file
+struct SessionCompaction
+{
+	bool bOk = 0;
+	std::string strBlob, strBlobCompact;
+	qint64 iOldLen = 0, iNewLen = 0;
+	std::map<qint64, qint64> mapOffs;	// old -> new region offset
+};
+
 class MiezeMainWnd : public QMainWindow
 { Q_OBJECT
 protected:
@@ -55,6 +80,8 @@ protected:
 	InfoDock *m_pinfo;
 
 	QAction *m_pRetainSession;
+	QAction *m_pSessCodec[3];
+	BlobCodec m_sessCodec;
 
 	CombineGraphsDlg *m_pcombinedlg;
 	FitDlg *m_pfitdlg;
@@ -74,6 +101,7 @@ protected:
 	std::vector<QAction*> m_vecSubWndActions;
 
 	QLabel *m_pStatusLabelLeft, *m_pStatusLabelMiddle, *m_pStatusLabelRight;
+	QLabel *m_pStatusLabelMem;
 
 	std::string m_strLastXColumn;
 	std::string m_strLastYColumn;
@@ -88,6 +116,20 @@ protected:
 
 	std::string m_strCurSess;
 
+	// index of the session file last saved or loaded, windows not
+	// modified since then keep their blob regions on the next save
+	std::string m_strSessIndex;
+	unsigned int m_iSessGeneration;
+	qint64 m_iSessBlobLen;
+	std::map<const SubWindowBase*, SessionWndEntry> m_mapSessWnds;
+	std::future<SessionCompaction> m_futCompact;
+
+	// memory budget: last activation of every window and the data size of
+	// the windows spilled to cache files
+	std::map<const SubWindowBase*, unsigned long> m_mapWndUse;
+	std::map<const SubWindowBase*, std::size_t> m_mapWndSpilled;
+	unsigned long m_iWndUseCounter = 0;
+
 
 protected:
 	SubWindowBase* GetActivePlot(bool bResolveWidget=1);
@@ -106,6 +148,14 @@ protected:
 	void LoadRecentSessionList();
 	void UpdateRecentSessionMenu();
 	void AddRecentSession(const QString& strSession);
+	void SetSessionCodec(BlobCodec codec);
+
+	// incremental session saving
+	void ResetSessionIndex();
+	bool WriteSessionIndex();
+	bool SaveSession();
+	void StartSessionCompaction();
+	void FinishSessionCompaction(bool bWait);
 
 	QMdiSubWindow* FindSubWindow(SubWindowBase* pSWB);
 	std::vector<SubWindowBase*> GetSubWindows(bool bResolveActualWidget=1);
@@ -140,6 +190,7 @@ protected slots:
 	void SessionLoadTriggered();
 	void SessionSaveTriggered();
 	void SessionSaveAsTriggered();
+	void SessionCodecTriggered();
 
 	void RebinTriggered();
 
@@ -206,6 +257,9 @@ public slots:
 protected slots:
 	void SubWindowDestroyed(SubWindowBase *pSWB);
 
+	// spills the least recently used windows while the budget is exceeded
+	void CheckMemoryBudget();
+
 signals:
 	void SubWindowRemoved(SubWindowBase *pSWB);
 	void SubWindowAdded(SubWindowBase *pSWB);
@@ -19,6 +19,7 @@
 #include "loader/loadtxt.h"
 #include "loader/loadnicos.h"
 #include "loader/loadcasc.h"
+#include "data/calib.h"
 
 #include <QtGui/QMdiSubWindow>
 #include <QtGui/QMessageBox>
@@ -59,50 +60,19 @@ void MiezeMainWnd::LoadFile(const std::string& _strFile)
 
 	if(tl::str_is_equal(strExt, std::string("tof")))
 	{
-		TofFile tof(strFile.c_str());
-		if(!tof.IsOpen())
-			return;
-
-		const uint iW = tof.GetWidth();
-		const uint iH = tof.GetHeight();
-		const uint iTcCnt = tof.GetTcCnt();
-		const uint iFoilCnt = tof.GetFoilCnt();
-
 		std::string strTitle = GetPlotTitle(strFileNoDir);
 		Plot4dWrapper *pPlotWrapper = new Plot4dWrapper(m_pmdi, strTitle.c_str(), true);
 		Plot4d *pPlot = (Plot4d*)pPlotWrapper->GetActualWidget();
-		Data4& dat4 = pPlot->GetData();
-		dat4.SetSize(iW, iH, iTcCnt, iFoilCnt);
 
-		double *pdDat = new double[iW*iH*iTcCnt];
-		double *pdErr = new double[iW*iH*iTcCnt];
-		for(uint iFoil=0; iFoil<iFoilCnt; ++iFoil)
+		if(!calib_load_tof(strFile.c_str(), CalibConfig::FromSettings(), pPlot->GetData()))
 		{
-			const uint* pDat = tof.GetData(iFoil);
-			if(!pDat)
-			{
-				tl::log_err("Could not load \"", strFileNoDir, "\" correctly.");
-				break;
-			}
-			tl::convert(pdDat, pDat, iW*iH*iTcCnt);
-
-			//for(unsigned int iTc=0; iTc<iTcCnt; ++iTc)
-			//	for(unsigned int iY=0; iY<iH; ++iY)
-			//		convert(pdDat+iTc*iW*iH + iY*iW, pDat + iTc*iW*iH + (iH-iY-1)*iW, iW);
-
-			tof.ReleaseData(pDat);
-
-			tl::apply_fkt(pdDat, pdErr, ::sqrt, iW*iH*iTcCnt);
-			dat4.SetVals(iFoil, pdDat, pdErr);
+			delete pPlotWrapper;
+			return;
 		}
-		delete[] pdDat;
-		delete[] pdErr;
 
 		pPlot->plot_manual();
 		pPlot->SetLabels("x pixels", "y pixels", "");
 
-		pPlot->GetData().SetParamMapStat(tof.GetParamMap());
-
 		AddSubWindow(pPlotWrapper);
 		pPlotWrapper->GetActualWidget()->RefreshPlot();
 
@@ -129,14 +99,30 @@ void MiezeMainWnd::LoadFile(const std::string& _strFile)
 		const uint iH = pad.GetHeight();
 
 		double *pdDat = new double[iW*iH];
-		tl::convert(pdDat, pDat, iW*iH);
+
+		const CalibConfig calibcfg = CalibConfig::FromSettings();
+		std::shared_ptr<const CalibTables> pCalib;
+		if(calibcfg.bEnabled)
+			pCalib = get_calib_tables(calibcfg, iW, iH);
+
+		std::vector<double> vecErr;
+		if(pCalib)
+		{
+			vecErr.resize(iW*iH);
+			calib_apply(*pCalib, get_calib_dead_time(calibcfg, pad.GetParamMap()),
+				0, 0, 1, pDat, pdDat, vecErr.data());
+		}
+		else
+		{
+			tl::convert(pdDat, pDat, iW*iH);
+		}
 		//for(unsigned int iY=0; iY<iH; ++iY)
 		//	convert(pdDat+iY*iW, pDat+(iH-iY-1)*iW, iW);
 
 		std::string strTitle = GetPlotTitle(strFileNoDir);
 		Plot2d *pPlot = new Plot2d(m_pmdi, strTitle.c_str(), true);
 
-		pPlot->plot(iW, iH, pdDat);
+		pPlot->plot(iW, iH, pdDat, vecErr.size() ? vecErr.data() : 0);
 		pPlot->SetLabels("x pixels", "y pixels", "");
 
 		pPlot->GetData2().SetParamMapStat(pad.GetParamMap());
@@ -8,8 +8,14 @@
 
 #include "mainwnd.h"
 #include "settings.h"
+#include "tlibs/log/log.h"
 
 #include <QtGui/QMdiSubWindow>
+#include <QtCore/QTimer>
+#include <QtCore/QDir>
+
+#include <sstream>
+#include <algorithm>
 
 
 QMdiSubWindow* MiezeMainWnd::FindSubWindow(SubWindowBase* pSWB)
@@ -21,7 +27,7 @@ QMdiSubWindow* MiezeMainWnd::FindSubWindow(SubWindowBase* pSWB)
 		SubWindowBase* pCurSWB = (SubWindowBase*)pWnd->widget();
 		if(!pCurSWB) continue;
 
-		if(pCurSWB==pSWB || pCurSWB->GetActualWidget()==pSWB)
+		if(pCurSWB==pSWB || pCurSWB->GetActualWidgetNoLoad()==pSWB)
 			return pWnd;
 	}
 
@@ -71,7 +77,7 @@ void MiezeMainWnd::UpdateSubWndList()
 	{
 		if(pSWB)
 		{
-			bool bActiveWindow = (pSWB == pSWBActive || pSWB->GetActualWidget() == pSWBActive);
+			bool bActiveWindow = (pSWB == pSWBActive || pSWB->GetActualWidgetNoLoad() == pSWBActive);
 			QString strTitle = pSWB->windowTitle();
 
 			QAction *pAction = new QAction(pMenuWindows);
@@ -104,6 +110,17 @@ void MiezeMainWnd::SubWindowChanged()
 	SubWindowBase* pSWB = (SubWindowBase*)pWnd->widget();
 	bool bSignal = 1;
 
+	// first activation of a lazily restored session window
+	if(pSWB->IsDeferred())
+	{
+		SetStatusMsg("Loading window data...", 2);
+		pSWB->Materialize();
+		SetStatusMsg("", 2);
+	}
+
+	m_mapWndUse[pSWB] = ++m_iWndUseCounter;
+	CheckMemoryBudget();
+
 	const StringMap *pMapOverride = 0;
 
 	if(pSWB->GetType() == PLOT_1D)
@@ -170,10 +187,95 @@ void MiezeMainWnd::PlotParamsDynChanged(const StringMap&)
 
 void MiezeMainWnd::SubWindowDestroyed(SubWindowBase *pSWB)
 {
+	m_mapWndUse.erase(pSWB);
+	m_mapWndSpilled.erase(pSWB);
+
+	// the window is only removed from the mdi area afterwards
+	QTimer::singleShot(0, this, SLOT(CheckMemoryBudget()));
+
 	emit SubWindowRemoved(pSWB);
 }
 
 
+static std::string mem_str(std::size_t iBytes)
+{
+	std::ostringstream ostr;
+	ostr.precision(1);
+	ostr << std::fixed << double(iBytes)/(1024.*1024.) << " MB";
+	return ostr.str();
+}
+
+void MiezeMainWnd::CheckMemoryBudget()
+{
+	const std::size_t iBudget = std::size_t(Settings::Get<qint64>("misc/mem_budget"));
+
+	QMdiSubWindow *pActiveWnd = m_pmdi->activeSubWindow();
+	const SubWindowBase *pActive = pActiveWnd ? (SubWindowBase*)pActiveWnd->widget() : 0;
+
+	struct WndMem
+	{
+		SubWindowBase *pWnd;
+		std::size_t iMem;
+		unsigned long iUse;
+	};
+
+	std::vector<WndMem> vecCandidates;
+	std::size_t iResident = 0;
+
+	for(SubWindowBase *pWnd : GetSubWindows(0))
+	{
+		if(pWnd->IsDeferred())
+			continue;
+
+		// restored on activation
+		m_mapWndSpilled.erase(pWnd);
+
+		SubWindowBase *pActual = pWnd->GetActualWidgetNoLoad();
+		iResident += pActual->GetMemory();
+
+		const std::size_t iReleasable = pActual->GetReleasableMemory();
+		if(pWnd != pActive && iReleasable)
+			vecCandidates.push_back(WndMem{pWnd, iReleasable, m_mapWndUse[pWnd]});
+	}
+
+	if(iBudget && iResident > iBudget)
+	{
+		std::sort(vecCandidates.begin(), vecCandidates.end(),
+			[](const WndMem& wnd1, const WndMem& wnd2) -> bool
+			{ return wnd1.iUse < wnd2.iUse; });
+
+		std::string strDir = Settings::Get<QString>("misc/spill_dir").toStdString();
+		if(strDir == "")
+			strDir = QDir::tempPath().toStdString();
+
+		for(const WndMem& wnd : vecCandidates)
+		{
+			if(iResident <= iBudget)
+				break;
+
+			SetStatusMsg(("Moving " + wnd.pWnd->windowTitle().toStdString() + " to disk.").c_str(), 2);
+			if(!wnd.pWnd->Spill(strDir))
+				continue;
+
+			iResident -= std::min(iResident, wnd.iMem);
+			m_mapWndSpilled[wnd.pWnd] = wnd.iMem;
+			tl::log_info("Spilled window \"", wnd.pWnd->windowTitle().toStdString(),
+				"\" to \"", strDir, "\", ", mem_str(wnd.iMem), ".");
+		}
+		SetStatusMsg("", 2);
+	}
+
+	std::size_t iSpilled = 0;
+	for(const auto& pairSpilled : m_mapWndSpilled)
+		iSpilled += pairSpilled.second;
+
+	std::string strMem = "Memory: " + mem_str(iResident);
+	if(iSpilled)
+		strMem += ", on disk: " + mem_str(iSpilled);
+	m_pStatusLabelMem->setText(strMem.c_str());
+}
+
+
 void MiezeMainWnd::AddSubWindow(SubWindowBase* pWnd, bool bShow)
 {
 	if(!pWnd) return;
@@ -183,12 +285,14 @@ void MiezeMainWnd::AddSubWindow(SubWindowBase* pWnd, bool bShow)
 		std::lock_guard<std::mutex> _lck(m_mutex);
 
 		pWnd->setParent(m_pmdi);
-		SubWindowBase *pActualWidget = pWnd->GetActualWidget();
+		// deferred windows stay unloaded until they are used
+		SubWindowBase *pActualWidget = pWnd->GetActualWidgetNoLoad();
 		QObject::connect(pWnd, SIGNAL(WndDestroyed(SubWindowBase*)), this, SLOT(SubWindowDestroyed(SubWindowBase*)));
 		QObject::connect(pActualWidget, SIGNAL(SetStatusMsg(const char*, int)), this, SLOT(SetStatusMsg(const char*, int)));
 		QObject::connect(pActualWidget, SIGNAL(ParamsChanged(const StringMap&)), this, SLOT(PlotParamsDynChanged(const StringMap&)));
 
 		pSubWnd = m_pmdi->addSubWindow(pWnd);
+		m_mapWndUse[pWnd] = ++m_iWndUseCounter;
 		emit SubWindowAdded(pWnd);
 	}
 
@@ -199,6 +303,8 @@ void MiezeMainWnd::AddSubWindow(SubWindowBase* pWnd, bool bShow)
 		//pWnd->RefreshPlot();
 		//std::cout << "subwindow added" << std::endl;
 	}
+
+	CheckMemoryBudget();
 }
 
 
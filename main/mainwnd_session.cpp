@@ -15,70 +15,189 @@
 #include <QtGui/QMessageBox>
 #include <QtGui/QFileDialog>
 #include <QtCore/QSignalMapper>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
 
 #include <fstream>
+#include <iterator>
 #include <algorithm>
-#include <thread>
-//#include <chrono>
-#include <unistd.h>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+
+#include "helper/workpool.h"
 
 
 // --------------------------------------------------------------------------------
 
-static void session_load_progress_thread(std::vector<int>* pvecProgress, bool* pbRunning, MiezeMainWnd *pWnd)
+/*
+ * estimated loading cost of a sub-window: the blob bytes of all its data objects;
+ * data stored directly in the xml is small and only counted as a base cost
+ */
+static double session_wnd_cost(tl::Xml& xml, const std::string& strSWBase, const std::string& strSWType)
 {
-	while(*pbRunning)
+	std::vector<std::string> vecDataBase;
+	if(strSWType == "plot_1d")
+	{
+		unsigned int iDatCnt = xml.Query<unsigned int>((strSWBase + "data_count").c_str(), 0);
+		for(unsigned int iDat=0; iDat<iDatCnt; ++iDat)
+		{
+			std::ostringstream ostrObj;
+			ostrObj << strSWBase << "plot_obj_" << iDat << "/data/";
+			vecDataBase.push_back(ostrObj.str());
+		}
+	}
+	else if(strSWType == "plot_2d")
+	{
+		vecDataBase.push_back(strSWBase + "data/");
+	}
+	else if(strSWType == "plot_3d" || strSWType == "plot_4d")
 	{
-		unsigned int iLoaded = std::count(pvecProgress->begin(), pvecProgress->end(), 1);
-		unsigned int iTotal = pvecProgress->size();
+		vecDataBase.push_back(strSWBase + "data/");
+		vecDataBase.push_back(strSWBase + "sub_2d/data/");
+	}
 
-		std::ostringstream ostrLoading;
-		ostrLoading << "Loaded " << iLoaded << " of " << iTotal << ".";
-		pWnd->SetStatusMsg(ostrLoading.str().c_str(), 2);
+	static const char* pcVecs[] = {"vals", "errs", "x", "y", "x_err", "y_err"};
 
-		// all plots loaded
-		if(iLoaded >= iTotal)
-			break;
+	double dCost = 1.;
+	for(const std::string& strDataBase : vecDataBase)
+	{
+		if(!xml.Query<bool>((strDataBase + "in_blob").c_str(), 0))
+			continue;
+
+		for(const char* pcVec : pcVecs)
+			dCost += xml.Query<double>((strDataBase + "blob_" + pcVec + "_size").c_str(), 0.);
+	}
+
+	return dCost;
+}
+
+/*
+ * xml text of a window block following its blob region tags,
+ * i.e. everything which does not change unless the window does
+ */
+static bool session_wnd_fragment(const std::string& strSess, unsigned int iWnd, std::string& strFrag)
+{
+	std::ostringstream ostrBegin, ostrEnd;
+	ostrBegin << "<window_" << iWnd << ">";
+	ostrEnd << "</window_" << iWnd << ">";
+
+	const std::size_t iBegin = strSess.find(ostrBegin.str());
+	if(iBegin == std::string::npos)
+		return false;
+	const std::size_t iEnd = strSess.find(ostrEnd.str(), iBegin);
+	if(iEnd == std::string::npos)
+		return false;
+
+	const std::string strMarker = "</blob_len>\n";
+	std::size_t iFrag = strSess.find(strMarker, iBegin);
+	if(iFrag == std::string::npos || iFrag > iEnd)
+		return false;
+	iFrag += strMarker.length();
+
+	strFrag = strSess.substr(iFrag, iEnd-iFrag);
+	return true;
+}
 
-		usleep(500);
+static qint64 session_file_len(const std::string& strFile)
+{
+	std::ifstream ifstr(strFile, std::ifstream::binary | std::ifstream::ate);
+	if(!ifstr)
+		return 0;
+	return qint64(ifstr.tellg());
+}
 
-		//std::chrono::duration<int, std::milli> sleeptime(250);
-		//std::this_thread::sleep_for(sleeptime);
+static bool session_copy_region(std::istream& istr, std::ostream& ostr,
+	qint64 iLen, std::vector<char>& vecBuf)
+{
+	while(iLen > 0)
+	{
+		const std::streamsize iChunk = std::streamsize(std::min<qint64>(iLen, vecBuf.size()));
+		if(!istr.read(vecBuf.data(), iChunk))
+			return false;
+		ostr.write(vecBuf.data(), iChunk);
+		iLen -= iChunk;
 	}
+	return bool(ostr);
 }
 
-static void session_load_thread(tl::Xml* xml, Blob* blob,
-	const std::vector<std::string>* vecBase,
-	const std::vector<unsigned int>* vecWndIdx,
-	SubWindowBase **pSWBs, int *piProgress)
+// copies the live regions (sorted by offset) of a session blob into a new file
+static SessionCompaction session_compact(const std::string& strBlob,
+	std::vector<std::pair<qint64, qint64>> vecRegions, qint64 iOldLen)
 {
-	for(unsigned int iWnd : *vecWndIdx)
+	SessionCompaction res;
+	res.strBlob = strBlob;
+	res.strBlobCompact = strBlob + ".compact";
+	res.iOldLen = iOldLen;
+
+	std::ifstream ifstr(strBlob, std::ifstream::binary);
+	std::ofstream ofstr(res.strBlobCompact, std::ofstream::binary);
+	if(!ifstr || !ofstr)
+		return res;
+
+	std::vector<char> vecBuf(BLOB_CHUNK_SIZE);
+	for(const std::pair<qint64, qint64>& region : vecRegions)
 	{
-		pSWBs[iWnd]->LoadXML(*xml, *blob, (*vecBase)[iWnd]);
-		piProgress[iWnd] = 1;
+		if(res.mapOffs.find(region.first) != res.mapOffs.end())
+			continue;
+
+		ifstr.seekg(region.first);
+		if(!session_copy_region(ifstr, ofstr, region.second, vecBuf))
+			return res;
+
+		res.mapOffs[region.first] = res.iNewLen;
+		res.iNewLen += region.second;
 	}
+
+	ofstr.close();
+	res.bOk = !ofstr.fail();
+	return res;
 }
 
 // session loading/saving
 void MiezeMainWnd::LoadSession(const std::string& strSess)
 {
-	tl::Xml xml;
+	// the source stays alive as long as any window still has to load from it
+	std::shared_ptr<SessionSource> pSrc(new SessionSource((strSess+".blob").c_str()));
+	tl::Xml& xml = pSrc->xml;
+	Blob& blob = pSrc->blob;
+
 	if(!xml.Load(strSess.c_str()))
 	{
 		QMessageBox::critical(this, "Error", "Failed to load session.");
 		return;
 	}
 
-	Blob blob((strSess+".blob").c_str());
+	// only create the windows now, their data is loaded on first use
+	const bool bLazy = Settings::Get<int>("misc/lazy_session_load");
 
 	//CloseAllTriggeredWithRetain();
-	if(!m_pRetainSession->isChecked())
+	const bool bRetain = m_pRetainSession->isChecked();
+	std::string strSessText;
+	if(!bRetain)
+	{
 		m_strCurSess = strSess;
 
+		// unchanged windows keep their blob regions when saving again
+		ResetSessionIndex();
+		m_strSessIndex = strSess;
+		m_iSessGeneration = xml.Query<unsigned int>("/cattus_session/generation", 0);
+		m_iSessBlobLen = session_file_len(strSess + ".blob");
+
+		std::ifstream ifstrSess(strSess);
+		strSessText.assign(std::istreambuf_iterator<char>(ifstrSess), std::istreambuf_iterator<char>());
+	}
+
 	std::string strBase = "/cattus_session/";
 	m_iPlotCnt = xml.Query<unsigned int>((strBase + "plot_counter").c_str(), 0);
 	unsigned int iWndCnt = xml.Query<unsigned int>((strBase + "window_counter").c_str(), 0);
 
+	bool bHasCodec = 0;
+	int iCodec = xml.Query<int>((strBase + "blob_codec").c_str(), 0, &bHasCodec);
+	if(bHasCodec && !m_pRetainSession->isChecked())
+		SetSessionCodec(BlobCodec(iCodec));
+
 	/*std::string strGeo = xml.QueryString((strBase+"viewport_geo").c_str(), "");
 	::trim(strGeo);
 	if(strGeo != "")
@@ -86,15 +205,13 @@ void MiezeMainWnd::LoadSession(const std::string& strSess)
 
 
 	std::vector<std::string> vecSWBase, vecSWType;
-	SubWindowBase** pSWBs = new SubWindowBase*[iWndCnt];
-
-	unsigned int iNumThreads = std::thread::hardware_concurrency();
-	if(iNumThreads==0) iNumThreads = 1;
-	std::vector<std::vector<unsigned int> > vecWndForThreads;
-	vecWndForThreads.resize(iNumThreads);
+	std::vector<SubWindowBase*> vecSWBs(iWndCnt, 0);
+	std::vector<SessionWndEntry> vecEntries(iWndCnt);
+	std::vector<bool> vecHasEntry(iWndCnt, 0);
 
+	// largest windows are loaded first, idle threads steal the small ones
+	WorkPool pool;
 
-	unsigned int iCurThread = 0;
 	for(unsigned int iWnd=0; iWnd<iWndCnt; ++iWnd)
 	{
 		std::ostringstream ostrSWBase;
@@ -119,47 +236,52 @@ void MiezeMainWnd::LoadSession(const std::string& strSess)
 			tl::log_err("Unknown plot type: \"", strSWType, "\".");
 			continue;
 		}
-		pSWBs[iWnd] = pSWB;
-
-		vecWndForThreads[iCurThread].push_back(iWnd);
-		if(++iCurThread >= iNumThreads)
-			iCurThread = 0;
-	}
+		vecSWBs[iWnd] = pSWB;
 
+		// sessions written before incremental saving have no window regions
+		if(!bRetain)
+		{
+			SessionWndEntry& entry = vecEntries[iWnd];
+			bool bHasOffs = 0, bHasLen = 0;
+			entry.iBlobOffs = xml.Query<qint64>((strSWBase + "blob_offs").c_str(), 0, &bHasOffs);
+			entry.iBlobLen = xml.Query<qint64>((strSWBase + "blob_len").c_str(), 0, &bHasLen);
+			vecHasEntry[iWnd] = bHasOffs && bHasLen
+				&& session_wnd_fragment(strSessText, iWnd, entry.strXml);
+		}
 
-	std::vector<std::thread*> vecThreads;
-	std::vector<int> vecProgress(iWndCnt);
-
-	bool bProgressRunning = 1;
-	std::thread thProgress = std::thread(session_load_progress_thread,
-											&vecProgress, &bProgressRunning,
-											this);
-
-	for(unsigned int iTh=0; iTh<iNumThreads; ++iTh)
-	{
-		if(vecWndForThreads[iTh].size() != 0)
+		if(bLazy)
 		{
-			std::thread *pTh = new std::thread(session_load_thread, &xml, &blob,
-												&vecSWBase, &vecWndForThreads[iTh],
-												pSWBs, vecProgress.data());
-			vecThreads.push_back(pTh);
+			pSWB->setWindowTitle(xml.QueryString((strSWBase + "window_title").c_str(), "").c_str());
+			pSWB->DeferLoadXML(pSrc, strSWBase);
+			continue;
 		}
+
+		pool.AddTask([pSWB, &xml, &blob, &vecSWBase, iWnd]()
+		{
+			pSWB->LoadSessionXML(xml, blob, vecSWBase[iWnd]);
+		}, session_wnd_cost(xml, strSWBase, strSWType));
 	}
 
-	for(unsigned int iTh=0; iTh<vecThreads.size(); ++iTh)
+	pool.Start();
+
+	// wait for the loader threads to signal completed windows
+	const unsigned int iNumTasks = pool.GetNumTasks();
+	for(unsigned int iLoaded=0; iLoaded<iNumTasks;)
 	{
-		vecThreads[iTh]->join();
-		delete vecThreads[iTh];
+		iLoaded = pool.WaitProgress(iLoaded);
+
+		std::ostringstream ostrLoading;
+		ostrLoading << "Loaded " << iLoaded << " of " << iNumTasks << ".";
+		SetStatusMsg(ostrLoading.str().c_str(), 2);
+		QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
 	}
 
-	bProgressRunning = 0;
-	thProgress.detach();
-	thProgress.~thread();
+	pool.Join();
 
 
 	for(unsigned int iWnd=0; iWnd<iWndCnt; ++iWnd)
 	{
-		SubWindowBase *pSWB = pSWBs[iWnd];
+		SubWindowBase *pSWB = vecSWBs[iWnd];
 		if(!pSWB) continue;
 
 		AddSubWindow(pSWB, 0);
@@ -182,11 +304,18 @@ void MiezeMainWnd::LoadSession(const std::string& strSess)
 				pSubWnd->move(iGeoX, iGeoY);
 		}
 
-		pSWB->GetActualWidget()->RefreshPlot();
+		if(!pSWB->IsDeferred())
+			pSWB->GetActualWidget()->RefreshPlot();
 		pSWB->show();
-	}
 
-	delete[] pSWBs;
+		if(vecHasEntry[iWnd])
+		{
+			SessionWndEntry& entry = vecEntries[iWnd];
+			entry.iOrder = iWnd;
+			entry.iVersion = pSWB->GetSessionVersion();
+			m_mapSessWnds[pSWB] = std::move(entry);
+		}
+	}
 
 	SetStatusMsg("Session loaded.", 2);
 	setWindowTitle((std::string(WND_TITLE) + " - " + tl::get_file_nodir(m_strCurSess)).c_str());
@@ -217,52 +346,411 @@ void MiezeMainWnd::SessionSaveTriggered()
 		return;
 	}
 
+	SaveSession();
+}
+
+bool MiezeMainWnd::SaveSession()
+{
+	FinishSessionCompaction(0);
+
+	// only windows modified since the last save are written, appended to the blob
+	const std::string strBlob = m_strCurSess + ".blob";
+	const bool bIncremental = (m_strSessIndex == m_strCurSess) && QFile::exists(strBlob.c_str());
+	if(!bIncremental)
+	{
+		ResetSessionIndex();
+		m_strSessIndex = m_strCurSess;
+	}
+
+	// a new blob is written next to the target and only replaces it at the end:
+	// lazily loaded windows may still be mapped from the target file
+	const std::string strBlobOut = bIncremental ? strBlob : strBlob + ".tmp";
+
 	std::vector<SubWindowBase*> vecWnd = GetSubWindows(0);
+	std::vector<SubWindowBase*> vecDirty;
+	// windows still referencing a cache file or another blob, written one by one
+	std::vector<SubWindowBase*> vecDeferred;
+
+	for(SubWindowBase *pWnd : vecWnd)
+	{
+		auto iterEntry = m_mapSessWnds.find(pWnd);
+		if(iterEntry != m_mapSessWnds.end() && iterEntry->second.iVersion == pWnd->GetSessionVersion())
+			continue;
+
+		if(pWnd->IsDeferred())
+			vecDeferred.push_back(pWnd);
+		else
+			vecDirty.push_back(pWnd);
+	}
+
+	auto fail = [this, bIncremental, &strBlobOut, &vecDirty, &vecDeferred](const std::string& strMsg) -> bool
+	{
+		if(bIncremental)
+		{
+			// the windows' data may only be partially appended, they are written again next time
+			for(SubWindowBase *pWnd : vecDirty)
+				m_mapSessWnds.erase(pWnd);
+			for(SubWindowBase *pWnd : vecDeferred)
+				m_mapSessWnds.erase(pWnd);
+		}
+		else
+		{
+			// nothing valid has been written, a later save has to start anew
+			std::remove(strBlobOut.c_str());
+			m_strSessIndex = "";
+		}
+
+		QMessageBox::critical(this, "Error", strMsg.c_str());
+		return false;
+	};
+
+	// each window is serialised in parallel into its own buffers, blob offsets are window-relative
+	struct WndSave
+	{
+		SubWindowBase *pWnd;
+		unsigned long iVersion;
+		std::ostringstream ostrXml;
+		BlobOStream ostrBlob;
+		bool bOk = 0;
+
+		WndSave(SubWindowBase *pWnd, BlobCodec codec)
+			: pWnd(pWnd), iVersion(pWnd->GetSessionVersion()), ostrBlob(codec)
+		{}
+	};
+
+	std::vector<std::unique_ptr<WndSave>> vecSaves;
+	WorkPool pool;
+
+	for(SubWindowBase *pWnd : vecDirty)
+	{
+		WndSave *pSave = new WndSave(pWnd, m_sessCodec);
+		vecSaves.push_back(std::unique_ptr<WndSave>(pSave));
+
+		// rough cost: higher-dimensional data first
+		pool.AddTask([pSave]()
+		{
+			pSave->bOk = pSave->pWnd->GetActualWidgetNoLoad()->SaveXML(pSave->ostrXml, pSave->ostrBlob);
+		}, std::pow(100., double(pWnd->GetType())));
+	}
+
+	pool.Start();
+
+	const unsigned int iNumTasks = pool.GetNumTasks();
+	for(unsigned int iSaved=0; iSaved<iNumTasks;)
+	{
+		iSaved = pool.WaitProgress(iSaved);
+
+		std::ostringstream ostrSaving;
+		ostrSaving << "Saved " << iSaved << " of " << iNumTasks << ".";
+		SetStatusMsg(ostrSaving.str().c_str(), 2);
+		QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+	}
+
+	pool.Join();
+
+	// e.g. data stored in chunks on disk, the session would silently lack these windows
+	std::string strFailed;
+	for(const std::unique_ptr<WndSave>& pSave : vecSaves)
+	{
+		if(!pSave->bOk)
+			strFailed += "\n\t" + pSave->pWnd->windowTitle().toStdString();
+	}
+	if(strFailed != "")
+	{
+		return fail("Session not saved, the following windows cannot be saved:" + strFailed +
+			"\n\nData stored in chunks on disk is too large for a session.");
+	}
+
+
+	std::ofstream ofstrBlob;
+	if(bIncremental)
+	{
+		ofstrBlob.open(strBlobOut, std::ofstream::binary | std::ofstream::app);
+		// a failed earlier save may have left a tail behind
+		m_iSessBlobLen = QFile(strBlobOut.c_str()).size();
+	}
+	else
+	{
+		ofstrBlob.open(strBlobOut, std::ofstream::binary);
+		m_iSessBlobLen = 0;
+	}
+
+	if(!ofstrBlob)
+		return fail("Failed to write session blob.");
+
+	for(const std::unique_ptr<WndSave>& pSave : vecSaves)
+	{
+		SessionWndEntry& entry = m_mapSessWnds[pSave->pWnd];
+		entry.iVersion = pSave->iVersion;
+		entry.strXml = pSave->ostrXml.str();
+
+		const std::string strWndBlob = pSave->ostrBlob.str();
+		ofstrBlob.write(strWndBlob.data(), strWndBlob.size());
+		entry.iBlobOffs = m_iSessBlobLen;
+		entry.iBlobLen = qint64(strWndBlob.size());
+		m_iSessBlobLen += entry.iBlobLen;
+	}
+
+	// their data is not kept resident
+	bool bDeferredOk = 1;
+	for(SubWindowBase *pWnd : vecDeferred)
+	{
+		SetStatusMsg(("Saving " + pWnd->windowTitle().toStdString() + ".").c_str(), 2);
+
+		const unsigned long iVersion = pWnd->GetSessionVersion();
+		std::ostringstream ostrXml;
+		const qint64 iLen = pWnd->SaveDeferred(ostrXml, ofstrBlob, m_sessCodec);
+		if(iLen < 0)
+		{
+			tl::log_err("Cannot save window \"", pWnd->windowTitle().toStdString(), "\".");
+			bDeferredOk = 0;
+			break;
+		}
+
+		SessionWndEntry& entry = m_mapSessWnds[pWnd];
+		entry.iVersion = iVersion;
+		entry.strXml = ostrXml.str();
+		entry.iBlobOffs = m_iSessBlobLen;
+		entry.iBlobLen = iLen;
+		m_iSessBlobLen += iLen;
+	}
+
+	ofstrBlob.close();
+	if(!bDeferredOk || ofstrBlob.fail())
+		return fail("Failed to save session.");
+
+	// the old file stays readable for the windows still mapping it
+	if(!bIncremental && std::rename(strBlobOut.c_str(), strBlob.c_str()) != 0)
+		return fail("Failed to replace session blob.");
+
+
+	// geometries are always current, closed windows are dropped from the index
+	std::map<const SubWindowBase*, SessionWndEntry> mapWnds;
+	for(unsigned int iWnd=0; iWnd<vecWnd.size(); ++iWnd)
+	{
+		SessionWndEntry& entry = m_mapSessWnds[vecWnd[iWnd]];
+		entry.iOrder = iWnd;
+
+		QMdiSubWindow *pSubWnd = FindSubWindow(vecWnd[iWnd]);
+		entry.bHasGeo = (pSubWnd != 0);
+		if(pSubWnd)
+		{
+			entry.strGeo = pSubWnd->saveGeometry().toHex().data();
+			entry.iGeoX = pSubWnd->pos().x();
+			entry.iGeoY = pSubWnd->pos().y();
+		}
+
+		mapWnds[vecWnd[iWnd]] = std::move(entry);
+	}
+	m_mapSessWnds.swap(mapWnds);
+
+	if(!WriteSessionIndex())
+		return fail("Failed to write session index.");
+
+	AddRecentSession(QString(m_strCurSess.c_str()));
+	this->SetStatusMsg("Ok.", 0);
+
+	StartSessionCompaction();
+	return true;
+}
+
+void MiezeMainWnd::ResetSessionIndex()
+{
+	// a pending compaction belongs to the previous session file
+	if(m_futCompact.valid())
+	{
+		SessionCompaction res = m_futCompact.get();
+		std::remove(res.strBlobCompact.c_str());
+	}
+
+	m_strSessIndex = "";
+	m_iSessGeneration = 0;
+	m_iSessBlobLen = 0;
+	m_mapSessWnds.clear();
+}
+
+/*
+ * writes a new generation of the session xml, which indexes the window
+ * regions in the blob; it replaces the old one atomically
+ */
+bool MiezeMainWnd::WriteSessionIndex()
+{
+	std::vector<const SessionWndEntry*> vecEntries;
+	for(const auto& pairEntry : m_mapSessWnds)
+		vecEntries.push_back(&pairEntry.second);
+	std::sort(vecEntries.begin(), vecEntries.end(),
+		[](const SessionWndEntry* pEntry1, const SessionWndEntry* pEntry2) -> bool
+		{ return pEntry1->iOrder < pEntry2->iOrder; });
+
+	const std::string strTmp = m_strSessIndex + ".tmp";
+	std::ofstream ofstr(strTmp);
+	if(!ofstr)
+	{
+		tl::log_err("Cannot write session index \"", strTmp, "\".");
+		return false;
+	}
 
-	std::ofstream ofstr(m_strCurSess);
 	ofstr << "<cattus_session>\n\n";
 	ofstr << "<plot_counter> " << m_iPlotCnt << " </plot_counter>\n";
-	ofstr << "<window_counter> " << vecWnd.size() << " </window_counter>\n";
+	ofstr << "<window_counter> " << vecEntries.size() << " </window_counter>\n";
+	ofstr << "<blob_codec> " << int(m_sessCodec) << " </blob_codec>\n";
+	ofstr << "<generation> " << ++m_iSessGeneration << " </generation>\n";
 	//ofstr << "<viewport_geo> " << m_pmdi->viewport()->saveGeometry().toHex().data()
 	//		<< " </viewport_geo>\n";
 
-	std::ofstream ofstrBlob(m_strCurSess + ".blob", std::ofstream::binary);
-
-	unsigned int iWnd=0;
-	for(SubWindowBase *pWnd : vecWnd)
+	for(unsigned int iWnd=0; iWnd<vecEntries.size(); ++iWnd)
 	{
-		std::ostringstream ostrSaving;
-		ostrSaving << "Saving " << (iWnd+1) << " of " << vecWnd.size() << ": "
-			<< pWnd->windowTitle().toStdString() << ".";
-		SetStatusMsg(ostrSaving.str().c_str(), 2);
+		const SessionWndEntry& entry = *vecEntries[iWnd];
 
-		pWnd = pWnd->GetActualWidget();
 		ofstr << "\n\n";
 		ofstr << "<window_" << iWnd << ">\n";
-		QMdiSubWindow *pSubWnd = FindSubWindow(pWnd);
-		if(pSubWnd)
+		if(entry.bHasGeo)
 		{
-			std::string strGeo = pSubWnd->saveGeometry().toHex().data();
-			ofstr << "<geo> " << strGeo << " </geo>\n";
+			ofstr << "<geo> " << entry.strGeo << " </geo>\n";
 
 			// hack
-			ofstr << "<geo_x> " << pSubWnd->pos().x() << "</geo_x>\n";
-			ofstr << "<geo_y> " << pSubWnd->pos().y() << "</geo_y>\n";
+			ofstr << "<geo_x> " << entry.iGeoX << "</geo_x>\n";
+			ofstr << "<geo_y> " << entry.iGeoY << "</geo_y>\n";
 		}
-		pWnd->SaveXML(ofstr, ofstrBlob);
+
+		ofstr << "<blob_offs> " << entry.iBlobOffs << " </blob_offs>\n";
+		ofstr << "<blob_len> " << entry.iBlobLen << " </blob_len>\n";
+		ofstr << entry.strXml;
 		ofstr << "</window_" << iWnd << ">\n";
 		ofstr << "\n\n";
-
-		++iWnd;
 	}
 
 	ofstr << "\n\n</cattus_session>\n";
-
-	ofstrBlob.close();
 	ofstr.close();
 
-	AddRecentSession(QString(m_strCurSess.c_str()));
-	this->SetStatusMsg("Ok.", 0);
+	if(ofstr.fail() || std::rename(strTmp.c_str(), m_strSessIndex.c_str()) != 0)
+	{
+		tl::log_err("Cannot replace session index \"", m_strSessIndex, "\".");
+		return false;
+	}
+
+	return true;
+}
+
+// starts copying the live blob regions in the background once most of the blob is stale
+void MiezeMainWnd::StartSessionCompaction()
+{
+	if(m_futCompact.valid() || m_strSessIndex == "")
+		return;
+
+	std::vector<std::pair<qint64, qint64>> vecRegions;
+	qint64 iLive = 0;
+	for(const auto& pairEntry : m_mapSessWnds)
+	{
+		const SessionWndEntry& entry = pairEntry.second;
+		if(entry.iBlobLen == 0)
+			continue;
+
+		vecRegions.push_back(std::make_pair(entry.iBlobOffs, entry.iBlobLen));
+		iLive += entry.iBlobLen;
+	}
+
+	const qint64 iMinLen = Settings::Get<qint64>("misc/session_compact_min_size");
+	if(m_iSessBlobLen < iMinLen || iLive*2 > m_iSessBlobLen)
+		return;
+
+	std::sort(vecRegions.begin(), vecRegions.end());
+	m_futCompact = std::async(std::launch::async, session_compact,
+		m_strSessIndex + ".blob", vecRegions, m_iSessBlobLen);
+}
+
+// swaps in the compacted blob; regions appended in the meantime are moved along
+void MiezeMainWnd::FinishSessionCompaction(bool bWait)
+{
+	if(!m_futCompact.valid())
+		return;
+	if(!bWait && m_futCompact.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	SessionCompaction res = m_futCompact.get();
+	if(!res.bOk || res.strBlob != m_strSessIndex + ".blob")
+	{
+		std::remove(res.strBlobCompact.c_str());
+		return;
+	}
+
+	{
+		std::ifstream ifstr(res.strBlob, std::ifstream::binary);
+		std::ofstream ofstr(res.strBlobCompact, std::ofstream::binary | std::ofstream::app);
+		std::vector<char> vecBuf(BLOB_CHUNK_SIZE);
+
+		ifstr.seekg(res.iOldLen);
+		if(!ifstr || !ofstr || !session_copy_region(ifstr, ofstr, m_iSessBlobLen-res.iOldLen, vecBuf))
+		{
+			tl::log_err("Cannot compact session blob \"", res.strBlob, "\".");
+			std::remove(res.strBlobCompact.c_str());
+			return;
+		}
+	}
+
+	const qint64 iTailShift = res.iNewLen - res.iOldLen;
+	std::map<const SubWindowBase*, qint64> mapNewOffs;
+	for(const auto& pairEntry : m_mapSessWnds)
+	{
+		const SessionWndEntry& entry = pairEntry.second;
+		qint64 iNewOffs = 0;
+
+		if(entry.iBlobLen == 0)
+			iNewOffs = 0;
+		else if(entry.iBlobOffs >= res.iOldLen)
+			iNewOffs = entry.iBlobOffs + iTailShift;
+		else
+		{
+			auto iterOffs = res.mapOffs.find(entry.iBlobOffs);
+			if(iterOffs == res.mapOffs.end())
+			{
+				tl::log_err("Session blob region missing in compaction.");
+				std::remove(res.strBlobCompact.c_str());
+				return;
+			}
+			iNewOffs = iterOffs->second;
+		}
+
+		mapNewOffs[pairEntry.first] = iNewOffs;
+	}
+
+	// windows still loading from the old blob keep their own mapping of it
+	if(std::rename(res.strBlobCompact.c_str(), res.strBlob.c_str()) != 0)
+	{
+		tl::log_err("Cannot replace session blob \"", res.strBlob, "\".");
+		std::remove(res.strBlobCompact.c_str());
+		return;
+	}
+
+	for(auto& pairEntry : m_mapSessWnds)
+		pairEntry.second.iBlobOffs = mapNewOffs[pairEntry.first];
+	m_iSessBlobLen += iTailShift;
+
+	if(WriteSessionIndex())
+		SetStatusMsg("Session blob compacted.", 2);
+}
+
+void MiezeMainWnd::SetSessionCodec(BlobCodec codec)
+{
+	int iCodec = int(codec);
+	if(iCodec < 0 || iCodec > 2)
+		iCodec = int(BlobCodec::FAST);
+
+	m_sessCodec = BlobCodec(iCodec);
+	m_pSessCodec[iCodec]->setChecked(1);
+}
+
+void MiezeMainWnd::SessionCodecTriggered()
+{
+	for(unsigned int iCodec=0; iCodec<3; ++iCodec)
+	{
+		if(m_pSessCodec[iCodec]->isChecked())
+		{
+			m_sessCodec = BlobCodec(iCodec);
+			Settings::Set<int>("misc/session_codec", iCodec);
+			break;
+		}
+	}
 }
 
 void MiezeMainWnd::SessionSaveAsTriggered()
@@ -279,8 +767,24 @@ void MiezeMainWnd::SessionSaveAsTriggered()
 	if(strExt != "cattus")
 		strFile1 += ".cattus";
 
+	// restored if the save fails, so that the window keeps referring to a valid session
+	const std::string strOldSess = m_strCurSess;
+	const std::string strOldIndex = m_strSessIndex;
+	const unsigned int iOldGeneration = m_iSessGeneration;
+	const qint64 iOldBlobLen = m_iSessBlobLen;
+	const std::map<const SubWindowBase*, SessionWndEntry> mapOldWnds = m_mapSessWnds;
+
+	// a new target file is written in full, saving onto the current session file stays incremental
 	m_strCurSess = strFile1;
-	SessionSaveTriggered();
+	if(!SaveSession())
+	{
+		m_strCurSess = strOldSess;
+		m_strSessIndex = strOldIndex;
+		m_iSessGeneration = iOldGeneration;
+		m_iSessBlobLen = iOldBlobLen;
+		m_mapSessWnds = mapOldWnds;
+		return;
+	}
 
 	setWindowTitle((std::string(WND_TITLE) + " - " + tl::get_file_nodir(m_strCurSess)).c_str());
 	pGlobals->setValue("main/lastdir_session", QString(tl::get_dir(strFile1).c_str()));
@@ -11,6 +11,7 @@
 #include <QtCore/QStringList>
 
 QSettings * Settings::s_pGlobals = 0;
+std::mutex Settings::s_mtx;
 
 QSettings *Settings::GetGlobals()
 {
@@ -44,7 +45,32 @@ void Settings::SetDefaults()
 	if(!keys.contains("misc/sort_x")) s_pGlobals->setValue("misc/sort_x", 1);
 	if(!keys.contains("misc/debug_level")) s_pGlobals->setValue("misc/debug_level", 2);
 	if(!keys.contains("misc/min_counts")) s_pGlobals->setValue("misc/min_counts", 25);
+	if(!keys.contains("misc/lazy_session_load")) s_pGlobals->setValue("misc/lazy_session_load", 1);
+	if(!keys.contains("misc/session_codec")) s_pGlobals->setValue("misc/session_codec", 1);
+	if(!keys.contains("misc/sum_tables")) s_pGlobals->setValue("misc/sum_tables", 0);
+	if(!keys.contains("misc/sparse_threshold")) s_pGlobals->setValue("misc/sparse_threshold", 0.25);
+	if(!keys.contains("misc/chunked_min_size")) s_pGlobals->setValue("misc/chunked_min_size", qint64(1)<<32);
+	if(!keys.contains("misc/chunk_cache_size")) s_pGlobals->setValue("misc/chunk_cache_size", qint64(1)<<29);
+	if(!keys.contains("misc/session_compact_min_size")) s_pGlobals->setValue("misc/session_compact_min_size", qint64(1)<<24);
+	if(!keys.contains("misc/mem_budget")) s_pGlobals->setValue("misc/mem_budget", qint64(1)<<32);
+	if(!keys.contains("misc/spill_dir")) s_pGlobals->setValue("misc/spill_dir", "");
+	if(!keys.contains("calib/enabled")) s_pGlobals->setValue("calib/enabled", 0);
+	if(!keys.contains("calib/efficiency_file")) s_pGlobals->setValue("calib/efficiency_file", "");
+	if(!keys.contains("calib/background_file")) s_pGlobals->setValue("calib/background_file", "");
+	if(!keys.contains("calib/background_scale")) s_pGlobals->setValue("calib/background_scale", 1.);
+	if(!keys.contains("calib/phases")) s_pGlobals->setValue("calib/phases", 0);
+	if(!keys.contains("calib/phase_file")) s_pGlobals->setValue("calib/phase_file", "");
+	if(!keys.contains("calib/dead_time")) s_pGlobals->setValue("calib/dead_time", 0.);
+	if(!keys.contains("calib/time_key")) s_pGlobals->setValue("calib/time_key", "time");
+	if(!keys.contains("jit/compiler")) s_pGlobals->setValue("jit/compiler", "cc -O2 -march=native -fno-math-errno");
+	if(!keys.contains("jit/cache_dir")) s_pGlobals->setValue("jit/cache_dir", "");
+	if(!keys.contains("jit/hot_points")) s_pGlobals->setValue("jit/hot_points", 1<<16);
 	if(!keys.contains("interpolation/spline_degree")) s_pGlobals->setValue("interpolation/spline_degree", 3);
+	if(!keys.contains("fit/lm_mieze_sine")) s_pGlobals->setValue("fit/lm_mieze_sine", 0);
+	if(!keys.contains("fit/lm_mieze_exp")) s_pGlobals->setValue("fit/lm_mieze_exp", 0);
+	if(!keys.contains("fit/lm_gaussian")) s_pGlobals->setValue("fit/lm_gaussian", 0);
+	if(!keys.contains("fit/lm_multi_gaussian")) s_pGlobals->setValue("fit/lm_multi_gaussian", 0);
+	if(!keys.contains("fit/lm_user_defined")) s_pGlobals->setValue("fit/lm_user_defined", 0);
 	// --------------------------------------------------------------------------------
 
 
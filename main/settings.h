@@ -11,11 +11,13 @@
 
 #include <QtCore/QSettings>
 #include <QtCore/QVariant>
+#include <mutex>
 
 class Settings
 {
 	protected:
 		static QSettings *s_pGlobals;
+		static std::mutex s_mtx;	// the fitters also read settings from worker threads
 		static void SetDefaults();
 
 	public:
@@ -25,12 +27,14 @@ class Settings
 		template<typename T>
 		static T Get(const char* pcKey)
 		{
+			std::lock_guard<std::mutex> lock(s_mtx);
 			QSettings *pSett = GetGlobals();
 			return pSett->value(pcKey).value<T>();
 		}
 
 		static bool HasKey(const char* pcKey)
 		{
+			std::lock_guard<std::mutex> lock(s_mtx);
 			const QSettings *pSett = GetGlobals();
 			return pSett->contains(pcKey);
 		}
@@ -38,6 +42,7 @@ class Settings
 		template<typename T>
 		static void Set(const char* pcKey, const T& t)
 		{
+			std::lock_guard<std::mutex> lock(s_mtx);
 			QSettings *pSett = GetGlobals();
 			pSett->setValue(pcKey, QVariant(t));
 		}
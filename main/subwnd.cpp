@@ -9,6 +9,201 @@
 #include "subwnd.h"
 #include "data/data.h"
 #include "plot/plot.h"
+#include "tlibs/log/log.h"
+
+#include <QtCore/QEvent>
+#include <QtCore/QTemporaryFile>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+
+std::atomic<unsigned long> SubWindowBase::s_iVersionCounter(0);
+
+SessionSource::~SessionSource()
+{
+	for(const std::string& strFile : vecTmpFiles)
+		std::remove(strFile.c_str());
+}
+
+void SubWindowBase::changeEvent(QEvent *pEvt)
+{
+	if(pEvt && pEvt->type() == QEvent::WindowTitleChange)
+		MarkDirty();
+
+	QWidget::changeEvent(pEvt);
+}
+
+
+bool SubWindowBase::LoadSessionXML(tl::Xml& xml, Blob& blob, const std::string& strBase)
+{
+	// older sessions have absolute blob offsets
+	qint64 iBlobOffs = xml.Query<qint64>((strBase + "blob_offs").c_str(), 0);
+	Blob blobWnd(&blob, iBlobOffs);
+
+	return LoadXML(xml, blobWnd, strBase);
+}
+
+void SubWindowBase::DeferLoadXML(const std::shared_ptr<SessionSource>& pSrc, const std::string& strBase)
+{
+	m_pDeferredSrc = pSrc;
+	m_strDeferredBase = strBase;
+}
+
+bool SubWindowBase::Materialize()
+{
+	if(!m_pDeferredSrc)
+		return true;
+
+	// release our reference first, LoadXML must not re-enter
+	std::shared_ptr<SessionSource> pSrc = m_pDeferredSrc;
+	m_pDeferredSrc.reset();
+
+	SubWindowBase *pActual = GetActualWidgetNoLoad();
+	const unsigned long iVersion = m_iVersion;
+	const unsigned long iActualVersion = pActual->m_iVersion;
+
+	bool bOk = LoadSessionXML(pSrc->xml, pSrc->blob, m_strDeferredBase);
+	if(!bOk)
+		tl::log_err("Cannot load deferred session data for \"",
+			windowTitle().toStdString(), "\".");
+
+	pActual->RefreshPlot();
+
+	// restoring the saved state is no modification
+	m_iVersion = iVersion;
+	pActual->m_iVersion = iActualVersion;
+	return bOk;
+}
+
+
+std::size_t SubWindowBase::GetMemory() const
+{
+	const DataInterface *pIf = GetDataInterface();
+	return pIf ? pIf->GetMemory() : 0;
+}
+
+bool SubWindowBase::Spill(const std::string& strDir)
+{
+	if(IsDeferred())
+		return true;
+
+	SubWindowBase *pActual = GetActualWidgetNoLoad();
+
+	std::ostringstream ostrWndXml;
+	BlobOStream ostrBlob(BlobCodec::FAST);
+	if(!pActual->SaveXML(ostrWndXml, ostrBlob))
+		return false;
+	const std::string strWndXml = ostrWndXml.str();
+
+	// unique, exclusively created files; they are removed with the session source
+	QTemporaryFile fileXml((strDir + "/cattus_spill_XXXXXX.xml").c_str());
+	QTemporaryFile fileBlob((strDir + "/cattus_spill_XXXXXX.blob").c_str());
+	fileXml.setAutoRemove(0);
+	fileBlob.setAutoRemove(0);
+	if(!fileXml.open() || !fileBlob.open())
+	{
+		tl::log_err("Cannot create cache files in \"", strDir, "\".");
+		if(fileXml.isOpen()) fileXml.remove();
+		return false;
+	}
+
+	const std::string strFile = fileXml.fileName().toStdString();
+	const std::string strBlob = fileBlob.fileName().toStdString();
+	{
+		const std::string strXml = "<spill>\n" + strWndXml + "</spill>\n";
+		const std::string strBlobData = ostrBlob.str();
+		const bool bXmlOk = (fileXml.write(strXml.data(), strXml.size()) == qint64(strXml.size()));
+		const bool bBlobOk = (fileBlob.write(strBlobData.data(), strBlobData.size()) == qint64(strBlobData.size()));
+		fileXml.close();
+		fileBlob.close();
+
+		if(!bXmlOk || !bBlobOk)
+		{
+			tl::log_err("Cannot write cache file \"", strFile, "\".");
+			fileXml.remove();
+			fileBlob.remove();
+			return false;
+		}
+	}
+
+	std::shared_ptr<SessionSource> pSrc(new SessionSource(strBlob.c_str()));
+	pSrc->vecTmpFiles = { strFile, strBlob };
+	pSrc->strWndXml = strWndXml;
+	pSrc->strWndBlobFile = strBlob;
+	if(!pSrc->xml.Load(strFile.c_str()) || !pSrc->blob.IsOpen())
+	{
+		tl::log_err("Cannot read back cache file \"", strFile, "\".");
+		return false;
+	}
+
+	// spilling is no modification
+	const unsigned long iVersion = m_iVersion;
+	const unsigned long iActualVersion = pActual->m_iVersion;
+
+	pActual->ReleaseData();
+	DeferLoadXML(pSrc, "/spill/");
+
+	m_iVersion = iVersion;
+	pActual->m_iVersion = iActualVersion;
+	return true;
+}
+
+
+qint64 SubWindowBase::SaveDeferred(std::ostream& ostrXml, std::ostream& ostrBlob, BlobCodec codec)
+{
+	if(!m_pDeferredSrc)
+		return -1;
+	std::shared_ptr<SessionSource> pSrc = m_pDeferredSrc;
+
+	// cache files already hold the saved window, the codecs are stored with the data
+	if(pSrc->strWndBlobFile != "")
+	{
+		std::ifstream ifstrBlob(pSrc->strWndBlobFile, std::ifstream::binary);
+		if(!ifstrBlob)
+		{
+			tl::log_err("Cannot read cache file \"", pSrc->strWndBlobFile, "\".");
+			return -1;
+		}
+
+		qint64 iLen = 0;
+		std::vector<char> vecBuf(BLOB_CHUNK_SIZE);
+		while(ifstrBlob)
+		{
+			ifstrBlob.read(vecBuf.data(), vecBuf.size());
+			ostrBlob.write(vecBuf.data(), ifstrBlob.gcount());
+			iLen += ifstrBlob.gcount();
+		}
+
+		ostrXml << pSrc->strWndXml;
+		return ostrBlob ? iLen : -1;
+	}
+
+	const std::string strBase = m_strDeferredBase;
+	if(!Materialize())
+		return -1;
+
+	SubWindowBase *pActual = GetActualWidgetNoLoad();
+	BlobOStream ostrWndBlob(codec);
+	const bool bOk = pActual->SaveXML(ostrXml, ostrWndBlob);
+	const std::string strWndBlob = ostrWndBlob.str();
+	ostrBlob.write(strWndBlob.data(), strWndBlob.size());
+
+	// release the data again, it is still in the source
+	if(pActual->GetReleasableMemory())
+	{
+		const unsigned long iVersion = m_iVersion;
+		const unsigned long iActualVersion = pActual->m_iVersion;
+
+		pActual->ReleaseData();
+		DeferLoadXML(pSrc, strBase);
+
+		m_iVersion = iVersion;
+		pActual->m_iVersion = iActualVersion;
+	}
+
+	return (bOk && ostrBlob) ? qint64(strWndBlob.size()) : -1;
+}
 
 
 const StringMap* SubWindowBase::GetParamMapDyn() const
@@ -12,6 +12,10 @@
 #include <QtGui/QWidget>
 #include <string>
 #include <iostream>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <cstddef>
 #include "roi/roi.h"
 #include "helper/xml.h"
 #include "helper/blob.h"
@@ -48,10 +52,37 @@ struct PlotInfo
 	unsigned int iHeight;
 };
 
+// xml and mapped blob of a session, shared by the windows not yet loaded from it
+struct SessionSource
+{
+	tl::Xml xml;
+	Blob blob;
+
+	// cache files removed once no window needs them anymore
+	std::vector<std::string> vecTmpFiles;
+
+	// for cache files: the window xml as written by SaveXML and its blob file
+	std::string strWndXml, strWndBlobFile;
+
+	SessionSource(const char* pcBlob) : blob(pcBlob) {}
+	~SessionSource();
+};
+
 class SubWindowBase : public QWidget
 {
 Q_OBJECT
 
+protected:
+	// deferred session data, loaded on first use
+	std::shared_ptr<SessionSource> m_pDeferredSrc;
+	std::string m_strDeferredBase;
+
+	// modification stamp from a global counter, so that stamps are never reused
+	static std::atomic<unsigned long> s_iVersionCounter;
+	unsigned long m_iVersion;
+
+	virtual void changeEvent(QEvent *pEvt) override;
+
 signals:
 	void SetStatusMsg(const char* pcMsg, int iPos);
 	void DataLoaded();
@@ -61,14 +92,17 @@ signals:
 	void ParamsChanged(const StringMap& mapStr);
 
 public:
-	SubWindowBase(QWidget* pParent=0) : QWidget(pParent) {}
+	SubWindowBase(QWidget* pParent=0) : QWidget(pParent), m_iVersion(++s_iVersionCounter) {}
 	virtual ~SubWindowBase() { emit WndDestroyed(this); }
 
 	virtual const DataInterface* GetDataInterface() const = 0;
 	virtual DataInterface* GetDataInterface() = 0;
 
 	virtual SubWindowType GetType() const = 0;
-	virtual SubWindowBase* GetActualWidget() { return this; }
+
+	// resolves wrapper windows, loading deferred session data first
+	SubWindowBase* GetActualWidget() { Materialize(); return GetActualWidgetNoLoad(); }
+	virtual SubWindowBase* GetActualWidgetNoLoad() { return this; }
 
 	virtual SubWindowBase* clone() const { return 0; }
 
@@ -91,6 +125,32 @@ public:
 	virtual bool LoadXML(tl::Xml& xml, Blob& blob, const std::string& strBase) { return false; }
 	virtual bool SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const { return false; }
 
+	// loads a session window whose blob data starts at its "blob_offs"
+	bool LoadSessionXML(tl::Xml& xml, Blob& blob, const std::string& strBase);
+
+	void DeferLoadXML(const std::shared_ptr<SessionSource>& pSrc, const std::string& strBase);
+	bool IsDeferred() const { return bool(m_pDeferredSrc); }
+	bool Materialize();
+
+	// bytes of data held by the window and the part of it ReleaseData() frees
+	virtual std::size_t GetMemory() const;
+	virtual std::size_t GetReleasableMemory() const { return 0; }
+	// drops the data which LoadXML restores
+	virtual void ReleaseData() {}
+
+	// saves the window to cache files in strDir and releases its data, which is
+	// loaded again on first use like deferred session data
+	bool Spill(const std::string& strDir);
+
+	// saves a deferred window without keeping its data resident: cache files are
+	// copied, other session data is loaded, saved and released again;
+	// returns the number of blob bytes written, -1 on failure
+	qint64 SaveDeferred(std::ostream& ostrXml, std::ostream& ostrBlob, BlobCodec codec);
+
+	// changes whenever this window or its wrapped plot is modified
+	void MarkDirty() { m_iVersion = ++s_iVersionCounter; }
+	unsigned long GetSessionVersion() { return m_iVersion + GetActualWidgetNoLoad()->m_iVersion; }
+
 	virtual void RefreshPlot() {}
 
 	virtual void ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight, bool bKeepTotalCounts=false) {}
@@ -185,6 +185,7 @@ void Plot::resizeEvent(QResizeEvent *pEvent)
 
 void Plot::RefreshPlot()
 {
+	MarkDirty();
 	paint();
 
 #ifndef USE_GPL
@@ -594,9 +595,26 @@ void Plot::plot_fkt(const tl::FitterFuncModel<double>& fkt, int iObj, bool bKeep
 	for(uint iX=0; iX<iCnt; ++iX)
 	{
 		double dX = dxmin + (dxmax-dxmin)*double(iX)/double(iCnt-1);
-
 		dat.SetX(iX, dX);
-		dat.SetY(iX, fkt(dX));
+	}
+
+	bool bSampled = 0;
+#ifndef NO_PARSER
+	// user-defined functions are sampled in one go
+	const FreeFktModel *pFreeFkt = dynamic_cast<const FreeFktModel*>(&fkt);
+	std::vector<double> vecY(iCnt);
+	if(pFreeFkt && pFreeFkt->EvalArray(dat.GetXPtr(), iCnt, vecY.data()))
+	{
+		for(uint iX=0; iX<iCnt; ++iX)
+			dat.SetY(iX, vecY[iX]);
+		bSampled = 1;
+	}
+#endif
+
+	if(!bSampled)
+	{
+		for(uint iX=0; iX<iCnt; ++iX)
+			dat.SetY(iX, fkt(dat.GetX(iX)));
 	}
 
 	if(!bKeepObj)
@@ -792,6 +810,7 @@ void Plot::mouseMoveEvent(QMouseEvent* pEvent)
 
 void Plot::SetROI(const Roi* pROI, bool bAntiRoi)
 {
+	MarkDirty();
 	for(unsigned int iDat=0; iDat<GetDataCount(); ++iDat)
 	{
 		PlotObj& obj = GetData(iDat);
@@ -12,6 +12,7 @@
 #include <QtGui/QGridLayout>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 
 #include "tlibs/helper/misc.h"
 #include "tlibs/math/math.h"
@@ -23,7 +24,7 @@
 
 Plot2d::Plot2d(QWidget* pParent, const char* pcTitle, bool bCountData, bool bPhaseData)
 			: SubWindowBase(pParent),
-			  m_pImg(0),
+			  m_pImg(0), m_iImgLevel(0),
 			  m_bLog(bCountData), m_bCountData(bCountData), m_bCyclicData(0),
 			  m_bPhaseData(bPhaseData)
 {
@@ -34,7 +35,7 @@ Plot2d::Plot2d(QWidget* pParent, const char* pcTitle, bool bCountData, bool bPha
 }
 
 Plot2d::Plot2d(const Plot2d& plot)
-			: SubWindowBase(plot.parentWidget()), m_pImg(0)
+			: SubWindowBase(plot.parentWidget()), m_pImg(0), m_iImgLevel(0)
 {
 	this->m_bLog = plot.m_bLog;
 	this->m_bCountData = plot.m_bCountData;
@@ -158,8 +159,23 @@ QSize Plot2d::minimumSizeHint() const
 
 void Plot2d::resizeEvent(QResizeEvent *pEvent)
 {
+	if(m_pImg && GetDisplayLevel() != m_iImgLevel)
+		RedrawImage();
 }
 
+// coarsest pyramid level with at least one pixel per screen pixel
+uint Plot2d::GetDisplayLevel() const
+{
+	const int iScreenW = this->width() - 2*PAD_X;
+	const int iScreenH = this->height() - 2*PAD_Y;
+	if(iScreenW <= 0 || iScreenH <= 0)
+		return 0;
+
+	// only the sizes are needed, the pyramid is built when a level > 0 is drawn
+	return Pyramid::ChooseLevel(m_dat.GetWidth(), m_dat.GetHeight(), iScreenW, iScreenH);
+}
+
+
 void Plot2d::paintEvent(QPaintEvent *pEvent)
 {
 	if(!pEvent || pEvent->rect().width()==0 || pEvent->rect().height()==0)
@@ -227,8 +243,8 @@ void Plot2d::paintEvent(QPaintEvent *pEvent)
 	}
 
 	painter.translate(m_rectImage.bottomLeft() + QPoint(0., 1.));
-	double dScaleX = 1.*double(m_rectImage.width()) / double(m_pImg->width());
-	double dScaleY = -1.*double(m_rectImage.height()) / double(m_pImg->height());
+	double dScaleX = 1.*double(m_rectImage.width()) / double(m_dat.GetWidth());
+	double dScaleY = -1.*double(m_rectImage.height()) / double(m_dat.GetHeight());
 	painter.scale(dScaleX, dScaleY);
 
 	QPen penROI = penOrg;
@@ -282,18 +298,54 @@ void Plot2d::CheckCyclicData()
 }
 
 void Plot2d::RefreshPlot()
+{
+	MarkDirty();
+	RedrawImage();
+}
+
+// only rebuilds the image, e.g. on resize, without modifying the window's state
+void Plot2d::RedrawImage()
 {
 	clear();
 
-	m_pImg = new QImage(m_dat.GetWidth(), m_dat.GetHeight(), QImage::Format_RGB32);
+	// only built if a coarser level is shown, from the displayed slice
+	std::shared_ptr<const Pyramid> pPyr;
+	m_iImgLevel = GetDisplayLevel();
+	if(m_iImgLevel > 0)
+	{
+		pPyr = m_dat.GetPyramid();
+		m_iImgLevel = std::min(m_iImgLevel, pPyr->GetNumLevels()-1);
+	}
+
+	if(m_iImgLevel == 0)
+	{
+		m_pImg = new QImage(m_dat.GetWidth(), m_dat.GetHeight(), QImage::Format_RGB32);
 
-	for(uint iY=0; iY<m_dat.GetHeight(); ++iY)
+		for(uint iY=0; iY<m_dat.GetHeight(); ++iY)
+		{
+			QRgb* pline = (QRgb*)m_pImg->scanLine(m_dat.GetHeight()-iY-1);
+			for(uint iX=0; iX<m_dat.GetWidth(); ++iX)
+			{
+				pline[iX] = GetSpectroColor(m_dat.GetValRaw(iX, iY));
+				//m_pImg->setPixel(iX, iY, GetSpectroColor(m_dat.GetVal(iX, iY)));
+			}
+		}
+	}
+	else
 	{
-		QRgb* pline = (QRgb*)m_pImg->scanLine(m_dat.GetHeight()-iY-1);
-		for(uint iX=0; iX<m_dat.GetWidth(); ++iX)
+		// the image is larger than the screen: only map the pixels of a coarser
+		// level, as means, so that the colour scale stays the same
+		const PyramidLevel& level = pPyr->GetLevel(m_iImgLevel);
+		const double dNorm = 1./level.dPixelArea;
+
+		m_pImg = new QImage(level.iW, level.iH, QImage::Format_RGB32);
+
+		for(uint iY=0; iY<level.iH; ++iY)
 		{
-			pline[iX] = GetSpectroColor(m_dat.GetValRaw(iX, iY));
-			//m_pImg->setPixel(iX, iY, GetSpectroColor(m_dat.GetVal(iX, iY)));
+			QRgb* pline = (QRgb*)m_pImg->scanLine(level.iH-iY-1);
+			const double *pRow = level.vecVals.data() + std::size_t(iY)*level.iW;
+			for(uint iX=0; iX<level.iW; ++iX)
+				pline[iX] = GetSpectroColor(pRow[iX]*dNorm);
 		}
 	}
 
@@ -450,6 +502,7 @@ void Plot2d::mouseMoveEvent(QMouseEvent* pEvent)
 
 void Plot2d::SetROI(const Roi* pROI, bool bAntiRoi)
 {
+	MarkDirty();
 	DataInterface* pDat = GetDataInterface();
 	if(!pDat) return;
 
@@ -33,6 +33,9 @@ protected:
 
 	Data2 m_dat;
 	QImage *m_pImg;
+	uint m_iImgLevel;	// pyramid level shown in m_pImg
+
+	uint GetDisplayLevel() const;
 
 	bool m_bLog;
 	bool m_bCountData;
@@ -56,6 +59,7 @@ public:
 	void plot(const Data2& dat);
 	void clear();
 	virtual void RefreshPlot() override;
+	void RedrawImage();
 
 	void SetLog(bool bLog);
 	bool GetLog() const;
@@ -14,6 +14,7 @@
 #include "tlibs/string/string.h"
 #include "tlibs/helper/misc.h"
 #include "helper/misc.h"
+#include "data/reduce.h"
 
 Plot3d::Plot3d(QWidget* pParent, const char* pcTitle,  bool bCountData)
 		: Plot2d(pParent, pcTitle, bCountData), m_iCurT(0)
@@ -63,7 +64,10 @@ void Plot3d::RefreshTSlice(uint iT)
 {
 	m_iCurT = iT;
 	m_dat = m_dat3.GetVal(iT);
-	RefreshPlot();
+
+	// the current slice is part of the saved session state
+	MarkDirty();
+	RedrawImage();
 }
 
 
@@ -125,16 +129,18 @@ Plot2d* Plot3d::ConvertTo2d(int iFoil)
 	ostrTitle << windowTitle().toStdString() << " -> ";
 
 	const Data3& dat3 = this->GetData();
-	Data2 dat2(dat3.GetWidth(), dat3.GetHeight());
+	ostrTitle << "sum";
+
+	ReduceParams params;
+	params.iAxes = AXIS_T;
+
+	ReduceResult res;
+	reduce(dat3, params, res);
+
+	Data2 dat2 = res.GetImage();
 	dat2.CopyParamMapsFrom(&dat3);
 	dat2.CopyXYRangeFrom(&dat3);
 	dat2.CopyRoiFlagsFrom(&dat3);
-	dat2.SetZero();
-
-	ostrTitle << "sum";
-
-	for(unsigned int iTC=0; iTC<dat3.GetDepth(); ++iTC)
-		dat2.Add(dat3.GetVal(iFoil));
 
 	Plot2d* pPlot = new Plot2d(0, ostrTitle.str().c_str(), m_bCountData);
 	pPlot->plot(dat2);
@@ -169,10 +175,10 @@ bool Plot3d::SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const
 
 
 	ostr << "<data>\n";
-	m_dat3.SaveXML(ostr, ostrBlob);
+	const bool bOk = m_dat3.SaveXML(ostr, ostrBlob);
 	ostr << "</data>\n";
 
-	return 1;
+	return bOk;
 }
 
 
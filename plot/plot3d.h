@@ -52,6 +52,11 @@ public:
 
 	virtual const DataInterface* GetDataInterface() const override { return &m_dat3; }
 	virtual DataInterface* GetDataInterface() override { return &m_dat3; }
+
+	// the displayed slice stays, so the plot can still be drawn
+	virtual std::size_t GetMemory() const override { return m_dat.GetMemory() + m_dat3.GetMemory(); }
+	virtual std::size_t GetReleasableMemory() const override { return m_dat3.GetMemory(); }
+	virtual void ReleaseData() override { m_dat3 = Data3(0, 0, 0); }
 };
 
 
@@ -71,7 +76,7 @@ public:
 	//operator Plot3d*() { return (Plot3d*)GetActualWidget(); }
 
 	virtual SubWindowType GetType() const override { return PLOT_3D; }
-	virtual SubWindowBase* GetActualWidget() override { return m_pPlot; }
+	virtual SubWindowBase* GetActualWidgetNoLoad() override { return m_pPlot; }
 
 	virtual std::string GetTitle() const { return m_pPlot->GetTitle(); }
 	virtual void SetTitle(const char* pcTitle) { m_pPlot->SetTitle(pcTitle); }
@@ -87,6 +92,10 @@ public:
 	virtual const DataInterface* GetDataInterface() const override { return m_pPlot->GetDataInterface(); }
 	virtual DataInterface* GetDataInterface() override { return m_pPlot->GetDataInterface(); }
 
+	virtual std::size_t GetMemory() const override { return m_pPlot->GetMemory(); }
+	virtual std::size_t GetReleasableMemory() const override { return m_pPlot->GetReleasableMemory(); }
+	virtual void ReleaseData() override { m_pPlot->ReleaseData(); }
+
 	virtual void ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight,
 		bool bKeepTotalCounts=false) override
 	{ m_pPlot->ChangeResolution(iNewWidth, iNewHeight, bKeepTotalCounts); }
@@ -18,6 +18,7 @@
 #include "tlibs/phys/mieze.h"
 #include "helper/misc.h"
 #include "data/fit_data.h"
+#include "data/reduce.h"
 #include "fitter/models/msin.h"
 #include "main/settings.h"
 
@@ -51,7 +52,10 @@ void Plot4d::RefreshTFSlice(uint iT, uint iF)
 	m_iCurT = iT;
 	m_iCurF = iF;
 	m_dat = m_dat4.GetVal(iT, iF);
-	RefreshPlot();
+
+	// the current slices are part of the saved session state
+	MarkDirty();
+	RedrawImage();
 }
 
 
@@ -105,15 +109,12 @@ Plot* Plot4d::ConvertTo1d(int iFoil)
 
 	std::string strTitle = pPlot4d->windowTitle().toStdString();
 	const Data4& dat4 = pPlot4d->GetData();
-	const unsigned int iNumFoils = dat4.GetDepth2();
 
 	if(iFoil<0)
 	{	// total, corrected MIEZE signal
 		strTitle += std::string(" -> t channels (corr)");
 
-		std::vector<Data1> vecFoils;
-		for(unsigned int iFoil=0; iFoil<iNumFoils; ++iFoil)
-			vecFoils.push_back(dat4.GetXYSum(iFoil));
+		std::vector<Data1> vecFoils = dat4.GetXYSums();
 
 		const std::vector<double> *pvecPhases = 0;
 		if(dat4.HasPhases())
@@ -155,28 +156,28 @@ Plot2d* Plot4d::ConvertTo2d(int iFoil)
 	ostrTitle << windowTitle().toStdString() << " -> ";
 
 	const Data4& dat4 = this->GetData();
-	Data2 dat2(dat4.GetWidth(), dat4.GetHeight());
-	dat2.CopyParamMapsFrom(&dat4);
-	dat2.CopyXYRangeFrom(&dat4);
-	dat2.CopyRoiFlagsFrom(&dat4);
-	dat2.SetZero();
 
+	ReduceParams params;
+	params.iAxes = AXIS_T;
 	if(iFoil<0)
 	{
 		ostrTitle << "foil sum";
-
-		for(unsigned int iFoil=0; iFoil<dat4.GetDepth2(); ++iFoil)
-			for(unsigned int iTC=0; iTC<dat4.GetDepth(); ++iTC)
-				dat2.Add(dat4.GetVal(iTC, iFoil));
+		params.iAxes |= AXIS_FOIL;
 	}
 	else
 	{
 		ostrTitle << "foil " << iFoil;
-
-		for(unsigned int iTC=0; iTC<dat4.GetDepth(); ++iTC)
-			dat2.Add(dat4.GetVal(iTC, iFoil));
+		params.iFoil = iFoil;
 	}
 
+	ReduceResult res;
+	reduce(dat4, params, res);
+
+	Data2 dat2 = res.GetImage();
+	dat2.CopyParamMapsFrom(&dat4);
+	dat2.CopyXYRangeFrom(&dat4);
+	dat2.CopyRoiFlagsFrom(&dat4);
+
 	Plot2d* pPlot = new Plot2d(0, ostrTitle.str().c_str(), m_bCountData);
 	pPlot->plot(dat2);
 	pPlot->SetLabels(GetXStr().toStdString().c_str(), GetYStr().toStdString().c_str(), "I");
@@ -190,18 +191,18 @@ Plot3d* Plot4d::ConvertTo3d(int iFoil)
 	ostrTitle << windowTitle().toStdString() << " -> ";
 
 	const Data4& dat4 = this->GetData();
-	Data3 dat3(dat4.GetWidth(), dat4.GetHeight(), dat4.GetDepth());
-	dat3.CopyParamMapsFrom(&dat4);
-	dat3.CopyXYRangeFrom(&dat4);
-	dat3.CopyRoiFlagsFrom(&dat4);
+	Data3 dat3(0, 0, 0);
 
 	if(iFoil<0)
 	{
 		ostrTitle << "foil sum";
 
-		dat3.SetZero();
-		for(unsigned int iFoil=0; iFoil<dat4.GetDepth2(); ++iFoil)
-			dat3.Add(dat4.GetVal(iFoil));
+		ReduceParams params;
+		params.iAxes = AXIS_FOIL;
+
+		ReduceResult res;
+		reduce(dat4, params, res);
+		dat3 = res.GetVolume();
 	}
 	else
 	{
@@ -210,6 +211,10 @@ Plot3d* Plot4d::ConvertTo3d(int iFoil)
 		dat3 = dat4.GetVal(iFoil);
 	}
 
+	dat3.CopyParamMapsFrom(&dat4);
+	dat3.CopyXYRangeFrom(&dat4);
+	dat3.CopyRoiFlagsFrom(&dat4);
+
 	Plot3d* pPlot = new Plot3d(0, ostrTitle.str().c_str(), m_bCountData);
 	pPlot->plot(dat3);
 	pPlot->SetLabels(GetXStr().toStdString().c_str(), GetYStr().toStdString().c_str(), "I");
@@ -245,10 +250,10 @@ bool Plot4d::SaveXML(std::ostream& ostr, std::ostream& ostrBlob) const
 
 
 	ostr << "<data>\n";
-	m_dat4.SaveXML(ostr, ostrBlob);
+	const bool bOk = m_dat4.SaveXML(ostr, ostrBlob);
 	ostr << "</data>\n";
 
-	return 1;
+	return bOk;
 }
 
 
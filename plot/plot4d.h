@@ -55,6 +55,12 @@ public:
 
 	virtual const DataInterface* GetDataInterface() const override { return &m_dat4; }
 	virtual DataInterface* GetDataInterface() override { return &m_dat4; }
+
+	// the displayed slice stays, so the plot can still be drawn
+	virtual std::size_t GetMemory() const override { return m_dat.GetMemory() + m_dat4.GetMemory(); }
+	virtual std::size_t GetReleasableMemory() const override
+	{ return m_dat4.IsChunked() ? 0 : m_dat4.GetMemory(); }
+	virtual void ReleaseData() override { m_dat4 = Data4(0, 0, 0, 0); }
 };
 
 
@@ -74,7 +80,7 @@ public:
 	//operator Plot4d*() { return (Plot4d*)GetActualWidget(); }
 
 	virtual SubWindowType GetType() const override { return PLOT_4D; }
-	virtual SubWindowBase* GetActualWidget() override { return m_pPlot; }
+	virtual SubWindowBase* GetActualWidgetNoLoad() override { return m_pPlot; }
 	virtual std::string GetTitle() const { return m_pPlot->GetTitle(); }
 	virtual void SetTitle(const char* pcTitle) { m_pPlot->SetTitle(pcTitle); }
 	virtual double GetTotalCounts() const override { return m_pPlot->GetTotalCounts(); }
@@ -89,6 +95,10 @@ public:
 	virtual const DataInterface* GetDataInterface() const override { return m_pPlot->GetDataInterface(); }
 	virtual DataInterface* GetDataInterface() override { return m_pPlot->GetDataInterface(); }
 
+	virtual std::size_t GetMemory() const override { return m_pPlot->GetMemory(); }
+	virtual std::size_t GetReleasableMemory() const override { return m_pPlot->GetReleasableMemory(); }
+	virtual void ReleaseData() override { m_pPlot->ReleaseData(); }
+
 	virtual void ChangeResolution(unsigned int iNewWidth, unsigned int iNewHeight,
 		bool bKeepTotalCounts=false) override
 	{ m_pPlot->ChangeResolution(iNewWidth, iNewHeight, bKeepTotalCounts); }
@@ -1360,6 +1360,7 @@ void Roi::Scale(double dScale)
 
 void RoiElement::draw(QPainter& painter, const XYRange& range)
 {
+#ifndef NO_GUI
 	if(GetVertexCount()<1)
 		return;
 
@@ -1379,4 +1380,5 @@ void RoiElement::draw(QPainter& painter, const XYRange& range)
 	QPointF pt0_(range.GetPixelXPos(vertPrev[0]), range.GetPixelYPos(vertPrev[1])),
 			pt1_(range.GetPixelXPos(vertBegin[0]), range.GetPixelYPos(vertBegin[1]));
 	painter.drawLine(pt0_, pt1_);
+#endif
 }
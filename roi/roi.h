@@ -16,7 +16,11 @@
 namespace ublas = boost::numeric::ublas;
 
 class XYRange;
-#include <QtGui/QPainter>
+#ifdef NO_GUI
+	class QPainter;		// headless tools only use the geometry
+#else
+	#include <QtGui/QPainter>
+#endif
 
 #include "helper/xml.h"
 
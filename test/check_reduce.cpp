@@ -0,0 +1,216 @@
+/**
+ * mieze-tool
+ * regression check: reductions against brute-force sums
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "data/data.h"
+#include "data/reduce.h"
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+
+
+// crosses the chunk borders in x, y and t
+static const uint s_iW = CHUNK_XY+2, s_iH = CHUNK_XY+1, s_iD = CHUNK_T+2, s_iD2 = 2;
+
+enum Storage { STORE_DENSE, STORE_SPARSE, STORE_CHUNKED };
+static const char* s_pcStorage[] = {"dense", "sparse", "chunked"};
+
+static unsigned int s_iFailed = 0;
+
+static void check(bool bOk, const char* pcWhat, const char* pcData, const ReduceParams& params,
+	std::size_t iIdx, double dVal, double dRef)
+{
+	if(bOk)
+		return;
+
+	std::cerr << "FAILED: " << pcWhat << ", " << pcData << ", axes " << params.iAxes
+		<< ", op " << int(params.op) << ", t " << params.iT << ", foil " << params.iFoil
+		<< ", index " << iIdx << ": " << dVal << " instead of " << dRef << std::endl;
+	++s_iFailed;
+}
+
+// weakly occupied counts, so that the sparse storage is used
+static void make_counts(std::size_t iLen, std::vector<double>& vecVals, std::vector<double>& vecErrs)
+{
+	vecVals.resize(iLen);
+	vecErrs.resize(iLen);
+
+	unsigned int iRnd = 12345;
+	for(std::size_t i=0; i<iLen; ++i)
+	{
+		iRnd = iRnd*1103515245u + 12345u;
+		const unsigned int iCts = (iRnd >> 16) % 64;
+		vecVals[i] = iCts < 48 ? 0. : double(iCts-47);
+		vecErrs[i] = std::sqrt(vecVals[i]);
+	}
+}
+
+static std::unique_ptr<Data4> make_data4(Storage storage,
+	const std::vector<double>& vecVals, const std::vector<double>& vecErrs)
+{
+	set_chunked_min_size(storage==STORE_CHUNKED ? 1 : 0);
+	set_sparse_threshold(storage==STORE_SPARSE ? 1. : 0.);
+
+	std::unique_ptr<Data4> pDat(new Data4(s_iW, s_iH, s_iD, s_iD2, vecVals.data(), vecErrs.data()));
+	pDat->SelectStorage();
+
+	set_chunked_min_size(0);
+	set_sparse_threshold(0.);
+
+	if(pDat->IsSparse() != (storage==STORE_SPARSE) || pDat->IsChunked() != (storage==STORE_CHUNKED))
+	{
+		std::cerr << "FAILED: " << s_pcStorage[storage] << " storage not selected." << std::endl;
+		++s_iFailed;
+	}
+	return pDat;
+}
+
+/*
+ * sums the [foil][t][y][x] input directly, the reduced and selected axes
+ * get size 1 and the errors are added in quadrature
+ */
+static void reduce_brute_force(const uint *piDims, const double *pVals, const double *pErrs,
+	const ReduceParams& params, std::vector<double>& vecVals, std::vector<double>& vecErrs)
+{
+	const int iSel[4] = {-1, -1, params.iT, params.iFoil};
+
+	uint iOutDims[4];
+	for(int iAxis=0; iAxis<4; ++iAxis)
+		iOutDims[iAxis] = ((params.iAxes & (1<<iAxis)) || iSel[iAxis] >= 0) ? 1 : piDims[iAxis];
+
+	const std::size_t iOutSize = std::size_t(iOutDims[0])*iOutDims[1]*iOutDims[2]*iOutDims[3];
+	vecVals.assign(iOutSize, 0.);
+	vecErrs.assign(iOutSize, 0.);
+	std::vector<double> vecCnt(iOutSize, 0.);
+
+	std::size_t iIn = 0;
+	for(uint iF=0; iF<piDims[3]; ++iF)
+		for(uint iT=0; iT<piDims[2]; ++iT)
+			for(uint iY=0; iY<piDims[1]; ++iY)
+				for(uint iX=0; iX<piDims[0]; ++iX, ++iIn)
+				{
+					if((iSel[2] >= 0 && int(iT) != iSel[2]) || (iSel[3] >= 0 && int(iF) != iSel[3]))
+						continue;
+
+					const uint iPos[4] = {iX, iY, iT, iF};
+					std::size_t iOut = 0;
+					for(int iAxis=3; iAxis>=0; --iAxis)
+						iOut = iOut*iOutDims[iAxis] + (iOutDims[iAxis]==1 ? 0 : iPos[iAxis]);
+
+					vecVals[iOut] += pVals[iIn];
+					vecErrs[iOut] += pErrs[iIn]*pErrs[iIn];
+					vecCnt[iOut] += 1.;
+				}
+
+	for(std::size_t iOut=0; iOut<iOutSize; ++iOut)
+	{
+		if(params.op == REDUCE_MEAN && vecCnt[iOut] > 0.)
+		{
+			vecVals[iOut] /= vecCnt[iOut];
+			vecErrs[iOut] /= vecCnt[iOut]*vecCnt[iOut];
+		}
+		vecErrs[iOut] = std::sqrt(vecErrs[iOut]);
+	}
+}
+
+static void compare(const char* pcData, const ReduceParams& params, const ReduceResult& res,
+	const std::vector<double>& vecVals, const std::vector<double>& vecErrs)
+{
+	if(res.vecVals.size() != vecVals.size() || res.vecErrs.size() != vecErrs.size())
+	{
+		check(0, "result size", pcData, params, 0, res.vecVals.size(), vecVals.size());
+		return;
+	}
+
+	for(std::size_t i=0; i<vecVals.size(); ++i)
+	{
+		const double dEps = 1e-9 * std::max(1., std::fabs(vecVals[i]));
+		check(std::fabs(res.vecVals[i] - vecVals[i]) < dEps, "value", pcData, params, i, res.vecVals[i], vecVals[i]);
+		check(std::fabs(res.vecErrs[i] - vecErrs[i]) < dEps, "error", pcData, params, i, res.vecErrs[i], vecErrs[i]);
+	}
+}
+
+// all combinations of reduced axes, and some selected time channels and foils
+static std::vector<ReduceParams> get_params(unsigned int iNumAxes)
+{
+	std::vector<ReduceParams> vecParams;
+	for(ReduceOp op : {REDUCE_SUM, REDUCE_MEAN})
+		for(unsigned int iAxes=0; iAxes < (1u<<iNumAxes); ++iAxes)
+		{
+			ReduceParams params;
+			params.iAxes = iAxes;
+			params.op = op;
+			vecParams.push_back(params);
+
+			if(!(iAxes & AXIS_T))
+			{
+				params.iT = s_iD-1;
+				vecParams.push_back(params);
+				params.iT = -1;
+			}
+			if(iNumAxes > 3 && !(iAxes & AXIS_FOIL))
+			{
+				params.iFoil = 1;
+				vecParams.push_back(params);
+			}
+		}
+	return vecParams;
+}
+
+
+int main()
+{
+	std::vector<double> vecVals, vecErrs;
+	make_counts(std::size_t(s_iW)*s_iH*s_iD*s_iD2, vecVals, vecErrs);
+
+	// with and without the summed-area tables for the x-y sums
+	for(bool bSumTables : {false, true})
+	{
+		set_use_sum_tables(bSumTables);
+
+		// the first foil as 3d data
+		const Data3 dat3(s_iW, s_iH, s_iD, vecVals.data(), vecErrs.data());
+		const uint iDims3[4] = {s_iW, s_iH, s_iD, 1};
+		for(const ReduceParams& params : get_params(3))
+		{
+			ReduceResult res;
+			reduce(dat3, params, res);
+
+			std::vector<double> vecRefVals, vecRefErrs;
+			reduce_brute_force(iDims3, vecVals.data(), vecErrs.data(), params, vecRefVals, vecRefErrs);
+			compare("3d", params, res, vecRefVals, vecRefErrs);
+		}
+
+		const uint iDims4[4] = {s_iW, s_iH, s_iD, s_iD2};
+		for(Storage storage : {STORE_DENSE, STORE_SPARSE, STORE_CHUNKED})
+		{
+			std::unique_ptr<Data4> pDat4 = make_data4(storage, vecVals, vecErrs);
+
+			for(const ReduceParams& params : get_params(4))
+			{
+				ReduceResult res;
+				reduce(*pDat4, params, res);
+
+				std::vector<double> vecRefVals, vecRefErrs;
+				reduce_brute_force(iDims4, vecVals.data(), vecErrs.data(), params, vecRefVals, vecRefErrs);
+				compare(s_pcStorage[storage], params, res, vecRefVals, vecRefErrs);
+			}
+		}
+	}
+
+	if(s_iFailed)
+	{
+		std::cerr << s_iFailed << " reduction checks failed." << std::endl;
+		return -1;
+	}
+
+	std::cout << "Reduction checks passed." << std::endl;
+	return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * mieze-tool
+ * regression check: resampling of constant images
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "data/resample.h"
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+
+static unsigned int s_iFailed = 0;
+
+static void check(bool bOk, const char* pcWhat, ResampleMode mode,
+	unsigned int iW, unsigned int iNewW, unsigned int iX, double dVal)
+{
+	if(bOk)
+		return;
+
+	std::cerr << "FAILED: " << pcWhat << ", mode " << int(mode)
+		<< ", " << iW << " -> " << iNewW << ", x = " << iX << ": " << dVal << std::endl;
+	++s_iFailed;
+}
+
+/*
+ * a constant image has to stay constant (as means), the error of a new pixel
+ * has to be sqrt(sum w^2) times the old error; where a new pixel is only made
+ * from one old pixel, e.g. at the borders when upsampling, the error is unchanged
+ */
+static void check_constant(ResampleMode mode, unsigned int iW, unsigned int iNewW)
+{
+	const unsigned int iH = 3;
+	const double dVal = 10., dErr = 1., dEps = 1e-9;
+
+	std::vector<double> vecVals(iW*iH, dVal), vecErrs(iW*iH, dErr);
+	std::vector<double> vecNewVals(iNewW*iH), vecNewErrs(iNewW*iH);
+
+	resample_slices(mode, 0, 1, iW, iH, vecVals.data(), vecErrs.data(),
+		iNewW, iH, vecNewVals.data(), vecNewErrs.data());
+
+	const ResampleAxis axis(mode, iW, iNewW, 0);
+	for(unsigned int iX=0; iX<iNewW; ++iX)
+	{
+		double dSumW2 = 0.;
+		for(unsigned int iTap=axis.vecStart[iX]; iTap<axis.vecStart[iX+1]; ++iTap)
+			dSumW2 += axis.vecWeight[iTap]*axis.vecWeight[iTap];
+		const bool bSingle = (axis.vecStart[iX+1] - axis.vecStart[iX] == 1);
+
+		for(unsigned int iY=0; iY<iH; ++iY)
+		{
+			const double dNewVal = vecNewVals[iY*iNewW + iX];
+			const double dNewErr = vecNewErrs[iY*iNewW + iX];
+
+			check(std::fabs(dNewVal - dVal) < dEps, "value", mode, iW, iNewW, iX, dNewVal);
+			check(std::fabs(dNewErr - dErr*std::sqrt(dSumW2)) < dEps, "error", mode, iW, iNewW, iX, dNewErr);
+			if(bSingle || iW == iNewW)
+				check(std::fabs(dNewErr - dErr) < dEps, "unchanged error", mode, iW, iNewW, iX, dNewErr);
+		}
+	}
+}
+
+// upsampling by two: the outer half pixels only see the border pixel
+static void check_borders(ResampleMode mode)
+{
+	const double vecVals[] = {10., 10.}, vecErrs[] = {1., 1.};
+	double vecNewVals[4], vecNewErrs[4];
+	resample_slices(mode, 0, 1, 2, 1, vecVals, vecErrs, 4, 1, vecNewVals, vecNewErrs);
+
+	const ResampleAxis axis(mode, 2, 4, 0);
+	for(unsigned int iX : {0u, 3u})
+	{
+		check(axis.vecStart[iX+1] - axis.vecStart[iX] == 1, "merged border taps", mode, 2, 4, iX, 0.);
+		check(std::fabs(vecNewErrs[iX] - 1.) < 1e-9, "border error", mode, 2, 4, iX, vecNewErrs[iX]);
+	}
+}
+
+
+int main()
+{
+	for(ResampleMode mode : {RESAMPLE_REBIN, RESAMPLE_BILINEAR, RESAMPLE_BICUBIC})
+	{
+		for(unsigned int iW : {1u, 2u, 5u, 16u})
+			for(unsigned int iNewW : {1u, 2u, 3u, 4u, 7u, 16u, 33u})
+				check_constant(mode, iW, iNewW);
+	}
+
+	check_borders(RESAMPLE_BILINEAR);
+
+	if(s_iFailed)
+	{
+		std::cerr << s_iFailed << " resampling checks failed." << std::endl;
+		return -1;
+	}
+
+	std::cout << "Resampling checks passed." << std::endl;
+	return 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * mieze-tool
+ * regression check: dense, sparse and chunked 4d data give the same values
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "data/data.h"
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+
+
+// crosses the chunk borders in x, y and t
+static const uint s_iW = CHUNK_XY+2, s_iH = CHUNK_XY+1, s_iD = CHUNK_T+2, s_iD2 = 2;
+
+enum Storage { STORE_DENSE, STORE_SPARSE, STORE_CHUNKED };
+static const char* s_pcStorage[] = {"dense", "sparse", "chunked"};
+
+static unsigned int s_iFailed = 0;
+
+static void check(double dVal, double dRef, const char* pcWhat, Storage storage,
+	uint iX, uint iY, uint iD, uint iD2)
+{
+	if(std::fabs(dVal - dRef) < 1e-9 * std::max(1., std::fabs(dRef)))
+		return;
+
+	std::cerr << "FAILED: " << pcWhat << ", " << s_pcStorage[storage]
+		<< ", x = " << iX << ", y = " << iY << ", t = " << iD << ", foil = " << iD2
+		<< ": " << dVal << " instead of " << dRef << std::endl;
+	++s_iFailed;
+}
+
+// weakly occupied counts, so that the sparse storage is used
+static void make_counts(std::size_t iLen, unsigned int iSeed,
+	std::vector<double>& vecVals, std::vector<double>& vecErrs)
+{
+	vecVals.resize(iLen);
+	vecErrs.resize(iLen);
+
+	unsigned int iRnd = iSeed;
+	for(std::size_t i=0; i<iLen; ++i)
+	{
+		iRnd = iRnd*1103515245u + 12345u;
+		const unsigned int iCts = (iRnd >> 16) % 64;
+		vecVals[i] = iCts < 48 ? 0. : double(iCts-47);
+		vecErrs[i] = std::sqrt(vecVals[i]);
+	}
+}
+
+static std::unique_ptr<Data4> make_data4(Storage storage,
+	const std::vector<double>& vecVals, const std::vector<double>& vecErrs)
+{
+	set_chunked_min_size(storage==STORE_CHUNKED ? 1 : 0);
+	set_sparse_threshold(storage==STORE_SPARSE ? 1. : 0.);
+
+	std::unique_ptr<Data4> pDat(new Data4(s_iW, s_iH, s_iD, s_iD2, vecVals.data(), vecErrs.data()));
+	pDat->SelectStorage();
+
+	set_chunked_min_size(0);
+	set_sparse_threshold(0.);
+
+	if(pDat->IsSparse() != (storage==STORE_SPARSE) || pDat->IsChunked() != (storage==STORE_CHUNKED))
+	{
+		std::cerr << "FAILED: " << s_pcStorage[storage] << " storage not selected." << std::endl;
+		++s_iFailed;
+	}
+	return pDat;
+}
+
+// every accessor of the data against the [foil][t][y][x] reference buffers
+static void check_data4(const Data4& dat, Storage storage,
+	const std::vector<double>& vecVals, const std::vector<double>& vecErrs)
+{
+	const std::size_t iSliceSize = std::size_t(s_iW)*s_iH;
+	auto idx = [iSliceSize](uint iX, uint iY, uint iD, uint iD2) -> std::size_t
+	{
+		return (std::size_t(iD2)*s_iD + iD)*iSliceSize + std::size_t(iY)*s_iW + iX;
+	};
+
+	double dTotal = 0.;
+	for(double dVal : vecVals)
+		dTotal += dVal;
+	check(dat.GetTotal(), dTotal, "total", storage, 0, 0, 0, 0);
+
+	for(uint iD2=0; iD2<s_iD2; ++iD2)
+	{
+		const Data3 dat3 = dat.GetVal(iD2);
+
+		for(uint iD=0; iD<s_iD; ++iD)
+		{
+			const Data2 dat2 = dat.GetVal(iD, iD2);
+
+			for(uint iY=0; iY<s_iH; ++iY)
+				for(uint iX=0; iX<s_iW; ++iX)
+				{
+					const double dVal = vecVals[idx(iX, iY, iD, iD2)];
+					const double dErr = vecErrs[idx(iX, iY, iD, iD2)];
+
+					check(dat.GetValRaw(iX, iY, iD, iD2), dVal, "GetValRaw", storage, iX, iY, iD, iD2);
+					check(dat.GetErrRaw(iX, iY, iD, iD2), dErr, "GetErrRaw", storage, iX, iY, iD, iD2);
+					check(dat2.GetVal(iX, iY), dVal, "slice value", storage, iX, iY, iD, iD2);
+					check(dat2.GetErr(iX, iY), dErr, "slice error", storage, iX, iY, iD, iD2);
+					check(dat3.GetVal(iX, iY, iD), dVal, "foil value", storage, iX, iY, iD, iD2);
+				}
+		}
+
+		// time series of some pixels at and next to the chunk borders
+		for(uint iY : {0u, uint(CHUNK_XY-1), uint(CHUNK_XY), s_iH-1})
+			for(uint iX : {0u, uint(CHUNK_XY-1), uint(CHUNK_XY), s_iW-1})
+			{
+				const Data1 dat1 = dat.GetXYD2(iX, iY, iD2);
+				for(uint iD=0; iD<s_iD; ++iD)
+				{
+					check(dat1.GetY(iD), vecVals[idx(iX, iY, iD, iD2)], "series value", storage, iX, iY, iD, iD2);
+					check(dat1.GetYErr(iD), vecErrs[idx(iX, iY, iD, iD2)], "series error", storage, iX, iY, iD, iD2);
+				}
+			}
+	}
+}
+
+
+int main()
+{
+	const std::size_t iSize = std::size_t(s_iW)*s_iH*s_iD*s_iD2;
+	const std::size_t iFoilSize = std::size_t(s_iW)*s_iH*s_iD;
+
+	std::vector<double> vecVals, vecErrs;
+	make_counts(iSize, 12345, vecVals, vecErrs);
+
+	// time channels across a chunk border of the second foil, written in bulk
+	const uint iSlice = CHUNK_T-1, iNumSlices = 2;
+	std::vector<double> vecNewVals, vecNewErrs;
+	make_counts(std::size_t(s_iW)*s_iH*iNumSlices, 54321, vecNewVals, vecNewErrs);
+
+	std::vector<double> vecWrittenVals = vecVals, vecWrittenErrs = vecErrs;
+	const std::size_t iOffs = iFoilSize + std::size_t(s_iW)*s_iH*iSlice;
+	std::copy(vecNewVals.begin(), vecNewVals.end(), vecWrittenVals.begin() + iOffs);
+	std::copy(vecNewErrs.begin(), vecNewErrs.end(), vecWrittenErrs.begin() + iOffs);
+
+	for(Storage storage : {STORE_DENSE, STORE_SPARSE, STORE_CHUNKED})
+	{
+		std::unique_ptr<Data4> pDat = make_data4(storage, vecVals, vecErrs);
+		check_data4(*pDat, storage, vecVals, vecErrs);
+
+		pDat->SetSlices(1, iSlice, iNumSlices, vecNewVals.data(), vecNewErrs.data());
+		check_data4(*pDat, storage, vecWrittenVals, vecWrittenErrs);
+	}
+
+	if(s_iFailed)
+	{
+		std::cerr << s_iFailed << " storage checks failed." << std::endl;
+		return -1;
+	}
+
+	std::cout << "Storage checks passed." << std::endl;
+	return 0;
+}
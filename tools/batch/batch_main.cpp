@@ -0,0 +1,65 @@
+/**
+ * mieze-tool
+ * headless batch reduction, e.g. for cron jobs
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "pipeline.h"
+#include "main/settings.h"
+#include "main/globals.h"
+
+#include "tlibs/math/rand.h"
+#include "tlibs/log/log.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QLocale>
+#include <iostream>
+#include <clocale>
+
+
+extern void init_formulas();
+
+
+int main(int argc, char **argv)
+{
+	if(argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <pipeline.xml> [run files...]\n"
+			<< "\tThe runs are taken from the pipeline file and the command line.\n";
+		return -1;
+	}
+
+	int iRet = -1;
+
+	try
+	{
+		tl::init_rand();
+		init_formulas();
+
+		Settings::GetGlobals();
+		QCoreApplication a(argc, argv);
+		apply_global_settings();
+
+		::setlocale(LC_ALL, "C");
+		QLocale::setDefault(QLocale::English);
+
+		Pipeline pipe;
+		if(pipe.Load(argv[1]))
+		{
+			for(int iArg=2; iArg<argc; ++iArg)
+				pipe.vecRuns.push_back(argv[iArg]);
+
+			iRet = run_pipeline(pipe) ? 0 : 1;
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		tl::log_crit(ex.what());
+		iRet = -1;
+	}
+
+	Settings::free();
+	return iRet;
+}
@@ -0,0 +1,468 @@
+/**
+ * mieze-tool
+ * declarative reduction pipeline for headless batch runs
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#include "pipeline.h"
+#include "main/settings.h"
+#include "data/reduce.h"
+#include "helper/mfourier.h"
+#include "helper/workpool.h"
+#include "helper/xml.h"
+
+#include "tlibs/string/string.h"
+#include "tlibs/file/comp.h"
+#include "tlibs/file/file.h"
+#include "tlibs/file/tmp.h"
+#include "tlibs/log/log.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <memory>
+#include <map>
+#include <cmath>
+
+
+static const std::string s_strBase = "/cattus_batch/";
+
+
+static int get_fit_fkt(const std::string& strFkt)
+{
+	// same names as the "fit/lm_*" settings
+	if(strFkt == "" || strFkt == "none") return FIT_INVALID;
+	if(strFkt == "mieze_sine") return FIT_MIEZE_SINE;
+	if(strFkt == "mieze_exp") return FIT_MIEZE_EXP;
+	if(strFkt == "gaussian") return FIT_GAUSSIAN;
+	if(strFkt == "multi_gaussian") return FIT_MULTI_GAUSSIAN;
+	if(strFkt == "user_defined") return FIT_USER_DEFINED;
+
+	tl::log_err("Unknown fit function \"", strFkt, "\".");
+	return FIT_INVALID;
+}
+
+static bool load_roi(const tl::Xml& xml, const std::string& strKey, Roi& roi)
+{
+	const std::string strFile = xml.QueryString((s_strBase + strKey).c_str(), "");
+	if(strFile == "")
+		return true;
+
+	if(!roi.Load(strFile.c_str()))
+		return false;
+	roi.SetRoiActive(1);
+	return true;
+}
+
+bool Pipeline::Load(const char* pcFile)
+{
+	tl::Xml xml;
+	if(!xml.Load(pcFile))
+	{
+		tl::log_err("Cannot load pipeline \"", pcFile, "\".");
+		return false;
+	}
+
+	strOutDir = xml.QueryString((s_strBase + "output").c_str(), ".");
+	iThreads = xml.Query<unsigned int>((s_strBase + "threads").c_str(), 0);
+
+	for(unsigned int iRun=0; ; ++iRun)
+	{
+		std::ostringstream ostrKey;
+		ostrKey << s_strBase << "runs/run_" << iRun;
+
+		bool bOk = 0;
+		std::string strRun = xml.QueryString(ostrKey.str().c_str(), "", &bOk);
+		if(!bOk)
+			break;
+		vecRuns.push_back(strRun);
+	}
+
+	// the settings are the defaults for the calibration
+	calib = CalibConfig::FromSettings();
+	const std::string strCalib = s_strBase + "calib/";
+	calib.bEnabled = xml.Query<int>((strCalib + "enabled").c_str(), calib.bEnabled);
+	calib.strEfficiency = xml.QueryString((strCalib + "efficiency_file").c_str(), calib.strEfficiency.c_str());
+	calib.strBackground = xml.QueryString((strCalib + "background_file").c_str(), calib.strBackground.c_str());
+	calib.dBackgroundScale = xml.Query<double>((strCalib + "background_scale").c_str(), calib.dBackgroundScale);
+	calib.phases = CalibPhases(xml.Query<int>((strCalib + "phases").c_str(), int(calib.phases)));
+	calib.strPhases = xml.QueryString((strCalib + "phase_file").c_str(), calib.strPhases.c_str());
+	calib.dDeadTime = xml.Query<double>((strCalib + "dead_time").c_str(), calib.dDeadTime);
+	calib.strTimeKey = xml.QueryString((strCalib + "time_key").c_str(), calib.strTimeKey.c_str());
+
+	if(!load_roi(xml, "roi", roi.GetRoi(0)) || !load_roi(xml, "antiroi", roi.GetRoi(1)))
+		return false;
+
+	iFoil = xml.Query<int>((s_strBase + "foil").c_str(), -1);
+	bSpectrum = xml.Query<int>((s_strBase + "spectrum").c_str(), 1);
+	bImage = xml.Query<int>((s_strBase + "image").c_str(), 0);
+	bContrastMap = xml.Query<int>((s_strBase + "contrast_map").c_str(), 0);
+
+	const std::string strFit = s_strBase + "fit/";
+	fit.iFkt = get_fit_fkt(xml.QueryString((strFit + "function").c_str(), "none"));
+	fit.iNumPeaks = xml.Query<int>((strFit + "peaks").c_str(), 1);
+	fit.strFkt = xml.QueryString((strFit + "expression").c_str(), "");
+	fit.strLimits = xml.QueryString((strFit + "limits").c_str(), "");
+	fit.strHints = xml.QueryString((strFit + "hints").c_str(), "");
+	strFitXKey = xml.QueryString((strFit + "x_key").c_str(), "");
+
+	return true;
+}
+
+
+// --------------------------------------------------------------------------------
+// output
+
+static void write_params(std::ostream& ostr, const StringMap& mapParams)
+{
+	for(const auto& pair : mapParams.GetMap())
+		ostr << "# " << pair.first << ": " << pair.second << "\n";
+}
+
+static bool write_spectrum(const std::string& strFile, const Data1& dat, const StringMap& mapParams)
+{
+	std::ofstream ofstr(strFile);
+	if(!ofstr.is_open())
+	{
+		tl::log_err("Cannot write \"", strFile, "\".");
+		return false;
+	}
+	ofstr.precision(std::numeric_limits<double>::digits10);
+
+	write_params(ofstr, mapParams);
+	ofstr << "# t\tI\tI_err\n";
+	for(unsigned int i=0; i<dat.GetLength(); ++i)
+		ofstr << dat.GetX(i) << "\t" << dat.GetY(i) << "\t" << dat.GetYErr(i) << "\n";
+	return true;
+}
+
+// rows are y
+static bool write_image(const std::string& strFile, unsigned int iW, unsigned int iH,
+	const double* pdVals, const StringMap& mapParams)
+{
+	std::ofstream ofstr(strFile);
+	if(!ofstr.is_open())
+	{
+		tl::log_err("Cannot write \"", strFile, "\".");
+		return false;
+	}
+	ofstr.precision(std::numeric_limits<double>::digits10);
+
+	write_params(ofstr, mapParams);
+	for(unsigned int iY=0; iY<iH; ++iY)
+	{
+		for(unsigned int iX=0; iX<iW; ++iX)
+			ofstr << (iX ? "\t" : "") << pdVals[std::size_t(iY)*iW + iX];
+		ofstr << "\n";
+	}
+	return true;
+}
+
+static bool write_fit(const std::string& strFile, const FitBatchResult& res,
+	const std::vector<std::string>& vecNames, const std::string& strXKey)
+{
+	std::ofstream ofstr(strFile);
+	if(!ofstr.is_open())
+	{
+		tl::log_err("Cannot write \"", strFile, "\".");
+		return false;
+	}
+	ofstr.precision(std::numeric_limits<double>::digits10);
+
+	ofstr << "# run\t" << (strXKey=="" ? "index" : strXKey);
+	for(const std::string& strParam : res.vecParamNames)
+		ofstr << "\t" << strParam << "\t" << strParam << "_err";
+	ofstr << "\tchi2\tconverged\n";
+
+	for(unsigned int iSet=0; iSet<res.GetNumSets(); ++iSet)
+	{
+		if(!res.vecHasModel[iSet])
+			continue;
+
+		ofstr << vecNames[iSet] << "\t" << res.vecX[iSet];
+		for(unsigned int iParam=0; iParam<res.vecParamNames.size(); ++iParam)
+			ofstr << "\t" << res.vecVals[iParam][iSet] << "\t" << res.vecErrs[iParam][iSet];
+		ofstr << "\t" << res.vecChi2[iSet] << "\t" << int(res.vecConverged[iSet]) << "\n";
+	}
+	return true;
+}
+
+
+// --------------------------------------------------------------------------------
+// processing
+
+// file names of the runs without directory and extension
+static std::string get_run_name(const std::string& strRun)
+{
+	std::string strName = tl::get_file_nodir(strRun);
+	for(const char* pcExt : {".gz", ".bz2", ".tof"})
+	{
+		const std::string strExt = pcExt;
+		if(strName.length() > strExt.length() &&
+			strName.compare(strName.length()-strExt.length(), strExt.length(), strExt) == 0)
+			strName.resize(strName.length()-strExt.length());
+	}
+
+	return strName;
+}
+
+// unique names for the output files, runs with the same name get their index appended
+static std::vector<std::string> get_run_names(const Pipeline& pipe)
+{
+	std::vector<std::string> vecNames;
+	std::map<std::string, unsigned int> mapCount;
+	for(const std::string& strRun : pipe.vecRuns)
+	{
+		vecNames.push_back(get_run_name(strRun));
+		++mapCount[vecNames.back()];
+	}
+
+	for(unsigned int iRun=0; iRun<vecNames.size(); ++iRun)
+	{
+		if(mapCount[vecNames[iRun]] > 1)
+			vecNames[iRun] += "_" + tl::var_to_str(iRun);
+	}
+
+	return vecNames;
+}
+
+static bool load_run(const Pipeline& pipe, const std::string& _strFile, Data4& dat4)
+{
+	tl::TmpFile tmp;
+
+	std::string strFile = _strFile;
+	std::string strExt = tl::get_fileext(strFile);
+	if(strExt == "gz" || strExt == "bz2")
+	{
+		strExt = tl::get_fileext2(strFile);
+
+		if(!tmp.open())
+		{
+			tl::log_err("Cannot create temporary file for \"", strFile, "\".");
+			return false;
+		}
+
+		strFile = tmp.GetFileName();
+		if(!tl::decomp_file_to_file(_strFile.c_str(), strFile.c_str()))
+		{
+			tl::log_err("Cannot decompress file \"", _strFile, "\".");
+			return false;
+		}
+	}
+
+	bool bLoaded = 0;
+	if(tl::str_is_equal(strExt, std::string("tof")))
+		bLoaded = calib_load_tof(strFile.c_str(), pipe.calib, dat4);
+	else if(tl::str_is_equal(strExt, std::string("pad")))
+		bLoaded = calib_load_pad(strFile.c_str(), pipe.calib, dat4);
+	else
+	{
+		tl::log_err("\"", _strFile, "\" is neither a tof nor a pad file.");
+		return false;
+	}
+
+	if(!bLoaded)
+	{
+		tl::log_err("Cannot load \"", _strFile, "\".");
+		return false;
+	}
+
+	dat4.CopyRoiFlagsFrom(&pipe.roi);
+	return true;
+}
+
+// fourier contrast and phase of every pixel of one foil with enough counts in the roi
+static bool write_contrast_map(const std::string& strBase, const Data4& dat4, unsigned int iFoil)
+{
+	Data3 dat3 = dat4.GetVal(iFoil);
+	dat3.CopyRoiFlagsFrom(&dat4);
+
+	const unsigned int iW = dat3.GetWidth(), iH = dat3.GetHeight(), iTCnt = dat3.GetDepth();
+	const double dNumOsc = Settings::Get<double>("mieze/num_osc");
+	const double dMinCts = Settings::Get<int>("misc/min_counts");
+
+	ReduceResult resCounts;
+	ReduceParams params;
+	params.iAxes = AXIS_T;
+	params.bUseRoi = 1;
+	reduce(dat3, params, resCounts);
+
+	std::vector<double> vecC(std::size_t(iW)*iH, 0.), vecPh(std::size_t(iW)*iH, 0.);
+	std::vector<double> vecX(iTCnt), vecY(iTCnt), vecYErr(iTCnt);
+	MFourier fourier(iTCnt);
+
+	for(unsigned int iY=0; iY<iH; ++iY)
+		for(unsigned int iX=0; iX<iW; ++iX)
+		{
+			const std::size_t iPixel = std::size_t(iY)*iW + iX;
+			const double dCts = resCounts.vecVals[iPixel];
+			if(dCts<=0. || dCts<dMinCts)
+				continue;
+
+			Data1 dat1 = dat3.GetXY(iX, iY);
+			dat1.ToArray<double>(vecX.data(), vecY.data(), vecYErr.data());
+
+			double dC=0., dPh=0.;
+			if(!fourier.get_contrast(dNumOsc, vecY.data(), dC, dPh))
+				continue;
+
+			vecC[iPixel] = (std::isnan(dC) || std::isinf(dC)) ? 0. : dC;
+			vecPh[iPixel] = (std::isnan(dPh) || std::isinf(dPh)) ? 0. : dPh;
+		}
+
+	return write_image(strBase + "_contrast.dat", iW, iH, vecC.data(), dat4.GetParamMapStat())
+		&& write_image(strBase + "_phase.dat", iW, iH, vecPh.data(), dat4.GetParamMapStat());
+}
+
+static bool process_run(const Pipeline& pipe, const std::string& strRun, const std::string& strBase,
+	Data1& datSpectrum, StringMap& mapParams)
+{
+	Data4 dat4(0, 0, 0, 0);
+	if(!load_run(pipe, strRun, dat4))
+		return false;
+	mapParams = dat4.GetParamMapStat();
+
+	if(pipe.iFoil >= int(dat4.GetDepth2()))
+	{
+		tl::log_err("\"", strRun, "\" has no foil ", pipe.iFoil, ".");
+		return false;
+	}
+
+	bool bOk = 1;
+
+	if(pipe.iFoil < 0)
+	{
+		std::vector<Data1> vecFoils = dat4.GetXYSums();
+		datSpectrum = FitData::mieze_sum_foils(vecFoils, dat4.HasPhases() ? &dat4.GetPhases() : 0);
+	}
+	else
+	{
+		datSpectrum = dat4.GetXYSum(pipe.iFoil);
+	}
+
+	if(pipe.bSpectrum)
+		bOk = write_spectrum(strBase + "_tc.dat", datSpectrum, mapParams) && bOk;
+
+	if(pipe.bImage)
+	{
+		ReduceParams params;
+		params.iAxes = AXIS_T | AXIS_FOIL;
+		params.iFoil = pipe.iFoil;
+		params.bUseRoi = 1;
+
+		ReduceResult res;
+		reduce(dat4, params, res);
+		bOk = write_image(strBase + "_img.dat", res.iDims[0], res.iDims[1],
+			res.vecVals.data(), mapParams) && bOk;
+	}
+
+	if(pipe.bContrastMap && dat4.GetDepth() < 2)
+	{
+		tl::log_warn("\"", strRun, "\" has no time channels, skipping its contrast map.");
+	}
+	else if(pipe.bContrastMap && pipe.iFoil >= 0)
+	{
+		bOk = write_contrast_map(strBase, dat4, pipe.iFoil) && bOk;
+	}
+	else if(pipe.bContrastMap)
+	{
+		// an uncorrected sum over the foils would wash out the contrast, so each foil gets its own map
+		for(unsigned int iFoil=0; iFoil<dat4.GetDepth2(); ++iFoil)
+			bOk = write_contrast_map(strBase + "_foil" + tl::var_to_str(iFoil), dat4, iFoil) && bOk;
+	}
+
+	return bOk;
+}
+
+bool run_pipeline(const Pipeline& pipe)
+{
+	const unsigned int iNumRuns = pipe.vecRuns.size();
+	if(iNumRuns == 0)
+	{
+		tl::log_err("No runs given.");
+		return false;
+	}
+
+	if(!QDir().mkpath(pipe.strOutDir.c_str()))
+	{
+		tl::log_err("Cannot create output directory \"", pipe.strOutDir, "\".");
+		return false;
+	}
+
+	const std::vector<std::string> vecNames = get_run_names(pipe);
+
+	// every task only writes to its own run
+	std::vector<Data1> vecSpectra(iNumRuns);
+	std::vector<StringMap> vecParams(iNumRuns);
+	std::unique_ptr<unsigned char[]> pbOk(new unsigned char[iNumRuns]());
+
+	WorkPool pool(pipe.iThreads);
+	for(unsigned int iRun=0; iRun<iNumRuns; ++iRun)
+	{
+		const std::string& strRun = pipe.vecRuns[iRun];
+		const std::string strBase = pipe.strOutDir + "/" + vecNames[iRun];
+		const double dCost = std::max<double>(QFileInfo(strRun.c_str()).size(), 1.);
+
+		// pools inside the runs' processing share the remaining cores
+		pool.AddTask([&pipe, &strRun, strBase, &vecSpectra, &vecParams, &pbOk, iRun]()
+		{
+			try
+			{
+				pbOk[iRun] = process_run(pipe, strRun, strBase, vecSpectra[iRun], vecParams[iRun]);
+			}
+			catch(const std::exception& ex)
+			{
+				tl::log_err("Run \"", strRun, "\" failed: ", ex.what());
+			}
+		}, dCost);
+	}
+
+	pool.Start();
+
+	const unsigned int iNumTasks = pool.GetNumTasks();
+	for(unsigned int iDone=0; iDone<iNumTasks;)
+	{
+		iDone = pool.WaitProgress(iDone);
+		tl::log_info("Processed ", iDone, " of ", iNumTasks, " runs.");
+	}
+	pool.Join();
+
+	unsigned int iNumOk = 0;
+	for(unsigned int iRun=0; iRun<iNumRuns; ++iRun)
+	{
+		if(pbOk[iRun])
+			++iNumOk;
+		else
+			tl::log_err("Run \"", pipe.vecRuns[iRun], "\" failed.");
+	}
+
+
+	if(pipe.fit.iFkt != FIT_INVALID)
+	{
+		std::vector<const Data1*> vecDat(iNumRuns, 0);
+		std::vector<double> vecX(iNumRuns, 0.);
+		for(unsigned int iRun=0; iRun<iNumRuns; ++iRun)
+		{
+			if(pbOk[iRun])
+				vecDat[iRun] = &vecSpectra[iRun];
+
+			if(pipe.strFitXKey == "")
+				vecX[iRun] = double(iRun);
+			else if(vecParams[iRun].HasKey(pipe.strFitXKey))
+				vecX[iRun] = tl::str_to_var<double>(vecParams[iRun][pipe.strFitXKey]);
+		}
+
+		FitBatchResult res;
+		FitData::fit_batch(vecDat, pipe.fit, res, &vecX);
+		if(!write_fit(pipe.strOutDir + "/fit.dat", res, vecNames, pipe.strFitXKey))
+			return false;
+	}
+
+	tl::log_info(iNumOk, " of ", iNumRuns, " runs processed successfully.");
+	return iNumOk == iNumRuns;
+}
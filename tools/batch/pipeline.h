@@ -0,0 +1,76 @@
+/**
+ * mieze-tool
+ * declarative reduction pipeline for headless batch runs
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date 19-oct-2026
+ * @license GPLv3
+ */
+
+#ifndef __MIEZE_BATCH_PIPELINE__
+#define __MIEZE_BATCH_PIPELINE__
+
+#include <string>
+#include <vector>
+
+#include "data/data.h"
+#include "data/calib.h"
+#include "data/fit_data.h"
+
+/*
+ * pipeline file, all entries are optional:
+ *
+ * <cattus_batch>
+ *	<output> results </output>
+ *	<threads> 0 </threads>
+ *	<runs> <run_0> a.tof </run_0> <run_1> b.tof.gz </run_1> </runs>
+ *		(tof or pad files; pad files have a single time channel and foil,
+ *		 they get no contrast maps)
+ *
+ *	<calib>
+ *		<enabled> 1 </enabled>
+ *		<efficiency_file> flat.pad </efficiency_file>
+ *		...  (the keys of the "calib/" settings, which are the defaults)
+ *	</calib>
+ *
+ *	<roi> roi.xml </roi>
+ *	<antiroi> antiroi.xml </antiroi>
+ *	<foil> -1 </foil>
+ *
+ *	<spectrum> 1 </spectrum>
+ *	<image> 0 </image>
+ *	<contrast_map> 0 </contrast_map>
+ *
+ *	<fit>
+ *		<function> mieze_sine </function>	(mieze_exp, gaussian, multi_gaussian, user_defined)
+ *		<x_key> tau </x_key>
+ *	</fit>
+ * </cattus_batch>
+ */
+struct Pipeline
+{
+	std::vector<std::string> vecRuns;
+	std::string strOutDir;
+	unsigned int iThreads = 0;		// runs processed at the same time, 0: all cores
+
+	CalibConfig calib;
+	RoiFlags roi;
+
+	// -1: sum over all foils, the spectra are corrected for the foil phases,
+	// the contrast maps are written for each foil
+	int iFoil = -1;
+
+	bool bSpectrum = 1;			// time channels, summed over the roi
+	bool bImage = 0;			// pixels, summed over the time channels
+	bool bContrastMap = 0;			// pixelwise contrast and phase
+
+	// fit of the spectra of all runs, FIT_INVALID: none
+	FitDataParams fit;
+	std::string strFitXKey;			// parameter of the runs used as abscissa, empty: run index
+
+	bool Load(const char* pcFile);
+};
+
+// processes all runs and writes the results, false if any run failed
+extern bool run_pipeline(const Pipeline& pipe);
+
+#endif